@@ -0,0 +1,274 @@
+// Copyright (C) 2020, Gururaj Saileshwar
+
+// Commentary:
+// Address schedule of the shared array: the entry that carries each bit, by
+// access pattern (-A, see params.hh).
+//
+// Every pattern accesses a group of pages in turn (one page per bit), and
+// moves the line within the pages by a stride; once the line wraps past the
+// end of a page, it moves on to the next group of pages, wrapping around the
+// lane's array. The patterns differ in their strides and in the order of the groups:
+// - streamline: every 3rd line, alternating between 2 pages, groups in order
+//   (BITID_2_ARRINDEX, made to sidestep the prefetchers of the paper's CPUs).
+// - stride:     a configurable stride (-A stride,<lines>,<pages>; default
+//   every 3rd line of 1 page), groups in order.
+// - permuted:   the streamline pattern (or a configurable one), with the groups
+//   in a pseudo-random order (fixed seed, so sender and receiver agree).
+// - balanced:   consecutive bits on consecutive lines, round-robin over the
+//   pages of the group (default 4; with stride s, every s-th line, s odd), so
+//   consecutive bits fall in different LLC sets, and every 64 bits cover each
+//   line of a page once: the set-index bits of the page offset are used
+//   evenly. (The other set-index bits and the slice come from physical
+//   address bits that are not known here.)
+// A pattern with a coarser stride or more pages per group uses fewer of the
+// array's lines; addr_pattern_coverage() counts them.
+//
+// Evaluated per bit, BITID_2_ARRINDEX is a division, a multiplication and two
+// modulos (one by the runtime array size) on the timed path of both loops.
+// struct addr_schedule walks the patterns with additions and compares only:
+// it keeps the line within the group, and the offset of the group already
+// reduced modulo the array size, and steps them bit by bit. A precomputed table
+// would be no cheaper to read, and its period (the array size) would put
+// megabytes of schedule in the caches the channel uses; the permuted pattern
+// keeps a table of the groups only.
+//
+// The sender re-accesses the address of the bit lag_delta behind. struct
+// addr_lag_ring keeps the addresses it accessed (payload already applied), so
+// the re-access is a load from a ring of addresses instead of a second
+// evaluation of the schedule and of the payload.
+
+#ifndef ADDR_SCHEDULE_H_
+#define ADDR_SCHEDULE_H_
+
+#include "utils.hh"
+#include "params.hh"
+
+//-------- Access Pattern ----------
+// Access every 3n cacheline alternating between page 0 and page 1, then continue to pages 2,3 .. 4,5 ... and so on.
+#define PG_NUM(l) (((uint64_t)(((uint64_t)(l/2))*3/CL_IN_PAGE))*2 + l%2)
+#define CL_NUM(l) ((((uint64_t)(l/2))*3 + 14) % CL_IN_PAGE)
+#define BITID_2_ARRINDEX(l) ( PG_NUM(l)*ENTRY_PER_PAGE + CL_NUM(l)*ENTRY_PER_CL )
+// Entries skipped at the start of the array, and line of a page at which the patterns start
+#define SCHEDULE_ENTRY_OFFSET (4)
+#define SCHEDULE_LINE_OFFSET (14)
+// Seed of the group order of the permuted pattern
+#define SCHEDULE_PERMUTATION_SEED (0x9e3779b97f4a7c15ULL)
+
+// Geometry of a pattern
+struct addr_pattern {
+  uint64_t pages;         //pages of a group, accessed in turn
+  uint64_t round_stride;  //lines advanced once every page of the group was accessed
+  uint64_t page_stride;   //lines between the accesses to consecutive pages of the group
+  bool permuted;          //groups in pseudo-random order
+};
+
+/*
+ * Fills in the default stride and pages of p->pattern, and checks them. Returns false if they are invalid.
+ */
+static bool addr_pattern_resolve(struct channel_params* p)
+{
+  bool balanced = (p->pattern == PATTERN_BALANCED);
+  if(p->pattern_stride == 0)
+    p->pattern_stride = balanced ? 1 : 3;
+  if(p->pattern_pages == 0)
+    p->pattern_pages = (p->pattern == PATTERN_STRIDE) ? 1 : (balanced ? 4 : 2);
+  if(p->pattern == PATTERN_STREAMLINE && (p->pattern_stride != 3 || p->pattern_pages != 2))
+    return false;
+  if(balanced && p->pattern_stride % 2 == 0)
+    return false;
+  return p->pattern_stride < CL_IN_PAGE && p->pattern_pages <= CL_IN_PAGE &&
+         (!balanced || p->pattern_stride*p->pattern_pages < CL_IN_PAGE);
+}
+
+static void addr_pattern_init(struct addr_pattern* a, const struct channel_params* p)
+{
+  a->pages = p->pattern_pages;
+  a->permuted = (p->pattern == PATTERN_PERMUTED);
+  if(p->pattern == PATTERN_BALANCED){
+    a->round_stride = p->pattern_stride*p->pattern_pages;
+    a->page_stride = p->pattern_stride;
+  } else {
+    a->round_stride = p->pattern_stride;
+    a->page_stride = 0;
+  }
+}
+
+// Position of the schedule at a bit-id (streamline: BITID_2_ARRINDEX(l) % numentries + SCHEDULE_ENTRY_OFFSET)
+struct addr_schedule {
+  struct addr_pattern pattern;
+  uint64_t group_offset;  //entry of the group, modulo the array size
+  uint64_t page_offset;   //entry of the page in the group
+  uint64_t page;          //page in the group
+  uint64_t round_line;    //line of the group's first page, before the SCHEDULE_LINE_OFFSET rotation
+  uint64_t line;          //line of the page, before the rotation
+  uint64_t group;         //groups passed
+  //Permuted pattern: order of the groups, and position in it
+  uint32_t* group_order;
+  uint64_t num_groups, order_pos;
+};
+
+/*
+ * Positions s at bit-id l of the pattern of p, for an array of numentries (at
+ * least a group of pages).
+ */
+static void addr_schedule_init(struct addr_schedule* s, uint64_t l, uint64_t numentries, const struct channel_params* p)
+{
+  addr_pattern_init(&s->pattern, p);
+  struct addr_pattern* a = &s->pattern;
+  s->group_order = NULL;
+  s->num_groups = 0;
+  if(a->permuted){
+    //Fisher-Yates shuffle of the whole groups of the array
+    s->num_groups = numentries/(a->pages*ENTRY_PER_PAGE);
+    s->group_order = (uint32_t*) malloc(s->num_groups*sizeof(uint32_t));
+    uint64_t x = SCHEDULE_PERMUTATION_SEED;
+    for(uint64_t g=0; g<s->num_groups; g++)
+      s->group_order[g] = g;
+    for(uint64_t g=s->num_groups - 1; g>0; g--){
+      x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+      uint64_t k = x % (g + 1);
+      uint32_t t = s->group_order[g];
+      s->group_order[g] = s->group_order[k];
+      s->group_order[k] = t;
+    }
+  }
+
+  uint64_t round = l/a->pages;
+  uint64_t lines = round*a->round_stride;
+  s->group = lines/CL_IN_PAGE;
+  if(a->permuted){
+    s->order_pos = s->group % s->num_groups;
+    s->group_offset = s->group_order[s->order_pos]*a->pages*ENTRY_PER_PAGE;
+  } else
+    s->group_offset = s->group*a->pages*ENTRY_PER_PAGE % numentries;
+  s->round_line = lines%CL_IN_PAGE;
+  s->page = l%a->pages;
+  s->page_offset = s->page*ENTRY_PER_PAGE;
+  s->line = s->round_line + s->page*a->page_stride;
+}
+
+static void addr_schedule_free(struct addr_schedule* s)
+{
+  free(s->group_order);
+  s->group_order = NULL;
+}
+
+/*
+ * Entry of the array at the current bit.
+ */
+inline __attribute__((always_inline))
+uint64_t addr_schedule_index(const struct addr_schedule* s, uint64_t numentries)
+{
+  uint64_t index = s->group_offset + s->page_offset + ((s->line + SCHEDULE_LINE_OFFSET) & (CL_IN_PAGE - 1))*ENTRY_PER_CL;
+  if(index >= numentries)
+    index -= numentries;
+  return index + SCHEDULE_ENTRY_OFFSET;
+}
+
+/*
+ * Steps s to the next bit.
+ */
+inline __attribute__((always_inline))
+void addr_schedule_next(struct addr_schedule* s, uint64_t numentries)
+{
+  s->page++;
+  if(s->page < s->pattern.pages){
+    //Next page of the group
+    s->page_offset += ENTRY_PER_PAGE;
+    s->line += s->pattern.page_stride;
+    return;
+  }
+  s->page = 0;
+  s->page_offset = 0;
+  s->round_line += s->pattern.round_stride;
+  if(s->round_line >= CL_IN_PAGE){
+    //Next group
+    s->round_line -= CL_IN_PAGE;
+    s->group++;
+    if(s->group_order){
+      s->order_pos = (s->order_pos + 1 == s->num_groups) ? 0 : s->order_pos + 1;
+      s->group_offset = s->group_order[s->order_pos]*s->pattern.pages*ENTRY_PER_PAGE;
+    } else {
+      s->group_offset += s->pattern.pages*ENTRY_PER_PAGE;
+      if(s->group_offset >= numentries)
+        s->group_offset -= numentries;
+    }
+  }
+  s->line = s->round_line;
+}
+
+/*
+ * Fraction of the lines of an array of numentries accessed by a pass of the
+ * pattern of p over it, and the bits of a pass.
+ */
+static double addr_pattern_coverage(const struct channel_params* p, uint64_t numentries, uint64_t* pass_bits)
+{
+  struct addr_schedule s;
+  addr_schedule_init(&s, 0, numentries, p);
+  uint64_t num_lines = numentries/ENTRY_PER_CL + 1;
+  std::vector<bool> used(num_lines, false);
+  uint64_t groups = s.group_order ? s.num_groups : (numentries + s.pattern.pages*ENTRY_PER_PAGE - 1)/(s.pattern.pages*ENTRY_PER_PAGE);
+  uint64_t distinct = 0, bits = 0;
+  while(s.group < groups){
+    uint64_t line = (addr_schedule_index(&s, numentries) - SCHEDULE_ENTRY_OFFSET)/ENTRY_PER_CL;
+    if(!used[line]){
+      used[line] = true;
+      distinct++;
+    }
+    bits++;
+    addr_schedule_next(&s, numentries);
+  }
+  addr_schedule_free(&s);
+  *pass_bits = bits;
+  return 1.0*distinct/(numentries/ENTRY_PER_CL);
+}
+
+static void addr_pattern_print(const struct channel_params* p, uint64_t numentries)
+{
+  uint64_t pass_bits;
+  double coverage = addr_pattern_coverage(p, numentries, &pass_bits);
+  printf("Access Pattern: %s, stride %llu lines, %llu pages. Uses %.1f%% of the lines of the lane's array,"
+         " %llu bits per pass.\n", pattern_names[p->pattern], p->pattern_stride, p->pattern_pages,
+         100*coverage, pass_bits);
+}
+
+// Addresses of the last bits (a power of two of them, more than the lag)
+struct addr_lag_ring {
+  uintptr_t* addr;
+  uint64_t mask;
+};
+
+static void addr_lag_ring_init(struct addr_lag_ring* r, uint64_t lag)
+{
+  uint64_t size = 1;
+  while(size <= lag)
+    size *= 2;
+  r->addr = (uintptr_t*) calloc(size, sizeof(uintptr_t));
+  r->mask = size - 1;
+}
+
+static void addr_lag_ring_free(struct addr_lag_ring* r)
+{
+  free(r->addr);
+  r->addr = NULL;
+}
+
+inline __attribute__((always_inline))
+void addr_lag_ring_push(struct addr_lag_ring* r, uint64_t bit_id, uintptr_t addr)
+{
+  r->addr[bit_id & r->mask] = addr;
+}
+
+/*
+ * Address pushed at bit_id - lag (which has to be less than the ring size behind).
+ */
+inline __attribute__((always_inline))
+uintptr_t addr_lag_ring_get(const struct addr_lag_ring* r, uint64_t bit_id, uint64_t lag)
+{
+  return r->addr[(bit_id - lag) & r->mask];
+}
+
+#endif
+
+//
+// addr_schedule.hh ends here
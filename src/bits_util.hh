@@ -1,56 +1,221 @@
 // String handling functions from "https://github.com/yshalabi/covert-channel-tutorial"
 
+// Commentary:
+// Packing and unpacking between bit arrays (one bool per bit) and bytes/words.
+// The first bit of the array is the most-significant bit of the first byte
+// (or word). Each kernel has a BMI2 (pext/pdep), an SSSE3 (pshufb+movemask)
+// and a portable (multiply) version; the SSSE3 one is preferred at startup
+// when supported, as pext/pdep are microcoded and slow on AMD before Zen 3.
+
+#ifndef BITS_UTIL_H_
+#define BITS_UTIL_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <x86intrin.h>
+
+#define BITS_IMPL_GENERIC (0)
+#define BITS_IMPL_BMI2    (1)
+#define BITS_IMPL_SSE     (2)
+
+//byte j of a word of 8 bools (little-endian load) is bit j of the array
+#define BITS_BYTE_LSBS  (0x0101010101010101ULL)
+//multiplier gathering the 8 bools of a word into its top byte, first bool most significant
+#define BITS_PACK_MUL   (0x8040201008040201ULL)
+//mask selecting bit 7-j of a broadcast byte in byte j
+#define BITS_UNPACK_SEL (0x0102040810204080ULL)
+
+static inline uint8_t pack_byte_generic(const bool* bits)
+{
+  uint64_t x;
+  memcpy(&x, bits, 8);
+  return (uint8_t)((x * BITS_PACK_MUL) >> 56);
+}
+
+static inline void unpack_byte_generic(uint8_t byte, bool* bits)
+{
+  uint64_t x = (byte * BITS_BYTE_LSBS) & BITS_UNPACK_SEL;
+  x = ((x + 0x7F7F7F7F7F7F7F7FULL) >> 7) & BITS_BYTE_LSBS;
+  memcpy(bits, &x, 8);
+}
+
+static void pack_bits_generic(const bool* bits, size_t num_bytes, uint8_t* bytes)
+{
+  for(size_t i = 0; i < num_bytes; i++)
+    bytes[i] = pack_byte_generic(&bits[8*i]);
+}
+
+static void unpack_bits_generic(const uint8_t* bytes, size_t num_bytes, bool* bits)
+{
+  for(size_t i = 0; i < num_bytes; i++)
+    unpack_byte_generic(bytes[i], &bits[8*i]);
+}
+
+__attribute__((target("bmi2")))
+static void pack_bits_bmi2(const bool* bits, size_t num_bytes, uint8_t* bytes)
+{
+  for(size_t i = 0; i < num_bytes; i++){
+    uint64_t x;
+    memcpy(&x, &bits[8*i], 8);
+    bytes[i] = (uint8_t)_pext_u64(__builtin_bswap64(x), BITS_BYTE_LSBS);
+  }
+}
+
+__attribute__((target("bmi2")))
+static void unpack_bits_bmi2(const uint8_t* bytes, size_t num_bytes, bool* bits)
+{
+  for(size_t i = 0; i < num_bytes; i++){
+    uint64_t x = __builtin_bswap64(_pdep_u64(bytes[i], BITS_BYTE_LSBS));
+    memcpy(&bits[8*i], &x, 8);
+  }
+}
+
+__attribute__((target("ssse3")))
+static void pack_bits_sse(const bool* bits, size_t num_bytes, uint8_t* bytes)
+{
+  //reverse every group of 8 bools, so that the first one lands in bit 7 of the mask byte
+  const __m128i rev = _mm_setr_epi8(7,6,5,4,3,2,1,0, 15,14,13,12,11,10,9,8);
+  size_t i = 0;
+  for(; i + 2 <= num_bytes; i += 2){
+    __m128i v = _mm_loadu_si128((const __m128i*) &bits[8*i]);
+    v = _mm_slli_epi64(_mm_shuffle_epi8(v, rev), 7);
+    uint16_t m = (uint16_t)_mm_movemask_epi8(v);
+    memcpy(&bytes[i], &m, 2);
+  }
+  pack_bits_generic(&bits[8*i], num_bytes - i, &bytes[i]);
+}
+
+__attribute__((target("ssse3")))
+static void unpack_bits_sse(const uint8_t* bytes, size_t num_bytes, bool* bits)
+{
+  const __m128i bcast = _mm_setr_epi8(0,0,0,0,0,0,0,0, 1,1,1,1,1,1,1,1);
+  const __m128i sel = _mm_setr_epi8((char)0x80,0x40,0x20,0x10,0x08,0x04,0x02,0x01,
+                                    (char)0x80,0x40,0x20,0x10,0x08,0x04,0x02,0x01);
+  const __m128i one = _mm_set1_epi8(1);
+  size_t i = 0;
+  for(; i + 2 <= num_bytes; i += 2){
+    uint16_t b;
+    memcpy(&b, &bytes[i], 2);
+    __m128i v = _mm_shuffle_epi8(_mm_cvtsi32_si128(b), bcast);
+    v = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(v, sel), sel), one);
+    _mm_storeu_si128((__m128i*) &bits[8*i], v);
+  }
+  unpack_bits_generic(&bytes[i], num_bytes - i, &bits[8*i]);
+}
+
+typedef void (*pack_bits_fn)(const bool*, size_t, uint8_t*);
+typedef void (*unpack_bits_fn)(const uint8_t*, size_t, bool*);
+static pack_bits_fn pack_bits_impl = pack_bits_generic;
+static unpack_bits_fn unpack_bits_impl = unpack_bits_generic;
+
+/*
+ * Select the packing kernels impl, or the fastest one below it the CPU supports.
+ */
+static int bits_select_impl(int impl)
+{
+  __builtin_cpu_init();
+  if(impl >= BITS_IMPL_SSE && __builtin_cpu_supports("ssse3")){
+    pack_bits_impl = pack_bits_sse;
+    unpack_bits_impl = unpack_bits_sse;
+    return BITS_IMPL_SSE;
+  }
+  if(impl >= BITS_IMPL_BMI2 && __builtin_cpu_supports("bmi2")){
+    pack_bits_impl = pack_bits_bmi2;
+    unpack_bits_impl = unpack_bits_bmi2;
+    return BITS_IMPL_BMI2;
+  }
+  pack_bits_impl = pack_bits_generic;
+  unpack_bits_impl = unpack_bits_generic;
+  return BITS_IMPL_GENERIC;
+}
+
+static const char* bits_impl_name(int impl)
+{
+  switch(impl){
+  case BITS_IMPL_SSE:  return "sse";
+  case BITS_IMPL_BMI2: return "bmi2";
+  default:             return "generic";
+  }
+}
+
+__attribute__((constructor))
+static void bits_init()
+{
+  bits_select_impl(BITS_IMPL_SSE);
+}
+
+/*
+ * Pack 8*num_bytes bits into num_bytes bytes.
+ */
+static inline void pack_bits(const bool* bits, size_t num_bytes, uint8_t* bytes)
+{
+  pack_bits_impl(bits, num_bytes, bytes);
+}
+
+/*
+ * Unpack num_bytes bytes into 8*num_bytes bits.
+ */
+static inline void unpack_bits(const uint8_t* bytes, size_t num_bytes, bool* bits)
+{
+  unpack_bits_impl(bytes, num_bytes, bits);
+}
+
+/*
+ * Pack 64 bits into a word (first bit most significant).
+ */
+static inline uint64_t pack_bits_word(const bool* bits)
+{
+  uint8_t bytes[8];
+  pack_bits(bits, 8, bytes);
+  uint64_t word;
+  memcpy(&word, bytes, 8);
+  return __builtin_bswap64(word);
+}
+
+/*
+ * Unpack a word into 64 bits (most-significant bit first).
+ */
+static inline void unpack_bits_word(uint64_t word, bool* bits)
+{
+  word = __builtin_bswap64(word);
+  uint8_t bytes[8];
+  memcpy(bytes, &word, 8);
+  unpack_bits(bytes, 8, bits);
+}
+
 /*
  * Convert a given ASCII string to a binary string.
  * From:
  * https://stackoverflow.com/questions/41384262/convert-string-to-binary-in-c
  */
-bool* string_to_binary(uint8_t *s,int num_bytes, bool* binary) 
+bool* string_to_binary(uint8_t *s,int num_bytes, bool* binary)
 {
   if (s == NULL) return 0; /* no input string */
 
-  size_t len = num_bytes; 
-
-  // Each char is one byte (8 bits) and + 1 at the end for null terminator   
-  for (size_t i = 0; i < len; ++i) { 
-    uint8_t ch = s[i]; 
-    for (int j = 7; j >= 0; --j) { 
-      binary[i*8 + 7-j] = ch & (1 << j);
-    } 
-  } 
-
-   return binary; 
- } 
+  unpack_bits(s, num_bytes, binary);
+  return binary;
+}
 
 /*
  * Convert 8 bit data stream into character and return
  */
 uint8_t *conv_char(bool *data, int size, uint8_t *msg)
 {
-  for (int i = 0; i < size; i++) {
-    char tmp[8];
-    int k = 0;
-
-    for (int j = i * 8; j < ((i + 1) * 8); j++) {
-      if(data[j])
-        tmp[k++] = '1';
-      else
-        tmp[k++] = '0';  	
-    }
-
-    char tm = strtol(tmp, 0, 2);
-    msg[i] = (uint8_t)tm;
-  }
-
-  // msg[size] = '\0';
+  pack_bits(data, size, msg);
   return msg;
 }
 
-void print_bool_array(bool* array, int num_entries){  
+void print_bool_array(bool* array, int num_entries){
   for(int i =0; i<num_entries; i++){
     printf("%d",array[i]);
     if(i%8 == 7)
-      printf(" ");    
+      printf(" ");
   }
   printf("\n");
 }
+
+#endif
+
+//
+// bits_util.hh ends here
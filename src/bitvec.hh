@@ -0,0 +1,186 @@
+// Copyright (C) 2020, Gururaj Saileshwar
+
+// Commentary:
+// Packed bit-vector used for the payload and the received bits.
+//
+// Bits are stored 64 to a word, MSB-first: bit i of the stream is bit (63 - i%64)
+// of words[i/64]. A byte-aligned slice therefore has the same bit-order as
+// string_to_binary() and conv_char().
+
+#ifndef BITVEC_H_
+#define BITVEC_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BITVEC_WORD_BITS (64)
+
+struct bitvec {
+  uint64_t* words;
+  uint64_t num_bits;
+  uint64_t num_words;
+};
+
+//Error counts from comparing a transmitted and received bit-vector.
+struct bitvec_err_stats {
+  uint64_t samples;   //bits compared
+  uint64_t errors;    //bits that differ
+  uint64_t one2zero;  //sent 1, received 0
+  uint64_t zero2one;  //sent 0, received 1
+  uint64_t tx_ones;   //sent 1
+};
+
+/*
+ * Allocate a zeroed bit-vector of num_bits (one spare word at the end so that
+ * unaligned 64-bit reads at the tail never run off the allocation).
+ */
+static inline void bitvec_alloc(struct bitvec* bv, uint64_t num_bits)
+{
+  bv->num_bits = num_bits;
+  bv->num_words = (num_bits + BITVEC_WORD_BITS - 1)/BITVEC_WORD_BITS;
+  bv->words = (uint64_t*) calloc(bv->num_words + 1, sizeof(uint64_t));
+  if(bv->words == NULL){
+    printf("Failed to allocate bit-vector of %llu bits\n", (unsigned long long) num_bits);
+    exit(1);
+  }
+}
+
+static inline void bitvec_free(struct bitvec* bv)
+{
+  free(bv->words);
+  bv->words = NULL;
+  bv->num_bits = bv->num_words = 0;
+}
+
+static inline uint64_t bitvec_size_bytes(const struct bitvec* bv)
+{
+  return (bv->num_words + 1)*sizeof(uint64_t);
+}
+
+inline __attribute__((always_inline))
+bool bitvec_get(const struct bitvec* bv, uint64_t i)
+{
+  return (bv->words[i/BITVEC_WORD_BITS] >> (BITVEC_WORD_BITS - 1 - i%BITVEC_WORD_BITS)) & 1;
+}
+
+inline __attribute__((always_inline))
+void bitvec_set(struct bitvec* bv, uint64_t i, bool val)
+{
+  uint64_t mask = (uint64_t)1 << (BITVEC_WORD_BITS - 1 - i%BITVEC_WORD_BITS);
+  if(val)
+    bv->words[i/BITVEC_WORD_BITS] |= mask;
+  else
+    bv->words[i/BITVEC_WORD_BITS] &= ~mask;
+}
+
+/*
+ * Read n (1..64) bits starting at bit pos. The first bit read ends up as the
+ * most-significant of the n right-aligned bits returned.
+ */
+static inline uint64_t bitvec_get_bits(const struct bitvec* bv, uint64_t pos, unsigned int n)
+{
+  uint64_t w = pos/BITVEC_WORD_BITS;
+  unsigned int off = pos%BITVEC_WORD_BITS;
+  uint64_t val = bv->words[w] << off;
+  if(off + n > BITVEC_WORD_BITS)
+    val |= bv->words[w+1] >> (BITVEC_WORD_BITS - off);
+  return val >> (BITVEC_WORD_BITS - n);
+}
+
+/*
+ * Write the n (1..64) right-aligned bits of val starting at bit pos.
+ */
+static inline void bitvec_set_bits(struct bitvec* bv, uint64_t pos, unsigned int n, uint64_t val)
+{
+  uint64_t w = pos/BITVEC_WORD_BITS;
+  unsigned int off = pos%BITVEC_WORD_BITS;
+  uint64_t mask = ~(uint64_t)0 << (BITVEC_WORD_BITS - n);
+  uint64_t aligned = (val << (BITVEC_WORD_BITS - n)) & mask;
+
+  bv->words[w] = (bv->words[w] & ~(mask >> off)) | (aligned >> off);
+  if(off + n > BITVEC_WORD_BITS){
+    bv->words[w+1] = (bv->words[w+1] & ~(mask << (BITVEC_WORD_BITS - off))) \
+      | (aligned << (BITVEC_WORD_BITS - off));
+  }
+}
+
+/*
+ * Copy the n bits at spos of src to dpos of dst, 64 bits at a time.
+ */
+static inline void bitvec_copy_bits(struct bitvec* dst, uint64_t dpos, const struct bitvec* src, uint64_t spos, uint64_t n)
+{
+  for(uint64_t i=0; i<n; i+=BITVEC_WORD_BITS){
+    unsigned int len = (n - i) < BITVEC_WORD_BITS ? (n - i) : BITVEC_WORD_BITS;
+    bitvec_set_bits(dst, dpos + i, len, bitvec_get_bits(src, spos + i, len));
+  }
+}
+
+/*
+ * Accumulate the errors between tx and rx over bits [pos, pos+n) into stats,
+ * using XOR and popcount 64 bits at a time.
+ */
+static inline void bitvec_compare(const struct bitvec* tx, const struct bitvec* rx,
+                                  uint64_t pos, uint64_t n, struct bitvec_err_stats* stats)
+{
+  uint64_t end = pos + n;
+  while(pos < end){
+    unsigned int len = (end - pos) < BITVEC_WORD_BITS ? (end - pos) : BITVEC_WORD_BITS;
+    uint64_t tx_bits = bitvec_get_bits(tx, pos, len);
+    uint64_t diff = tx_bits ^ bitvec_get_bits(rx, pos, len);
+
+    stats->errors += __builtin_popcountll(diff);
+    stats->one2zero += __builtin_popcountll(diff & tx_bits);
+    stats->zero2one += __builtin_popcountll(diff & ~tx_bits);
+    stats->tx_ones += __builtin_popcountll(tx_bits);
+    stats->samples += len;
+    pos += len;
+  }
+}
+
+/*
+ * As bitvec_compare, for the bits of [pos, pos+n) set in mask only.
+ */
+static inline void bitvec_compare_masked(const struct bitvec* tx, const struct bitvec* rx, const struct bitvec* mask,
+                                         uint64_t pos, uint64_t n, struct bitvec_err_stats* stats)
+{
+  uint64_t end = pos + n;
+  while(pos < end){
+    unsigned int len = (end - pos) < BITVEC_WORD_BITS ? (end - pos) : BITVEC_WORD_BITS;
+    uint64_t m = bitvec_get_bits(mask, pos, len);
+    uint64_t tx_bits = bitvec_get_bits(tx, pos, len) & m;
+    uint64_t diff = (tx_bits ^ bitvec_get_bits(rx, pos, len)) & m;
+
+    stats->errors += __builtin_popcountll(diff);
+    stats->one2zero += __builtin_popcountll(diff & tx_bits);
+    stats->zero2one += __builtin_popcountll(diff & ~tx_bits);
+    stats->tx_ones += __builtin_popcountll(tx_bits);
+    stats->samples += __builtin_popcountll(m);
+    pos += len;
+  }
+}
+
+/*
+ * Conversion between a 64-bit word and 8 bytes (first byte = most-significant),
+ * matching the bit-order of the packed vector.
+ */
+static inline uint64_t bytes_to_word(const uint8_t* bytes)
+{
+  uint64_t word = 0;
+  for(int i = 0; i < 8; i++)
+    word = (word << 8) | bytes[i];
+  return word;
+}
+
+static inline void word_to_bytes(uint64_t word, uint8_t* bytes)
+{
+  for(int i = 7; i >= 0; i--){
+    bytes[i] = (uint8_t) word;
+    word >>= 8;
+  }
+}
+
+#endif
+
+//
+// bitvec.hh ends here
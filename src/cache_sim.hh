@@ -0,0 +1,478 @@
+// Copyright (C) 2020, Gururaj Saileshwar
+
+// Commentary:
+// Software model of the cache hierarchy, behind the simulator memory backend
+// (see mem_backend.hh): runs the sender and the receiver without Intel
+// hardware, a shared LLC or root privileges.
+//
+// Every core has a private L1 and L2 (L1 in L2); the LLC is shared,
+// set-associative and inclusive (an LLC eviction invalidates the line in every
+// private cache), with LRU, SRRIP or random replacement. A flush removes the
+// line from every cache.
+//
+// Each simulated thread (agent) runs on a core and has a virtual cycle clock,
+// advanced by its timer reads, flushes and loads. A load costs the latency of
+// the level that serves it, drawn around the level's mean with a deterministic
+// per-agent generator. The agents run in lockstep: an access is applied once
+// the clocks of all other agents have passed it, so the caches see accesses in
+// virtual-time order and a run only depends on the configuration and seed.
+//
+// The simulator runs one sender and one receiver thread (SIM_NUM_AGENTS), in
+// one process (see sim_channel.cc).
+
+#ifndef CACHE_SIM_H_
+#define CACHE_SIM_H_
+
+#include <atomic>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define SIM_LINE_SZ (64)
+#define SIM_MAX_CORES (16)
+#define SIM_NUM_AGENTS (2)   /* sender and receiver */
+
+// LLC replacement policies
+#define SIM_REPL_LRU    (0)
+#define SIM_REPL_SRRIP  (1)
+#define SIM_REPL_RANDOM (2)
+#define SIM_SRRIP_MAX   (3)  /* 2-bit re-reference prediction values */
+
+// Levels that serve a load
+#define SIM_L1  (0)
+#define SIM_L2  (1)
+#define SIM_LLC (2)
+#define SIM_MEM (3)
+#define SIM_NUM_LEVELS (4)
+
+struct sim_config {
+  uint64_t size[SIM_MEM];            //bytes of L1, L2, LLC
+  uint64_t ways[SIM_MEM];
+  uint64_t lat[SIM_NUM_LEVELS];      //mean load latency (cycles) from L1, L2, LLC, memory
+  uint64_t jitter[SIM_NUM_LEVELS];   //its standard deviation
+  int llc_repl;
+  uint64_t timer_cycles;             //cost of a timer read
+  uint64_t flush_cycles;             //cost of a flush
+  uint64_t seed;
+};
+
+struct sim_cache {
+  uint64_t num_sets;
+  uint64_t ways;
+  int repl;
+  uint64_t* tags;      //line number + 1 (0: invalid)
+  uint64_t* state;     //LRU: time of last use; SRRIP: re-reference prediction value
+};
+
+struct sim_agent {
+  int core;
+  std::atomic<uint64_t> clock;
+  std::atomic<bool> active;
+  uint64_t rng;
+  uint64_t loads[SIM_NUM_LEVELS];    //loads served by each level
+  uint64_t flushes;
+};
+
+struct sim_state {
+  struct sim_config cfg;
+  struct sim_cache l1[SIM_MAX_CORES], l2[SIM_MAX_CORES], llc;
+  struct sim_agent agents[SIM_NUM_AGENTS];
+  std::atomic<int> num_agents;       //agents attached so far
+  pthread_mutex_t lock;              //cache state
+  pthread_mutex_t config_lock;       //option parsing of the programs
+  uint64_t use_count;                //LRU time
+  uint64_t rng;                      //random replacement
+  uint64_t llc_evictions, back_invalidations;
+  void* shared_region;
+  uint64_t shared_size;
+};
+
+static struct sim_state sim;
+static __thread struct sim_agent* sim_self;   //agent of the calling thread (NULL: not simulated)
+
+/*
+ * Deterministic generator (xorshift64*).
+ */
+static inline uint64_t sim_rand(uint64_t* s)
+{
+  *s ^= *s >> 12;
+  *s ^= *s << 25;
+  *s ^= *s >> 27;
+  return *s * 2685821657736338717ULL;
+}
+
+static void sim_config_init(struct sim_config* cfg, uint64_t llc_size)
+{
+  cfg->size[SIM_L1] = 32*1024;   cfg->ways[SIM_L1] = 8;
+  cfg->size[SIM_L2] = 256*1024;  cfg->ways[SIM_L2] = 4;
+  cfg->size[SIM_LLC] = llc_size; cfg->ways[SIM_LLC] = 16;
+  cfg->lat[SIM_L1] = 4;    cfg->jitter[SIM_L1] = 0;
+  cfg->lat[SIM_L2] = 14;   cfg->jitter[SIM_L2] = 1;
+  cfg->lat[SIM_LLC] = 50;  cfg->jitter[SIM_LLC] = 6;
+  cfg->lat[SIM_MEM] = 250; cfg->jitter[SIM_MEM] = 25;
+  cfg->llc_repl = SIM_REPL_LRU;
+  cfg->timer_cycles = 25;
+  cfg->flush_cycles = 40;
+  cfg->seed = 42;
+}
+
+static const char* sim_repl_name(int repl)
+{
+  switch(repl){
+  case SIM_REPL_SRRIP:  return "srrip";
+  case SIM_REPL_RANDOM: return "random";
+  default:              return "lru";
+  }
+}
+
+//------------------------------------------------------------------------
+// Set-associative cache
+//------------------------------------------------------------------------
+
+static void sim_cache_init(struct sim_cache* c, uint64_t size, uint64_t ways, int repl)
+{
+  c->ways = ways;
+  c->num_sets = size/SIM_LINE_SZ/ways;
+  c->repl = repl;
+  c->tags = (uint64_t*) calloc(c->num_sets*ways, sizeof(uint64_t));
+  c->state = (uint64_t*) calloc(c->num_sets*ways, sizeof(uint64_t));
+}
+
+/*
+ * Slot (set*ways + way) holding line, or -1.
+ */
+static inline int64_t sim_cache_find(const struct sim_cache* c, uint64_t line)
+{
+  uint64_t base = (line % c->num_sets)*c->ways;
+  for(uint64_t w=0; w<c->ways; w++)
+    if(c->tags[base + w] == line + 1)
+      return base + w;
+  return -1;
+}
+
+static inline void sim_cache_hit(struct sim_cache* c, int64_t slot)
+{
+  if(c->repl == SIM_REPL_SRRIP)
+    c->state[slot] = 0;
+  else
+    c->state[slot] = ++sim.use_count;
+}
+
+/*
+ * Inserts line (not present), and returns the line evicted for it (+1, 0: none).
+ */
+static uint64_t sim_cache_fill(struct sim_cache* c, uint64_t line)
+{
+  uint64_t base = (line % c->num_sets)*c->ways;
+  int64_t victim = -1;
+  for(uint64_t w=0; w<c->ways && victim<0; w++)
+    if(c->tags[base + w] == 0)
+      victim = base + w;
+
+  if(victim < 0){
+    switch(c->repl){
+    case SIM_REPL_SRRIP:
+      while(victim < 0){
+        for(uint64_t w=0; w<c->ways && victim<0; w++)
+          if(c->state[base + w] >= SIM_SRRIP_MAX)
+            victim = base + w;
+        if(victim < 0)
+          for(uint64_t w=0; w<c->ways; w++)
+            c->state[base + w]++;
+      }
+      break;
+    case SIM_REPL_RANDOM:
+      victim = base + sim_rand(&sim.rng) % c->ways;
+      break;
+    default:
+      victim = base;
+      for(uint64_t w=1; w<c->ways; w++)
+        if(c->state[base + w] < c->state[victim])
+          victim = base + w;
+    }
+  }
+
+  uint64_t evicted = c->tags[victim];
+  c->tags[victim] = line + 1;
+  c->state[victim] = (c->repl == SIM_REPL_SRRIP) ? SIM_SRRIP_MAX - 1 : ++sim.use_count;
+  return evicted;
+}
+
+static inline bool sim_cache_invalidate(struct sim_cache* c, uint64_t line)
+{
+  int64_t slot = sim_cache_find(c, line);
+  if(slot < 0)
+    return false;
+  c->tags[slot] = 0;
+  return true;
+}
+
+//------------------------------------------------------------------------
+// Hierarchy (called with sim.lock held)
+//------------------------------------------------------------------------
+
+static void sim_private_fill(int core, uint64_t line)
+{
+  if(sim_cache_find(&sim.l2[core], line) < 0){
+    uint64_t evicted = sim_cache_fill(&sim.l2[core], line);
+    if(evicted)
+      sim_cache_invalidate(&sim.l1[core], evicted - 1);
+  }
+  sim_cache_fill(&sim.l1[core], line);
+}
+
+/*
+ * Load of line by core (-1: no private caches). Returns the level that served it.
+ */
+static int sim_hier_load(int core, uint64_t line)
+{
+  int64_t slot;
+  if(core >= 0){
+    if((slot = sim_cache_find(&sim.l1[core], line)) >= 0){
+      sim_cache_hit(&sim.l1[core], slot);
+      return SIM_L1;
+    }
+    if((slot = sim_cache_find(&sim.l2[core], line)) >= 0){
+      sim_cache_hit(&sim.l2[core], slot);
+      sim_cache_fill(&sim.l1[core], line);
+      return SIM_L2;
+    }
+  }
+
+  int level = SIM_LLC;
+  if((slot = sim_cache_find(&sim.llc, line)) >= 0){
+    sim_cache_hit(&sim.llc, slot);
+  } else {
+    level = SIM_MEM;
+    uint64_t evicted = sim_cache_fill(&sim.llc, line);
+    if(evicted){
+      //Inclusive LLC: back-invalidate the private copies
+      sim.llc_evictions++;
+      for(int c=0; c<SIM_MAX_CORES; c++){
+        if(sim.l2[c].tags == NULL)
+          continue;
+        bool in_l1 = sim_cache_invalidate(&sim.l1[c], evicted - 1);
+        bool in_l2 = sim_cache_invalidate(&sim.l2[c], evicted - 1);
+        if(in_l1 || in_l2)
+          sim.back_invalidations++;
+      }
+    }
+  }
+  if(core >= 0)
+    sim_private_fill(core, line);
+  return level;
+}
+
+static void sim_hier_flush(uint64_t line)
+{
+  sim_cache_invalidate(&sim.llc, line);
+  for(int c=0; c<SIM_MAX_CORES; c++){
+    if(sim.l2[c].tags == NULL)
+      continue;
+    sim_cache_invalidate(&sim.l1[c], line);
+    sim_cache_invalidate(&sim.l2[c], line);
+  }
+}
+
+//------------------------------------------------------------------------
+// Agents and virtual time
+//------------------------------------------------------------------------
+
+static void sim_init(const struct sim_config* cfg)
+{
+  sim.cfg = *cfg;
+  sim_cache_init(&sim.llc, cfg->size[SIM_LLC], cfg->ways[SIM_LLC], cfg->llc_repl);
+  sim.num_agents.store(0);
+  pthread_mutex_init(&sim.lock, NULL);
+  pthread_mutex_init(&sim.config_lock, NULL);
+  sim.rng = cfg->seed | 1;
+}
+
+/*
+ * Attaches the calling thread to core, and waits for the other agent (the
+ * clocks of both start at 0).
+ */
+static void sim_attach(int core)
+{
+  if(core < 0 || core >= SIM_MAX_CORES){
+    printf("Simulator: core %d out of range\n", core);
+    exit(1);
+  }
+  pthread_mutex_lock(&sim.lock);
+  int id = sim.num_agents.load();
+  if(id == SIM_NUM_AGENTS){
+    printf("Simulator: only one sender and one receiver thread are simulated (use a single lane)\n");
+    exit(1);
+  }
+  struct sim_agent* a = &sim.agents[id];
+  a->core = core;
+  a->clock.store(0);
+  a->rng = (sim.cfg.seed + 1)*(core + 1)*0x9E3779B97F4A7C15ULL | 1;
+  a->active.store(true);
+  if(sim.l2[core].tags == NULL){
+    sim_cache_init(&sim.l1[core], sim.cfg.size[SIM_L1], sim.cfg.ways[SIM_L1], SIM_REPL_LRU);
+    sim_cache_init(&sim.l2[core], sim.cfg.size[SIM_L2], sim.cfg.ways[SIM_L2], SIM_REPL_LRU);
+  }
+  sim.num_agents.store(id + 1, std::memory_order_release);
+  pthread_mutex_unlock(&sim.lock);
+
+  while(sim.num_agents.load(std::memory_order_acquire) < SIM_NUM_AGENTS)
+    sched_yield();
+  sim_self = a;
+}
+
+/*
+ * Detaches the calling thread: the other agents no longer wait for it.
+ */
+static void sim_detach()
+{
+  if(sim_self)
+    sim_self->active.store(false, std::memory_order_release);
+  sim_self = NULL;
+}
+
+/*
+ * Waits until every other active agent's clock has passed the caller's
+ * (ties go to the lower core).
+ */
+static void sim_wait_turn(struct sim_agent* a)
+{
+  uint64_t t = a->clock.load(std::memory_order_relaxed);
+  for(int i=0; i<SIM_NUM_AGENTS; i++){
+    struct sim_agent* b = &sim.agents[i];
+    if(b == a)
+      continue;
+    while(b->active.load(std::memory_order_acquire)){
+      uint64_t tb = b->clock.load(std::memory_order_acquire);
+      if(tb > t || (tb == t && b->core > a->core))
+        break;
+      sched_yield();
+    }
+  }
+}
+
+/*
+ * Latency of a load served by level, with jitter (approximately normal).
+ */
+static inline uint64_t sim_latency(struct sim_agent* a, int level)
+{
+  int64_t lat = sim.cfg.lat[level];
+  uint64_t jitter = sim.cfg.jitter[level];
+  if(jitter){
+    int64_t sum = 0;
+    for(int i=0; i<4; i++)
+      sum += sim_rand(&a->rng) % 1024;
+    lat += (sum - 2*1023)*(int64_t)jitter*1732/(1024*1000);   //sum of 4 uniforms: stddev 1024/sqrt(3)
+  }
+  return lat < 1 ? 1 : lat;
+}
+
+//------------------------------------------------------------------------
+// Primitives (see mem_backend.hh)
+//------------------------------------------------------------------------
+
+static inline uint64_t sim_line(const volatile void* p)
+{
+  return (uintptr_t) p / SIM_LINE_SZ;
+}
+
+static void sim_load(const volatile void* p)
+{
+  struct sim_agent* a = sim_self;
+  if(a == NULL){
+    pthread_mutex_lock(&sim.lock);
+    sim_hier_load(-1, sim_line(p));
+    pthread_mutex_unlock(&sim.lock);
+    return;
+  }
+  sim_wait_turn(a);
+  pthread_mutex_lock(&sim.lock);
+  int level = sim_hier_load(a->core, sim_line(p));
+  pthread_mutex_unlock(&sim.lock);
+  a->loads[level]++;
+  a->clock.store(a->clock.load(std::memory_order_relaxed) + sim_latency(a, level), std::memory_order_release);
+}
+
+static void sim_clflush(const volatile void* p)
+{
+  struct sim_agent* a = sim_self;
+  if(a)
+    sim_wait_turn(a);
+  pthread_mutex_lock(&sim.lock);
+  sim_hier_flush(sim_line(p));
+  pthread_mutex_unlock(&sim.lock);
+  if(a){
+    a->flushes++;
+    a->clock.store(a->clock.load(std::memory_order_relaxed) + sim.cfg.flush_cycles, std::memory_order_release);
+  }
+}
+
+/*
+ * Virtual timestamp counter of the calling agent (latest clock of all agents
+ * for other threads).
+ */
+static uint64_t sim_rdtscp(unsigned int* aux)
+{
+  struct sim_agent* a = sim_self;
+  if(a == NULL){
+    uint64_t t = 0;
+    for(int i=0; i<sim.num_agents.load(); i++)
+      if(sim.agents[i].clock.load() > t)
+        t = sim.agents[i].clock.load();
+    return t;
+  }
+  uint64_t t = a->clock.load(std::memory_order_relaxed);
+  a->clock.store(t + sim.cfg.timer_cycles, std::memory_order_release);
+  *aux = a->core;
+  return t;
+}
+
+/*
+ * Memory shared by the simulated programs (in place of the shared file): a
+ * memfd, mapped once for both.
+ */
+static void* sim_shared_region(uint64_t size)
+{
+  pthread_mutex_lock(&sim.lock);
+  if(sim.shared_region == NULL){
+    int fd = memfd_create("streamline_shared_region", 0);
+    sim.shared_region = MAP_FAILED;
+    if(fd != -1 && ftruncate(fd, size) == 0)
+      sim.shared_region = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if(fd != -1)
+      close(fd);
+    if(sim.shared_region == MAP_FAILED){
+      printf("Simulator: failed to map the shared region\n");
+      exit(1);
+    }
+    sim.shared_size = size;
+  } else if(size > sim.shared_size){
+    printf("Simulator: sender and receiver need the same shared-array size\n");
+    exit(1);
+  }
+  pthread_mutex_unlock(&sim.lock);
+  return sim.shared_region;
+}
+
+static void sim_print_stats()
+{
+  printf("Simulator: LLC %llu KB, %llu-way, %s replacement. Seed %llu.\n",
+         sim.cfg.size[SIM_LLC]/1024, sim.cfg.ways[SIM_LLC], sim_repl_name(sim.cfg.llc_repl), sim.cfg.seed);
+  printf("Core, Cycles, Loads (L1, L2, LLC, Memory), Flushes\n");
+  for(int i=0; i<sim.num_agents.load(); i++){
+    struct sim_agent* a = &sim.agents[i];
+    printf("Core %d \t %llu \t %llu \t %llu \t %llu \t %llu \t %llu\n", a->core, a->clock.load(),
+           a->loads[SIM_L1], a->loads[SIM_L2], a->loads[SIM_LLC], a->loads[SIM_MEM], a->flushes);
+  }
+  printf("LLC evictions: %llu, back-invalidations: %llu\n", sim.llc_evictions, sim.back_invalidations);
+}
+
+#endif
+
+//
+// cache_sim.hh ends here
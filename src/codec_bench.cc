@@ -0,0 +1,619 @@
+// Copyright (C) 2020, Gururaj Saileshwar
+
+// Commentary:
+// Throughput of the payload codecs (ECC, bit-array packing), against a plain
+// memory pass over the same data. Also the cost per bit of the shared-array
+// address schedule, evaluated per bit or stepped (see addr_schedule.hh). And
+// the soft-decision decoding of the ECC blocks against the hard one, on
+// latencies of hits and misses with Gaussian noise (see soft_decode.hh). And
+// the interleaver and the Reed-Solomon outer code against bursts of errors
+// (see outer_code.hh). And the erasure code across sync epochs, with the
+// generic and the AVX2 GF(2^8) kernels (see epoch_code.hh), and the
+// receiver's rebuild of lost epochs in the stream analysis (see rx_stream.hh).
+//
+// Usage: codec_bench [num_words]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <math.h>
+
+#include "fec_secded7264.hh"
+#include "bits_util.hh"
+#include "addr_schedule.hh"
+#include "soft_decode.hh"
+#include "outer_code.hh"
+#include "epoch_code.hh"
+#include "rx_stream.hh"
+
+#define DEFAULT_BENCH_WORDS ((uint64_t)1 << 24)  /* 128MB of data */
+
+static double now_sec()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static double report(const char* name, uint64_t bytes, double secs)
+{
+  printf("%-28s %8.3f GB/s\n", name, bytes/secs/1e9);
+  return secs;
+}
+
+/*
+ * SEC-DED (72,64): byte API one block at a time (as the sender and receiver
+ * used it) versus the batch word API with every parity kernel.
+ */
+static int bench_secded7264(uint64_t num_words)
+{
+  uint64_t bytes = num_words*sizeof(uint64_t);
+  uint64_t* data = (uint64_t*) malloc(bytes);
+  uint64_t* rx_data = (uint64_t*) malloc(bytes);
+  uint64_t* copy = (uint64_t*) malloc(bytes);
+  uint8_t* parity = (uint8_t*) malloc(num_words);
+  uint8_t* rx_parity = (uint8_t*) malloc(num_words);
+  uint8_t* ref_parity = (uint8_t*) malloc(num_words);
+  int mismatches = 0;
+  double t;
+
+  srand(42);
+  for(uint64_t i=0; i<num_words; i++)
+    data[i] = ((uint64_t)rand() << 42) ^ ((uint64_t)rand() << 21) ^ (uint64_t)rand();
+
+  memcpy(copy, data, bytes); //fault in the pages
+  t = now_sec();
+  memcpy(copy, data, bytes);
+  report("memcpy", bytes, now_sec()-t);
+
+  //Byte API
+  t = now_sec();
+  for(uint64_t i=0; i<num_words; i++){
+    uint8_t dec[8], enc[9];
+    for(int j=0; j<8; j++)
+      dec[j] = data[i] >> (56-8*j);
+    fec_secded7264_encode(8, dec, enc);
+    ref_parity[i] = enc[0];
+  }
+  report("encode (byte API)", bytes, now_sec()-t);
+
+  //Received blocks: one flipped bit in every 16th block, two in every 64th.
+  for(uint64_t i=0; i<num_words; i++){
+    rx_data[i] = data[i];
+    rx_parity[i] = ref_parity[i];
+    if(i%16 == 0)
+      rx_data[i] ^= (uint64_t)1 << (i%64);
+    if(i%64 == 0)
+      rx_parity[i] ^= 0x01;
+  }
+
+  t = now_sec();
+  for(uint64_t i=0; i<num_words; i++){
+    uint8_t dec[8], enc[9];
+    unsigned int errors;
+    enc[0] = rx_parity[i];
+    for(int j=0; j<8; j++)
+      enc[j+1] = rx_data[i] >> (56-8*j);
+    fec_secded7264_decode(9, enc, dec, &errors);
+  }
+  report("decode (byte API)", bytes, now_sec()-t);
+
+  //Word API
+  for(int impl=FEC_SECDED7264_IMPL_GENERIC; impl<=FEC_SECDED7264_IMPL_AVX2; impl++){
+    if(fec_secded7264_select_impl(impl) != impl)
+      continue;
+    char name[64];
+
+    t = now_sec();
+    fec_secded7264_encode_words(num_words, data, parity);
+    snprintf(name, sizeof(name), "encode_words (%s)", fec_secded7264_impl_name(impl));
+    report(name, bytes, now_sec()-t);
+    if(memcmp(parity, ref_parity, num_words) != 0){
+      printf("  MISMATCH with byte API\n");
+      mismatches++;
+    }
+
+    memcpy(copy, rx_data, bytes);
+    t = now_sec();
+    unsigned int errors = fec_secded7264_decode_words(num_words, copy, rx_parity, NULL);
+    snprintf(name, sizeof(name), "decode_words (%s)", fec_secded7264_impl_name(impl));
+    report(name, bytes, now_sec()-t);
+
+    //Single errors are corrected, double errors are detected but left alone.
+    for(uint64_t i=0; i<num_words; i++){
+      uint64_t expected = (i%64 == 0) ? rx_data[i] : data[i];
+      if(copy[i] != expected){
+        printf("  MISMATCH in decoded word %lu\n", i);
+        mismatches++;
+        break;
+      }
+    }
+    if(errors != (num_words+63)/64){
+      printf("  MISMATCH in detected errors: %u\n", errors);
+      mismatches++;
+    }
+  }
+  fec_secded7264_select_impl(FEC_SECDED7264_IMPL_AVX2);
+
+  free(data); free(rx_data); free(copy);
+  free(parity); free(rx_parity); free(ref_parity);
+  return mismatches;
+}
+
+/*
+ * Previous conv_char()/string_to_binary() loops (strtol per byte, shift-and-mask per bit).
+ */
+static void legacy_pack(const bool* data, size_t size, uint8_t* msg)
+{
+  for (size_t i = 0; i < size; i++) {
+    char tmp[9];
+    int k = 0;
+    for (size_t j = i * 8; j < ((i + 1) * 8); j++)
+      tmp[k++] = data[j] ? '1' : '0';
+    tmp[8] = '\0';
+    msg[i] = (uint8_t)strtol(tmp, 0, 2);
+  }
+}
+
+static void legacy_unpack(const uint8_t* s, size_t len, bool* binary)
+{
+  for (size_t i = 0; i < len; ++i) {
+    uint8_t ch = s[i];
+    for (int j = 7; j >= 0; --j)
+      binary[i*8 + 7-j] = ch & (1 << j);
+  }
+}
+
+/*
+ * Bit-array packing: the previous loops versus every kernel of bits_util.hh.
+ * Throughput is given in bytes of the bool array.
+ */
+static int bench_pack(uint64_t num_bytes)
+{
+  uint64_t num_bits = num_bytes*8;
+  uint8_t* bytes = (uint8_t*) malloc(num_bytes);
+  uint8_t* packed = (uint8_t*) malloc(num_bytes);
+  bool* bits = (bool*) malloc(num_bits);
+  bool* unpacked = (bool*) malloc(num_bits);
+  int mismatches = 0;
+  double t, t_pack, t_unpack;
+
+  srand(43);
+  for(uint64_t i=0; i<num_bytes; i++)
+    bytes[i] = rand();
+
+  t = now_sec();
+  legacy_unpack(bytes, num_bytes, bits);
+  t_unpack = report("unpack (legacy)", num_bits, now_sec()-t);
+  t = now_sec();
+  legacy_pack(bits, num_bytes, packed);
+  t_pack = report("pack (legacy)", num_bits, now_sec()-t);
+
+  for(int impl=BITS_IMPL_GENERIC; impl<=BITS_IMPL_SSE; impl++){
+    if(bits_select_impl(impl) != impl)
+      continue;
+    char name[64];
+
+    memset(unpacked, 0, num_bits);
+    t = now_sec();
+    unpack_bits(bytes, num_bytes, unpacked);
+    snprintf(name, sizeof(name), "unpack_bits (%s)", bits_impl_name(impl));
+    double secs = report(name, num_bits, now_sec()-t);
+    printf("  %.1fx\n", t_unpack/secs);
+    if(memcmp(unpacked, bits, num_bits) != 0){
+      printf("  MISMATCH with legacy unpack\n");
+      mismatches++;
+    }
+
+    memset(packed, 0, num_bytes);
+    t = now_sec();
+    pack_bits(bits, num_bytes, packed);
+    snprintf(name, sizeof(name), "pack_bits (%s)", bits_impl_name(impl));
+    secs = report(name, num_bits, now_sec()-t);
+    printf("  %.1fx\n", t_pack/secs);
+    if(memcmp(packed, bytes, num_bytes) != 0){
+      printf("  MISMATCH with legacy pack\n");
+      mismatches++;
+    }
+  }
+  bits_select_impl(BITS_IMPL_SSE);
+
+  //Word helpers
+  for(uint64_t i=0; i+8<=num_bytes && i<4096; i+=8){
+    uint64_t w = pack_bits_word(&bits[8*i]);
+    bool tmp[64];
+    unpack_bits_word(w, tmp);
+    if(w != ((uint64_t)bytes[i] << 56 | (uint64_t)bytes[i+1] << 48 | (uint64_t)bytes[i+2] << 40 |
+             (uint64_t)bytes[i+3] << 32 | (uint64_t)bytes[i+4] << 24 | (uint64_t)bytes[i+5] << 16 |
+             (uint64_t)bytes[i+6] << 8 | (uint64_t)bytes[i+7]) ||
+       memcmp(tmp, &bits[8*i], 64) != 0){
+      printf("  MISMATCH in word packing\n");
+      mismatches++;
+      break;
+    }
+  }
+
+  free(bytes); free(packed); free(bits); free(unpacked);
+  return mismatches;
+}
+
+/*
+ * Address schedule: BITID_2_ARRINDEX per bit versus struct addr_schedule, on
+ * the default array size and on an odd number of pages.
+ */
+static int bench_schedule(uint64_t num_bits)
+{
+  const uint64_t sizes[2] = {ARRAYSZ_2_NUMENTRIES(8), 1027*ENTRY_PER_PAGE};
+  const uint64_t seed = 42;
+  int mismatches = 0;
+  for(int i=0; i<2; i++){
+    //The array size is a runtime value in the generic loops
+    volatile uint64_t numentries_v = sizes[i];
+    uint64_t numentries = numentries_v;
+    uint64_t sum_ref = 0, sum = 0;
+
+    double t = now_sec();
+    for(uint64_t l=seed; l<seed+num_bits; l++)
+      sum_ref += BITID_2_ARRINDEX(l)%numentries + SCHEDULE_ENTRY_OFFSET;
+    double t_ref = now_sec() - t;
+
+    struct channel_params p;
+    channel_params_init(&p);
+    addr_pattern_resolve(&p);
+    struct addr_schedule s;
+    addr_schedule_init(&s, seed, numentries, &p);
+    t = now_sec();
+    for(uint64_t l=seed; l<seed+num_bits; l++){
+      sum += addr_schedule_index(&s, numentries);
+      addr_schedule_next(&s, numentries);
+    }
+    double t_sched = now_sec() - t;
+
+    printf("schedule (%6.1f MB array)   per bit %.2f ns, stepped %.2f ns  %.1fx\n", numentries*ARRENTRY_SZ/1e6,
+           t_ref*1e9/num_bits, t_sched*1e9/num_bits, t_ref/t_sched);
+    addr_schedule_init(&s, seed, numentries, &p);
+    for(uint64_t l=seed; l<seed+num_bits; l++){
+      if(addr_schedule_index(&s, numentries) != BITID_2_ARRINDEX(l)%numentries + SCHEDULE_ENTRY_OFFSET){
+        printf("  MISMATCH at bit-id %lu\n", l);
+        mismatches++;
+        break;
+      }
+      addr_schedule_next(&s, numentries);
+    }
+    if(sum != sum_ref && mismatches == 0){
+      printf("  MISMATCH in the sum of the indices\n");
+      mismatches++;
+    }
+  }
+  return mismatches;
+}
+
+/*
+ * Soft-decision decoding: error-free blocks of the hard and the soft decoding
+ * of the same received blocks, with hits at 50 and misses at 250 cycles and
+ * the noise deviation swept, and the throughput of the decoding for the
+ * flips of the orchestrator's sweep.
+ */
+static int bench_chase(uint64_t num_blocks)
+{
+  const double devs[3] = {30, 40, 50};
+  const int flips[3] = {2, 4, 8};
+  uint64_t* data = (uint64_t*) malloc(num_blocks*sizeof(uint64_t));
+  uint64_t* rx_data = (uint64_t*) malloc(num_blocks*sizeof(uint64_t));
+  uint64_t* hard_data = (uint64_t*) malloc(num_blocks*sizeof(uint64_t));
+  uint64_t* soft_data = (uint64_t*) malloc(num_blocks*sizeof(uint64_t));
+  uint8_t* parity = (uint8_t*) malloc(num_blocks);
+  uint8_t* rx_parity = (uint8_t*) malloc(num_blocks);
+  uint8_t* rel = (uint8_t*) malloc(num_blocks*SOFT_BLOCK_BITS);
+  int mismatches = 0;
+
+  srand(44);
+  for(uint64_t i=0; i<num_blocks; i++)
+    data[i] = ((uint64_t)rand() << 42) ^ ((uint64_t)rand() << 21) ^ (uint64_t)rand();
+  fec_secded7264_encode_words(num_blocks, data, parity);
+
+  for(int d=0; d<3; d++){
+    struct train_fit fit = {{50, 250}, {devs[d], devs[d]}, 150};
+    struct soft_model m;
+    soft_model_fit(&m, &fit, 0);
+
+    //Received blocks: bits in stream order, parity first
+    uint64_t raw_errors = 0;
+    for(uint64_t i=0; i<num_blocks; i++){
+      rx_data[i] = 0;
+      rx_parity[i] = 0;
+      for(int b=0; b<SOFT_BLOCK_BITS; b++){
+        int bit = (b < SOFT_PARITY_BITS) ? (parity[i] >> (SOFT_PARITY_BITS - 1 - b)) & 1 : (data[i] >> (SOFT_BLOCK_BITS - 1 - b)) & 1;
+        double u1 = (rand() + 1.0)/(RAND_MAX + 2.0), u2 = (rand() + 1.0)/(RAND_MAX + 2.0);
+        double lat = fit.mean[bit] + devs[d]*sqrt(-2*log(u1))*cos(2*M_PI*u2);
+        uint64_t latency = lat > 0 ? (uint64_t) lat : 0;
+        int rx_bit = latency > m.threshold;
+        raw_errors += (rx_bit != bit);
+        rel[i*SOFT_BLOCK_BITS + b] = soft_reliability(&m, latency);
+        if(b < SOFT_PARITY_BITS)
+          rx_parity[i] |= rx_bit << (SOFT_PARITY_BITS - 1 - b);
+        else
+          rx_data[i] |= (uint64_t)rx_bit << (SOFT_BLOCK_BITS - 1 - b);
+      }
+    }
+    printf("deviation %.0f cycles: raw BER %.3f%%\n", devs[d], 100.0*raw_errors/(num_blocks*SOFT_BLOCK_BITS));
+
+    for(int f=0; f<3; f++){
+      struct soft_stats st;
+      memset(&st, 0, sizeof(st));
+      memcpy(soft_data, rx_data, num_blocks*sizeof(uint64_t));
+      unsigned char flags[PAYLOAD_CHUNK_BITS/ECCBLK_BITLEN];
+      double t = now_sec();
+      for(uint64_t i=0; i<num_blocks; i += PAYLOAD_CHUNK_BITS/ECCBLK_BITLEN){
+        unsigned int num = (num_blocks - i < PAYLOAD_CHUNK_BITS/ECCBLK_BITLEN) ? num_blocks - i : PAYLOAD_CHUNK_BITS/ECCBLK_BITLEN;
+        soft_decode_blocks(num, &soft_data[i], &rx_parity[i], &rel[i*SOFT_BLOCK_BITS], flips[f], &hard_data[i], flags,
+                           &st);
+      }
+      double secs = now_sec() - t;
+      uint64_t good = 0;
+      for(uint64_t i=0; i<num_blocks; i++)
+        good += (soft_data[i] == data[i]);
+      soft_stats_add_hard(&st, num_blocks, data, hard_data);
+      printf("  chase (%d flips)  error-free blocks: hard %.3f%%, soft %.3f%%  %8.3f Mblocks/s\n", flips[f],
+             100.0*st.hard_good_blks/num_blocks, 100.0*good/num_blocks, num_blocks/secs/1e6);
+      //The hard decoding is one of the test patterns, when it decodes
+      if(good + st.changed < st.hard_good_blks){
+        printf("  MISMATCH: blocks of the hard decoding lost\n");
+        mismatches++;
+      }
+    }
+  }
+
+  free(data); free(rx_data); free(hard_data); free(soft_data);
+  free(parity); free(rx_parity); free(rel);
+  return mismatches;
+}
+
+/*
+ * Interleaver and outer code: chunks of blocks encoded, interleaved, hit by a
+ * burst of errors (every bit flipped) of the burst tolerance at a random
+ * position, then de-interleaved and decoded, for the depths and parities of
+ * the orchestrator's sweeps. Every burst must be decoded.
+ */
+static int bench_outer(uint64_t num_chunks)
+{
+  const uint64_t depths[3] = {8, 64, 512};
+  const uint64_t parities[3] = {8, 16, 32};
+  const unsigned int chunk_blks = PAYLOAD_CHUNK_BITS/ECCBLK_BITLEN;
+  uint64_t data[PAYLOAD_CHUNK_BITS/ECCBLK_BITLEN], rx_data[PAYLOAD_CHUNK_BITS/ECCBLK_BITLEN];
+  uint8_t parity[PAYLOAD_CHUNK_BITS/ECCBLK_BITLEN], rx_parity[PAYLOAD_CHUNK_BITS/ECCBLK_BITLEN];
+  unsigned char flags[PAYLOAD_CHUNK_BITS/ECCBLK_BITLEN];
+  struct bitvec blocks, channel;
+  bitvec_alloc(&blocks, PAYLOAD_CHUNK_BITS);
+  bitvec_alloc(&channel, PAYLOAD_CHUNK_BITS);
+  int mismatches = 0;
+
+  srand(45);
+  for(int d=0; d<3; d++){
+    for(int o=0; o<3; o++){
+      struct channel_params p;
+      channel_params_init(&p);
+      p.ecc = true;
+      p.interleave_depth = depths[d];
+      p.outer_parity = parities[o];
+      struct outer_code oc;
+      outer_code_init(&oc, &p);
+      uint64_t burst = outer_burst_tolerance(&p);
+      struct outer_stats st;
+      memset(&st, 0, sizeof(st));
+      uint64_t failed_chunks = 0;
+      double enc_secs = 0, dec_secs = 0;
+      for(uint64_t c=0; c<num_chunks; c++){
+        for(unsigned int b=0; b<chunk_blks; b++)
+          data[b] = ((uint64_t)rand() << 42) ^ ((uint64_t)rand() << 21) ^ (uint64_t)rand();
+        double t = now_sec();
+        outer_encode_blocks(&oc, data, chunk_blks);
+        fec_secded7264_encode_words(chunk_blks, data, parity);
+        for(unsigned int b=0; b<chunk_blks; b++){
+          bitvec_set_bits(&blocks, b*ECCBLK_BITLEN, PARITY_BITLEN, parity[b]);
+          bitvec_set_bits(&blocks, b*ECCBLK_BITLEN + PARITY_BITLEN, DATABLK_BITLEN, data[b]);
+        }
+        interleave_blocks(&blocks, 0, &channel, 0, chunk_blks, p.interleave_depth);
+        enc_secs += now_sec() - t;
+
+        uint64_t start = (uint64_t)rand() % (PAYLOAD_CHUNK_BITS - burst);
+        for(uint64_t i=start; i<start + burst; i++)
+          bitvec_set(&channel, i, !bitvec_get(&channel, i));
+
+        t = now_sec();
+        deinterleave_blocks(&channel, 0, &blocks, 0, chunk_blks, p.interleave_depth);
+        for(unsigned int b=0; b<chunk_blks; b++){
+          rx_parity[b] = bitvec_get_bits(&blocks, b*ECCBLK_BITLEN, PARITY_BITLEN);
+          rx_data[b] = bitvec_get_bits(&blocks, b*ECCBLK_BITLEN + PARITY_BITLEN, DATABLK_BITLEN);
+        }
+        fec_secded7264_decode_words(chunk_blks, rx_data, rx_parity, flags);
+        outer_decode_blocks(&oc, rx_data, flags, chunk_blks, &st);
+        dec_secs += now_sec() - t;
+        failed_chunks += (memcmp(data, rx_data, sizeof(data)) != 0);
+      }
+      printf("  depth %3llu, RS(%llu,%llu)  burst %5llu bits: %llu blocks erased, %llu symbols corrected,"
+             " %llu chunks lost  encode %7.3f decode %7.3f Mblocks/s\n", p.interleave_depth, p.outer_frame,
+             p.outer_frame - p.outer_parity, burst, st.erased_blocks, st.corrected, failed_chunks,
+             num_chunks*chunk_blks/enc_secs/1e6, num_chunks*chunk_blks/dec_secs/1e6);
+      if(failed_chunks){
+        printf("  MISMATCH: bursts within the tolerance not decoded\n");
+        mismatches++;
+      }
+    }
+  }
+
+  bitvec_free(&blocks);
+  bitvec_free(&channel);
+  return mismatches;
+}
+
+/*
+ * Erasure code across epochs: throughput of the encoding and of rebuilding
+ * <repair> lost payload epochs of a group, for the repair epochs of the
+ * orchestrator's sweep, with each GF(2^8) kernel. The rebuilt epochs must
+ * match the lost ones.
+ */
+static int bench_epoch_code(uint64_t epoch_bits)
+{
+  const uint64_t repairs[3] = {1, 2, 4};
+  const bool kernels[2] = {false, true};
+  int mismatches = 0;
+  gf256_init();
+
+  srand(46);
+  for(int r=0; r<3; r++){
+    struct channel_params p;
+    channel_params_init(&p);
+    p.sync_bitfreq = epoch_bits;
+    p.epoch_repair = repairs[r];
+    struct epoch_code ec;
+    epoch_code_init(&ec, &p, p.epoch_group*epoch_bits);
+    uint64_t group_bytes = ec.group*ec.epoch_bytes;
+    uint64_t* ref = (uint64_t*) malloc(group_bytes);
+    uint8_t state[EPOCH_CODE_MAX_GROUP];
+
+    for(int k=0; k<2; k++){
+      const char* impl = gf256_select_region(kernels[k]);
+      if(kernels[k] && strcmp(impl, "avx2") != 0)
+        continue;
+      for(uint64_t w=0; w<ec.data*ec.epoch_bytes/sizeof(uint64_t); w++)
+        ec.sym[w] = ((uint64_t)rand() << 42) ^ ((uint64_t)rand() << 21) ^ (uint64_t)rand();
+      double t = now_sec();
+      epoch_code_encode(&ec);
+      double enc_secs = now_sec() - t;
+      memcpy(ref, ec.sym, group_bytes);
+
+      //Lose as many payload epochs as there are repair epochs, at random, and rebuild them
+      memset(state, EPOCH_RECEIVED, sizeof(state));
+      for(uint64_t lost=0; lost<ec.repair; ){
+        uint64_t e = rand() % ec.data;
+        if(state[e] == EPOCH_LOST)
+          continue;
+        state[e] = EPOCH_LOST;
+        memset(epoch_code_epoch(&ec, ec.sym, e), 0, ec.epoch_bytes);
+        lost++;
+      }
+      t = now_sec();
+      int rebuilt = epoch_code_rebuild(&ec, state);
+      double dec_secs = now_sec() - t;
+      printf("  RS(%llu,%llu) %-8s  encode %8.3f GB/s  rebuild %llu epochs %8.3f GB/s\n", ec.group, ec.data, impl,
+             ec.data*ec.epoch_bytes/enc_secs/1e9, ec.repair, ec.data*ec.epoch_bytes/dec_secs/1e9);
+      if(rebuilt != (int)ec.repair || memcmp(ref, ec.sym, group_bytes) != 0){
+        printf("  MISMATCH: lost epochs not rebuilt\n");
+        mismatches++;
+      }
+    }
+    free(ref);
+    epoch_code_free(&ec);
+  }
+  gf256_select_region(true);
+  return mismatches;
+}
+
+/*
+ * The receiver's rebuild of lost epochs: the stream of a sender with the
+ * erasure code across epochs (RS(16,13), 25000-bit epochs) is received, with the
+ * bits of some epochs flagged as lost garbled, and analyzed by rx_stream as the
+ * decoder thread does. With lost, the number of epochs lost in each group (at
+ * random), the payload has to come back without errors as long as lost is
+ * within the repair epochs, and the groups to be reported beyond repair past them.
+ */
+static int bench_epoch_rebuild(bool ecc, uint64_t lost)
+{
+  static struct rx_stream rs;
+  struct channel_params p;
+  channel_params_init(&p);
+  p.sync_bitfreq = 25000;
+  p.epoch_repair = 3;
+  p.ecc = ecc;
+  uint64_t num_bits = 64*p.sync_bitfreq;
+  uint64_t transmitted_bits = ecc ? num_bits*ECCBLK_BITLEN/DATABLK_BITLEN : num_bits;
+  struct bitvec tx;
+  bitvec_alloc(&tx, transmitted_bits);
+  create_tx_payload(&tx, transmitted_bits, &p);
+  rx_stream_init(&rs, num_bits, transmitted_bits, &p, 1);
+
+  //Epochs lost in every group (payload or repair epochs), and the payload epochs among them
+  srand(47);
+  uint64_t payload_lost = 0;
+  for(uint64_t g=0; g<rs.epochs.groups; g++){
+    for(uint64_t n=0; n<lost; ){
+      uint64_t e = g*rs.epochs.group + rand() % rs.epochs.group;
+      if(rs.epoch_state[e] == EPOCH_LOST)
+        continue;
+      rx_stream_lose_epochs(&rs, e, e);
+      payload_lost += (e % rs.epochs.group < rs.epochs.data);
+      n++;
+    }
+  }
+
+  //Received bits: the lost epochs' at random, as the decoder thread appends them
+  for(uint64_t w=0; w<tx.num_words; w++){
+    uint64_t word = tx.words[w];
+    unsigned int len = (transmitted_bits - w*BITVEC_WORD_BITS < BITVEC_WORD_BITS) ?
+                       transmitted_bits - w*BITVEC_WORD_BITS : BITVEC_WORD_BITS;
+    for(unsigned int b=0; b<len; b++){
+      if(rs.epoch_state[(w*BITVEC_WORD_BITS + b)/p.sync_bitfreq] == EPOCH_LOST && (rand() & 1))
+        word ^= (uint64_t)1 << (BITVEC_WORD_BITS - 1 - b);
+      rx_stream_push_latency(&rs, 0, 0);
+    }
+    if(len < BITVEC_WORD_BITS){
+      rx_stream_finish(&rs, transmitted_bits, word >> (BITVEC_WORD_BITS - len), 0);
+      break;
+    }
+    rx_stream_push_word(&rs, word, 0);
+    if(rs.stored_bits - rs.analyzed_bits >= RX_CHUNK_BITS)
+      rx_stream_drain(&rs, false);
+    if((w + 1)*BITVEC_WORD_BITS == transmitted_bits)
+      rx_stream_finish(&rs, transmitted_bits, 0, 0);
+  }
+
+  const struct epoch_code_stats* st = &rs.repair_stats;
+  bool repairable = (lost <= rs.epochs.repair);
+  printf("  ECC %-3s  %llu of %llu epochs lost per group: channel errors %llu, %llu payload epochs rebuilt,"
+         " %llu groups beyond repair, payload %llu of %llu bits correct\n", ecc ? "on" : "off", lost, rs.epochs.group,
+         rs.tx_stats.errors, st->rebuilt, st->failed, rs.correct_samples, rs.total_samples);
+  int mismatches = 0;
+  if(repairable ? (st->rebuilt != payload_lost || st->failed != 0 || rs.correct_samples != rs.total_samples)
+                : (st->failed != rs.epochs.groups || rs.correct_samples == rs.total_samples)){
+    printf("  MISMATCH: lost epochs %s\n", repairable ? "not rebuilt" : "not reported beyond repair");
+    mismatches++;
+  }
+  bitvec_free(&tx);
+  return mismatches;
+}
+
+int main(int argc, char** argv)
+{
+  uint64_t num_words = DEFAULT_BENCH_WORDS;
+  if(argc > 1)
+    num_words = strtoull(argv[1], NULL, 0);
+  if(num_words == 0 || num_words > 0xFFFFFFFFull){
+    printf("num_words must be between 1 and 2^32-1\n");
+    return 1;
+  }
+
+  printf("Data: %lu words (%.1f MB)\n", num_words, num_words*8/1e6);
+  int mismatches = bench_secded7264(num_words);
+  printf("Bit arrays: %lu bits\n", num_words*8);
+  mismatches += bench_pack(num_words);
+  printf("Address schedule: %lu bits\n", num_words*8);
+  mismatches += bench_schedule(num_words*8);
+  printf("Soft decoding: %lu blocks\n", num_words/64);
+  mismatches += bench_chase(num_words/64);
+  printf("Outer code: %lu chunks\n", num_words/4096);
+  mismatches += bench_outer(num_words/4096);
+  printf("Epoch code: epochs of %lu bits\n", num_words);
+  mismatches += bench_epoch_code(num_words);
+  printf("Epoch rebuild: 1600000 payload bits, epochs of 25000 bits\n");
+  for(int ecc=0; ecc<2; ecc++)
+    for(uint64_t lost=3; lost<=4; lost++)
+      mismatches += bench_epoch_rebuild(ecc, lost);
+  return mismatches ? 1 : 0;
+}
+
+//
+// codec_bench.cc ends here
@@ -0,0 +1,260 @@
+// Copyright (C) 2020, Gururaj Saileshwar
+
+// Commentary:
+// Erasure code across sync epochs (-G <repair>[,<group>]): epochs lost to a
+// barrier timeout (or a missed deadline) are rebuilt from repair epochs,
+// without retransmission.
+//
+// The sync epochs are coded in groups of <group> epochs (default
+// DEFAULT_EPOCH_GROUP): the first <group> - <repair> epochs of a group carry
+// the channel bits of the payload, and the last <repair> ones, in place of
+// theirs, a systematic Reed-Solomon code of them over GF(2^8) (a Cauchy
+// matrix, so that any <group> - <repair> epochs of a group rebuild the
+// others). Byte j of every epoch is a symbol of codeword j, so a codeword
+// spans the group, and an epoch lost as a whole is one erasure of each.
+//
+// The code runs on the channel bits (after the channel encoding, see
+// payload.hh), with whole epochs as buffers: encoding and rebuilding are
+// multiply-adds of epochs by constants (gf256_region_mul_add, with AVX2, see
+// fec_rs.hh), and only groups with lost epochs are decoded. The groups start
+// with the stream; the epochs past the last full group are sent uncoded.
+//
+// The receiver flags the epoch of a barrier it timed out of, and the next one
+// (up to the next barrier, with the adaptive sync period), as lost: it ran
+// ahead of the sender around the barrier. Once the bits of a group are all
+// received, the decoder thread rebuilds the lost epochs, if no more than
+// <repair> of them, before the group is analyzed (see rx_stream.hh). The
+// bits of the repair epochs carry no payload.
+
+#ifndef EPOCH_CODE_H_
+#define EPOCH_CODE_H_
+
+#include "utils.hh"
+#include "params.hh"
+#include "bitvec.hh"
+#include "fec_rs.hh"
+
+// Epochs of a group, and repair epochs, at most
+#define EPOCH_CODE_MAX_GROUP (64)
+#define EPOCH_CODE_MAX_REPAIR (16)
+// State of an epoch at the receiver
+#define EPOCH_RECEIVED (0)
+#define EPOCH_LOST (1)
+#define EPOCH_REBUILT (2)
+
+struct epoch_code_stats {
+  uint64_t groups;            //groups received
+  uint64_t lossy_groups;      //with lost epochs
+  uint64_t lost;              //epochs flagged as lost
+  uint64_t rebuilt;           //payload epochs rebuilt
+  uint64_t failed;            //groups with more lost epochs than repair epochs
+};
+
+struct epoch_code {
+  uint64_t group, repair, data;   //epochs of a group (0: off)
+  uint64_t epoch_bits;            //sync_bitfreq
+  uint64_t epoch_bytes;           //bytes of an epoch, rounded up to words
+  uint64_t groups;                //full groups of the stream (coded)
+  uint8_t coef[EPOCH_CODE_MAX_REPAIR][EPOCH_CODE_MAX_GROUP];  //repair epoch r: sum of coef[r][i] x payload epoch i
+  uint64_t* sym;                  //the epochs of a group (group x epoch_bytes)
+  uint64_t* acc;                  //rebuilding: repair x epoch_bytes
+};
+
+static void epoch_code_init(struct epoch_code* ec, const struct channel_params* p, uint64_t transmitted_bits)
+{
+  memset(ec, 0, sizeof(*ec));
+  if(p->epoch_repair == 0)
+    return;
+  gf256_init();
+  ec->group = p->epoch_group;
+  ec->repair = p->epoch_repair;
+  ec->data = p->epoch_group - p->epoch_repair;
+  ec->epoch_bits = p->sync_bitfreq;
+  ec->epoch_bytes = (p->sync_bitfreq + BITVEC_WORD_BITS - 1)/BITVEC_WORD_BITS*sizeof(uint64_t);
+  ec->groups = transmitted_bits/(ec->group*ec->epoch_bits);
+  //Cauchy matrix: 1/(x_r + y_i), x_r = data + r, y_i = i
+  for(uint64_t r=0; r<ec->repair; r++)
+    for(uint64_t i=0; i<ec->data; i++)
+      ec->coef[r][i] = gf256_inv((ec->data + r) ^ i);
+  ec->sym = (uint64_t*) calloc(ec->group*ec->epoch_bytes, 1);
+  ec->acc = (uint64_t*) calloc(ec->repair*ec->epoch_bytes, 1);
+}
+
+static void epoch_code_free(struct epoch_code* ec)
+{
+  free(ec->sym);
+  free(ec->acc);
+  ec->sym = ec->acc = NULL;
+}
+
+static inline uint64_t epoch_code_group_bits(const struct epoch_code* ec)
+{
+  return ec->group*ec->epoch_bits;
+}
+
+static inline uint8_t* epoch_code_epoch(const struct epoch_code* ec, uint64_t* base, uint64_t j)
+{
+  return (uint8_t*) base + j*ec->epoch_bytes;
+}
+
+/*
+ * True if a bit of [pos, pos+n) of the stream is in a repair epoch.
+ */
+static inline bool epoch_code_is_repair(const struct epoch_code* ec, uint64_t pos, uint64_t n)
+{
+  if(ec->group == 0)
+    return false;
+  for(uint64_t e = pos/ec->epoch_bits; e*ec->epoch_bits < pos + n; e++)
+    if(e/ec->group < ec->groups && e%ec->group >= ec->data)
+      return true;
+  return false;
+}
+
+/*
+ * Rate of the code (payload epochs per epoch).
+ */
+static inline double epoch_code_rate(const struct channel_params* p)
+{
+  return p->epoch_repair ? 1.0*(p->epoch_group - p->epoch_repair)/p->epoch_group : 1.0;
+}
+
+/*
+ * Loads the epochs of a group from bits (the group from bit 0).
+ */
+static void epoch_code_load(struct epoch_code* ec, const struct bitvec* bits)
+{
+  uint64_t words = ec->epoch_bytes/sizeof(uint64_t);
+  for(uint64_t j=0; j<ec->group; j++){
+    uint64_t* w = (uint64_t*) epoch_code_epoch(ec, ec->sym, j);
+    for(uint64_t k=0; k<words; k++){
+      uint64_t left = ec->epoch_bits - k*BITVEC_WORD_BITS;
+      unsigned int len = left < BITVEC_WORD_BITS ? left : BITVEC_WORD_BITS;
+      w[k] = bitvec_get_bits(bits, j*ec->epoch_bits + k*BITVEC_WORD_BITS, len) << (BITVEC_WORD_BITS - len);
+    }
+  }
+}
+
+/*
+ * Stores epoch j of the group back to bits.
+ */
+static void epoch_code_store(const struct epoch_code* ec, struct bitvec* bits, uint64_t j)
+{
+  const uint64_t* w = (const uint64_t*) epoch_code_epoch(ec, ec->sym, j);
+  for(uint64_t k=0; k*BITVEC_WORD_BITS < ec->epoch_bits; k++){
+    uint64_t left = ec->epoch_bits - k*BITVEC_WORD_BITS;
+    unsigned int len = left < BITVEC_WORD_BITS ? left : BITVEC_WORD_BITS;
+    bitvec_set_bits(bits, j*ec->epoch_bits + k*BITVEC_WORD_BITS, len, w[k] >> (BITVEC_WORD_BITS - len));
+  }
+}
+
+/*
+ * Computes the repair epochs of the loaded group.
+ */
+static void epoch_code_encode(struct epoch_code* ec)
+{
+  for(uint64_t r=0; r<ec->repair; r++){
+    uint8_t* out = epoch_code_epoch(ec, ec->sym, ec->data + r);
+    memset(out, 0, ec->epoch_bytes);
+    for(uint64_t i=0; i<ec->data; i++)
+      gf256_region_mul_add(out, epoch_code_epoch(ec, ec->sym, i), ec->coef[r][i], ec->epoch_bytes);
+  }
+}
+
+/*
+ * Inverts the n x n matrix a (in place). False if it is singular.
+ */
+static bool epoch_code_invert(uint8_t a[EPOCH_CODE_MAX_REPAIR][EPOCH_CODE_MAX_REPAIR], int n)
+{
+  uint8_t inv[EPOCH_CODE_MAX_REPAIR][EPOCH_CODE_MAX_REPAIR];
+  memset(inv, 0, sizeof(inv));
+  for(int i=0; i<n; i++)
+    inv[i][i] = 1;
+  for(int c=0; c<n; c++){
+    int pivot = c;
+    while(pivot < n && a[pivot][c] == 0)
+      pivot++;
+    if(pivot == n)
+      return false;
+    for(int k=0; k<n; k++){
+      uint8_t t = a[c][k]; a[c][k] = a[pivot][k]; a[pivot][k] = t;
+      t = inv[c][k]; inv[c][k] = inv[pivot][k]; inv[pivot][k] = t;
+    }
+    uint8_t scale = gf256_inv(a[c][c]);
+    for(int k=0; k<n; k++){
+      a[c][k] = gf256_mul(a[c][k], scale);
+      inv[c][k] = gf256_mul(inv[c][k], scale);
+    }
+    for(int r=0; r<n; r++){
+      uint8_t f = a[r][c];
+      if(r == c || f == 0)
+        continue;
+      for(int k=0; k<n; k++){
+        a[r][k] ^= gf256_mul(f, a[c][k]);
+        inv[r][k] ^= gf256_mul(f, inv[c][k]);
+      }
+    }
+  }
+  memcpy(a, inv, sizeof(inv));
+  return true;
+}
+
+/*
+ * Rebuilds the lost payload epochs of the loaded group (state: EPOCH_LOST or
+ * not, of each of its epochs), from the others. Returns the number of epochs
+ * rebuilt, or -1 if there are more lost epochs than repair epochs left.
+ */
+static int epoch_code_rebuild(struct epoch_code* ec, const uint8_t* state)
+{
+  int lost[EPOCH_CODE_MAX_REPAIR], rows[EPOCH_CODE_MAX_REPAIR];
+  int m = 0, rr = 0;
+  for(uint64_t i=0; i<ec->data; i++){
+    if(state[i] != EPOCH_LOST)
+      continue;
+    if(m == (int)ec->repair)
+      return -1;
+    lost[m++] = i;
+  }
+  for(uint64_t r=0; r<ec->repair && rr<m; r++)
+    if(state[ec->data + r] != EPOCH_LOST)
+      rows[rr++] = r;
+  if(m == 0)
+    return 0;
+  if(rr < m)
+    return -1;
+
+  //Repair epochs less the received payload epochs: the lost ones, through the m x m matrix a
+  uint8_t a[EPOCH_CODE_MAX_REPAIR][EPOCH_CODE_MAX_REPAIR];
+  for(int k=0; k<m; k++){
+    uint8_t* acc = epoch_code_epoch(ec, ec->acc, k);
+    memcpy(acc, epoch_code_epoch(ec, ec->sym, ec->data + rows[k]), ec->epoch_bytes);
+    for(uint64_t i=0, l=0; i<ec->data; i++){
+      if(l < (uint64_t)m && lost[l] == (int)i){
+        a[k][l++] = ec->coef[rows[k]][i];
+        continue;
+      }
+      gf256_region_mul_add(acc, epoch_code_epoch(ec, ec->sym, i), ec->coef[rows[k]][i], ec->epoch_bytes);
+    }
+  }
+  if(!epoch_code_invert(a, m))
+    return -1;
+  for(int l=0; l<m; l++){
+    uint8_t* out = epoch_code_epoch(ec, ec->sym, lost[l]);
+    memset(out, 0, ec->epoch_bytes);
+    for(int k=0; k<m; k++)
+      gf256_region_mul_add(out, epoch_code_epoch(ec, ec->acc, k), a[l][k], ec->epoch_bytes);
+  }
+  return m;
+}
+
+static void epoch_code_print(const struct epoch_code_stats* s, const struct channel_params* p)
+{
+  printf("Epoch Code: RS(%llu,%llu) across groups of %llu epochs (%s). Rate: %.4f. Groups: %llu, %llu with lost epochs."
+         " Epochs lost: %llu, %llu payload epochs rebuilt, %llu groups beyond repair.\n", p->epoch_group,
+         p->epoch_group - p->epoch_repair, p->epoch_group, gf256_region_impl, epoch_code_rate(p), s->groups,
+         s->lossy_groups, s->lost, s->rebuilt, s->failed);
+}
+
+#endif
+
+//
+// epoch_code.hh ends here
@@ -0,0 +1,170 @@
+// Copyright (C) 2020, Gururaj Saileshwar
+
+// Commentary:
+// Time-triggered sync epochs (-E deadline): instead of meeting at the
+// Flush+Reload barrier every sync period, sender and receiver start every
+// epoch at a TSC deadline of a schedule agreed once. It needs a TSC that all
+// the cores share (invariant and synchronized, see timer.hh).
+//
+// The initial handshake leaves both sides a few 10K cycles past the same
+// masked-TSC boundary (cc_sync), so both take the second boundary after it as
+// the start of the first epoch, and epoch e starts at
+//   start + e x <sync period> x <cycles per bit>   (-E deadline,<cycles per bit>,<guard>)
+// Tx waits for the start of every epoch (before its training bits). Rx waits
+// at its sync point, TX_SYNC_LAG_DELTA bits before the end of an epoch as for
+// the barrier, for the start of the next epoch plus the guard interval. So
+// they stay TX_SYNC_LAG_DELTA bits and the guard apart, without a round trip.
+// <cycles per bit> paces both sides: it has to leave them time for the bits
+// of an epoch. A side that reaches a deadline late goes on right away, and
+// counts a missed deadline.
+//
+// Skew: every side measures, from the timestamps of its bits, how long after
+// a release its first bit runs (Tx: after the training bits), and releases
+// that much ahead of the deadline (average of the past epochs), so that its
+// bits, rather than the end of its wait, are on the schedule.
+
+#ifndef EPOCH_SCHEDULE_H_
+#define EPOCH_SCHEDULE_H_
+
+#include "utils.hh"
+#include "params.hh"
+
+// Cycles of the epochs
+struct epoch_stats {
+  uint64_t epochs;
+  uint64_t wait_cycles;       //waiting for the deadlines
+  uint64_t late, late_cycles; //deadlines missed, and by how much
+  uint64_t skew_samples;
+  uint64_t skew_cycles;       //distance of the first bit after a release from its deadline
+};
+
+// First bit of a release that is not on the schedule (not measured for the skew)
+#define EPOCH_UNSCHEDULED (~0ULL)
+
+// Timestamps of a release: arrival, deadline, release
+struct epoch_times {
+  uint64_t reached, deadline, released;
+};
+
+struct epoch_schedule {
+  uint64_t start;             //TSC of the start of the first epoch
+  uint64_t period;            //cycles of an epoch
+  uint64_t offset;            //release of this side after the start of an epoch
+  uint64_t skew;              //release latency: cycles from a release to the first bit (average)
+  //Last release: deadline, target and first bit after it
+  uint64_t deadline, target, first_bit;
+  bool on_time;
+  struct epoch_stats stats;
+};
+
+/*
+ * Start of the first epoch: the second boundary of the handshake's time mask
+ * from now (right after the handshake, the same for both sides).
+ */
+static uint64_t epoch_schedule_start(uint64_t timemask)
+{
+  uint64_t now = timer_cycles();
+  return (now & ~timemask) + 2*(timemask + 1);
+}
+
+static void epoch_schedule_init(struct epoch_schedule* s, uint64_t start, const struct channel_params* p,
+                                uint64_t offset)
+{
+  memset(s, 0, sizeof(*s));
+  s->start = start;
+  s->period = p->sync_bitfreq*p->epoch_bit_cycles;
+  s->offset = offset;
+}
+
+/*
+ * Deadline of epoch e for this side.
+ */
+static inline uint64_t epoch_deadline(const struct epoch_schedule* s, uint64_t e)
+{
+  return s->start + e*s->period + s->offset;
+}
+
+/*
+ * Waits until deadline, less the release latency, and counts the wait.
+ * first_bit is the bit that runs after the release (EPOCH_UNSCHEDULED: none
+ * on the schedule).
+ */
+static void epoch_wait(struct epoch_schedule* s, uint64_t deadline, uint64_t first_bit, struct epoch_times* t)
+{
+  unsigned int junk = 0;
+  uint64_t target = deadline - s->skew;
+  t->deadline = deadline;
+  t->reached = MEM_RDTSCP(&junk);
+  uint64_t now = t->reached;
+  while(now < target)
+    now = MEM_RDTSCP(&junk);
+  t->released = now;
+
+  s->stats.epochs++;
+  s->on_time = (t->reached <= target);
+  if(s->on_time)
+    s->stats.wait_cycles += t->released - t->reached;
+  else {
+    s->stats.late++;
+    s->stats.late_cycles += t->reached - target;
+  }
+  s->deadline = deadline;
+  s->target = target;
+  s->first_bit = first_bit;
+}
+
+/*
+ * Measures the skew of the last release from the timestamps of the bits
+ * (ring of ring_size, the last one bit_id), if it was on time and the
+ * timestamp of its first bit is still in the ring.
+ */
+static void epoch_measure_skew(struct epoch_schedule* s, const uint64_t* timestamps, uint64_t ring_size,
+                               uint64_t bit_id)
+{
+  if(!s->on_time || s->stats.epochs == 0 || s->first_bit == EPOCH_UNSCHEDULED ||
+     bit_id < s->first_bit || bit_id - s->first_bit >= ring_size)
+    return;
+  uint64_t first = timestamps[s->first_bit % ring_size];
+  if(first < s->target)
+    return;
+  uint64_t latency = first - s->target;
+  s->skew = s->stats.skew_samples ? (3*s->skew + latency)/4 : latency;
+  s->stats.skew_samples++;
+  s->stats.skew_cycles += (first > s->deadline) ? first - s->deadline : s->deadline - first;
+}
+
+/*
+ * Adds the counters of a lane's schedule to sum.
+ */
+static void epoch_stats_add(struct epoch_stats* sum, const struct epoch_stats* s)
+{
+  sum->epochs += s->epochs;
+  sum->wait_cycles += s->wait_cycles;
+  sum->late += s->late;
+  sum->late_cycles += s->late_cycles;
+  sum->skew_samples += s->skew_samples;
+  sum->skew_cycles += s->skew_cycles;
+}
+
+/*
+ * Waiting cost, out of total_cycles of transmission (of every lane).
+ */
+static double epoch_overhead(const struct epoch_stats* s, uint64_t total_cycles)
+{
+  return total_cycles ? 100.0*s->wait_cycles/total_cycles : 0;
+}
+
+static void epoch_print(const char* side, const struct epoch_stats* s, uint64_t total_cycles)
+{
+  uint64_t n = s->epochs ? s->epochs : 1;
+  printf("%s Epochs: %llu, per epoch: wait %.0f cycles, %.3f%% of the transmission. Missed deadlines: %llu"
+         " (late by %.0f cycles on average). Skew of the first bit: %.0f cycles.\n", side, s->epochs,
+         1.0*s->wait_cycles/n, epoch_overhead(s, total_cycles), s->late,
+         s->late ? 1.0*s->late_cycles/s->late : 0.0,
+         s->skew_samples ? 1.0*s->skew_cycles/s->skew_samples : 0.0);
+}
+
+#endif
+
+//
+// epoch_schedule.hh ends here
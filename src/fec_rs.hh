@@ -0,0 +1,344 @@
+// Copyright (C) 2020, Gururaj Saileshwar
+
+// Commentary:
+// Reed-Solomon codes over GF(2^8) (primitive polynomial 0x11d, roots
+// alpha^0 .. alpha^(nroots-1)), shortened to n symbols (up to 255), with
+// errors-and-erasures decoding (Berlekamp-Massey, Chien search, Forney): a
+// codeword is decoded if 2 x errors + erasures <= nroots.
+//
+// The codes run on 64-bit words, each holding a symbol of 8 codewords (byte c
+// of every word is codeword c), so that the encoder and the syndromes handle 8
+// codewords per table lookup pass: a word is multiplied by a constant with the
+// row of the constant in the multiplication table (64KB). Only the codewords
+// with non-zero syndromes are decoded one at a time.
+//
+// For erasure codes over long buffers (see epoch_code.hh), a buffer is
+// multiplied by a constant and added to another (gf256_region_mul_add) 32
+// bytes at a time with AVX2, each byte split in nibbles that index 16-entry
+// product tables (vpshufb), or a byte at a time through the table row
+// otherwise. The kernel is chosen at gf256_init, as in fec_secded7264.cc.
+
+#ifndef FEC_RS_H_
+#define FEC_RS_H_
+
+#include <immintrin.h>
+
+#include "utils.hh"
+
+#define FEC_RS_MAX_N (255)
+#define FEC_RS_MAX_ROOTS (128)
+#define FEC_RS_LANES (8)
+
+// GF(2^8) tables
+struct gf256 {
+  uint8_t exp[2*255];
+  uint8_t log[256];
+  uint8_t mul[256][256];
+  bool ready;
+};
+static struct gf256 gf256_tables;
+
+/*
+ * dst ^= c x src, over len bytes.
+ */
+static void gf256_region_mul_add_generic(uint8_t* dst, const uint8_t* src, uint8_t c, uint64_t len)
+{
+  const uint8_t* row = gf256_tables.mul[c];
+  for(uint64_t i=0; i<len; i++)
+    dst[i] ^= row[src[i]];
+}
+
+__attribute__((target("avx2")))
+static void gf256_region_mul_add_avx2(uint8_t* dst, const uint8_t* src, uint8_t c, uint64_t len)
+{
+  uint8_t lo[16], hi[16];
+  for(int x=0; x<16; x++){
+    lo[x] = gf256_tables.mul[c][x];
+    hi[x] = gf256_tables.mul[c][x << 4];
+  }
+  const __m256i tlo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) lo));
+  const __m256i thi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) hi));
+  const __m256i nibble = _mm256_set1_epi8(0x0F);
+  uint64_t i = 0;
+  for(; i+32<=len; i+=32){
+    __m256i s = _mm256_loadu_si256((const __m256i*) &src[i]);
+    __m256i p = _mm256_xor_si256(_mm256_shuffle_epi8(tlo, _mm256_and_si256(s, nibble)),
+                                 _mm256_shuffle_epi8(thi, _mm256_and_si256(_mm256_srli_epi16(s, 4), nibble)));
+    __m256i d = _mm256_loadu_si256((const __m256i*) &dst[i]);
+    _mm256_storeu_si256((__m256i*) &dst[i], _mm256_xor_si256(d, p));
+  }
+  gf256_region_mul_add_generic(&dst[i], &src[i], c, len - i);
+}
+
+typedef void (*gf256_region_fn)(uint8_t*, const uint8_t*, uint8_t, uint64_t);
+static gf256_region_fn gf256_region_kernel = gf256_region_mul_add_generic;
+static const char* gf256_region_impl = "generic";
+
+/*
+ * dst ^= c x src, over len bytes.
+ */
+static inline void gf256_region_mul_add(uint8_t* dst, const uint8_t* src, uint8_t c, uint64_t len)
+{
+  if(c == 0)
+    return;
+  gf256_region_kernel(dst, src, c, len);
+}
+
+/*
+ * Selects the region kernel (avx2: if the CPU has it), and returns its name.
+ */
+static const char* gf256_select_region(bool avx2)
+{
+  __builtin_cpu_init();
+  if(avx2 && __builtin_cpu_supports("avx2")){
+    gf256_region_kernel = gf256_region_mul_add_avx2;
+    gf256_region_impl = "avx2";
+  } else {
+    gf256_region_kernel = gf256_region_mul_add_generic;
+    gf256_region_impl = "generic";
+  }
+  return gf256_region_impl;
+}
+
+static void gf256_init()
+{
+  if(gf256_tables.ready)
+    return;
+  unsigned int x = 1;
+  for(int i=0; i<255; i++){
+    gf256_tables.exp[i] = gf256_tables.exp[i+255] = x;
+    gf256_tables.log[x] = i;
+    x <<= 1;
+    if(x & 0x100)
+      x ^= 0x11d;
+  }
+  gf256_tables.log[0] = 0;
+  for(int a=0; a<256; a++)
+    for(int b=0; b<256; b++)
+      gf256_tables.mul[a][b] = (a && b) ? gf256_tables.exp[gf256_tables.log[a] + gf256_tables.log[b]] : 0;
+  gf256_tables.ready = true;
+  gf256_select_region(true);
+}
+
+static inline uint8_t gf256_mul(uint8_t a, uint8_t b)
+{
+  return gf256_tables.mul[a][b];
+}
+
+static inline uint8_t gf256_inv(uint8_t a)
+{
+  return gf256_tables.exp[255 - gf256_tables.log[a]];
+}
+
+/*
+ * Multiplies the 8 symbols of w by c.
+ */
+static inline uint64_t gf256_mul_word(uint64_t w, uint8_t c)
+{
+  const uint8_t* row = gf256_tables.mul[c];
+  uint64_t r = 0;
+  for(int s=0; s<FEC_RS_LANES*8; s+=8)
+    r |= (uint64_t)row[(w >> s) & 0xFF] << s;
+  return r;
+}
+
+struct fec_rs {
+  int n, nroots;
+  uint8_t gen[FEC_RS_MAX_ROOTS + 1];  //generator polynomial, gen[i]: coefficient of x^i
+};
+
+/*
+ * Code of n symbols, nroots of them parity (1 <= nroots < n <= 255).
+ */
+static void fec_rs_init(struct fec_rs* rs, int n, int nroots)
+{
+  gf256_init();
+  rs->n = n;
+  rs->nroots = nroots;
+  memset(rs->gen, 0, sizeof(rs->gen));
+  rs->gen[0] = 1;
+  for(int j=0; j<nroots; j++){
+    //gen *= (x + alpha^j)
+    uint8_t root = gf256_tables.exp[j];
+    for(int i=j+1; i>0; i--)
+      rs->gen[i] = rs->gen[i-1] ^ gf256_mul(rs->gen[i], root);
+    rs->gen[0] = gf256_mul(rs->gen[0], root);
+  }
+}
+
+/*
+ * Encodes 8 codewords: words[0..n-nroots-1] hold their data symbols, and
+ * words[n-nroots..n-1] get their parity symbols.
+ */
+static void fec_rs_encode_words(const struct fec_rs* rs, uint64_t* words)
+{
+  int k = rs->n - rs->nroots;
+  uint64_t* reg = &words[k];
+  memset(reg, 0, rs->nroots*sizeof(uint64_t));
+  for(int i=0; i<k; i++){
+    uint64_t fb = words[i] ^ reg[0];
+    for(int j=0; j<rs->nroots-1; j++)
+      reg[j] = reg[j+1] ^ gf256_mul_word(fb, rs->gen[rs->nroots-1-j]);
+    reg[rs->nroots-1] = gf256_mul_word(fb, rs->gen[0]);
+  }
+}
+
+/*
+ * Decodes the codeword sym (n symbols, the first one of the highest degree),
+ * with the erasures of the positions eras[0..num_eras-1]. Returns the number
+ * of symbols corrected, or -1 (sym unchanged) if it cannot be decoded.
+ */
+static int fec_rs_decode(const struct fec_rs* rs, uint8_t* sym, const int* eras, int num_eras)
+{
+  int n = rs->n, nroots = rs->nroots;
+  uint8_t s[FEC_RS_MAX_ROOTS];
+  bool clean = true;
+  for(int j=0; j<nroots; j++){
+    uint8_t root = gf256_tables.exp[j], acc = 0;
+    for(int i=0; i<n; i++)
+      acc = gf256_mul(acc, root) ^ sym[i];
+    s[j] = acc;
+    clean &= (acc == 0);
+  }
+  if(clean)
+    return 0;
+  if(num_eras > nroots)
+    return -1;
+
+  //Erasure locator, the start of the error locator: prod (1 + X_k x), X_k = alpha^(n-1-pos)
+  uint8_t lambda[FEC_RS_MAX_ROOTS + 1], b[FEC_RS_MAX_ROOTS + 1], t[FEC_RS_MAX_ROOTS + 1];
+  memset(lambda, 0, sizeof(lambda));
+  lambda[0] = 1;
+  for(int e=0; e<num_eras; e++){
+    uint8_t x = gf256_tables.exp[n - 1 - eras[e]];
+    for(int i=e+1; i>0; i--)
+      lambda[i] ^= gf256_mul(lambda[i-1], x);
+  }
+  memcpy(b, lambda, sizeof(b));
+
+  //Berlekamp-Massey
+  int el = num_eras;
+  for(int r=num_eras+1; r<=nroots; r++){
+    uint8_t discr = 0;
+    for(int i=0; i<r; i++)
+      discr ^= gf256_mul(lambda[i], s[r-1-i]);
+    //b *= x
+    memmove(&b[1], &b[0], nroots*sizeof(uint8_t));
+    b[0] = 0;
+    if(discr == 0)
+      continue;
+    for(int i=0; i<=nroots; i++)
+      t[i] = lambda[i] ^ gf256_mul(discr, b[i]);
+    if(2*el <= r + num_eras - 1){
+      el = r + num_eras - el;
+      uint8_t inv = gf256_inv(discr);
+      for(int i=0; i<=nroots; i++)
+        b[i] = gf256_mul(lambda[i], inv);
+    }
+    memcpy(lambda, t, sizeof(lambda));
+  }
+  int deg = 0;
+  for(int i=0; i<=nroots; i++)
+    if(lambda[i])
+      deg = i;
+  if(deg == 0 || deg > nroots)
+    return -1;
+
+  //Chien search over the n positions: lambda(X^-1) == 0
+  int pos[FEC_RS_MAX_ROOTS];
+  int count = 0;
+  for(int i=0; i<n && count<deg; i++){
+    uint8_t xinv = gf256_tables.exp[(255 - (n - 1 - i)) % 255], acc = 0;
+    for(int d=deg; d>=0; d--)
+      acc = gf256_mul(acc, xinv) ^ lambda[d];
+    if(acc == 0)
+      pos[count++] = i;
+  }
+  if(count != deg)
+    return -1;
+
+  //Forney: omega = s x lambda mod x^nroots, e = X omega(X^-1)/lambda'(X^-1)
+  uint8_t omega[FEC_RS_MAX_ROOTS];
+  for(int i=0; i<nroots; i++){
+    uint8_t acc = 0;
+    for(int j=0; j<=i && j<=deg; j++)
+      acc ^= gf256_mul(lambda[j], s[i-j]);
+    omega[i] = acc;
+  }
+  uint8_t value[FEC_RS_MAX_ROOTS];
+  for(int c=0; c<count; c++){
+    int p = n - 1 - pos[c];
+    uint8_t x = gf256_tables.exp[p], xinv = gf256_tables.exp[(255 - p) % 255];
+    uint8_t num = 0, den = 0;
+    for(int i=nroots-1; i>=0; i--)
+      num = gf256_mul(num, xinv) ^ omega[i];
+    for(int i=deg - !(deg & 1); i>=1; i-=2)
+      den = gf256_mul(den, gf256_mul(xinv, xinv)) ^ lambda[i];
+    if(den == 0)
+      return -1;
+    value[c] = gf256_mul(gf256_mul(x, num), gf256_inv(den));
+  }
+  int corrected = 0;
+  for(int c=0; c<count; c++){
+    sym[pos[c]] ^= value[c];
+    corrected += (value[c] != 0);
+  }
+  return corrected;
+}
+
+/*
+ * Syndromes of the 8 codewords of words: true if they are all codewords.
+ */
+static bool fec_rs_check_words(const struct fec_rs* rs, const uint64_t* words)
+{
+  for(int j=0; j<rs->nroots; j++){
+    uint8_t root = gf256_tables.exp[j];
+    uint64_t acc = 0;
+    for(int i=0; i<rs->n; i++)
+      acc = gf256_mul_word(acc, root) ^ words[i];
+    if(acc)
+      return false;
+  }
+  return true;
+}
+
+/*
+ * Decodes the 8 codewords of words (n words), with the erasures of the words
+ * flagged in erased (NULL: none). A codeword that does not decode with the
+ * erasures is decoded without them. Returns the number of codewords that
+ * cannot be decoded, and adds the symbols corrected to corrected.
+ */
+static int fec_rs_decode_words(const struct fec_rs* rs, uint64_t* words, const bool* erased, uint64_t* corrected)
+{
+  if(fec_rs_check_words(rs, words))
+    return 0;
+  int eras[FEC_RS_MAX_N];
+  int num_eras = 0;
+  for(int i=0; erased && i<rs->n; i++)
+    if(erased[i])
+      eras[num_eras++] = i;
+
+  int failed = 0;
+  for(int c=0; c<FEC_RS_LANES; c++){
+    int shift = 8*(FEC_RS_LANES - 1 - c);
+    uint8_t sym[FEC_RS_MAX_N];
+    for(int i=0; i<rs->n; i++)
+      sym[i] = words[i] >> shift;
+    int fixed = (num_eras && num_eras <= rs->nroots) ? fec_rs_decode(rs, sym, eras, num_eras) : -1;
+    if(fixed < 0)
+      fixed = fec_rs_decode(rs, sym, NULL, 0);
+    if(fixed < 0){
+      failed++;
+      continue;
+    }
+    for(int i=0; i<rs->n; i++)
+      words[i] = (words[i] & ~((uint64_t)0xFF << shift)) | ((uint64_t)sym[i] << shift);
+    *corrected += fixed;
+  }
+  return failed;
+}
+
+#endif
+
+//
+// fec_rs.hh ends here
@@ -32,42 +32,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <immintrin.h>
 #include "fec_secded7264.hh"
 
-// number of ones in a byte
-//  0   0000 0000   :   0
-//  1   0000 0001   :   1
-//  2   0000 0010   :   1
-//  3   0000 0011   :   2
-//  4   0000 0100   :   1
-//  ...
-//  126 0111 1110   :   6
-//  127 0111 1111   :   7
-//  128 1000 0000   :   1
-//  129 1000 0001   :   2
-//  ...
-//  253 1111 1101   :   7
-//  254 1111 1110   :   7
-//  255 1111 1111   :   8
-unsigned const char liquid_c_ones[256] = {
-    0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
-    1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5,
-    1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5,
-    2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6,
-    1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5,
-    2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6,
-    2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6,
-    3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7,
-    1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5,
-    2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6,
-    2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6,
-    3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7,
-    2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6,
-    3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7,
-    3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7,
-    4, 5, 5, 6, 5, 6, 6, 7, 5, 6, 6, 7, 6, 7, 7, 8
-};
-
 #define DEBUG_FEC_SECDED7264 0
 
 // P matrix [8 x 64]
@@ -101,56 +69,184 @@ unsigned char secded7264_syndrome_w1[72] = {
     0x91, 0x92, 0x94, 0x98, 0xe0, 0xec, 0xdc, 0xd0,
     0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80};
 
-// compute parity byte on 64-byte input
-static unsigned char fec_secded7264_compute_parity(const unsigned char * _v)
+// P matrix rows as 64-bit words (row i is secded7264_P[8*i..8*i+7], first
+// byte most significant), so a data word in the same byte order can be
+// masked with a whole row at once
+static uint64_t secded7264_P_w[8];
+
+// syndrome -> single-error position n (see secded7264_syndrome_w1), or -1
+// when the syndrome is zero or matches no weight-1 error
+static signed char secded7264_syndrome_pos[256];
+
+// bit position b of the AVX2 parity movemask (per word) -> parity bit
+static unsigned char secded7264_avx2_perm[256];
+
+// parity byte of one data word (bit 7-i of the result is the parity of row i)
+static inline unsigned char fec_secded7264_parity_word(uint64_t _d)
 {
-    // compute parity byte on message
     unsigned int i;
     unsigned char parity = 0x00;
-    for (i=0; i<8; i++) {
-        parity <<= 1;
-
-        unsigned int p = liquid_c_ones[ secded7264_P[8*i+0] & _v[0] ] +
-                         liquid_c_ones[ secded7264_P[8*i+1] & _v[1] ] +
-                         liquid_c_ones[ secded7264_P[8*i+2] & _v[2] ] +
-                         liquid_c_ones[ secded7264_P[8*i+3] & _v[3] ] +
-                         liquid_c_ones[ secded7264_P[8*i+4] & _v[4] ] +
-                         liquid_c_ones[ secded7264_P[8*i+5] & _v[5] ] +
-                         liquid_c_ones[ secded7264_P[8*i+6] & _v[6] ] +
-                         liquid_c_ones[ secded7264_P[8*i+7] & _v[7] ];
-
-        parity |= p & 0x01;
-    }
-
-    // return parity byte
+    for (i=0; i<8; i++)
+        parity = (parity << 1) | __builtin_parityll(secded7264_P_w[i] & _d);
     return parity;
 }
 
-// compute syndrome on 72-bit input
-static unsigned char fec_secded7264_compute_syndrome(const unsigned char * _v)
+// portable batch parity
+static void fec_secded7264_parity_words_generic(unsigned int _n,
+                                                const uint64_t * _d,
+                                                unsigned char * _parity)
 {
-    // TODO : unwrap this loop
+    unsigned int k;
+    for (k=0; k<_n; k++)
+        _parity[k] = fec_secded7264_parity_word(_d[k]);
+}
+
+// batch parity with one popcnt per row
+__attribute__((target("popcnt")))
+static void fec_secded7264_parity_words_popcnt(unsigned int _n,
+                                               const uint64_t * _d,
+                                               unsigned char * _parity)
+{
+    unsigned int k;
+    for (k=0; k<_n; k++) {
+        uint64_t d = _d[k];
+        _parity[k] = ((__builtin_popcountll(secded7264_P_w[0] & d) & 1) << 7) |
+                     ((__builtin_popcountll(secded7264_P_w[1] & d) & 1) << 6) |
+                     ((__builtin_popcountll(secded7264_P_w[2] & d) & 1) << 5) |
+                     ((__builtin_popcountll(secded7264_P_w[3] & d) & 1) << 4) |
+                     ((__builtin_popcountll(secded7264_P_w[4] & d) & 1) << 3) |
+                     ((__builtin_popcountll(secded7264_P_w[5] & d) & 1) << 2) |
+                     ((__builtin_popcountll(secded7264_P_w[6] & d) & 1) << 1) |
+                     ((__builtin_popcountll(secded7264_P_w[7] & d) & 1) << 0);
+    }
+}
+
+// batch parity, four words per AVX2 register. The eight masked rows of every
+// word are XOR-folded together: each halving step folds two rows into one
+// register (one row per half), so after three steps every byte of a lane holds
+// the partial parity of a different row; byte b holds row 4*(b&1) +
+// 2*((b>>1)&1) + ((b>>2)&1), which secded7264_avx2_perm undoes.
+__attribute__((target("avx2")))
+static void fec_secded7264_parity_words_avx2(unsigned int _n,
+                                             const uint64_t * _d,
+                                             unsigned char * _parity)
+{
+    unsigned int k = 0;
     unsigned int i;
-    unsigned char syndrome = 0x00;
+    __m256i P[8];
+    for (i=0; i<8; i++)
+        P[i] = _mm256_set1_epi64x((long long)secded7264_P_w[i]);
+    const __m256i hi_bytes = _mm256_set1_epi16((short)0xFF00);
+
+    for (k=0; k+4<=_n; k+=4) {
+        __m256i d = _mm256_loadu_si256((const __m256i *)&_d[k]);
+        __m256i t[8], w[4], x[2], a, b, y;
+        for (i=0; i<8; i++)
+            t[i] = _mm256_and_si256(d, P[i]);
+
+        // 64 -> 32: row 2j in the low half, row 2j+1 in the high half
+        for (i=0; i<4; i++) {
+            a = _mm256_xor_si256(t[2*i],   _mm256_srli_epi64(t[2*i],   32));
+            b = _mm256_xor_si256(t[2*i+1], _mm256_slli_epi64(t[2*i+1], 32));
+            w[i] = _mm256_blend_epi32(a, b, 0xAA);
+        }
+        // 32 -> 16
+        for (i=0; i<2; i++) {
+            a = _mm256_xor_si256(w[2*i],   _mm256_srli_epi32(w[2*i],   16));
+            b = _mm256_xor_si256(w[2*i+1], _mm256_slli_epi32(w[2*i+1], 16));
+            x[i] = _mm256_blend_epi16(a, b, 0xAA);
+        }
+        // 16 -> 8
+        a = _mm256_xor_si256(x[0], _mm256_srli_epi16(x[0], 8));
+        b = _mm256_xor_si256(x[1], _mm256_slli_epi16(x[1], 8));
+        y = _mm256_blendv_epi8(a, b, hi_bytes);
+        // 8 -> 1 (bit 0 of every byte)
+        y = _mm256_xor_si256(y, _mm256_srli_epi16(y, 4));
+        y = _mm256_xor_si256(y, _mm256_srli_epi16(y, 2));
+        y = _mm256_xor_si256(y, _mm256_srli_epi16(y, 1));
+        unsigned int m = (unsigned int)_mm256_movemask_epi8(_mm256_slli_epi16(y, 7));
+
+        _parity[k+0] = secded7264_avx2_perm[(m >>  0) & 0xFF];
+        _parity[k+1] = secded7264_avx2_perm[(m >>  8) & 0xFF];
+        _parity[k+2] = secded7264_avx2_perm[(m >> 16) & 0xFF];
+        _parity[k+3] = secded7264_avx2_perm[(m >> 24) & 0xFF];
+    }
+
+    fec_secded7264_parity_words_popcnt(_n-k, &_d[k], &_parity[k]);
+}
+
+typedef void (*fec_secded7264_parity_fn)(unsigned int, const uint64_t *, unsigned char *);
+static fec_secded7264_parity_fn fec_secded7264_parity_words = fec_secded7264_parity_words_generic;
+static int fec_secded7264_impl = FEC_SECDED7264_IMPL_GENERIC;
+
+int fec_secded7264_select_impl(int _impl)
+{
+    __builtin_cpu_init();
+    if (_impl >= FEC_SECDED7264_IMPL_AVX2 && __builtin_cpu_supports("avx2")) {
+        fec_secded7264_parity_words = fec_secded7264_parity_words_avx2;
+        fec_secded7264_impl = FEC_SECDED7264_IMPL_AVX2;
+    } else if (_impl >= FEC_SECDED7264_IMPL_POPCNT && __builtin_cpu_supports("popcnt")) {
+        fec_secded7264_parity_words = fec_secded7264_parity_words_popcnt;
+        fec_secded7264_impl = FEC_SECDED7264_IMPL_POPCNT;
+    } else {
+        fec_secded7264_parity_words = fec_secded7264_parity_words_generic;
+        fec_secded7264_impl = FEC_SECDED7264_IMPL_GENERIC;
+    }
+    return fec_secded7264_impl;
+}
+
+const char * fec_secded7264_impl_name(int _impl)
+{
+    switch (_impl) {
+    case FEC_SECDED7264_IMPL_AVX2:   return "avx2";
+    case FEC_SECDED7264_IMPL_POPCNT: return "popcnt";
+    default:                         return "generic";
+    }
+}
+
+// build the word tables from secded7264_P/secded7264_syndrome_w1 and select
+// the fastest parity kernel, before main()
+__attribute__((constructor))
+static void fec_secded7264_init(void)
+{
+    unsigned int i, b;
     for (i=0; i<8; i++) {
-        syndrome <<= 1;
-
-        // compute parity bit
-        unsigned int p =
-            ( (_v[0] & (1<<(8-i-1))) ? 1 : 0 ) +
-            liquid_c_ones[ secded7264_P[8*i+0] & _v[1] ] +
-            liquid_c_ones[ secded7264_P[8*i+1] & _v[2] ] +
-            liquid_c_ones[ secded7264_P[8*i+2] & _v[3] ] +
-            liquid_c_ones[ secded7264_P[8*i+3] & _v[4] ] +
-            liquid_c_ones[ secded7264_P[8*i+4] & _v[5] ] +
-            liquid_c_ones[ secded7264_P[8*i+5] & _v[6] ] +
-            liquid_c_ones[ secded7264_P[8*i+6] & _v[7] ] +
-            liquid_c_ones[ secded7264_P[8*i+7] & _v[8] ];
-
-        syndrome |= p & 0x01;
+        secded7264_P_w[i] = 0;
+        for (b=0; b<8; b++)
+            secded7264_P_w[i] = (secded7264_P_w[i] << 8) | secded7264_P[8*i+b];
     }
 
-    return syndrome;
+    memset(secded7264_syndrome_pos, -1, sizeof(secded7264_syndrome_pos));
+    for (i=72; i>0; i--)
+        secded7264_syndrome_pos[secded7264_syndrome_w1[i-1]] = i-1;
+
+    for (i=0; i<256; i++) {
+        unsigned char parity = 0x00;
+        for (b=0; b<8; b++) {
+            unsigned int row = 4*(b & 1) + 2*((b >> 1) & 1) + ((b >> 2) & 1);
+            if (i & (1 << b))
+                parity |= 1 << (7-row);
+        }
+        secded7264_avx2_perm[i] = parity;
+    }
+
+    fec_secded7264_select_impl(FEC_SECDED7264_IMPL_AVX2);
+}
+
+// compute parity byte on 64-bit (8-byte) input
+static unsigned char fec_secded7264_compute_parity(const unsigned char * _v)
+{
+    uint64_t d = 0;
+    unsigned int i;
+    for (i=0; i<8; i++)
+        d = (d << 8) | _v[i];
+    return fec_secded7264_parity_word(d);
+}
+
+// compute syndrome on 72-bit input
+static unsigned char fec_secded7264_compute_syndrome(const unsigned char * _v)
+{
+    return _v[0] ^ fec_secded7264_compute_parity(&_v[1]);
 }
 
 // estimate error vector, returning 0/1/2 for zero/one/multiple errors
@@ -166,28 +262,19 @@ static int fec_secded7264_estimate_ehat(const unsigned char * _sym_enc,
     // compute syndrome vector, s = r*H^T = ( H*r^T )^T
     unsigned char s = fec_secded7264_compute_syndrome(_sym_enc);
 
-    // compute weight of s
-    unsigned int ws = liquid_c_ones[s];
-
-    if (ws == 0) {
+    if (s == 0) {
         // no errors detected
         return 0;
-    } else {
-        // estimate error location; search for syndrome with error
-        // vector of weight one
+    }
 
-        unsigned int n;
-        // estimate error location
-        for (n=0; n<72; n++) {
-            if (s == secded7264_syndrome_w1[n]) {
-                // single error detected at location 'n'
-                div_t d = div(n,8);
-                _e_hat[9-d.quot-1] = 1 << d.rem;
-
-                return 1;
-            }
-        }
+    // estimate error location from syndrome
+    int n = secded7264_syndrome_pos[s];
+    if (n >= 0) {
+        // single error detected at location 'n'
+        div_t d = div(n,8);
+        _e_hat[9-d.quot-1] = 1 << d.rem;
 
+        return 1;
     }
 
     // no syndrome match; multiple errors detected
@@ -364,3 +451,71 @@ unsigned int fec_secded7264_decode_lazy(unsigned int _enc_msg_len,
 
     return i;
 }
+
+// encode a batch of 64-bit data words using SEC-DED (72,64) encoder
+//
+//  _num_words      :   number of data words
+//  _data           :   data words [size: _num_words x 1]
+//  _parity         :   parity bytes [size: _num_words x 1]
+void fec_secded7264_encode_words(unsigned int _num_words,
+                                 const uint64_t *_data,
+                                 unsigned char *_parity)
+{
+    fec_secded7264_parity_words(_num_words, _data, _parity);
+}
+
+// decode a batch of 64-bit data words in place using SEC-DED (72,64) decoder
+//
+//  _num_words      :   number of data words
+//  _data           :   received/corrected data words [size: _num_words x 1]
+//  _parity         :   received parity bytes [size: _num_words x 1]
+//  _flags          :   0/1/2 for zero/one/multiple errors detected
+//                      [size: _num_words x 1] (can be NULL)
+unsigned int fec_secded7264_decode_words(unsigned int _num_words,
+                                         uint64_t *_data,
+                                         const unsigned char *_parity,
+                                         unsigned char *_flags)
+{
+    unsigned char s[64];    // syndromes of the current batch
+    unsigned int num_errors = 0;
+    unsigned int k, i;
+
+    for (k=0; k<_num_words; k+=64) {
+        unsigned int n = _num_words-k < 64 ? _num_words-k : 64;
+        fec_secded7264_parity_words(n, &_data[k], s);
+        for (i=0; i<n; i++)
+            s[i] ^= _parity[k+i];
+
+        for (i=0; i<n; i++) {
+            // fast path: eight clean blocks at once
+            if (i+8 <= n) {
+                uint64_t s8;
+                memcpy(&s8, &s[i], sizeof(s8));
+                if (s8 == 0) {
+                    if (_flags != NULL)
+                        memset(&_flags[k+i], 0, 8);
+                    i += 7;
+                    continue;
+                }
+            }
+
+            int flag = 0;
+            if (s[i] != 0) {
+                int pos = secded7264_syndrome_pos[s[i]];
+                if (pos < 0) {
+                    flag = 2;
+                    num_errors++;
+                } else {
+                    flag = 1;
+                    // positions 64..71 are parity bits
+                    if (pos < 64)
+                        _data[k+i] ^= (uint64_t)1 << pos;
+                }
+            }
+            if (_flags != NULL)
+                _flags[k+i] = flag;
+        }
+    }
+
+    return num_errors;
+}
@@ -23,6 +23,8 @@
 #ifndef FEC7264_H
 #define FEC7264_H
 
+#include <stdint.h>
+
 /* fec_secded7264_encode
  *
  * Inputs:
@@ -76,4 +78,60 @@ unsigned int fec_secded7264_decode_lazy(unsigned int enc_msg_len,
                                         const unsigned char *msg_enc,
                                         unsigned char *msg_dec);
 
+/* Batch (word) API
+ *
+ * A data word holds the 8 message bytes of one block, first byte in the
+ * most-significant position; its parity byte is the first byte of the 9-byte
+ * encoded block. Results are bit-identical to the byte API above.
+ */
+
+/* Parity kernels for the batch API; the fastest supported one is selected
+ * at startup. */
+#define FEC_SECDED7264_IMPL_GENERIC (0)
+#define FEC_SECDED7264_IMPL_POPCNT  (1)
+#define FEC_SECDED7264_IMPL_AVX2    (2)
+
+/* fec_secded7264_select_impl
+ *
+ * Selects the parity kernel impl, or the fastest one below it that the CPU
+ * supports.
+ *
+ * Returns:
+ * Selected kernel
+ */
+int fec_secded7264_select_impl(int impl);
+const char * fec_secded7264_impl_name(int impl);
+
+/* fec_secded7264_encode_words
+ *
+ * Inputs:
+ * num_words    number of data words
+ * data         data words
+ *
+ * Outputs:
+ * parity       parity byte of each data word gets put here
+ */
+void fec_secded7264_encode_words(unsigned int num_words,
+                                 const uint64_t *data,
+                                 unsigned char *parity);
+
+/* fec_secded7264_decode_words
+ *
+ * Inputs:
+ * num_words    number of data words
+ * data         received data words, corrected in place
+ * parity       received parity byte of each data word
+ *
+ * Outputs:
+ * flags        0/1/2 per word for zero/one/multiple errors detected
+ *              (can be NULL)
+ *
+ * Returns:
+ * Number of unrecoverable errors encountered in decoding
+ */
+unsigned int fec_secded7264_decode_words(unsigned int num_words,
+                                         uint64_t *data,
+                                         const unsigned char *parity,
+                                         unsigned char *flags);
+
 #endif
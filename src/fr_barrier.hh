@@ -0,0 +1,309 @@
+// Copyright (C) 2020, Gururaj Saileshwar
+
+// Commentary:
+// Flush+Reload barrier of the sender and the receiver, every sync period.
+//
+// Each side signals with loads of its own lines and watches the other's lines
+// by polling them: a poll reloads each line (timed) and flushes it again, so
+// a hit means the other side loaded it since the last poll. A signal counts
+// once a majority of the voting lines hit in the same poll (-S <lines>, lines
+// spread over the 3 sync pages of the lane, FR_BARRIER_MAX_LINES at most).
+//   Rx: polls Tx's ready lines until Tx has arrived, then loads its own ready
+//       lines and polls Tx's exit lines until Tx has left (the explicit exit
+//       confirmation), or gives up after the Rx sync timeout. A poll's reload
+//       can itself swallow the exit signal, if Tx loads a line while the
+//       reload of the miss is in flight; so Rx also takes Tx as gone once its
+//       ready lines stay cached (nobody polls them any more) for longer than
+//       Tx's longest poll period.
+//   Tx: loads its own ready lines and polls Rx's ready lines until Rx has seen
+//       it, then loads its exit lines (twice, in case a poll of Rx flushed the
+//       first load away) and leaves.
+// The poll interval starts at <poll min> cycles and doubles after every
+// unsuccessful poll, up to <poll max> (-S <lines>,<min>,<max>). Since the waits
+// of consecutive barriers are alike, it stays at <poll min> around the
+// average of the past waits, when the other side is most likely to arrive.
+//
+// Other lines of a side go along with its ready signal (fr_barrier_keep): Tx
+// keeps them loaded while it waits (the pilot markers, see pilot.hh), in case
+// the LLC evicts them; Rx loads them before it signals (the sync period it
+// chose, see sync_adapt.hh).
+//
+// Every side counts the cycles of its barriers by phase: waiting for the other
+// side to arrive, the handshake (Rx: until Tx has seen it) and the exit
+// confirmation (Tx: its exit signal), reported next to the bit period.
+
+#ifndef FR_BARRIER_H_
+#define FR_BARRIER_H_
+
+#include "utils.hh"
+#include "params.hh"
+
+#define FR_BARRIER_MAX_LINES (12)
+#define FR_BARRIER_SYNC_PAGES (3)
+// Lines of a sync page: ready lines in its first half, exit lines in the second
+#define FR_BARRIER_LINE_STRIDE (512)
+#define FR_BARRIER_EXIT_OFFSET (PAGE_SZ/2)
+// Polls at the minimum interval within 1/FR_BARRIER_EXPECTED_MARGIN of the expected end of a wait
+#define FR_BARRIER_EXPECTED_MARGIN (4)
+
+// Cycles of the barriers, by phase
+struct fr_barrier_stats {
+  uint64_t barriers;
+  uint64_t wait_cycles;       //until the other side was seen at the barrier
+  uint64_t handshake_cycles;  //until the other side has seen this one
+  uint64_t confirm_cycles;    //exit confirmation
+  uint64_t polls, timeouts;
+};
+
+// Timestamps of a barrier: arrival, other side seen, exit
+struct fr_barrier_times {
+  uint64_t reached, start, complete;
+};
+
+struct fr_barrier {
+  volatile uint64_t* own_ready[FR_BARRIER_MAX_LINES];
+  volatile uint64_t* own_exit[FR_BARRIER_MAX_LINES];
+  volatile uint64_t* peer_ready[FR_BARRIER_MAX_LINES];
+  volatile uint64_t* peer_exit[FR_BARRIER_MAX_LINES];
+  int num_lines, votes;
+  uint64_t threshold;         //hit/miss threshold of the polls
+  uint64_t poll_min, poll_max;
+  uint64_t timeout;           //cycles (0: none)
+  uint64_t expected_wait;     //average wait of the past barriers
+  uint64_t quiet;             //cycles without a poll of the other side after which it has left
+  volatile uint64_t* const* keep; //lines loaded along with the ready signal (num_keep, 0: none)
+  int num_keep;
+  struct fr_barrier_stats stats;
+};
+
+/*
+ * Lines of a barrier between own_pages (this side's sync pages) and
+ * peer_pages (the other side's), with the voting lines and poll intervals of p.
+ */
+static void fr_barrier_init(struct fr_barrier* b, uint64_t* const* own_pages, uint64_t* const* peer_pages,
+                            const struct channel_params* p, uint64_t threshold, uint64_t timeout)
+{
+  memset(b, 0, sizeof(*b));
+  b->num_lines = p->sync_lines;
+  b->votes = p->sync_lines/2 + 1;
+  for(int l=0; l<b->num_lines; l++){
+    uint64_t offset = (l/FR_BARRIER_SYNC_PAGES)*FR_BARRIER_LINE_STRIDE;
+    uint8_t* own = (uint8_t*) own_pages[l%FR_BARRIER_SYNC_PAGES];
+    uint8_t* peer = (uint8_t*) peer_pages[l%FR_BARRIER_SYNC_PAGES];
+    b->own_ready[l] = (uint64_t*) (own + offset);
+    b->own_exit[l] = (uint64_t*) (own + FR_BARRIER_EXIT_OFFSET + offset);
+    b->peer_ready[l] = (uint64_t*) (peer + offset);
+    b->peer_exit[l] = (uint64_t*) (peer + FR_BARRIER_EXIT_OFFSET + offset);
+  }
+  b->threshold = threshold;
+  b->poll_min = p->sync_poll_min;
+  b->poll_max = p->sync_poll_max;
+  b->timeout = timeout;
+  //Twice a poll period of the other side at the longest interval (a reload and a flush of every line)
+  b->quiet = 2*(b->poll_max + 2*b->num_lines*threshold);
+}
+
+static void fr_barrier_signal(struct fr_barrier* b, volatile uint64_t* const* lines)
+{
+  uint64_t temp = 0;
+  for(int l=0; l<b->num_lines; l++)
+    temp += MEM_LOAD(lines[l]);
+}
+
+/*
+ * Lines loaded along with the ready signal at the next barriers.
+ */
+static void fr_barrier_keep(struct fr_barrier* b, volatile uint64_t* const* lines, int num_lines)
+{
+  b->keep = lines;
+  b->num_keep = num_lines;
+}
+
+/*
+ * Ready signal, after the lines that go along with it.
+ */
+static void fr_barrier_signal_ready(struct fr_barrier* b)
+{
+  uint64_t temp = 0;
+  for(int l=0; l<b->num_keep; l++)
+    temp += MEM_LOAD(b->keep[l]);
+  fr_barrier_signal(b, b->own_ready);
+}
+
+static void fr_barrier_flush(struct fr_barrier* b, volatile uint64_t* const* lines)
+{
+  for(int l=0; l<b->num_lines; l++)
+    MEM_CLFLUSH((uint64_t*) lines[l]);
+}
+
+/*
+ * Loads the lines (a signal), timed: true if a majority of them hit, i.e. were
+ * not flushed since the last load.
+ */
+static bool fr_barrier_probe(struct fr_barrier* b, volatile uint64_t* const* lines)
+{
+  unsigned int junk = 0;
+  uint64_t temp = 0;
+  int hits = 0;
+  for(int l=0; l<b->num_lines; l++){
+    uint64_t time0 = MEM_RDTSCP(&junk);
+    temp += MEM_LOAD(lines[l]);
+    if(MEM_RDTSCP(&junk) - time0 < b->threshold)
+      hits++;
+  }
+  return hits >= b->votes;
+}
+
+/*
+ * Reloads and flushes the lines: true if a majority of them hit.
+ */
+static bool fr_barrier_poll(struct fr_barrier* b, volatile uint64_t* const* lines)
+{
+  unsigned int junk = 0;
+  uint64_t temp = 0;
+  int hits = 0;
+  for(int l=0; l<b->num_lines; l++){
+    uint64_t time0 = MEM_RDTSCP(&junk);
+    temp += MEM_LOAD(lines[l]);
+    uint64_t delta_time = MEM_RDTSCP(&junk) - time0;
+    MEM_CLFLUSH((uint64_t*) lines[l]);
+    if(delta_time < b->threshold)
+      hits++;
+  }
+  b->stats.polls++;
+  return hits >= b->votes;
+}
+
+/*
+ * Next poll interval after an unsuccessful poll, elapsed cycles into a wait
+ * expected to last expected cycles (0: unknown): the minimum around the
+ * expected end, otherwise doubled.
+ */
+static inline uint64_t fr_barrier_backoff(const struct fr_barrier* b, uint64_t interval, uint64_t elapsed,
+                                          uint64_t expected)
+{
+  uint64_t margin = expected/FR_BARRIER_EXPECTED_MARGIN + b->poll_max;
+  if(expected && elapsed + margin >= expected && elapsed <= expected + margin)
+    return b->poll_min;
+  return (2*interval < b->poll_max) ? 2*interval : b->poll_max;
+}
+
+/*
+ * Counts the cycles of a barrier (of Rx: after the wait, handshake; of Tx: confirm).
+ * A barrier that timed out does not count towards the expected wait.
+ */
+static void fr_barrier_account(struct fr_barrier* b, const struct fr_barrier_times* t, bool handshake_phase,
+                               bool timed_out)
+{
+  uint64_t wait = t->start - t->reached;
+  b->stats.barriers++;
+  b->stats.wait_cycles += wait;
+  if(handshake_phase)
+    b->stats.handshake_cycles += t->complete - t->start;
+  else
+    b->stats.confirm_cycles += t->complete - t->start;
+  if(timed_out)
+    b->stats.timeouts++;
+  else
+    b->expected_wait = b->expected_wait ? (3*b->expected_wait + wait)/4 : wait;
+}
+
+/*
+ * Barrier of the sender.
+ */
+static void fr_barrier_tx(struct fr_barrier* b, struct fr_barrier_times* t)
+{
+  unsigned int junk = 0;
+  t->reached = MEM_RDTSCP(&junk);
+  fr_barrier_flush(b, b->peer_ready);
+  uint64_t interval = b->poll_min;
+  while(true){
+    fr_barrier_signal_ready(b);
+    delayloop(interval);
+    if(fr_barrier_poll(b, b->peer_ready))
+      break;
+    interval = fr_barrier_backoff(b, interval, MEM_RDTSCP(&junk) - t->reached, b->expected_wait);
+  }
+  t->start = MEM_RDTSCP(&junk);
+
+  fr_barrier_signal(b, b->own_exit);
+  delayloop(b->poll_min);
+  fr_barrier_signal(b, b->own_exit);
+  t->complete = MEM_RDTSCP(&junk);
+  fr_barrier_account(b, t, false, false);
+}
+
+/*
+ * Barrier of the receiver. Returns false if it timed out.
+ */
+static bool fr_barrier_rx(struct fr_barrier* b, struct fr_barrier_times* t)
+{
+  unsigned int junk = 0;
+  t->reached = MEM_RDTSCP(&junk);
+  fr_barrier_flush(b, b->peer_ready);
+  fr_barrier_flush(b, b->peer_exit);
+  uint64_t interval = b->poll_min, elapsed = 0;
+  bool arrived = false, left = false;
+
+  //Wait for Tx
+  while(!arrived && !(b->timeout && elapsed > b->timeout)){
+    delayloop(interval);
+    arrived = fr_barrier_poll(b, b->peer_ready);
+    elapsed = MEM_RDTSCP(&junk) - t->reached;
+    interval = fr_barrier_backoff(b, interval, elapsed, b->expected_wait);
+  }
+  t->start = MEM_RDTSCP(&junk);
+
+  //Handshake: signal until Tx has left, after the lines that go along with the signal
+  uint64_t temp = 0;
+  for(int l=0; arrived && l<b->num_keep; l++)
+    temp += MEM_LOAD(b->keep[l]);
+  interval = b->poll_min;
+  uint64_t polled = MEM_RDTSCP(&junk);  //last time Tx was seen polling our ready lines
+  while(arrived && !left && !(b->timeout && elapsed > b->timeout)){
+    if(!fr_barrier_probe(b, b->own_ready))
+      polled = MEM_RDTSCP(&junk);
+    delayloop(interval);
+    left = fr_barrier_poll(b, b->peer_exit) || MEM_RDTSCP(&junk) - polled > b->quiet;
+    elapsed = MEM_RDTSCP(&junk) - t->reached;
+    interval = fr_barrier_backoff(b, interval, elapsed, 0);
+  }
+  t->complete = MEM_RDTSCP(&junk);
+  fr_barrier_account(b, t, true, !left);
+  return left;
+}
+
+/*
+ * Adds the counters of a lane's barrier to sum.
+ */
+static void fr_barrier_stats_add(struct fr_barrier_stats* sum, const struct fr_barrier_stats* s)
+{
+  sum->barriers += s->barriers;
+  sum->wait_cycles += s->wait_cycles;
+  sum->handshake_cycles += s->handshake_cycles;
+  sum->confirm_cycles += s->confirm_cycles;
+  sum->polls += s->polls;
+  sum->timeouts += s->timeouts;
+}
+
+/*
+ * Barrier cost, out of total_cycles of transmission (of every lane: lanes x the elapsed cycles).
+ */
+static double fr_barrier_overhead(const struct fr_barrier_stats* s, uint64_t total_cycles)
+{
+  return total_cycles ? 100.0*(s->wait_cycles + s->handshake_cycles + s->confirm_cycles)/total_cycles : 0;
+}
+
+static void fr_barrier_print(const char* side, const struct fr_barrier_stats* s, uint64_t total_cycles)
+{
+  uint64_t n = s->barriers ? s->barriers : 1;
+  printf("%s Barriers: %llu, per barrier: wait %.0f, handshake %.0f, confirm %.0f cycles, %.1f polls."
+         " %.3f%% of the transmission. Timeouts: %llu.\n", side, s->barriers,
+         1.0*s->wait_cycles/n, 1.0*s->handshake_cycles/n, 1.0*s->confirm_cycles/n, 1.0*s->polls/n,
+         fr_barrier_overhead(s, total_cycles), s->timeouts);
+}
+
+#endif
+
+//
+// fr_barrier.hh ends here
@@ -23,6 +23,18 @@
 #include <string.h>
 
 #include "utils.hh"
+#include "params.hh"
+#include "training.hh"
+#include "host.hh"
+#include "shared_region.hh"
+#include "addr_schedule.hh"
+#include "fr_barrier.hh"
+#include "epoch_schedule.hh"
+#include "pilot.hh"
+#include "sync_adapt.hh"
+#include "soft_decode.hh"
+#include "outer_code.hh"
+#include "epoch_code.hh"
 
 // ------ Variable Definitions  ----------
 
@@ -33,10 +45,10 @@
 #define CHANNEL_SYNC_TIMEMASK_DEF           0x000FFFFF
 #define CHANNEL_SYNC_JITTER_DEF             0x0100
 
-#define DEFAULT_FILE_NAME ((char*) SHARED_READONLY_FILE_PATH)
 #define DEFAULT_FILE_OFFSET	0x0
-#define DEFAULT_FILE_SIZE	((uint64_t)(SHARED_ARRAY_SZ + 1024*1024))
 #define CACHE_BLOCK_SIZE	64
+#define DEFAULT_DECODER_CPUID 2
+#define DECODER_CPUID_AUTO (-2)   /* DEFAULT_DECODER_CPUID, or the first core after the lanes */
 
 
 struct config {
@@ -45,12 +57,26 @@ struct config {
   int comm_interval;
   int CHANNEL_SYNC_JITTER;
   int CHANNEL_SYNC_TIMEMASK;
+  uint64_t raw_samples; //Number of raw latencies kept by the receiver
+  int decoder_cpuid;    //Core for the receiver's decoder thread (-1: not pinned)
+  int num_lanes;        //Sender/receiver thread pairs
+  int result_fd;        //File descriptor for the receiver's result line (-1: none)
+  char* hist_filename;  //File for the receiver's per-epoch latency histograms (NULL: none)
+  uint64_t threshold;   //Hit/miss threshold (cycles, timed with rdtscp): probed at startup, or -T
+  struct shared_region region; //Region shared with the other program (see shared_region.hh)
+  struct channel_params params; //Channel parameters (the same for sender and receiver)
 };
 
 // ------ Function Definitions  ----------
 
 CYCLES measure_one_block_access_time(ADDR_PTR addr)
 {
+#ifdef SIM_BACKEND
+    unsigned int aux;
+    CYCLES start = MEM_RDTSCP(&aux);
+    sim_load((const volatile void*) addr);
+    return MEM_RDTSCP(&aux) - start;
+#else
     CYCLES cycles;
 
     asm volatile("mov %1, %%r8\n\t"
@@ -66,6 +92,7 @@ CYCLES measure_one_block_access_time(ADDR_PTR addr)
     : "r8", "edi");
 
     return cycles;
+#endif
 }
 
 /* 
@@ -73,11 +100,7 @@ CYCLES measure_one_block_access_time(ADDR_PTR addr)
  */
 inline __attribute__((always_inline))
 CYCLES rdtscp(void) {
-	CYCLES cycles;
-	asm volatile ("rdtscp"
-	: /* outputs */ "=a" (cycles));
-
-	return cycles;
+	return timer_cycles();
 }
 
 /* 
@@ -105,7 +128,11 @@ CYCLES cc_sync(int CHANNEL_SYNC_TIMEMASK, int CHANNEL_SYNC_JITTER) {
 inline __attribute__((always_inline))
 void clflush(ADDR_PTR addr)
 {
+#ifdef SIM_BACKEND
+    sim_clflush((const volatile void*) addr);
+#else
     asm volatile ("clflush (%0)"::"r"(addr));
+#endif
 }
 
 
@@ -114,8 +141,36 @@ void clflush(ADDR_PTR addr)
  */
 void print_help() {
   printf("-f,\tFile to be shared between sender/receiver\n"
+         "-M,\tBacking of the shared region: file, thp, hugetlbfs or memfd (see shared_region.hh)\n"
          "-o,\tSelected offset into shared file\n"
-         "-i,\tTime interval for sending a single bit\n");
+         "-i,\tTime interval for sending a single bit\n"
+         "-n,\tNumber of bits to transmit\n"
+         "-r,\tNumber of raw latency samples kept by the receiver\n"
+         "-d,\tCore for the receiver's decoder thread (-1: not pinned)\n"
+         "-l,\tNumber of lanes (sender/receiver thread pairs), the same for sender and receiver\n"
+         "-R,\tFile descriptor to which the receiver writes its result line (see results.hh)\n"
+         "-H,\tFile to which the receiver writes per-epoch latency histograms (csv, see lat_hist.hh)\n"
+         "-T,\tHit/miss threshold (cycles), instead of the one probed at startup\n"
+         "Channel parameters (the same for sender and receiver):\n"
+         "-a,\tShared-array size, in multiples of the LLC size\n"
+         "-p,\tSynchronization period (bits)\n"
+         "-D,\tAdaptive synchronization period: longest period (bits, 0: off), optionally with ,<target training errors %%>"
+         " (see sync_adapt.hh)\n"
+         "-g,\tAccess lag: bits after which an access is repeated, or taps <lag>[/<every>],... (see params.hh)\n"
+         "-t,\tRx synchronization timeout (cycles)\n"
+         "-E,\tSynchronization mode: barrier, or deadline optionally with ,<cycles per bit>,<guard cycles> (see epoch_schedule.hh)\n"
+         "-S,\tSynchronization barrier: voting lines, optionally with ,<min>,<max> poll interval (cycles, see fr_barrier.hh)\n"
+         "-P,\tPilot period (bits, a power of two, 0: off): re-alignment of Rx after slips (see pilot.hh)\n"
+         "-b,\tHeartbeat period (bits)\n"
+         "-k,\tTraining bits at the start of every sync epoch, for the hit/miss threshold (0: fixed threshold)\n"
+         "-e,\tEnable ECC\n"
+         "-I,\tInterleaver depth: ECC blocks interleaved bit by bit (a power of two, 1: off, see interleave.hh)\n"
+         "-O,\tOuter Reed-Solomon code over the ECC blocks: parity blocks per frame (0: off), optionally with ,<frame blocks> (see outer_code.hh)\n"
+         "-G,\tErasure code across sync epochs: repair epochs per group (0: off), optionally with ,<group epochs> (see epoch_code.hh)\n"
+         "-C,\tSoft-decision decoding of the ECC blocks: least reliable bits flipped per block (0: off, see soft_decode.hh)\n"
+         "-m,\tPayload type: random, 0 or 1\n"
+         "-w,\tWhitening keystream: mt (Mersenne Twister, default) or lfsr (xorshift64, see payload.hh)\n"
+         "-A,\tAccess pattern: streamline, stride, permuted or balanced, optionally with ,<stride lines>,<pages> (see addr_schedule.hh)\n");
 }
 
 /*
@@ -124,23 +179,48 @@ void print_help() {
  */
 void init_config(struct config *config, uint64_t& NUM_BITS,  int argc, char **argv)
 {
+#ifdef SIM_BACKEND
+	// Sender and receiver parse their options in turn (threads of one process)
+	pthread_mutex_lock(&sim.config_lock);
+	optind = 0;
+#endif
+	// Timer (TSC frequency and overheads)
+	timer_init(SYS_FREQ_MHZ);
+	timer_print();
+
 	// Initialize default config parameters
 	int offset = DEFAULT_FILE_OFFSET;
 	config->sync_interval = CHANNEL_DEFAULT_INTERVAL;
     config->comm_interval = CHANNEL_DEFAULT_INTERVAL;
     config->CHANNEL_SYNC_TIMEMASK = CHANNEL_SYNC_TIMEMASK_DEF;
     config->CHANNEL_SYNC_JITTER = CHANNEL_SYNC_JITTER_DEF;
+    config->raw_samples = NUM_BITS_DEBUG_MAX;
+    config->decoder_cpuid = DECODER_CPUID_AUTO;
+    config->num_lanes = 1;
+    config->result_fd = -1;
+    config->hist_filename = NULL;
+    config->threshold = 0;
+    channel_params_init(&config->params);
     
-    char *filename = DEFAULT_FILE_NAME;
+    char *filename = NULL;
+    enum region_backend backend = REGION_DEFAULT;
 
     
 	// Parse the command line flags
 	//      -f is used to specify the shared file 
+	//      -M is used to specify the backing of the shared region
 	//      -i is used to specify the sending interval rate
 	//      -o is used to specify the shared file offset
     //      -n is used to specify number of bits to transmit.
+    //      -r is used to specify number of raw latencies kept by the receiver.
+    //      -d is used to specify the core of the receiver's decoder thread.
+    //      -l is used to specify the number of lanes.
+    //      -R is used to specify the file descriptor for the receiver's result line.
+    //      -H is used to specify the file for the receiver's latency histograms.
+    //      -T is used to specify the hit/miss threshold.
+    //      -a,-p,-D,-g,-E,-t,-S,-P,-b,-k,-e,-I,-O,-G,-C,-m,-w,-A are used to specify the channel parameters.
 	int option;
-	while ((option = getopt(argc, argv, "i:s:o:f:n:")) != -1) {
+	while ((option = getopt(argc, argv, "i:s:o:f:M:n:r:d:l:R:H:T:a:p:D:g:E:t:S:P:b:k:eI:O:G:C:m:w:A:h")) != -1) {
       switch (option) {
       case 'i':
         config->sync_interval = atoi(optarg);
@@ -154,9 +234,135 @@ void init_config(struct config *config, uint64_t& NUM_BITS,  int argc, char **ar
       case 'f':
         filename = optarg;
         break;
+      case 'M':
+        backend = region_backend_parse(optarg);
+        if(backend == REGION_DEFAULT){
+          fprintf(stderr, "Unknown shared region %s\n", optarg);
+          print_help();
+          exit(1);
+        }
+        break;
       case 'n':
-        NUM_BITS = strtol(optarg,NULL,10);
+        NUM_BITS = strtoull(optarg,NULL,10);
         break;        
+      case 'r':
+        config->raw_samples = strtoull(optarg,NULL,10);
+        break;
+      case 'd':
+        config->decoder_cpuid = atoi(optarg);
+        break;
+      case 'l':
+        config->num_lanes = atoi(optarg);
+        break;
+      case 'R':
+        config->result_fd = atoi(optarg);
+        break;
+      case 'H':
+        config->hist_filename = optarg;
+        break;
+      case 'T':
+        config->threshold = strtoull(optarg,NULL,10);
+        break;
+      case 'a':
+        config->params.arraysz_per_cachesz = strtoull(optarg,NULL,10);
+        break;
+      case 'p':
+        config->params.sync_bitfreq = strtoull(optarg,NULL,10);
+        break;
+      case 'D':
+        if(!parse_sync_adapt(optarg, &config->params)){
+          fprintf(stderr, "Invalid adaptive sync period %s: <max period>[,<target error %%>]\n", optarg);
+          print_help();
+          exit(1);
+        }
+        break;
+      case 'g':
+        if(!parse_lag_taps(optarg, &config->params)){
+          fprintf(stderr, "Invalid access lag %s: up to %d taps <lag>[/<every>], every a power of two\n", optarg, MAX_LAG_TAPS);
+          print_help();
+          exit(1);
+        }
+        break;
+      case 'E':
+        if(!parse_sync_mode(optarg, &config->params)){
+          fprintf(stderr, "Unknown synchronization mode %s\n", optarg);
+          print_help();
+          exit(1);
+        }
+        break;
+      case 't':
+        config->params.rx_sync_timeout = strtoull(optarg,NULL,10);
+        break;
+      case 'S':
+        if(!parse_sync_lines(optarg, &config->params)){
+          fprintf(stderr, "Invalid barrier %s: <voting lines>[,<poll min>,<poll max>]\n", optarg);
+          print_help();
+          exit(1);
+        }
+        break;
+      case 'P':
+        config->params.pilot_period = strtoull(optarg,NULL,10);
+        break;
+      case 'b':
+        config->params.heartbeat_freq = strtoull(optarg,NULL,10);
+        break;
+      case 'k':
+        config->params.train_bits = strtoull(optarg,NULL,10);
+        break;
+      case 'e':
+        config->params.ecc = true;
+        break;
+      case 'I':
+        config->params.interleave_depth = strtoull(optarg,NULL,10);
+        break;
+      case 'O':
+        if(!parse_outer_code(optarg, &config->params)){
+          fprintf(stderr, "Invalid outer code %s: <parity blocks>[,<frame blocks>]\n", optarg);
+          print_help();
+          exit(1);
+        }
+        break;
+      case 'G':
+        if(!parse_epoch_code(optarg, &config->params)){
+          fprintf(stderr, "Invalid erasure code across epochs %s: <repair epochs>[,<group epochs>]\n", optarg);
+          print_help();
+          exit(1);
+        }
+        break;
+      case 'C':
+        config->params.chase_flips = atoi(optarg);
+        break;
+      case 'm':
+        if(strcmp(optarg, "random") == 0)
+          config->params.payload_type = PAYLOAD_RANDOM;
+        else if(strcmp(optarg, "0") == 0)
+          config->params.payload_type = PAYLOAD_CONSTANT_0;
+        else if(strcmp(optarg, "1") == 0)
+          config->params.payload_type = PAYLOAD_CONSTANT_1;
+        else {
+          fprintf(stderr, "Unknown payload type %s\n", optarg);
+          print_help();
+          exit(1);
+        }
+        break;
+      case 'w':
+        if(strcmp(optarg, "mt") == 0)
+          config->params.scrambler = SCRAMBLER_MT;
+        else if(strcmp(optarg, "lfsr") == 0)
+          config->params.scrambler = SCRAMBLER_LFSR;
+        else {
+          fprintf(stderr, "Unknown whitening keystream %s\n", optarg);
+          print_help();
+          exit(1);
+        }
+        break;
+      case 'A':
+        if(!parse_pattern(optarg, &config->params)){
+          fprintf(stderr, "Unknown access pattern %s\n", optarg);
+          print_help();
+          exit(1);
+        }
+        break;
       case 'h':
         print_help();
         exit(1);
@@ -170,23 +376,91 @@ void init_config(struct config *config, uint64_t& NUM_BITS,  int argc, char **ar
       }
 	}
 
-	// Map file to virtual memory and extract the address at the file offset
-	if (filename != NULL) {
-		int inFile = open(filename, O_RDONLY);
-		if(inFile == -1) {
-			printf("Failed to Open File\n");
-			exit(1);
-		}
-
-		void *mapaddr = mmap(NULL,DEFAULT_FILE_SIZE,PROT_READ,MAP_SHARED,inFile,0);
+	// Check the channel parameters
+	struct channel_params* p = &config->params;
+	if(p->arraysz_per_cachesz == 0 || p->heartbeat_freq == 0 ||
+	   p->sync_bitfreq <= TX_SYNC_LAG_DELTA || p->lag_delta == 0){
+      printf("Invalid channel parameters: array size and heartbeat have to be positive,"
+             " access lag too, and the sync period longer than %d bits\n", TX_SYNC_LAG_DELTA);
+      exit(1);
+	}
+	if(p->sync_lines < 1 || p->sync_lines > FR_BARRIER_MAX_LINES ||
+	   p->sync_poll_min == 0 || p->sync_poll_max < p->sync_poll_min){
+      printf("Invalid barrier: 1 to %d voting lines, and a poll interval min <= max (cycles)\n", FR_BARRIER_MAX_LINES);
+      exit(1);
+	}
+	if(p->sync_mode == SYNC_DEADLINE && p->sync_bitfreq*p->epoch_bit_cycles <= p->epoch_guard){
+      printf("Invalid deadline epochs: the epoch period (sync period x cycles per bit) has to be longer than the guard\n");
+      exit(1);
+	}
+	if(p->pilot_period && ((p->pilot_period & (p->pilot_period - 1)) ||
+	   p->pilot_period < PILOT_MIN_PERIOD || p->pilot_period > PILOT_MAX_PERIOD)){
+      printf("Invalid pilot period: 0, or a power of two from %d to %d bits\n", PILOT_MIN_PERIOD, PILOT_MAX_PERIOD);
+      exit(1);
+	}
+	if(p->sync_adapt_max){
+      uint64_t levels = 0;
+      while(levels < SYNC_ADAPT_LEVELS && (p->sync_bitfreq << levels) < p->sync_adapt_max)
+        levels++;
+      if((p->sync_bitfreq << levels) != p->sync_adapt_max || levels == 0 || levels >= SYNC_ADAPT_LEVELS ||
+         p->sync_mode != SYNC_BARRIER || p->train_bits == 0){
+        printf("Invalid adaptive sync period: the sync period times a power of two, up to %d, with the barrier"
+               " and training bits\n", 1 << (SYNC_ADAPT_LEVELS - 1));
+        exit(1);
+      }
+	}
+	if(p->chase_flips < 0 || p->chase_flips > CHASE_MAX_FLIPS || (p->chase_flips && !p->ecc)){
+      printf("Invalid soft-decision decoding: 0 to %d flips per block, with ECC\n", CHASE_MAX_FLIPS);
+      exit(1);
+	}
+	if(p->interleave_depth == 0 || (p->interleave_depth & (p->interleave_depth - 1)) ||
+	   p->interleave_depth > INTERLEAVE_MAX_DEPTH || (p->interleave_depth > 1 && !p->ecc)){
+      printf("Invalid interleaver: a power of two up to %d blocks, with ECC\n", INTERLEAVE_MAX_DEPTH);
+      exit(1);
+	}
+	if(p->outer_parity && ((p->outer_frame & (p->outer_frame - 1)) || p->outer_frame < OUTER_MIN_FRAME ||
+	   p->outer_frame > OUTER_MAX_FRAME || 2*p->outer_parity > p->outer_frame || !p->ecc)){
+      printf("Invalid outer code: a frame of a power of two from %d to %d blocks, up to half of them parity, with ECC\n",
+             OUTER_MIN_FRAME, OUTER_MAX_FRAME);
+      exit(1);
+	}
+	if(p->epoch_repair && (p->epoch_repair > EPOCH_CODE_MAX_REPAIR || p->epoch_repair >= p->epoch_group ||
+	   p->epoch_group > EPOCH_CODE_MAX_GROUP || p->epoch_group*p->sync_bitfreq < PAYLOAD_CHUNK_BITS ||
+	   config->num_lanes != 1)){
+      printf("Invalid erasure code across epochs: 1 to %d repair epochs in a group of up to %d epochs, of %llu bits"
+             " at least, with a single lane\n", EPOCH_CODE_MAX_REPAIR, EPOCH_CODE_MAX_GROUP, PAYLOAD_CHUNK_BITS);
+      exit(1);
+	}
+	if(!addr_pattern_resolve(p)){
+      printf("Invalid access pattern: a stride below %d lines and at most %d pages (streamline: stride 3, 2 pages;"
+             " balanced: an odd stride, stride x pages below %d)\n", CL_IN_PAGE, CL_IN_PAGE, CL_IN_PAGE);
+      exit(1);
+	}
+	if(p->train_bits % TRAIN_BITS_UNIT != 0 || p->train_bits > TRAIN_MAX_BITS){
+      printf("Invalid number of training bits: a multiple of %d, at most %d\n", TRAIN_BITS_UNIT, TRAIN_MAX_BITS);
+      exit(1);
+	}
 
-		if (mapaddr == (void*) -1 ) {
-			printf("Failed to Map Address\n");
-			exit(1);
-		}
+	// Host: LLC size (for the shared array) and threshold
+	host_init(config->threshold);
+	host_print();
+	config->threshold = host.threshold;
+	p->array_numentries = ARRAYSZ_2_NUMENTRIES_LLC(p->arraysz_per_cachesz, host.llc_size);
 
-		config->addr = (ADDR_PTR) mapaddr + offset;
-	}
+	// Map the shared region and extract the address at the offset
+#ifdef SIM_BACKEND
+	// Simulated programs share the region of the process by default
+	if(backend == REGION_DEFAULT)
+	  backend = REGION_MEMFD;
+#else
+	if(backend == REGION_DEFAULT)
+	  backend = REGION_FILE;
+#endif
+	region_map(&config->region, backend, filename, FILE_SIZE(p->array_numentries));
+#ifdef SIM_BACKEND
+	pthread_mutex_unlock(&sim.config_lock);
+#endif
+	region_print(&config->region);
+	config->addr = (ADDR_PTR) config->region.addr + offset;
 }
-
 #endif
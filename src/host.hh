@@ -0,0 +1,432 @@
+// Copyright (C) 2020, Gururaj Saileshwar
+
+// Commentary:
+// Host discovery, so that a new machine needs no edits or recompiles:
+// - LLC geometry: size, associativity, line size and sharing, from the
+//   deterministic cache parameters of CPUID (leaf 4 on Intel, 0x8000001D on
+//   AMD), or else from /sys/devices/system/cpu/cpu0/cache. The shared-array size
+//   (-a, in multiples of the LLC) follows from it. CACHE_SZ is only the
+//   fallback, and the LLC size of the specialized loops (see params.hh).
+// - Whether two cores (e.g. of the sender and the receiver) share the LLC.
+// - The shared file: created, or grown, to the size needed by the shared array.
+// - The hit/miss threshold: a quick probe times loads of flushed lines (misses)
+//   and of lines in the LLC (hits: installed, then evicted from L1 and L2 by a
+//   walk of twice the L2), and takes the 1st percentile of the misses (as the
+//   profiling in system_config/ recommends its minimum). If the tails overlap
+//   but the medians are apart (misses at least 1.5x the hits), the threshold is
+//   their midpoint; otherwise LLC_MISS_THRESHOLD_CYCLES is used.
+//
+// With the simulator backend, the LLC is the simulated one, and the threshold
+// is LLC_MISS_THRESHOLD_CYCLES.
+
+#ifndef HOST_H_
+#define HOST_H_
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <cpuid.h>
+#include <algorithm>
+
+#include "utils.hh"
+
+#define HOST_SYSFS_CPU "/sys/devices/system/cpu"
+// Lines (one per page) timed by the threshold probe
+#define HOST_PROBE_LINES (1024)
+// L2 size when sysfs does not report it (the probe walks twice the L2)
+#define HOST_PROBE_DEFAULT_L2 (1024*1024)
+// Medians apart: the miss median is at least this many halves of the hit median
+#define HOST_PROBE_MEDIAN_GAP (3)
+// Shared-file creation: block size and seed of the pseudo-random contents
+#define HOST_FILE_BLOCK_SZ (1024*1024)
+#define HOST_FILE_SEED (0x5eed5eed5eed5eedULL)
+
+struct host_info {
+  bool initialized;
+  //LLC
+  uint64_t llc_size, llc_ways, llc_sets, llc_line;
+  int llc_level;
+  int llc_sharing;              //logical CPUs sharing the LLC (0: unknown)
+  const char* llc_source;
+  //Hit/miss threshold (cycles, timed with rdtscp)
+  uint64_t threshold;
+  const char* threshold_source;
+  uint64_t probe_hit, probe_miss; //medians of the probe
+};
+static struct host_info host;
+// Sink of the probe's loads
+static volatile uint64_t host_probe_sink;
+
+//------------------------------------------------------------------------
+// LLC geometry
+//------------------------------------------------------------------------
+
+#ifndef SIM_BACKEND
+/*
+ * Last-level cache from the deterministic cache parameters of CPUID (leaf
+ * leaf, subleafs 0..). Returns false if the processor does not report them.
+ */
+static bool host_llc_from_cpuid(unsigned int leaf)
+{
+  bool found = false;
+  for(unsigned int i=0; i<32; i++){
+    unsigned int eax, ebx, ecx, edx;
+    __cpuid_count(leaf, i, eax, ebx, ecx, edx);
+    unsigned int type = eax & 0x1f;   //0: none, 1: data, 2: instruction, 3: unified
+    if(type == 0)
+      break;
+    int level = (eax >> 5) & 0x7;
+    if(type == 2 || level < host.llc_level)
+      continue;
+    host.llc_level = level;
+    host.llc_ways = ((ebx >> 22) & 0x3ff) + 1;
+    host.llc_line = (ebx & 0xfff) + 1;
+    host.llc_sets = (uint64_t)ecx + 1;
+    host.llc_size = host.llc_ways*(((ebx >> 12) & 0x3ff) + 1)*host.llc_line*host.llc_sets;
+    found = true;
+  }
+  return found;
+}
+#endif
+
+/*
+ * Reads a line of a sysfs file of the cache index idx of cpu. Returns false if it does not exist.
+ */
+static bool host_sysfs_cache(int cpu, int idx, const char* name, char* buf, size_t len)
+{
+  char path[256];
+  snprintf(path, sizeof(path), HOST_SYSFS_CPU "/cpu%d/cache/index%d/%s", cpu, idx, name);
+  FILE* f = fopen(path, "r");
+  if(f == NULL)
+    return false;
+  bool ok = fgets(buf, len, f) != NULL;
+  fclose(f);
+  if(ok)
+    buf[strcspn(buf, "\n")] = '\0';
+  return ok;
+}
+
+/*
+ * Size (bytes) of cache idx of cpu in sysfs, or 0.
+ */
+static uint64_t host_sysfs_cache_size(int cpu, int idx)
+{
+  char buf[64];
+  if(!host_sysfs_cache(cpu, idx, "size", buf, sizeof(buf)))
+    return 0;
+  char* unit;
+  uint64_t size = strtoull(buf, &unit, 10);
+  if(*unit == 'K')
+    size *= 1024;
+  else if(*unit == 'M')
+    size *= 1024*1024;
+  return size;
+}
+
+/*
+ * Index of the last-level (data or unified) cache of cpu in sysfs, or -1.
+ */
+static int host_sysfs_llc_index(int cpu)
+{
+  int llc = -1, llc_level = 0;
+  char buf[64];
+  for(int idx=0; host_sysfs_cache(cpu, idx, "level", buf, sizeof(buf)); idx++){
+    int level = atoi(buf);
+    if(!host_sysfs_cache(cpu, idx, "type", buf, sizeof(buf)) || strcmp(buf, "Instruction") == 0)
+      continue;
+    if(level >= llc_level){
+      llc = idx;
+      llc_level = level;
+    }
+  }
+  return llc;
+}
+
+/*
+ * Size (bytes) of the L2 (data or unified) of cpu in sysfs, or 0.
+ */
+static uint64_t host_sysfs_l2_size(int cpu)
+{
+  char buf[64];
+  for(int idx=0; host_sysfs_cache(cpu, idx, "level", buf, sizeof(buf)); idx++){
+    if(atoi(buf) != 2)
+      continue;
+    if(host_sysfs_cache(cpu, idx, "type", buf, sizeof(buf)) && strcmp(buf, "Instruction") != 0)
+      return host_sysfs_cache_size(cpu, idx);
+  }
+  return 0;
+}
+
+/*
+ * Parses a cpu list ("0-3,8-11") into mask (cpus below CPU_SETSIZE). Returns the number of cpus.
+ */
+static int host_parse_cpulist(const char* list, cpu_set_t* mask)
+{
+  CPU_ZERO(mask);
+  const char* p = list;
+  while(*p){
+    char* end;
+    long lo = strtol(p, &end, 10), hi = lo;
+    if(end == p)
+      break;
+    if(*end == '-')
+      hi = strtol(end + 1, &end, 10);
+    for(long c=lo; c<=hi && c<CPU_SETSIZE; c++)
+      CPU_SET(c, mask);
+    p = (*end == ',') ? end + 1 : end;
+  }
+  return CPU_COUNT(mask);
+}
+
+static bool host_llc_from_sysfs()
+{
+  int idx = host_sysfs_llc_index(0);
+  char buf[64];
+  if(idx < 0)
+    return false;
+  host.llc_size = host_sysfs_cache_size(0, idx);
+  host.llc_ways = host_sysfs_cache(0, idx, "ways_of_associativity", buf, sizeof(buf)) ? atoi(buf) : 0;
+  host.llc_line = host_sysfs_cache(0, idx, "coherency_line_size", buf, sizeof(buf)) ? atoi(buf) : CACHELINE_SZ;
+  host.llc_sets = host_sysfs_cache(0, idx, "number_of_sets", buf, sizeof(buf)) ? atoi(buf) : 0;
+  host.llc_level = host_sysfs_cache(0, idx, "level", buf, sizeof(buf)) ? atoi(buf) : 0;
+  return host.llc_size > 0;
+}
+
+/*
+ * Whether cpus a and b share the LLC: 1 yes, 0 no, -1 unknown.
+ */
+static int host_cores_share_llc(int a, int b)
+{
+#ifdef SIM_BACKEND
+  return 1;
+#else
+  int idx = host_sysfs_llc_index(a);
+  char buf[4096];
+  cpu_set_t mask;
+  if(idx < 0 || !host_sysfs_cache(a, idx, "shared_cpu_list", buf, sizeof(buf)) || host_parse_cpulist(buf, &mask) == 0)
+    return -1;
+  return CPU_ISSET(b, &mask) ? 1 : 0;
+#endif
+}
+
+/*
+ * Warns if the cores of a sender/receiver pair do not share the LLC.
+ */
+static void host_check_llc_sharing(int tx_cpu, int rx_cpu)
+{
+  int shared = host_cores_share_llc(tx_cpu, rx_cpu);
+  if(shared == 0)
+    printf("Warning: CPUs %d and %d do not share the LLC, the channel needs a shared LLC.\n", tx_cpu, rx_cpu);
+  else if(shared < 0)
+    printf("Warning: could not check whether CPUs %d and %d share the LLC.\n", tx_cpu, rx_cpu);
+}
+
+static void host_discover_llc()
+{
+  host.llc_level = 0;
+  host.llc_sharing = 0;
+#ifdef SIM_BACKEND
+  host.llc_size = sim.cfg.size[SIM_LLC];
+  host.llc_ways = sim.cfg.ways[SIM_LLC];
+  host.llc_line = SIM_LINE_SZ;
+  host.llc_sets = host.llc_size/host.llc_ways/SIM_LINE_SZ;
+  host.llc_level = 3;
+  host.llc_sharing = SIM_MAX_CORES;
+  host.llc_source = "simulated";
+#else
+  unsigned int eax, ebx, ecx, edx;
+  __cpuid(0, eax, ebx, ecx, edx);
+  bool intel = (ebx == 0x756e6547);   //"Genu"
+  bool amd = (ebx == 0x68747541);     //"Auth"
+  if(intel && eax >= 4 && host_llc_from_cpuid(4))
+    host.llc_source = "cpuid leaf 4";
+  else if(amd && __get_cpuid_max(0x80000000, NULL) >= 0x8000001D && host_llc_from_cpuid(0x8000001D))
+    host.llc_source = "cpuid leaf 0x8000001D";
+  else if(host_llc_from_sysfs())
+    host.llc_source = "sysfs";
+  else {
+    host.llc_size = CACHE_SZ;
+    host.llc_ways = host.llc_sets = 0;
+    host.llc_line = CACHELINE_SZ;
+    host.llc_source = "default CACHE_SZ";
+  }
+
+  //Sharing (the actual cpus, rather than the maximum of CPUID)
+  int idx = host_sysfs_llc_index(0);
+  char buf[4096];
+  cpu_set_t mask;
+  if(idx >= 0 && host_sysfs_cache(0, idx, "shared_cpu_list", buf, sizeof(buf)))
+    host.llc_sharing = host_parse_cpulist(buf, &mask);
+#endif
+}
+
+//------------------------------------------------------------------------
+// Hit/miss threshold
+//------------------------------------------------------------------------
+
+/*
+ * Times loads of HOST_PROBE_LINES flushed lines and of the same lines in the
+ * LLC (evicted from L1 and L2), and seeds the threshold from them.
+ */
+static void host_probe_threshold()
+{
+  host.threshold = LLC_MISS_THRESHOLD_CYCLES;
+  host.threshold_source = "default LLC_MISS_THRESHOLD_CYCLES";
+  host.probe_hit = host.probe_miss = 0;
+#ifndef SIM_BACKEND
+  uint8_t* buf = (uint8_t*) aligned_alloc(PAGE_SZ, HOST_PROBE_LINES*PAGE_SZ);
+  if(buf == NULL)
+    return;
+  for(uint64_t i=0; i<HOST_PROBE_LINES; i++)
+    buf[i*PAGE_SZ] = i;
+  //Walk evicting the lines from L1 and L2 (at most a quarter of the LLC, which keeps them)
+  uint64_t l2_size = host_sysfs_l2_size(0);
+  uint64_t evict_size = 2*(l2_size ? l2_size : HOST_PROBE_DEFAULT_L2);
+  if(evict_size > host.llc_size/4)
+    evict_size = host.llc_size/4;
+  uint8_t* evict = (uint8_t*) aligned_alloc(PAGE_SZ, evict_size);
+  if(evict == NULL){
+    free(buf);
+    return;
+  }
+  memset(evict, 1, evict_size);
+
+  std::vector<uint64_t> hit(HOST_PROBE_LINES), miss(HOST_PROBE_LINES);
+  unsigned int junk = 0;
+  uint64_t temp = 0;
+  for(int round=0; round<3; round++){
+    //Misses: flushed lines (one per page, so that the prefetchers stay out)
+    if(round == 0){
+      for(uint64_t i=0; i<HOST_PROBE_LINES; i++)
+        MEM_CLFLUSH(&buf[i*PAGE_SZ]);
+      _mm_mfence();
+    }
+    //Hits: the lines installed by round 1, out of L1 and L2
+    if(round == 2){
+      for(uint64_t i=0; i<evict_size; i+=CACHELINE_SZ)
+        temp += MEM_LOAD((volatile uint8_t*) &evict[i]);
+      _mm_mfence();
+    }
+    for(uint64_t i=0; i<HOST_PROBE_LINES; i++){
+      volatile uint8_t* addr = &buf[i*PAGE_SZ];
+      uint64_t time0 = MEM_RDTSCP(&junk);
+      temp += MEM_LOAD(addr);
+      uint64_t delta = MEM_RDTSCP(&junk) - time0;
+      //Round 0 times misses, round 1 installs the lines, round 2 times hits.
+      if(round == 0)
+        miss[i] = delta;
+      else if(round == 2)
+        hit[i] = delta;
+    }
+  }
+  host_probe_sink = temp;
+  free(buf);
+  free(evict);
+
+  std::sort(hit.begin(), hit.end());
+  std::sort(miss.begin(), miss.end());
+  host.probe_hit = hit[HOST_PROBE_LINES/2];
+  host.probe_miss = miss[HOST_PROBE_LINES/2];
+  uint64_t miss_p1 = miss[HOST_PROBE_LINES/100];
+  if(miss_p1 > hit[HOST_PROBE_LINES*99/100]){
+    host.threshold = miss_p1;
+    host.threshold_source = "probe";
+  } else if(2*host.probe_miss >= HOST_PROBE_MEDIAN_GAP*host.probe_hit){
+    //Tails overlap (noise): between the medians rather than the compile-time default
+    host.threshold = (host.probe_hit + host.probe_miss)/2;
+    host.threshold_source = "probe (medians)";
+  }
+#endif
+}
+
+//------------------------------------------------------------------------
+// Shared file
+//------------------------------------------------------------------------
+
+/*
+ * Fills words of buf with the pseudo-random sequence (xorshift) continuing from *state.
+ */
+static void host_random_fill(uint64_t* buf, uint64_t words, uint64_t* state)
+{
+  uint64_t x = *state;
+  for(uint64_t i=0; i<words; i++){
+    x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+    buf[i] = x;
+  }
+  *state = x;
+}
+
+/*
+ * Opens the shared file at path (read-only), creating or growing it to at
+ * least size bytes of pseudo-random contents. Sender and receiver may both
+ * find it missing, so it is filled under an exclusive lock. Returns -1 on failure.
+ */
+static int host_shared_file_open(const char* path, uint64_t size)
+{
+  struct stat st;
+  int fd = open(path, O_RDONLY);
+  if(fd != -1 && fstat(fd, &st) == 0 && (uint64_t)st.st_size >= size)
+    return fd;
+  if(fd != -1)
+    close(fd);
+
+  fd = open(path, O_RDWR | O_CREAT, 0644);
+  if(fd == -1 || flock(fd, LOCK_EX) != 0 || fstat(fd, &st) != 0){
+    perror(path);
+    return -1;
+  }
+  if((uint64_t)st.st_size < size){
+    printf("Shared file %s: writing %.1f MB\n", path, (size - st.st_size)/1024.0/1024.0);
+    uint64_t* block = (uint64_t*) malloc(HOST_FILE_BLOCK_SZ);
+    uint64_t x = HOST_FILE_SEED ^ st.st_size;
+    for(uint64_t off=st.st_size; off<size; off+=HOST_FILE_BLOCK_SZ){
+      host_random_fill(block, HOST_FILE_BLOCK_SZ/sizeof(uint64_t), &x);
+      uint64_t len = (size - off < HOST_FILE_BLOCK_SZ) ? size - off : HOST_FILE_BLOCK_SZ;
+      if(pwrite(fd, block, len, off) != (ssize_t)len){
+        perror(path);
+        free(block);
+        close(fd);
+        return -1;
+      }
+    }
+    free(block);
+  }
+  flock(fd, LOCK_UN);
+  close(fd);
+  //Read-only from here on (the page cache of a file open for writing gets no huge pages)
+  return open(path, O_RDONLY);
+}
+
+/*
+ * Discovers the host (once); the threshold is probed unless one is given (non-zero).
+ */
+static void host_init(uint64_t threshold)
+{
+  if(host.initialized)
+    return;
+  host.initialized = true;
+  host_discover_llc();
+  if(threshold == 0)
+    host_probe_threshold();
+  else {
+    host.threshold = threshold;
+    host.threshold_source = "given";
+    host.probe_hit = host.probe_miss = 0;
+  }
+}
+
+static void host_print()
+{
+  printf("Host: LLC %.1f MB (L%d, %llu-way, %llu sets, %llu B lines, shared by %d CPUs) from %s."
+         " Threshold: %llu cycles (%s",
+         host.llc_size/1024.0/1024.0, host.llc_level, host.llc_ways, host.llc_sets, host.llc_line,
+         host.llc_sharing, host.llc_source, host.threshold, host.threshold_source);
+  if(host.probe_miss)
+    printf("; probe medians: hit %llu, miss %llu", host.probe_hit, host.probe_miss);
+  printf(").\n");
+}
+
+#endif
+
+//
+// host.hh ends here
@@ -0,0 +1,106 @@
+// Copyright (C) 2020, Gururaj Saileshwar
+
+// Commentary:
+// Block interleaver across the (72,64) ECC blocks (-I <depth>).
+//
+// The blocks are sent in groups of <depth>: the channel carries bit 0 of every
+// block of the group, then bit 1 of every block, and so on. A burst of errors
+// of up to <depth> channel bits then leaves at most one error in every block,
+// which SEC-DED corrects. The groups start with the payload chunks (see
+// payload.hh), whose blocks they divide; the blocks past the last full group
+// of the payload are sent in order. The channel encoding (whitening) applies
+// to the channel bits, after the interleaving.
+
+#ifndef INTERLEAVE_H_
+#define INTERLEAVE_H_
+
+#include "utils.hh"
+#include "bitvec.hh"
+
+// Depth: a power of two, up to the blocks of a payload chunk
+#define INTERLEAVE_MAX_DEPTH (512)
+// Bits of a block (ECCBLK_BITLEN): read as a head (the parity byte) and a word
+#define INTERLEAVE_BLK_BITS (72)
+#define INTERLEAVE_HEAD_BITS (INTERLEAVE_BLK_BITS - BITVEC_WORD_BITS)
+
+/*
+ * Interleaves the num_blks blocks at in_pos of in (in their order) into the
+ * channel bits at out_pos of out.
+ */
+static void interleave_blocks(const struct bitvec* in, uint64_t in_pos, struct bitvec* out, uint64_t out_pos,
+                              uint64_t num_blks, uint64_t depth)
+{
+  uint64_t grouped = num_blks/depth*depth;
+  for(uint64_t g=0; g<grouped; g+=depth){
+    uint64_t base_in = in_pos + g*INTERLEAVE_BLK_BITS, base_out = out_pos + g*INTERLEAVE_BLK_BITS;
+    for(uint64_t b=0; b<depth; b++){
+      uint64_t head = bitvec_get_bits(in, base_in + b*INTERLEAVE_BLK_BITS, INTERLEAVE_HEAD_BITS);
+      uint64_t tail = bitvec_get_bits(in, base_in + b*INTERLEAVE_BLK_BITS + INTERLEAVE_HEAD_BITS, BITVEC_WORD_BITS);
+      for(int j=0; j<INTERLEAVE_HEAD_BITS; j++)
+        bitvec_set(out, base_out + j*depth + b, (head >> (INTERLEAVE_HEAD_BITS - 1 - j)) & 1);
+      for(int j=0; j<BITVEC_WORD_BITS; j++)
+        bitvec_set(out, base_out + (INTERLEAVE_HEAD_BITS + j)*depth + b, (tail >> (BITVEC_WORD_BITS - 1 - j)) & 1);
+    }
+  }
+  for(uint64_t pos=grouped*INTERLEAVE_BLK_BITS; pos<num_blks*INTERLEAVE_BLK_BITS; pos+=INTERLEAVE_BLK_BITS){
+    bitvec_set_bits(out, out_pos + pos, INTERLEAVE_HEAD_BITS, bitvec_get_bits(in, in_pos + pos, INTERLEAVE_HEAD_BITS));
+    bitvec_set_bits(out, out_pos + pos + INTERLEAVE_HEAD_BITS, BITVEC_WORD_BITS, bitvec_get_bits(in, in_pos + pos + INTERLEAVE_HEAD_BITS, BITVEC_WORD_BITS));
+  }
+}
+
+/*
+ * De-interleaves the channel bits of num_blks blocks at in_pos of in into the
+ * blocks (in their order) at out_pos of out.
+ */
+static void deinterleave_blocks(const struct bitvec* in, uint64_t in_pos, struct bitvec* out, uint64_t out_pos,
+                                uint64_t num_blks, uint64_t depth)
+{
+  uint64_t grouped = num_blks/depth*depth;
+  for(uint64_t g=0; g<grouped; g+=depth){
+    uint64_t base_in = in_pos + g*INTERLEAVE_BLK_BITS, base_out = out_pos + g*INTERLEAVE_BLK_BITS;
+    for(uint64_t b=0; b<depth; b++){
+      uint64_t head = 0, tail = 0;
+      for(int j=0; j<INTERLEAVE_HEAD_BITS; j++)
+        head = (head << 1) | (uint64_t)bitvec_get(in, base_in + j*depth + b);
+      for(int j=0; j<BITVEC_WORD_BITS; j++)
+        tail = (tail << 1) | (uint64_t)bitvec_get(in, base_in + (INTERLEAVE_HEAD_BITS + j)*depth + b);
+      bitvec_set_bits(out, base_out + b*INTERLEAVE_BLK_BITS, INTERLEAVE_HEAD_BITS, head);
+      bitvec_set_bits(out, base_out + b*INTERLEAVE_BLK_BITS + INTERLEAVE_HEAD_BITS, BITVEC_WORD_BITS, tail);
+    }
+  }
+  for(uint64_t pos=grouped*INTERLEAVE_BLK_BITS; pos<num_blks*INTERLEAVE_BLK_BITS; pos+=INTERLEAVE_BLK_BITS){
+    bitvec_set_bits(out, out_pos + pos, INTERLEAVE_HEAD_BITS, bitvec_get_bits(in, in_pos + pos, INTERLEAVE_HEAD_BITS));
+    bitvec_set_bits(out, out_pos + pos + INTERLEAVE_HEAD_BITS, BITVEC_WORD_BITS, bitvec_get_bits(in, in_pos + pos + INTERLEAVE_HEAD_BITS, BITVEC_WORD_BITS));
+  }
+}
+
+/*
+ * De-interleaves per-bit values (the reliabilities of soft_decode.hh) of
+ * num_blks blocks.
+ */
+static void deinterleave_bytes(const uint8_t* in, uint8_t* out, uint64_t num_blks, uint64_t depth)
+{
+  uint64_t grouped = num_blks/depth*depth;
+  for(uint64_t g=0; g<grouped; g+=depth){
+    const uint8_t* group_in = in + g*INTERLEAVE_BLK_BITS;
+    uint8_t* group_out = out + g*INTERLEAVE_BLK_BITS;
+    for(uint64_t b=0; b<depth; b++)
+      for(int j=0; j<INTERLEAVE_BLK_BITS; j++)
+        group_out[b*INTERLEAVE_BLK_BITS + j] = group_in[j*depth + b];
+  }
+  memcpy(out + grouped*INTERLEAVE_BLK_BITS, in + grouped*INTERLEAVE_BLK_BITS, (num_blks - grouped)*INTERLEAVE_BLK_BITS);
+}
+
+/*
+ * Block of channel bit pos (from the start of a chunk).
+ */
+static inline uint64_t interleave_block_of(uint64_t pos, uint64_t depth)
+{
+  uint64_t group_bits = depth*INTERLEAVE_BLK_BITS;
+  return pos/group_bits*depth + pos%group_bits%depth;
+}
+
+#endif
+
+//
+// interleave.hh ends here
@@ -0,0 +1,133 @@
+// Copyright (C) 2020, Gururaj Saileshwar
+
+// Commentary:
+// Multi-lane transmission.
+//
+// The shared array is split into num_lanes equal regions. Each lane is a
+// sender/receiver thread pair, pinned to its own cores, that walks its region
+// with the usual BITID_2_ARRINDEX schedule (on lane-local bit-ids) and runs its
+// own Flush+Reload barrier on its own sync pages. The payload is striped across
+// the lanes one 64-bit word at a time: global word w is carried by lane
+// w % num_lanes, so the receiver's decoder can reassemble it in order.
+//
+// Lane 0 uses the original cores, region start and sync pages, so a single lane
+// behaves exactly like the original channel. Lanes run the usual loop instances
+// (see params.hh): they are specialized on the sync period and take the size of
+// the region at runtime, so any number of lanes keeps the specialized instance.
+
+#ifndef LANES_H_
+#define LANES_H_
+
+#include <atomic>
+
+#include "utils.hh"
+#include "bitvec.hh"
+
+#define MAX_LANES (8)
+// Striping unit
+#define LANE_STRIPE_BITS (BITVEC_WORD_BITS)
+// Cores of lanes 1.. (lane 0 uses tx_cpuid/rx_cpuid)
+#define LANE_RX_CPUID(l) (2*(l))
+#define LANE_TX_CPUID(l) (2*(l)+1)
+// Sync pages of lanes 1.. are placed after the shared array (in the slack of the shared file).
+#define LANE_SYNC_PAGES (6)
+#define OFFSET_LANE_SYNC_PAGES(array_numentries, l) \
+  (OFFSET_SHARED_ARRAY + (array_numentries)*ARRENTRY_SZ + ((l)-1)*LANE_SYNC_PAGES*PAGE_SZ)
+// Training pages of every lane (see training.hh) follow those of the sync pages.
+#define LANE_TRAIN_PAGES (2)
+#define OFFSET_LANE_TRAIN_PAGES(array_numentries, l) \
+  (OFFSET_LANE_SYNC_PAGES(array_numentries, MAX_LANES) + (l)*LANE_TRAIN_PAGES*PAGE_SZ)
+
+struct lane_region {
+  uint64_t* shared_array;
+  uint64_t numentries;                //whole pages
+  uint64_t* sync_rxready_page[3];
+  uint64_t* sync_txready_page[3];
+  uint64_t* train_array;              //training lines
+};
+
+/*
+ * Region and sync pages of a lane, in the shared file mapped at base
+ * (with a shared array of array_numentries).
+ */
+static void lane_region_init(struct lane_region* r, uintptr_t base, uint64_t array_numentries,
+                             int lane, int num_lanes)
+{
+  r->numentries = array_numentries/num_lanes/ENTRY_PER_PAGE*ENTRY_PER_PAGE;
+  r->shared_array = (uint64_t*) (base + OFFSET_SHARED_ARRAY) + lane*r->numentries;
+
+  if(lane == 0){
+    r->sync_rxready_page[0] = (uint64_t*) (base + OFFSET_FR_SYNC_REG_RX1);
+    r->sync_txready_page[0] = (uint64_t*) (base + OFFSET_FR_SYNC_REG_TX1);
+    r->sync_rxready_page[1] = (uint64_t*) (base + OFFSET_FR_SYNC_REG_RX2);
+    r->sync_txready_page[1] = (uint64_t*) (base + OFFSET_FR_SYNC_REG_TX2);
+    r->sync_rxready_page[2] = (uint64_t*) (base + OFFSET_FR_SYNC_REG_RX3);
+    r->sync_txready_page[2] = (uint64_t*) (base + OFFSET_FR_SYNC_REG_TX3);
+  } else {
+    uintptr_t pages = base + OFFSET_LANE_SYNC_PAGES(array_numentries, lane);
+    for(int i=0; i<3; i++){
+      r->sync_rxready_page[i] = (uint64_t*) (pages + (2*i)*PAGE_SZ);
+      r->sync_txready_page[i] = (uint64_t*) (pages + (2*i+1)*PAGE_SZ);
+    }
+  }
+  r->train_array = (uint64_t*) (base + OFFSET_LANE_TRAIN_PAGES(array_numentries, lane));
+}
+
+/*
+ * Flush the sync and training pages of a lane.
+ */
+static void lane_flush_sync_pages(struct lane_region* r)
+{
+  for(int p=0; p<3; p++){
+    for(uint64_t i=0;i<PAGE_SZ/sizeof(uint64_t);i++){
+      MEM_CLFLUSH(&r->sync_rxready_page[p][i]);
+      MEM_CLFLUSH(&r->sync_txready_page[p][i]);
+    }
+  }
+  for(uint64_t i=0;i<LANE_TRAIN_PAGES*PAGE_SZ/sizeof(uint64_t);i++)
+    MEM_CLFLUSH(&r->train_array[i]);
+}
+
+/*
+ * Number of the total_bits (global) bits carried by a lane.
+ */
+static uint64_t lane_num_bits(uint64_t total_bits, int lane, int num_lanes)
+{
+  uint64_t stripe_round = (uint64_t)LANE_STRIPE_BITS*num_lanes;
+  uint64_t bits = total_bits/stripe_round*LANE_STRIPE_BITS;
+  uint64_t rem = total_bits%stripe_round;
+  if(rem > (uint64_t)lane*LANE_STRIPE_BITS){
+    rem -= lane*LANE_STRIPE_BITS;
+    bits += rem < LANE_STRIPE_BITS ? rem : LANE_STRIPE_BITS;
+  }
+  return bits;
+}
+
+/*
+ * Lane that carries global word w, and its position there.
+ */
+static inline int lane_of_word(uint64_t w, int num_lanes)
+{
+  return w % num_lanes;
+}
+
+static inline uint64_t lane_word(uint64_t w, int num_lanes)
+{
+  return w / num_lanes;
+}
+
+/*
+ * Extracts the bits carried by a lane from the (global) payload.
+ */
+static void lane_split_payload(const struct bitvec* payload, int lane, int num_lanes,
+                               struct bitvec* lane_payload)
+{
+  bitvec_alloc(lane_payload, lane_num_bits(payload->num_bits, lane, num_lanes));
+  for(uint64_t w=0; w<lane_payload->num_words; w++)
+    lane_payload->words[w] = payload->words[w*num_lanes + lane];
+}
+
+#endif
+
+//
+// lanes.hh ends here
@@ -0,0 +1,172 @@
+// Copyright (C) 2020, Gururaj Saileshwar
+
+// Commentary:
+// Latency histograms of the received bits, kept separately for the bits sent
+// as 0 (hits) and as 1 (misses).
+//
+// Buckets are logarithmic with LAT_HIST_SUB_BITS bits of sub-bucket precision
+// (HDR-style): latencies below LAT_HIST_SUB have a bucket each, and every
+// power of two above is split into LAT_HIST_SUB equal buckets, i.e. a bucket is
+// at most 1/LAT_HIST_SUB of its latency wide. A histogram covers all 16-bit
+// latencies in a fixed LAT_HIST_BUCKETS counters per class, and adding a
+// sample is a count-leading-zeros, a shift and a few adds.
+//
+// The summary of a histogram describes how well hits and misses separate:
+// - separation: distance of the means in pooled standard deviations (d'),
+// - overlap: shared area of the two normalized histograms (0: disjoint, 1: identical),
+// - best threshold: the bucket boundary with the fewest errors, and its error rate.
+
+#ifndef LAT_HIST_H_
+#define LAT_HIST_H_
+
+#include <math.h>
+
+#include "utils.hh"
+
+#define LAT_HIST_SUB_BITS (4)
+#define LAT_HIST_SUB (1 << LAT_HIST_SUB_BITS)
+#define LAT_HIST_BUCKETS ((16 - LAT_HIST_SUB_BITS + 1)*LAT_HIST_SUB)
+
+struct lat_hist {
+  uint64_t count[2][LAT_HIST_BUCKETS];   //[sent bit][bucket]
+  uint64_t samples[2];
+  uint64_t sum[2], sumsq[2];
+};
+
+struct lat_hist_summary {
+  double mean[2], sd[2];
+  uint64_t p1[2], p50[2], p99[2];   //lower bounds of the percentile buckets
+  double separation;
+  double overlap;
+  uint64_t best_threshold;          //latencies above are misses
+  double best_error;                //fraction of samples misclassified at best_threshold
+};
+
+/*
+ * Bucket of a (16-bit) latency, and the lowest latency of a bucket.
+ */
+static inline unsigned int lat_hist_bucket(uint64_t latency)
+{
+  if(latency < LAT_HIST_SUB)
+    return latency;
+  unsigned int msb = 63 - __builtin_clzll(latency);
+  return (msb - LAT_HIST_SUB_BITS + 1)*LAT_HIST_SUB + ((latency >> (msb - LAT_HIST_SUB_BITS)) & (LAT_HIST_SUB - 1));
+}
+
+static inline uint64_t lat_hist_bucket_lo(unsigned int b)
+{
+  if(b < LAT_HIST_SUB)
+    return b;
+  unsigned int msb = b/LAT_HIST_SUB + LAT_HIST_SUB_BITS - 1;
+  return (uint64_t)(LAT_HIST_SUB + b%LAT_HIST_SUB) << (msb - LAT_HIST_SUB_BITS);
+}
+
+static inline void lat_hist_reset(struct lat_hist* h)
+{
+  memset(h, 0, sizeof(*h));
+}
+
+inline __attribute__((always_inline))
+void lat_hist_add(struct lat_hist* h, int sent, uint64_t latency)
+{
+  h->count[sent][lat_hist_bucket(latency)]++;
+  h->samples[sent]++;
+  h->sum[sent] += latency;
+  h->sumsq[sent] += latency*latency;
+}
+
+static void lat_hist_merge(struct lat_hist* dst, const struct lat_hist* src)
+{
+  for(int c=0; c<2; c++){
+    for(int b=0; b<LAT_HIST_BUCKETS; b++)
+      dst->count[c][b] += src->count[c][b];
+    dst->samples[c] += src->samples[c];
+    dst->sum[c] += src->sum[c];
+    dst->sumsq[c] += src->sumsq[c];
+  }
+}
+
+/*
+ * Lower bound of the bucket holding the q-quantile of class c.
+ */
+static uint64_t lat_hist_percentile(const struct lat_hist* h, int c, double q)
+{
+  uint64_t rank = (uint64_t)(q*h->samples[c]), seen = 0;
+  for(int b=0; b<LAT_HIST_BUCKETS; b++){
+    seen += h->count[c][b];
+    if(seen > rank)
+      return lat_hist_bucket_lo(b);
+  }
+  return lat_hist_bucket_lo(LAT_HIST_BUCKETS - 1);
+}
+
+/*
+ * Summarizes h (metrics of a missing class are NaN).
+ */
+static void lat_hist_summarize(const struct lat_hist* h, struct lat_hist_summary* s)
+{
+  for(int c=0; c<2; c++){
+    uint64_t n = h->samples[c];
+    s->mean[c] = n ? 1.0*h->sum[c]/n : NAN;
+    s->sd[c] = n ? sqrt(fmax(1.0*h->sumsq[c]/n - s->mean[c]*s->mean[c], 0)) : NAN;
+    s->p1[c] = lat_hist_percentile(h, c, 0.01);
+    s->p50[c] = lat_hist_percentile(h, c, 0.50);
+    s->p99[c] = lat_hist_percentile(h, c, 0.99);
+  }
+
+  uint64_t n0 = h->samples[0], n1 = h->samples[1];
+  if(n0 == 0 || n1 == 0){
+    s->separation = s->overlap = s->best_error = NAN;
+    s->best_threshold = 0;
+    return;
+  }
+
+  double pooled_sd = sqrt((s->sd[0]*s->sd[0] + s->sd[1]*s->sd[1])/2);
+  s->separation = (s->mean[1] - s->mean[0])/pooled_sd;  //inf if both are constant
+
+  //Threshold below bucket b: hits of buckets >= b and misses of buckets < b are errors
+  s->overlap = 0;
+  uint64_t errors = n0, best_errors = n0;
+  unsigned int best_b = 0;
+  for(int b=0; b<LAT_HIST_BUCKETS; b++){
+    s->overlap += fmin(1.0*h->count[0][b]/n0, 1.0*h->count[1][b]/n1);
+    errors = errors - h->count[0][b] + h->count[1][b];
+    if(errors < best_errors){
+      best_errors = errors;
+      best_b = b + 1;
+    }
+  }
+  s->best_threshold = best_b ? lat_hist_bucket_lo(best_b) - 1 : 0;
+  s->best_error = 1.0*best_errors/(n0 + n1);
+}
+
+/*
+ * Per-epoch export (csv): one row per epoch and sent bit, with the summary of
+ * the epoch and the counts of every bucket (columns named by their lowest latency).
+ */
+static void lat_hist_write_header(FILE* f)
+{
+  fprintf(f, "epoch,first_bit,sent,samples,mean,sd,p1,p50,p99,separation,overlap,best_threshold,best_error");
+  for(int b=0; b<LAT_HIST_BUCKETS; b++)
+    fprintf(f, ",%llu", lat_hist_bucket_lo(b));
+  fprintf(f, "\n");
+}
+
+static void lat_hist_write_epoch(FILE* f, uint64_t epoch, uint64_t first_bit, const struct lat_hist* h)
+{
+  struct lat_hist_summary s;
+  lat_hist_summarize(h, &s);
+  for(int c=0; c<2; c++){
+    fprintf(f, "%llu,%llu,%d,%llu,%.2f,%.2f,%llu,%llu,%llu,%.4f,%.4f,%llu,%.6f",
+            epoch, first_bit, c, h->samples[c], s.mean[c], s.sd[c], s.p1[c], s.p50[c], s.p99[c],
+            s.separation, s.overlap, s.best_threshold, s.best_error);
+    for(int b=0; b<LAT_HIST_BUCKETS; b++)
+      fprintf(f, ",%llu", h->count[c][b]);
+    fprintf(f, "\n");
+  }
+}
+
+#endif
+
+//
+// lat_hist.hh ends here
@@ -0,0 +1,510 @@
+// Copyright (C) 2020, Gururaj Saileshwar
+
+// Commentary:
+// Survival of the sender's lines in the LLC while the channel streams, against
+// the distance (in bits) behind the sender at which they are read: how far the
+// receiver may fall behind before the lines of the 0 bits (the shared-array
+// lines the sender loads) are evicted by the replacement policy, and how much
+// the sender's lagging re-accesses (taps, -g) extend that.
+//
+// An installer thread, on the sender's core, walks the shared array as the
+// sender does: access pattern (-A), random payload (0: the line of the bit,
+// 1: a private page) and taps, without the training bits and barriers. A
+// prober thread, on the receiver's core, cycles through log-spaced distances,
+// and times a load of the line of the 0 bit at that distance behind the
+// installer (each bit at most once, and by one distance only): a hit is a
+// surviving line.
+//
+// Every run streams without taps first, as the baseline. With -x, it then
+// streams once per candidate tap list: single taps at 1/4 to 4 times the
+// first lag of -g, of every bit or of 1 in 4, then pairs with the best single
+// one. A tap list is scored by the survival within the window (-D, default
+// twice the receiver's sync lag), and the one recommended is that with the
+// most survival gained per extra sender load, among those within
+// SURVIVAL_TOLERANCE of the best score.
+//
+// Usage: llc_survival [options]
+//
+
+#include <atomic>
+#include <cmath>
+#include <sys/mman.h>
+
+#include "utils.hh"
+#include "params.hh"
+#include "host.hh"
+#include "addr_schedule.hh"
+
+// Cores of the installer and the prober (those of the sender and the receiver, see sender.cc)
+#define SURVIVAL_TX_CPUID (1)
+#define SURVIVAL_RX_CPUID (0)
+
+#define SURVIVAL_NUM_DISTANCES (24)
+#define SURVIVAL_MIN_DISTANCE (64)
+#define SURVIVAL_DEFAULT_BITS (1000000)
+#define SURVIVAL_DEFAULT_WINDOW (2*TX_SYNC_LAG_DELTA)
+#define SURVIVAL_TOLERANCE (0.02)
+#define SURVIVAL_PAYLOAD_SEED (0x2545f4914f6cdd1dULL)
+#define SURVIVAL_MAX_RUNS (32)
+#define SURVIVAL_SWEEP_EVERY (4)
+
+// A stream with one tap list (num_lag_taps 0: none), and its survival by distance
+struct survival_run {
+  struct channel_params params;
+  uint64_t probes[SURVIVAL_NUM_DISTANCES];
+  uint64_t hits[SURVIVAL_NUM_DISTANCES];
+  uint64_t extra_loads;     //loads of the taps
+  double score;             //survival within the window
+  double extra_per_bit;
+};
+
+//Set up by main()
+static struct channel_params params;
+static uint64_t numentries, num_bits, window;
+static uint64_t distances[SURVIVAL_NUM_DISTANCES];
+static uint64_t* shared_array;
+static uint8_t* payload;       //bit values
+static uint32_t* bit_index;    //entry of the shared array of every bit, written by the installer
+static uint8_t* probed;        //bits probed, by the prober
+static uint64_t private_page[PAGE_SZ/ARRENTRY_SZ] = {1};   //loaded by the '1' bits; [1] keeps the loads
+static bool sweep;
+
+static struct survival_run runs[SURVIVAL_MAX_RUNS];
+static int num_runs;
+
+//Handshake of the installer and the prober: the prober starts run r (run_ready = r),
+//the installer publishes its progress, then ends it (run_done = r + 1)
+static std::atomic<uint64_t> installed;
+static std::atomic<int> run_ready, run_done;
+
+/*
+ * Waits a little: a load of a private line. With the simulator, a load waits
+ * for the other thread's clock, so neither runs ahead of the other in virtual
+ * time (a timer read would not).
+ */
+static inline void survival_spin()
+{
+  static __thread uint64_t spin_line;
+  volatile uint64_t* addr = &spin_line;
+  MEM_LOAD(addr);
+}
+
+static void survival_pin(int cpuid)
+{
+#ifdef SIM_BACKEND
+  sim_attach(cpuid);
+#else
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+  CPU_SET(cpuid, &mask);
+  if(sched_setaffinity(0, sizeof(mask), &mask) != 0)
+    perror("sched_setaffinity");
+#endif
+}
+
+static void survival_unpin()
+{
+#ifdef SIM_BACKEND
+  sim_detach();
+#endif
+}
+
+/*
+ * Streams the bits with the taps of run r, as the sender does.
+ */
+static void install_run(struct survival_run* run)
+{
+  const struct channel_params* p = &run->params;
+  struct addr_schedule schedule;
+  addr_schedule_init(&schedule, 0, numentries, &params);
+  struct addr_lag_ring lag_ring;
+  addr_lag_ring_init(&lag_ring, max_lag_tap(p));
+  uint64_t extra_loads = 0, temp = 0;
+
+  for(uint64_t b=0; b<num_bits; b++){
+    uint64_t index = addr_schedule_index(&schedule, numentries);
+    addr_schedule_next(&schedule, numentries);
+    bit_index[b] = index;
+    volatile uint64_t* addr = payload[b] ? &private_page[0] : &shared_array[index];
+    temp += MEM_LOAD(addr);
+    addr_lag_ring_push(&lag_ring, b, (uintptr_t) addr);
+    for(int t=0; t<p->num_lag_taps; t++){
+      uint64_t lag = p->lag_taps[t];
+      if(b > lag && ((b - lag) & (p->lag_every[t] - 1)) == 0){
+        temp += MEM_LOAD((volatile uint64_t*) addr_lag_ring_get(&lag_ring, b, lag));
+        extra_loads++;
+      }
+    }
+    installed.store(b + 1, std::memory_order_release);
+  }
+  run->extra_loads = extra_loads;
+  private_page[1] = temp;   //keep the loads
+  addr_lag_ring_free(&lag_ring);
+  addr_schedule_free(&schedule);
+}
+
+static void* installer_thread(void* arg)
+{
+  survival_pin(SURVIVAL_TX_CPUID);
+  for(int r=0; ; r++){
+    int ready;
+    while((ready = run_ready.load(std::memory_order_acquire)) < r)
+      survival_spin();
+    if(ready == SURVIVAL_MAX_RUNS)   //no more runs
+      break;
+    install_run(&runs[r]);
+    installed.store(0, std::memory_order_relaxed);
+    run_done.store(r + 1, std::memory_order_release);
+  }
+  survival_unpin();
+  return NULL;
+}
+
+/*
+ * Probes the lines of run r while they are installed.
+ */
+static void probe_run(struct survival_run* run, int r)
+{
+  memset(probed, 0, num_bits);
+  uint64_t temp = 0;
+  int d = 0;
+  while(run_done.load(std::memory_order_acquire) != r + 1){
+    survival_spin();
+    uint64_t last = installed.load(std::memory_order_acquire);
+    uint64_t distance = distances[d];
+    int bucket = d;
+    d = (d + 1 == SURVIVAL_NUM_DISTANCES) ? 0 : d + 1;
+    if(last <= distance + 1)
+      continue;
+    //Bits of distance d are those of b = d mod SURVIVAL_NUM_DISTANCES, so that each distance gets its share
+    uint64_t b = last - 1 - distance;
+    b -= (b + SURVIVAL_NUM_DISTANCES - bucket) % SURVIVAL_NUM_DISTANCES;
+    if(b >= last || payload[b] || probed[b])
+      continue;
+    probed[b] = 1;
+    volatile uint64_t* addr = &shared_array[bit_index[b]];
+    unsigned int junk = 0;
+    uint64_t time0 = MEM_RDTSCP(&junk);
+    temp += MEM_LOAD(addr);
+    uint64_t delta_time = MEM_RDTSCP(&junk) - time0;
+    run->probes[bucket]++;
+    if(delta_time < host.threshold)
+      run->hits[bucket]++;
+  }
+  private_page[1] = temp;   //keep the loads
+}
+
+/*
+ * Survival of the run within the window, and its extra loads per bit.
+ */
+static void score_run(struct survival_run* run)
+{
+  uint64_t probes = 0, hits = 0;
+  for(int d=0; d<SURVIVAL_NUM_DISTANCES; d++)
+    if(distances[d] <= window){
+      probes += run->probes[d];
+      hits += run->hits[d];
+    }
+  run->score = probes ? 1.0*hits/probes : 0;
+  run->extra_per_bit = 1.0*run->extra_loads/num_bits;
+}
+
+static int add_run(uint64_t lag, uint64_t every, const struct channel_params* base)
+{
+  if(num_runs == SURVIVAL_MAX_RUNS)
+    return -1;
+  struct survival_run* run = &runs[num_runs];
+  memset(run, 0, sizeof(*run));
+  run->params = base ? *base : params;
+  if(base == NULL)
+    run->params.num_lag_taps = 0;
+  if(lag){
+    int t = run->params.num_lag_taps++;
+    run->params.lag_taps[t] = lag;
+    run->params.lag_every[t] = every;
+  }
+  return num_runs++;
+}
+
+/*
+ * Pairs the best single tap with the other lags of the sweep, of 1 in SURVIVAL_SWEEP_EVERY bits.
+ */
+static void add_pair_runs(const uint64_t* lags, int num_lags, int first_single)
+{
+  int best = first_single;
+  for(int r=first_single; r<num_runs; r++)
+    if(runs[r].score > runs[best].score + SURVIVAL_TOLERANCE/2 ||
+       (runs[r].score > runs[best].score - SURVIVAL_TOLERANCE/2 && runs[r].extra_per_bit < runs[best].extra_per_bit))
+      best = r;
+  struct channel_params base = runs[best].params;
+  for(int i=0; i<num_lags; i++)
+    if(lags[i] && lags[i] != base.lag_taps[0])
+      add_run(lags[i], SURVIVAL_SWEEP_EVERY, &base);
+}
+
+static void* prober_thread(void* arg)
+{
+  survival_pin(SURVIVAL_RX_CPUID);
+  uint64_t lag = params.lag_taps[0];
+  uint64_t lags[] = {lag/4, lag/2, lag, 2*lag, 4*lag};
+  int num_lags = sizeof(lags)/sizeof(lags[0]);
+  int first_single = 1, pairs_added = !sweep;
+
+  for(int r=0; ; r++){
+    if(r == num_runs && !pairs_added){
+      add_pair_runs(lags, num_lags, first_single);
+      pairs_added = 1;
+    }
+    if(r == num_runs){
+      run_ready.store(SURVIVAL_MAX_RUNS, std::memory_order_release);
+      break;
+    }
+    run_ready.store(r, std::memory_order_release);
+    probe_run(&runs[r], r);
+    score_run(&runs[r]);
+    printf("Run %d/%d done.\n", r + 1, num_runs);
+    fflush(stdout);
+  }
+  survival_unpin();
+  return NULL;
+}
+
+static const char* run_name(const struct survival_run* run, char* buf, size_t len)
+{
+  if(run->params.num_lag_taps == 0)
+    snprintf(buf, len, "none");
+  else
+    format_lag_taps(&run->params, buf, len);
+  return buf;
+}
+
+static void print_results(const char* csv_filename)
+{
+  char name[128];
+  const struct survival_run* base = &runs[0];
+
+  //Survival curve, without taps and with the taps of -g
+  printf("\nSurvival of the lines of 0 bits, by distance behind the sender (bits):\n");
+  printf("%10s %12s", "Distance", "Probes");
+  int shown = sweep ? 1 : num_runs;
+  for(int r=0; r<shown; r++)
+    printf(" %16s", run_name(&runs[r], name, sizeof(name)));
+  printf("\n");
+  for(int d=0; d<SURVIVAL_NUM_DISTANCES; d++){
+    printf("%10llu %12llu", distances[d], base->probes[d]);
+    for(int r=0; r<shown; r++)
+      printf(" %15.1f%%", runs[r].probes[d] ? 100.0*runs[r].hits[d]/runs[r].probes[d] : 0.0);
+    printf("\n");
+  }
+
+  //Tap lists, and the recommended one
+  printf("\nSurvival within %llu bits, by taps:\n", window);
+  printf("%-24s %16s %10s %22s\n", "Taps (-g)", "Extra loads/bit", "Survival", "Gain per extra load");
+  double best_score = 0;
+  for(int r=0; r<num_runs; r++){
+    const struct survival_run* run = &runs[r];
+    printf("%-24s %16.3f %9.1f%%", run_name(run, name, sizeof(name)), run->extra_per_bit, 100*run->score);
+    if(run->extra_per_bit > 0)
+      printf(" %21.2f%%\n", 100*(run->score - base->score)/run->extra_per_bit);
+    else
+      printf(" %22s\n", "-");
+    if(r && run->score > best_score)
+      best_score = run->score;
+  }
+  int rec = -1;
+  double rec_gain = 0;
+  for(int r=1; r<num_runs; r++){
+    double gain = (runs[r].score - base->score)/runs[r].extra_per_bit;
+    if(runs[r].score >= best_score - SURVIVAL_TOLERANCE && (rec == -1 || gain > rec_gain)){
+      rec = r;
+      rec_gain = gain;
+    }
+  }
+  if(rec > 0 && runs[rec].score > base->score)
+    printf("Recommended: -g %s (survival %.1f%% vs. %.1f%% without taps, %.3f extra loads/bit)\n",
+           run_name(&runs[rec], name, sizeof(name)), 100*runs[rec].score, 100*base->score, runs[rec].extra_per_bit);
+  else
+    printf("Recommended: no taps help within %llu bits.\n", window);
+
+  if(csv_filename){
+    FILE* f = fopen(csv_filename, "w");
+    if(f == NULL){
+      perror(csv_filename);
+      return;
+    }
+    fprintf(f, "distance");
+    for(int r=0; r<num_runs; r++)
+      fprintf(f, ",\"%s\"", run_name(&runs[r], name, sizeof(name)));
+    fprintf(f, "\n");
+    for(int d=0; d<SURVIVAL_NUM_DISTANCES; d++){
+      fprintf(f, "%llu", distances[d]);
+      for(int r=0; r<num_runs; r++)
+        fprintf(f, ",%.4f", runs[r].probes[d] ? 1.0*runs[r].hits[d]/runs[r].probes[d] : 0.0);
+      fprintf(f, "\n");
+    }
+    fclose(f);
+    printf("Survival curves written to %s\n", csv_filename);
+  }
+}
+
+/*
+ * Prints help menu
+ */
+static void print_help()
+{
+  printf("Usage: llc_survival [options]\n"
+         "-a,\tShared-array size, in multiples of the LLC size\n"
+         "-A,\tAccess pattern: streamline, stride, permuted or balanced[,<stride>,<pages>] (see addr_schedule.hh)\n"
+         "-g,\tAccess lag taps <lag>[/<every>],... (see params.hh); with -x, the sweep is around the first lag\n"
+         "-n,\tBits streamed per run\n"
+         "-D,\tWindow (bits behind the sender) of the scores\n"
+         "-T,\tHit/miss threshold in cycles (0: probed at startup)\n"
+         "-x,\tSweep tap lists, and recommend one\n"
+         "-o,\tCSV file for the survival curves\n"
+#ifdef SIM_BACKEND
+         "-c,\tSimulated LLC size (KB)\n"
+         "-w,\tSimulated LLC associativity\n"
+         "-p,\tSimulated LLC replacement policy: lru, srrip or random\n"
+         "-s,\tSimulator seed\n"
+#endif
+         );
+}
+
+int main(int argc, char** argv)
+{
+  channel_params_init(&params);
+  num_bits = SURVIVAL_DEFAULT_BITS;
+  window = SURVIVAL_DEFAULT_WINDOW;
+  uint64_t threshold = 0;
+  const char* csv_filename = NULL;
+#ifdef SIM_BACKEND
+  struct sim_config cfg;
+  sim_config_init(&cfg, CACHE_SZ);
+#endif
+
+  int option;
+  while((option = getopt(argc, argv, "a:A:g:n:D:T:xo:c:w:p:s:h")) != -1){
+    switch(option){
+    case 'a': params.arraysz_per_cachesz = strtoull(optarg, NULL, 10); break;
+    case 'A':
+      if(!parse_pattern(optarg, &params)){
+        printf("Unknown access pattern %s\n", optarg);
+        exit(1);
+      }
+      break;
+    case 'g':
+      if(!parse_lag_taps(optarg, &params)){
+        printf("Invalid access lag %s: up to %d taps <lag>[/<every>], every a power of two\n", optarg, MAX_LAG_TAPS);
+        exit(1);
+      }
+      break;
+    case 'n': num_bits = strtoull(optarg, NULL, 10); break;
+    case 'D': window = strtoull(optarg, NULL, 10); break;
+    case 'T': threshold = strtoull(optarg, NULL, 10); break;
+    case 'x': sweep = true; break;
+    case 'o': csv_filename = optarg; break;
+#ifdef SIM_BACKEND
+    case 'c': cfg.size[SIM_LLC] = strtoull(optarg, NULL, 10)*1024; break;
+    case 'w': cfg.ways[SIM_LLC] = strtoull(optarg, NULL, 10); break;
+    case 'p':
+      for(cfg.llc_repl=SIM_REPL_LRU; cfg.llc_repl<=SIM_REPL_RANDOM; cfg.llc_repl++)
+        if(strcmp(optarg, sim_repl_name(cfg.llc_repl)) == 0)
+          break;
+      if(cfg.llc_repl > SIM_REPL_RANDOM){
+        printf("Unknown replacement policy %s\n", optarg);
+        exit(1);
+      }
+      break;
+    case 's': cfg.seed = strtoull(optarg, NULL, 10); break;
+#endif
+    default:
+      print_help();
+      exit(1);
+    }
+  }
+#ifdef SIM_BACKEND
+  if(cfg.ways[SIM_LLC] == 0 || cfg.size[SIM_LLC] < cfg.ways[SIM_LLC]*SIM_LINE_SZ){
+    printf("Invalid LLC: %llu KB, %llu-way\n", cfg.size[SIM_LLC]/1024, cfg.ways[SIM_LLC]);
+    exit(1);
+  }
+  sim_init(&cfg);
+#endif
+
+  host_init(threshold);
+  host_print();
+#ifndef SIM_BACKEND
+  host_check_llc_sharing(SURVIVAL_TX_CPUID, SURVIVAL_RX_CPUID);
+#endif
+  if(params.arraysz_per_cachesz == 0 || !addr_pattern_resolve(&params)){
+    printf("Invalid array size or access pattern\n");
+    exit(1);
+  }
+  numentries = ARRAYSZ_2_NUMENTRIES_LLC(params.arraysz_per_cachesz, host.llc_size);
+  addr_pattern_print(&params, numentries);
+
+  //Distances: log-spaced, up to half a pass of the pattern (and a quarter of the run)
+  uint64_t pass_bits;
+  addr_pattern_coverage(&params, numentries, &pass_bits);
+  uint64_t max_distance = std::min(pass_bits/2, num_bits/4);
+  if(max_distance < 2*SURVIVAL_MIN_DISTANCE){
+    printf("Too few bits per run (-n) for distances of at least %d bits\n", 2*SURVIVAL_MIN_DISTANCE);
+    exit(1);
+  }
+  for(int d=0; d<SURVIVAL_NUM_DISTANCES; d++)
+    distances[d] = SURVIVAL_MIN_DISTANCE*pow(1.0*max_distance/SURVIVAL_MIN_DISTANCE, 1.0*d/(SURVIVAL_NUM_DISTANCES - 1));
+  if(window > max_distance){
+    printf("Window %llu bits beyond the distances measured, reduced to %llu bits\n", window, max_distance);
+    window = max_distance;
+  }
+
+  //Shared array (every page written, so that none is the zero page), payload and per-bit state
+  uint64_t array_bytes = (numentries + SCHEDULE_ENTRY_OFFSET)*ARRENTRY_SZ + PAGE_SZ;
+  shared_array = (uint64_t*) mmap(NULL, array_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if(shared_array == MAP_FAILED){
+    perror("mmap");
+    exit(1);
+  }
+  uint64_t x = SURVIVAL_PAYLOAD_SEED;
+  host_random_fill(shared_array, array_bytes/sizeof(uint64_t), &x);
+  payload = (uint8_t*) malloc(num_bits);
+  probed = (uint8_t*) malloc(num_bits);
+  bit_index = (uint32_t*) calloc(num_bits, sizeof(uint32_t));
+  for(uint64_t b=0; b<num_bits; b++){
+    x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+    payload[b] = x & 1;
+  }
+
+  //Runs: none, the taps of -g (or the sweep)
+  add_run(0, 0, NULL);
+  if(sweep){
+    uint64_t lag = params.lag_taps[0];
+    uint64_t lags[] = {lag/4, lag/2, lag, 2*lag, 4*lag};
+    uint64_t every[] = {1, SURVIVAL_SWEEP_EVERY};
+    for(int e=0; e<2; e++)
+      for(int i=0; i<(int)(sizeof(lags)/sizeof(lags[0])); i++)
+        if(lags[i])
+          add_run(lags[i], every[e], NULL);
+  } else {
+    int r = add_run(0, 0, NULL);
+    runs[r].params = params;
+  }
+  printf("Runs of %llu bits, probed at %d distances from %llu to %llu bits.\n",
+         num_bits, SURVIVAL_NUM_DISTANCES, distances[0], distances[SURVIVAL_NUM_DISTANCES - 1]);
+
+  run_ready.store(-1);
+  run_done.store(0);
+  pthread_t tx_thread, rx_thread;
+  if(pthread_create(&tx_thread, NULL, installer_thread, NULL) != 0 ||
+     pthread_create(&rx_thread, NULL, prober_thread, NULL) != 0){
+    printf("Failed to create the installer and prober threads\n");
+    exit(1);
+  }
+  pthread_join(tx_thread, NULL);
+  pthread_join(rx_thread, NULL);
+
+  print_results(csv_filename);
+  return 0;
+}
+
+//
+// llc_survival.cc ends here
@@ -7,9 +7,8 @@
  */
 
 void delayloop(uint32_t cycles) {
-  unsigned int junk = 0;
-  uint64_t start = __rdtscp(&junk);
-  while ((__rdtscp(&junk) - start) < cycles)
+  uint64_t start = timer_cycles();
+  while ((timer_cycles() - start) < cycles)
     ;
 }
 
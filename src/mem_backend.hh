@@ -0,0 +1,33 @@
+// Copyright (C) 2020, Gururaj Saileshwar
+
+// Commentary:
+// Memory backend of the sender and receiver: the timer reads, timed loads and
+// flushes of the channel go through these primitives.
+//
+// The native backend (default) is the hardware itself: the primitives expand
+// to the same rdtscp / load / clflush as before. With -DSIM_BACKEND, they run
+// against the software model of cache_sim.hh, on a virtual cycle clock.
+
+#ifndef MEM_BACKEND_H_
+#define MEM_BACKEND_H_
+
+#ifndef SIM_BACKEND
+
+#define MEM_RDTSCP(aux)   __rdtscp(aux)
+#define MEM_LOAD(p)       (*(p))
+#define MEM_CLFLUSH(p)    _mm_clflush(p)
+
+#else
+
+#include "cache_sim.hh"
+
+#define MEM_RDTSCP(aux)   sim_rdtscp(aux)
+#define MEM_LOAD(p)       (sim_load(p), *(p))
+#define MEM_CLFLUSH(p)    sim_clflush(p)
+
+#endif
+
+#endif
+
+//
+// mem_backend.hh ends here
@@ -0,0 +1,643 @@
+// Copyright (C) 2020, Gururaj Saileshwar
+
+// Commentary:
+// Experiment orchestrator: runs the sweeps of results/* (base, ecc, array_sz,
+// sync_period) natively, instead of the per-experiment zsh scripts.
+//
+// For every sweep point, it forks the receiver and the sender (which pin
+// themselves to their cores) and reads the receiver's result line (results.hh)
+// from a pipe. A point is repeated until the 95% confidence intervals of the
+// bit-rate and of the bit-error-rate are tight enough (at least min-reps and at
+// most max-reps runs). The shared file stays mapped here, and its pages are
+// touched before every run, so that it stays resident across runs.
+//
+// Every experiment writes to its results directory: the averages in the format
+// of the former scripts (*_results.txt, read by the notebook and plot scripts),
+// mean, standard deviation and confidence interval of every metric
+// (*_results.csv, and *_results.json along with the runs), and the outputs of
+// the programs (receiver_out.log, sender_out.log).
+//
+// Usage: sudo bin/orchestrator.o [options] [-- options for sender and receiver]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <sched.h>
+#include <signal.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <string>
+#include <vector>
+
+#include "utils.hh"
+#include "params.hh"
+#include "host.hh"
+#include "results.hh"
+
+#define DEFAULT_MIN_REPS (3)
+#define DEFAULT_MAX_REPS (5)         /* as the former scripts */
+#define DEFAULT_BPS_REL_CI (1.0)     /* % of the mean bit-rate */
+#define DEFAULT_BER_CI (0.25)        /* percentage points */
+#define DEFAULT_RUN_TIMEOUT_S (900)
+#define DEFAULT_BIN_DIR "bin"
+#define DEFAULT_RESULTS_DIR "results"
+
+#define MAX_SWEEP_POINTS (16)
+#define PAYLOAD_SIZES {200000, 500000, 1000000, 2000000, 5000000, 10000000, 20000000, \
+                       50000000, 100000000, 200000000, 500000000, 1000000000}
+
+struct experiment {
+  const char* name;
+  const char* results_file;   //in results/<name>/, without extension
+  const char* options;        //fixed options of sender and receiver (NULL: none)
+  char sweep_opt;             //swept option: 'n' (payload size), 'a' (array size), 'p' (sync period), 'M' (region), 'A' (access pattern), 'S' (barrier), 'E' (sync mode), 'P' (pilots), 'D' (adaptive sync period), 'C' (soft decoding), 'I' (interleaver), 'O' (outer code) or 'G' (epoch code)
+  const char* sweep_key;      //csv/json name of the swept option (other than the payload size)
+  const char* sweep_column;   //txt column of the swept option (other than the payload size)
+  uint64_t numbits;           //payload size, if not swept
+  uint64_t values[MAX_SWEEP_POINTS]; //0-terminated
+  bool extra;                 //not one of the paper's: left out of "all"
+};
+
+static const struct experiment experiments[] = {
+  //Base attack (Fig-9, Table-2)
+  {"base", "bitrate_results", NULL, 'n', NULL, NULL, 0, PAYLOAD_SIZES},
+  //Attack with ECC (Table-3)
+  {"ecc", "bitrate_ECC_results", "-e", 'n', NULL, NULL, 0, PAYLOAD_SIZES},
+  //Shared-array sizes of 1X, 2X and 4X the LLC size (Table-4)
+  {"array_sz", "bitrate_arraysz_results", NULL, 'a', "arraysz", "ArraySz(inMultipleofLLCSize)",
+   100000000, {1, 2, 4}},
+  //Synchronization periods of 25K, 50K, 100K and 500K bits (Table-5)
+  {"sync_period", "bitrate_syncperiod_results", NULL, 'p', "sync_period", "SyncPeriod",
+   100000000, {25000, 50000, 100000, 500000}},
+  //Backings of the shared region: 1 file, 2 thp, 3 hugetlbfs (see shared_region.hh)
+  {"region", "bitrate_region_results", NULL, 'M', "region", "Region(1:file,2:thp,3:hugetlbfs)",
+   100000000, {1, 2, 3}, true},
+  //Access patterns: 1 streamline, 2 stride, 3 permuted, 4 balanced (see addr_schedule.hh)
+  {"pattern", "bitrate_pattern_results", NULL, 'A', "pattern", "Pattern(1:streamline,2:stride,3:permuted,4:balanced)",
+   100000000, {1, 2, 3, 4}, true},
+  //Voting lines of the sync barrier, at the 25K-bit sync period (see fr_barrier.hh)
+  {"barrier", "bitrate_barrier_results", "-p 25000", 'S', "barrier_lines", "Barrier-Voting-Lines",
+   100000000, {1, 3, 5, 9}, true},
+  //Synchronization modes, at the 25K-bit sync period: 1 barrier, 2 deadline (see epoch_schedule.hh)
+  {"sync_mode", "bitrate_syncmode_results", "-p 25000", 'E', "sync_mode", "SyncMode(1:barrier,2:deadline)",
+   100000000, {1, 2}, true},
+  //Pilot periods, at the 25K-bit sync period (see pilot.hh)
+  {"pilots", "bitrate_pilots_results", "-p 25000", 'P', "pilot_period", "Pilot-Period",
+   100000000, {1024, 4096, 16384}, true},
+  //Longest adaptive sync periods, from the 25K-bit sync period (see sync_adapt.hh), next to the fixed ones of Table-5
+  {"sync_adapt", "bitrate_syncadapt_results", "-p 25000", 'D', "sync_adapt_max", "Adaptive-SyncPeriod-Max",
+   100000000, {100000, 400000, 800000}, true},
+  //Bits flipped by the soft-decision decoding of the ECC blocks (see soft_decode.hh): goodput next to goodput_hard
+  {"chase", "bitrate_chase_results", "-e", 'C', "chase_flips", "Chase-Flips",
+   100000000, {2, 4, 8}, true},
+  //Depth of the interleaver of the ECC blocks (see interleave.hh), and parity blocks of the outer code (see outer_code.hh)
+  {"interleave", "bitrate_interleave_results", "-e", 'I', "interleave_depth", "Interleave-Depth",
+   100000000, {8, 64, 512}, true},
+  {"outer_code", "bitrate_outercode_results", "-e -I 64", 'O', "outer_parity", "Outer-Parity-Blocks",
+   100000000, {8, 16, 32}, true},
+  //Repair epochs of the erasure code across sync epochs (see epoch_code.hh), in groups of 16
+  {"epoch_code", "bitrate_epochcode_results", "-p 25000", 'G', "epoch_repair", "Repair-Epochs",
+   100000000, {1, 2, 4}, true},
+};
+#define NUM_EXPERIMENTS (sizeof(experiments)/sizeof(experiments[0]))
+
+struct orch_opts {
+  int min_reps;
+  int max_reps;
+  double bps_rel_ci;          //% of the mean
+  double ber_ci;              //percentage points
+  int run_timeout_s;
+  int cpuid;                  //core of the orchestrator (-1: not pinned)
+  const char* file;           //shared file (NULL: default of the programs)
+  std::string bin_dir;
+  std::string results_dir;
+  std::vector<std::string> extra_args; //passed to sender and receiver
+};
+
+struct metric_stats {
+  double mean;
+  double stddev;
+  double ci;                  //half-width of the 95% confidence interval
+};
+
+struct sweep_point {
+  uint64_t numbits;
+  uint64_t value;             //swept option (the payload size for 'n')
+  std::vector<struct run_result> runs;
+  struct metric_stats stats[NUM_METRICS];
+  bool converged;
+};
+
+/*
+ * Prints help menu
+ */
+static void print_help()
+{
+  printf("Usage: sudo bin/orchestrator.o [options] [-- options for sender and receiver]\n"
+         "-x,\tExperiment:");
+  for(size_t i=0; i<NUM_EXPERIMENTS; i++)
+    printf(" %s,", experiments[i].name);
+  printf(" or all of the paper's (default all)\n"
+         "-m,\tMinimum runs per point (default %d)\n"
+         "-M,\tMaximum runs per point (default %d)\n"
+         "-c,\tTarget 95%% confidence interval of the bit-rate, in %% of its mean (default %.2f)\n"
+         "-b,\tTarget 95%% confidence interval of the bit-error-rate, in percentage points (default %.2f)\n"
+         "-T,\tTimeout of a run, in seconds (default %d)\n"
+         "-C,\tCore of the orchestrator (default: the last one; -1: not pinned)\n"
+         "-f,\tShared file (default: the one of the programs)\n"
+         "-B,\tDirectory of sender.o and receiver.o (default %s)\n"
+         "-O,\tResults directory (default %s)\n",
+         DEFAULT_MIN_REPS, DEFAULT_MAX_REPS, DEFAULT_BPS_REL_CI, DEFAULT_BER_CI,
+         DEFAULT_RUN_TIMEOUT_S, DEFAULT_BIN_DIR, DEFAULT_RESULTS_DIR);
+}
+
+static double now_seconds()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+//------------------------------------------------------------------------
+// Statistics
+//------------------------------------------------------------------------
+
+/*
+ * 97.5% quantile of Student's t-distribution with df degrees of freedom.
+ */
+static double t_quantile_975(int df)
+{
+  static const double t[30] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                               2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                               2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+  if(df < 1)
+    return NAN;
+  return df <= 30 ? t[df-1] : 1.960;
+}
+
+static void compute_stats(struct sweep_point* pt)
+{
+  int n = pt->runs.size();
+  for(int m=0; m<NUM_METRICS; m++){
+    double sum = 0, sq = 0;
+    for(int i=0; i<n; i++)
+      sum += pt->runs[i].metric[m];
+    double mean = n ? sum/n : NAN;
+    for(int i=0; i<n; i++)
+      sq += (pt->runs[i].metric[m] - mean)*(pt->runs[i].metric[m] - mean);
+    pt->stats[m].mean = mean;
+    pt->stats[m].stddev = n > 1 ? sqrt(sq/(n-1)) : NAN;
+    pt->stats[m].ci = n > 1 ? t_quantile_975(n-1)*pt->stats[m].stddev/sqrt(n) : NAN;
+  }
+}
+
+/*
+ * Whether a point has enough runs: the confidence intervals of the bit-rate
+ * and the bit-error-rate are within the targets.
+ */
+static bool point_converged(const struct orch_opts* o, const struct sweep_point* pt)
+{
+  if((int)pt->runs.size() < o->min_reps)
+    return false;
+  const struct metric_stats* bps = &pt->stats[METRIC_BPS];
+  const struct metric_stats* ber = &pt->stats[METRIC_BER];
+  return bps->ci <= o->bps_rel_ci/100*bps->mean && ber->ci <= o->ber_ci;
+}
+
+//------------------------------------------------------------------------
+// Shared file
+//------------------------------------------------------------------------
+
+struct shared_file {
+  const volatile uint8_t* addr;
+  uint64_t size;
+};
+
+/*
+ * Maps the shared file, creating it if needed for the default shared array on this host's LLC.
+ */
+static void shared_file_map(struct shared_file* sf, const char* path)
+{
+  host_discover_llc();
+  int fd = host_shared_file_open(path, FILE_SIZE(ARRAYSZ_2_NUMENTRIES_LLC(DEFAULT_ARRAYSZ_PER_CACHESZ, host.llc_size)));
+  struct stat st;
+  if(fd == -1 || fstat(fd, &st) != 0){
+    printf("Failed to Open File %s\n", path);
+    exit(1);
+  }
+  sf->size = st.st_size;
+  void* addr = mmap(NULL, sf->size, PROT_READ, MAP_SHARED, fd, 0);
+  if(addr == MAP_FAILED){
+    printf("Failed to Map Address\n");
+    exit(1);
+  }
+  close(fd);
+  madvise(addr, sf->size, MADV_WILLNEED);
+  sf->addr = (const volatile uint8_t*) addr;
+}
+
+/*
+ * Touches every page of the shared file, so that it is resident for the next run.
+ */
+static uint64_t shared_file_touch(const struct shared_file* sf)
+{
+  uint64_t sum = 0;
+  for(uint64_t off=0; off<sf->size; off+=PAGE_SZ)
+    sum += sf->addr[off];
+  return sum;
+}
+
+//------------------------------------------------------------------------
+// Runs
+//------------------------------------------------------------------------
+
+/*
+ * Appends the whitespace-separated options of opts to args, one argument each.
+ */
+static void append_options(std::vector<std::string>& args, const char* opts)
+{
+  const char* p = opts;
+  while(*p){
+    size_t len = strcspn(p, " \t");
+    if(len)
+      args.push_back(std::string(p, len));
+    p += len;
+    p += strspn(p, " \t");
+  }
+}
+
+/*
+ * Forks and runs path with args, with stdout and stderr to out_fd.
+ */
+static pid_t spawn(const std::string& path, const std::vector<std::string>& args, int out_fd)
+{
+  pid_t pid = fork();
+  if(pid == -1){
+    perror("fork");
+    exit(1);
+  }
+  if(pid == 0){
+    std::vector<char*> argv;
+    argv.push_back((char*) path.c_str());
+    for(size_t i=0; i<args.size(); i++)
+      argv.push_back((char*) args[i].c_str());
+    argv.push_back(NULL);
+    dup2(out_fd, STDOUT_FILENO);
+    dup2(out_fd, STDERR_FILENO);
+    execv(path.c_str(), argv.data());
+    perror(path.c_str());
+    _exit(127);
+  }
+  return pid;
+}
+
+/*
+ * Waits for pid until deadline (then kills it). Returns true if it exited with 0.
+ */
+static bool wait_deadline(pid_t pid, double deadline)
+{
+  int status;
+  while(waitpid(pid, &status, WNOHANG) == 0){
+    if(now_seconds() > deadline){
+      kill(pid, SIGKILL);
+      waitpid(pid, &status, 0);
+      return false;
+    }
+    usleep(10000);
+  }
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/*
+ * Runs the receiver and the sender once with args. Returns true with the
+ * receiver's result in r if both completed.
+ */
+static bool run_once(const struct orch_opts* o, const std::vector<std::string>& args,
+                     int rx_log, int tx_log, struct run_result* r)
+{
+  int pfd[2];
+  if(pipe(pfd) != 0){
+    perror("pipe");
+    exit(1);
+  }
+  fcntl(pfd[0], F_SETFD, FD_CLOEXEC);
+
+  std::vector<std::string> rx_args = args;
+  rx_args.push_back("-R");
+  rx_args.push_back(std::to_string(pfd[1]));
+
+  //Started together, as in the former scripts
+  pid_t rx_pid = spawn(o->bin_dir + "/receiver.o", rx_args, rx_log);
+  close(pfd[1]); //(not inherited by the sender)
+  pid_t tx_pid = spawn(o->bin_dir + "/sender.o", args, tx_log);
+
+  //Result line: read until the receiver closes the pipe
+  double deadline = now_seconds() + o->run_timeout_s;
+  std::string buf;
+  bool timeout = false;
+  while(true){
+    int wait_ms = (int)((deadline - now_seconds())*1000);
+    if(wait_ms <= 0){
+      timeout = true;
+      break;
+    }
+    struct pollfd p = {pfd[0], POLLIN, 0};
+    if(poll(&p, 1, wait_ms) <= 0)
+      continue;
+    char chunk[RUN_RESULT_LINE_MAX];
+    ssize_t len = read(pfd[0], chunk, sizeof(chunk));
+    if(len <= 0)
+      break;
+    buf.append(chunk, len);
+  }
+  close(pfd[0]);
+
+  if(timeout){
+    kill(rx_pid, SIGKILL);
+    kill(tx_pid, SIGKILL);
+  }
+  bool rx_ok = wait_deadline(rx_pid, deadline);
+  bool tx_ok = wait_deadline(tx_pid, deadline);
+  if(timeout)
+    printf("  Run timed out after %d s\n", o->run_timeout_s);
+  else if(!rx_ok || !tx_ok)
+    printf("  Run failed (receiver %s, sender %s)\n", rx_ok ? "ok" : "failed", tx_ok ? "ok" : "failed");
+  return !timeout && rx_ok && tx_ok && run_result_parse(buf.c_str(), r);
+}
+
+//------------------------------------------------------------------------
+// Output
+//------------------------------------------------------------------------
+
+static FILE* open_output(const struct orch_opts* o, const struct experiment* e, const char* name, const char* mode)
+{
+  std::string dir = o->results_dir + "/" + e->name;
+  mkdir(dir.c_str(), 0755);   //experiments other than the paper's have no directory of their own
+  std::string path = dir + "/" + name;
+  FILE* f = fopen(path.c_str(), mode);
+  if(f == NULL){
+    printf("Failed to open %s\n", path.c_str());
+    exit(1);
+  }
+  fcntl(fileno(f), F_SETFD, FD_CLOEXEC); //(not inherited by the programs)
+  return f;
+}
+
+static void print_json_number(FILE* f, double v)
+{
+  if(isfinite(v))
+    fprintf(f, "%.6f", v);
+  else
+    fprintf(f, "null");
+}
+
+static void print_json_metrics(FILE* f, const double* v, size_t stride)
+{
+  fprintf(f, "{");
+  for(int m=0; m<NUM_METRICS; m++){
+    fprintf(f, "%s\"%s\": ", m ? ", " : "", run_metric_names[m]);
+    print_json_number(f, v[m*stride]);
+  }
+  fprintf(f, "}");
+}
+
+/*
+ * Writes all the points of an experiment (so far) to its json file.
+ */
+static void write_json(const struct orch_opts* o, const struct experiment* e,
+                       const std::string& options, const std::vector<struct sweep_point>& points)
+{
+  std::string name = std::string(e->results_file) + ".json";
+  FILE* f = open_output(o, e, name.c_str(), "w");
+  fprintf(f, "{\n  \"experiment\": \"%s\",\n  \"options\": \"%s\",\n  \"points\": [", e->name, options.c_str());
+  const size_t stride = sizeof(struct metric_stats)/sizeof(double);
+  for(size_t i=0; i<points.size(); i++){
+    const struct sweep_point* pt = &points[i];
+    fprintf(f, "%s\n    {\"numbits\": %llu, ", i ? "," : "", pt->numbits);
+    if(e->sweep_key)
+      fprintf(f, "\"%s\": %llu, ", e->sweep_key, pt->value);
+    fprintf(f, "\"runs\": %zu, \"converged\": %s,\n", pt->runs.size(), pt->converged ? "true" : "false");
+    fprintf(f, "     \"mean\": ");
+    print_json_metrics(f, &pt->stats[0].mean, stride);
+    fprintf(f, ",\n     \"stddev\": ");
+    print_json_metrics(f, &pt->stats[0].stddev, stride);
+    fprintf(f, ",\n     \"ci95\": ");
+    print_json_metrics(f, &pt->stats[0].ci, stride);
+    fprintf(f, ",\n     \"samples\": [");
+    for(size_t r=0; r<pt->runs.size(); r++){
+      fprintf(f, "%s\n       ", r ? "," : "");
+      print_json_metrics(f, pt->runs[r].metric, 1);
+    }
+    fprintf(f, "]}");
+  }
+  fprintf(f, "\n  ]\n}\n");
+  fclose(f);
+}
+
+//------------------------------------------------------------------------
+// Experiments
+//------------------------------------------------------------------------
+
+static void run_experiment(const struct orch_opts* o, const struct experiment* e, const struct shared_file* sf)
+{
+  double exp_start = now_seconds();
+  std::string options = e->options ? e->options : "";
+  if(o->file)
+    options += std::string(options.empty() ? "" : " ") + "-f " + o->file;
+  for(size_t i=0; i<o->extra_args.size(); i++)
+    options += (options.empty() ? "" : " ") + o->extra_args[i];
+  printf("Running experiment %s%s%s\n", e->name, options.empty() ? "" : " with options ", options.c_str());
+
+  //Outputs
+  std::string txt_name = std::string(e->results_file) + ".txt";
+  std::string csv_name = std::string(e->results_file) + ".csv";
+  FILE* txt = open_output(o, e, txt_name.c_str(), "w");
+  FILE* csv = open_output(o, e, csv_name.c_str(), "w");
+  FILE* rx_log = open_output(o, e, "receiver_out.log", "w");
+  FILE* tx_log = open_output(o, e, "sender_out.log", "w");
+
+  if(e->sweep_column)
+    fprintf(txt, "numbits %s bps ber ber10 ber01 ber1bit bermultibit\n", e->sweep_column);
+  else
+    fprintf(txt, "numbits bps ber ber10 ber01 ber1bit bermultibit\n");
+  fprintf(csv, "numbits,%s%sruns,converged", e->sweep_key ? e->sweep_key : "", e->sweep_key ? "," : "");
+  for(int m=0; m<NUM_METRICS; m++)
+    fprintf(csv, ",%s_mean,%s_stddev,%s_ci95", run_metric_names[m], run_metric_names[m], run_metric_names[m]);
+  fprintf(csv, "\n");
+  fflush(txt);
+  fflush(csv);
+  printf("numbits %sbps ber | ber10 ber01 | ber1bit bermultibit | runs, bps-ci95, time\n",
+         e->sweep_column ? "value " : "");
+
+  std::vector<struct sweep_point> points;
+  for(int v=0; v<MAX_SWEEP_POINTS && e->values[v]; v++){
+    double point_start = now_seconds();
+    struct sweep_point pt;
+    pt.value = e->values[v];
+    pt.numbits = (e->sweep_opt == 'n') ? e->values[v] : e->numbits;
+    pt.converged = false;
+
+    //Options of sender and receiver
+    std::vector<std::string> args;
+    args.push_back("-n");
+    args.push_back(std::to_string(pt.numbits));
+    if(e->sweep_opt != 'n'){
+      args.push_back(std::string("-") + e->sweep_opt);
+      args.push_back(std::to_string(pt.value));
+    }
+    if(e->options)
+      append_options(args, e->options);
+    if(o->file){
+      args.push_back("-f");
+      args.push_back(o->file);
+    }
+    args.insert(args.end(), o->extra_args.begin(), o->extra_args.end());
+
+    //Repeat until the confidence intervals are tight enough
+    int failures = 0;
+    while((int)pt.runs.size() < o->max_reps && failures < o->max_reps){
+      int run = pt.runs.size() + failures;
+      fprintf(rx_log, "---------- %s %llu, run %d ----------\n", e->name, pt.value, run);
+      fprintf(tx_log, "---------- %s %llu, run %d ----------\n", e->name, pt.value, run);
+      fflush(rx_log);
+      fflush(tx_log);
+
+      shared_file_touch(sf);
+      struct run_result r;
+      if(run_once(o, args, fileno(rx_log), fileno(tx_log), &r))
+        pt.runs.push_back(r);
+      else
+        failures++;
+
+      compute_stats(&pt);
+      pt.converged = point_converged(o, &pt);
+      if(pt.converged)
+        break;
+    }
+    points.push_back(pt);
+
+    //Results (a point without runs only in the csv and json, with 0 runs: the plots parse the txt)
+    const struct metric_stats* st = pt.stats;
+    if(!pt.runs.empty()){
+      if(e->sweep_column)
+        fprintf(txt, "%llu %llu ", pt.numbits, pt.value);
+      else
+        fprintf(txt, "%llu  ", pt.numbits);
+      fprintf(txt, "%.0f  %0.2f%%  %0.2f%%  %0.2f%%  %0.2f%%  %0.2f%%\n",
+              st[METRIC_BPS].mean, st[METRIC_BER].mean, st[METRIC_BER10].mean, st[METRIC_BER01].mean,
+              st[METRIC_BER1BIT].mean, st[METRIC_BERMULTIBIT].mean);
+    }
+    fprintf(csv, "%llu,", pt.numbits);
+    if(e->sweep_key)
+      fprintf(csv, "%llu,", pt.value);
+    fprintf(csv, "%zu,%d", pt.runs.size(), pt.converged);
+    for(int m=0; m<NUM_METRICS; m++)
+      fprintf(csv, ",%.6f,%.6f,%.6f", st[m].mean, st[m].stddev, st[m].ci);
+    fprintf(csv, "\n");
+    fflush(txt);
+    fflush(csv);
+    write_json(o, e, options, points);
+
+    if(e->sweep_column)
+      printf("%llu %llu ", pt.numbits, pt.value);
+    else
+      printf("%llu  ", pt.numbits);
+    if(pt.runs.empty()){
+      printf("all %d runs failed, left out of %s.txt\n", failures, e->results_file);
+      continue;
+    }
+    printf("%.0f  %0.2f%% | %0.2f%%  %0.2f%% | %0.2f%%  %0.2f%% | %zu%s, +-%.0f bps, %.1fs\n",
+           st[METRIC_BPS].mean, st[METRIC_BER].mean, st[METRIC_BER10].mean, st[METRIC_BER01].mean,
+           st[METRIC_BER1BIT].mean, st[METRIC_BERMULTIBIT].mean, pt.runs.size(),
+           pt.converged ? "" : " (not converged)", st[METRIC_BPS].ci, now_seconds() - point_start);
+  }
+
+  fclose(txt);
+  fclose(csv);
+  fclose(rx_log);
+  fclose(tx_log);
+  printf("Experiment %s done in %.1fs\n\n", e->name, now_seconds() - exp_start);
+}
+
+int main(int argc, char** argv)
+{
+  struct orch_opts o;
+  o.min_reps = DEFAULT_MIN_REPS;
+  o.max_reps = DEFAULT_MAX_REPS;
+  o.bps_rel_ci = DEFAULT_BPS_REL_CI;
+  o.ber_ci = DEFAULT_BER_CI;
+  o.run_timeout_s = DEFAULT_RUN_TIMEOUT_S;
+  o.cpuid = sysconf(_SC_NPROCESSORS_ONLN) - 1;
+  o.file = NULL;
+  o.bin_dir = DEFAULT_BIN_DIR;
+  o.results_dir = DEFAULT_RESULTS_DIR;
+  const char* exp_name = "all";
+
+  int option;
+  while ((option = getopt(argc, argv, "x:m:M:c:b:T:C:f:B:O:h")) != -1) {
+    switch (option) {
+    case 'x': exp_name = optarg; break;
+    case 'm': o.min_reps = atoi(optarg); break;
+    case 'M': o.max_reps = atoi(optarg); break;
+    case 'c': o.bps_rel_ci = atof(optarg); break;
+    case 'b': o.ber_ci = atof(optarg); break;
+    case 'T': o.run_timeout_s = atoi(optarg); break;
+    case 'C': o.cpuid = atoi(optarg); break;
+    case 'f': o.file = optarg; break;
+    case 'B': o.bin_dir = optarg; break;
+    case 'O': o.results_dir = optarg; break;
+    default:
+      print_help();
+      exit(1);
+    }
+  }
+  //Options after "--" are passed to sender and receiver
+  for(int i=optind; i<argc; i++)
+    o.extra_args.push_back(argv[i]);
+
+  if(o.min_reps < 2 || o.max_reps < o.min_reps || o.run_timeout_s <= 0){
+    printf("Invalid options: at least 2 runs per point, max runs >= min runs, and a positive timeout\n");
+    exit(1);
+  }
+
+  //Experiments to run
+  std::vector<const struct experiment*> to_run;
+  for(size_t i=0; i<NUM_EXPERIMENTS; i++)
+    if((strcmp(exp_name, "all") == 0 && !experiments[i].extra) || strcmp(exp_name, experiments[i].name) == 0)
+      to_run.push_back(&experiments[i]);
+  if(to_run.empty()){
+    printf("Unknown experiment %s\n", exp_name);
+    print_help();
+    exit(1);
+  }
+
+  //Out of the way of the sender and receiver cores (they pin themselves)
+  if(o.cpuid >= 0){
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    CPU_SET(o.cpuid, &mask);
+    if(sched_setaffinity(0, sizeof(mask), &mask) != 0)
+      printf("Warning: Orchestrator could not be pinned to CPU %d\n", o.cpuid);
+  }
+
+  //Keep the shared file mapped (and resident) across runs
+  struct shared_file sf;
+  shared_file_map(&sf, o.file ? o.file : SHARED_READONLY_FILE_PATH);
+
+  printf("Streamline Experiment Orchestrator: %d to %d runs per point, target 95%% CI: bit-rate %.2f%%, bit-error-rate %.2f%%\n\n",
+         o.min_reps, o.max_reps, o.bps_rel_ci, o.ber_ci);
+  double start = now_seconds();
+  for(size_t i=0; i<to_run.size(); i++)
+    run_experiment(&o, to_run[i], &sf);
+  printf("All experiments done in %.1fs\n", now_seconds() - start);
+  return 0;
+}
@@ -0,0 +1,189 @@
+// Copyright (C) 2020, Gururaj Saileshwar
+
+// Commentary:
+// Reed-Solomon outer code over the (72,64) ECC blocks (-O <parity>[,<frame>]).
+//
+// The data words of the blocks are coded in frames of <frame> blocks (default
+// DEFAULT_OUTER_FRAME): byte c of every data word of a frame is a symbol of
+// codeword c, an RS(<frame>, <frame> - <parity>) codeword over GF(2^8) (see
+// fec_rs.hh). The first <frame> - <parity> blocks of a frame carry payload,
+// and the last <parity> ones its parity symbols, so every block carries one
+// symbol of each of the 8 codewords of its frame.
+//
+// The receiver decodes the blocks with SEC-DED first. The blocks in which it
+// detects errors are erasures of the outer code, and the blocks it
+// miscorrects (3 errors or more) errors, so a frame is decoded as long as
+// 2 x miscorrected + detected blocks <= <parity>. The frames start with the
+// payload chunks (see payload.hh), whose blocks they divide; the blocks past
+// the last full frame of the payload carry payload without the outer code.
+//
+// With the interleaver (see interleave.hh), a burst first has to leave two
+// errors in a block before it costs the outer code a symbol. The receiver
+// reports the longest burst of channel bits (every bit in error) that is
+// always decoded, and the rate of the codes.
+
+#ifndef OUTER_CODE_H_
+#define OUTER_CODE_H_
+
+#include <vector>
+
+#include "utils.hh"
+#include "params.hh"
+#include "fec_rs.hh"
+#include "interleave.hh"
+
+// Frame: a power of two dividing the blocks of a payload chunk, and at most 255 symbols
+#define OUTER_MIN_FRAME (16)
+#define OUTER_MAX_FRAME (128)
+
+struct outer_stats {
+  uint64_t frames;
+  uint64_t clean;             //frames whose codewords were all received without errors
+  uint64_t erased_blocks;     //blocks in which SEC-DED detected errors, in the frames
+  uint64_t corrected;         //symbols corrected
+  uint64_t failed;            //codewords that could not be decoded
+};
+
+struct outer_code {
+  struct fec_rs rs;
+  uint64_t frame;             //blocks of a frame (0: off)
+  uint64_t data_blks;         //blocks of a frame that carry payload
+};
+
+static void outer_code_init(struct outer_code* oc, const struct channel_params* p)
+{
+  memset(oc, 0, sizeof(*oc));
+  if(p->outer_parity == 0)
+    return;
+  fec_rs_init(&oc->rs, p->outer_frame, p->outer_parity);
+  oc->frame = p->outer_frame;
+  oc->data_blks = p->outer_frame - p->outer_parity;
+}
+
+/*
+ * True if block b (from the start of a chunk of num_blks blocks) carries
+ * parity symbols.
+ */
+static inline bool outer_is_parity(const struct outer_code* oc, uint64_t b, uint64_t num_blks)
+{
+  return oc->frame && b < num_blks/oc->frame*oc->frame && b%oc->frame >= oc->data_blks;
+}
+
+/*
+ * Fills the parity blocks of the full frames of the num_blks data words of a
+ * chunk.
+ */
+static void outer_encode_blocks(const struct outer_code* oc, uint64_t* data, uint64_t num_blks)
+{
+  for(uint64_t f=0; oc->frame && f + oc->frame <= num_blks; f += oc->frame)
+    fec_rs_encode_words(&oc->rs, &data[f]);
+}
+
+/*
+ * Decodes the full frames of the num_blks data words of a chunk, with the
+ * SEC-DED flags of the blocks (2: errors detected).
+ */
+static void outer_decode_blocks(const struct outer_code* oc, uint64_t* data, const unsigned char* flags,
+                                uint64_t num_blks, struct outer_stats* st)
+{
+  bool erased[OUTER_MAX_FRAME];
+  for(uint64_t f=0; oc->frame && f + oc->frame <= num_blks; f += oc->frame){
+    bool any = false;
+    for(uint64_t b=0; b<oc->frame; b++){
+      erased[b] = (flags[f + b] > 1);
+      any |= erased[b];
+      st->erased_blocks += erased[b];
+    }
+    uint64_t corrected = st->corrected;
+    st->failed += fec_rs_decode_words(&oc->rs, &data[f], any ? erased : NULL, &st->corrected);
+    st->clean += (!any && corrected == st->corrected);
+    st->frames++;
+  }
+}
+
+/*
+ * Rate of the outer code (payload per data bit).
+ */
+static inline double outer_rate(const struct channel_params* p)
+{
+  return p->outer_parity ? 1.0*(p->outer_frame - p->outer_parity)/p->outer_frame : 1.0;
+}
+
+/*
+ * Counts the bit of channel position pos (from the start of a chunk) in or
+ * out (delta) of a burst: hits of its block, cost of its frame to the outer
+ * code (1 for a block with 2 errors, detected, 2 with more, which SEC-DED may
+ * miscorrect), and the frames costing more than nroots.
+ */
+static void outer_burst_count(uint64_t pos, int delta, uint64_t depth, uint64_t frame, int nroots,
+                              std::vector<int>& hits, std::vector<int>& cost, int* over)
+{
+  static const int block_cost[4] = {0, 0, 1, 2};
+  uint64_t b = interleave_block_of(pos, depth);
+  uint64_t f = b/frame;
+  bool was_over = cost[f] > nroots;
+  int before = block_cost[hits[b] < 3 ? hits[b] : 3];
+  hits[b] += delta;
+  cost[f] += block_cost[hits[b] < 3 ? hits[b] : 3] - before;
+  *over += (cost[f] > nroots) - was_over;
+}
+
+/*
+ * True if every burst of len channel bits, wherever it starts, is decoded.
+ */
+static bool outer_burst_decoded(uint64_t len, uint64_t depth, uint64_t frame, int nroots)
+{
+  //The layout repeats every period bits
+  uint64_t period = INTERLEAVE_BLK_BITS*(depth > frame ? depth : frame);
+  uint64_t blocks = (period + len)/INTERLEAVE_BLK_BITS + depth + frame;
+  std::vector<int> hits(blocks, 0), cost(blocks/frame + 1, 0);
+  int over = 0;
+  for(uint64_t pos=0; pos<len; pos++)
+    outer_burst_count(pos, 1, depth, frame, nroots, hits, cost, &over);
+  for(uint64_t start=0; over == 0 && start<period; start++){
+    outer_burst_count(start, -1, depth, frame, nroots, hits, cost, &over);
+    outer_burst_count(start + len, 1, depth, frame, nroots, hits, cost, &over);
+  }
+  return over == 0;
+}
+
+/*
+ * Longest burst of channel bits (every bit in error) that is always decoded,
+ * with the interleaver of depth and the outer code of p: depth bits with
+ * SEC-DED alone (one error per block).
+ */
+static uint64_t outer_burst_tolerance(const struct channel_params* p)
+{
+  uint64_t depth = p->interleave_depth;
+  if(p->outer_parity == 0)
+    return depth;
+  uint64_t frame = p->outer_frame;
+  uint64_t lo = depth, hi = 2*INTERLEAVE_BLK_BITS*(depth > frame ? depth : frame) + 2*depth;
+  while(hi - lo > 1){
+    uint64_t mid = (lo + hi)/2;
+    if(outer_burst_decoded(mid, depth, frame, p->outer_parity))
+      lo = mid;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+static void outer_print(const struct outer_stats* s, const struct channel_params* p)
+{
+  if(p->outer_parity == 0){
+    printf("Interleaver: %llu blocks deep. Burst tolerance: %llu bits.\n", p->interleave_depth, outer_burst_tolerance(p));
+    return;
+  }
+  printf("Outer Code: RS(%llu,%llu) over frames of %llu blocks, interleaved %llu blocks deep. Rate: %.4f (with SEC-DED %.4f)."
+         " Burst tolerance: %llu bits (SEC-DED alone: %llu). Frames: %llu, %llu without errors, %llu blocks erased,"
+         " %llu symbols corrected, %llu of %llu codewords failed.\n", p->outer_frame, p->outer_frame - p->outer_parity,
+         p->outer_frame, p->interleave_depth, outer_rate(p), outer_rate(p)*BITVEC_WORD_BITS/INTERLEAVE_BLK_BITS,
+         outer_burst_tolerance(p), p->interleave_depth, s->frames, s->clean, s->erased_blocks, s->corrected, s->failed,
+         s->frames*FEC_RS_LANES);
+}
+
+#endif
+
+//
+// outer_code.hh ends here
@@ -0,0 +1,421 @@
+// Copyright (C) 2020, Gururaj Saileshwar
+
+// Commentary:
+// Runtime channel parameters (shared-array size, synchronization period, fixed
+// or adaptive, access lag, synchronization mode, Rx sync timeout, barrier, pilots, heartbeat, training bits,
+// ECC, payload type and access pattern), and dispatch of the per-bit loops to instances specialized for them.
+//
+// The sender and receiver loops are templates over the parameters they use on
+// every bit. Each sync period of the sensitivity studies (with the default lag
+// and heartbeat) has its own instance, where these parameters are constants
+// exactly as in the former per-experiment builds. The size of the lane's
+// region stays a runtime value in every instance: it is sized from the LLC
+// found at startup (see host.hh), and only bounds the address schedule. Any
+// other combination runs the generic instance (kSpecialized false, the other
+// template arguments 0), which reads them at runtime. So does an access lag of
+// several taps, or of a subsample of the bits (-g, see parse_lag_taps), the
+// pilots (-P) and the adaptive sync period (-D).
+//
+// The former compile-time flags (-DARRAYSZ_PER_CACHESZ, -DSYNC_FREQ_SENSITIVITY,
+// -DECC, -DCONSTANT_PAYLOAD_0/1) still work, and set the defaults.
+
+#ifndef PARAMS_H_
+#define PARAMS_H_
+
+#include "utils.hh"
+
+#define PAYLOAD_RANDOM     (0)
+#define PAYLOAD_CONSTANT_0 (1)
+#define PAYLOAD_CONSTANT_1 (2)
+
+// Channel-encoding (whitening) keystream generators (see channel_keystream in payload.hh)
+#define SCRAMBLER_MT       (0)
+#define SCRAMBLER_LFSR     (1)
+
+// Access patterns: order of the cache lines of the shared array accessed by the bits (see addr_schedule.hh)
+#define PATTERN_STREAMLINE (1)
+#define PATTERN_STRIDE     (2)
+#define PATTERN_PERMUTED   (3)
+#define PATTERN_BALANCED   (4)
+#define NUM_PATTERNS       (5)
+static const char* pattern_names[NUM_PATTERNS] = {"", "streamline", "stride", "permuted", "balanced"};
+
+// Synchronization every sync period: Flush+Reload barrier (see fr_barrier.hh), or TSC deadlines (see epoch_schedule.hh)
+#define SYNC_BARRIER       (1)
+#define SYNC_DEADLINE      (2)
+#define NUM_SYNC_MODES     (3)
+static const char* sync_mode_names[NUM_SYNC_MODES] = {"", "barrier", "deadline"};
+
+// Defaults
+#ifndef ARRAYSZ_PER_CACHESZ
+#define DEFAULT_ARRAYSZ_PER_CACHESZ (8)
+#else
+#define DEFAULT_ARRAYSZ_PER_CACHESZ (ARRAYSZ_PER_CACHESZ)
+#endif
+#ifndef SYNC_FREQ_SENSITIVITY
+#define DEFAULT_SYNC_BITFREQ (200000)
+#else
+#define DEFAULT_SYNC_BITFREQ (SYNC_FREQ_SENSITIVITY)
+#endif
+#define DEFAULT_ACCESS_LAG_DELTA (5000)
+// Repeats (taps) of every access, at lags behind it (see parse_lag_taps)
+#define MAX_LAG_TAPS (4)
+#define DEFAULT_RX_SYNC_TIMEOUT (5*100*5000)
+// Flush+Reload barrier: voting lines, and poll interval (cycles, see fr_barrier.hh)
+#define DEFAULT_SYNC_LINES (3)
+#define DEFAULT_SYNC_POLL_MIN (64)
+#define DEFAULT_SYNC_POLL_MAX (1000)
+#define DEFAULT_SYNC_MODE (SYNC_BARRIER)
+// TSC-deadline epochs: cycles per bit of the epoch period, and guard of Rx after the deadlines
+#define DEFAULT_EPOCH_BIT_CYCLES (250)
+#define DEFAULT_EPOCH_GUARD (1000)
+// Pilots: bits between pilots (0: off, see pilot.hh)
+#define DEFAULT_PILOT_PERIOD (0)
+// Adaptive sync period: longest period (bits, 0: off), and target training errors (%, see sync_adapt.hh)
+#define DEFAULT_SYNC_ADAPT_MAX (0)
+#define DEFAULT_SYNC_ADAPT_TARGET (2.0)
+#define DEFAULT_HEARTBEAT_FREQ (1000)
+#define DEFAULT_TRAIN_BITS (64)
+#define DEFAULT_PATTERN (PATTERN_STREAMLINE)
+#ifdef ECC
+#define DEFAULT_ECC (true)
+#else
+#define DEFAULT_ECC (false)
+#endif
+// Soft-decision decoding: least reliable bits flipped per ECC block (0: off, see soft_decode.hh)
+#define DEFAULT_CHASE_FLIPS (0)
+// Interleaver depth (ECC blocks, 1: off, see interleave.hh), and outer code: parity blocks (0: off) of a frame (see outer_code.hh)
+#define DEFAULT_INTERLEAVE_DEPTH (1)
+#define DEFAULT_OUTER_PARITY (0)
+#define DEFAULT_OUTER_FRAME (128)
+// Erasure code across sync epochs: repair epochs (0: off) of a group (see epoch_code.hh)
+#define DEFAULT_EPOCH_REPAIR (0)
+#define DEFAULT_EPOCH_GROUP (16)
+#if defined(CONSTANT_PAYLOAD_0)
+#define DEFAULT_PAYLOAD_TYPE (PAYLOAD_CONSTANT_0)
+#elif defined(CONSTANT_PAYLOAD_1)
+#define DEFAULT_PAYLOAD_TYPE (PAYLOAD_CONSTANT_1)
+#else
+#define DEFAULT_PAYLOAD_TYPE (PAYLOAD_RANDOM)
+#endif
+
+// Gap between Tx and Rx at synchronization (the sync period has to be longer)
+#define TX_SYNC_LAG_DELTA (5000)
+
+struct channel_params {
+  uint64_t arraysz_per_cachesz;   //shared-array size, in multiples of the LLC size
+  uint64_t array_numentries;
+  uint64_t sync_bitfreq;          //bits between synchronizations
+  uint64_t sync_adapt_max;        //adaptive: longest period between synchronizations (bits, 0: off)
+  double sync_adapt_target;       //adaptive: training errors (%) up to which the period grows
+  uint64_t lag_delta;             //bits between an access and its repeat (the first tap)
+  int num_lag_taps;               //repeats of every access
+  uint64_t lag_taps[MAX_LAG_TAPS];  //bits between an access and each repeat (lag_taps[0] == lag_delta)
+  uint64_t lag_every[MAX_LAG_TAPS]; //each repeat is of 1 in lag_every bits (a power of two)
+  uint64_t rx_sync_timeout;       //cycles after which Rx exits sync
+  int sync_lines;                 //voting lines of the barrier
+  uint64_t sync_poll_min, sync_poll_max; //poll interval of the barrier (cycles)
+  int sync_mode;                  //barrier or deadline
+  uint64_t epoch_bit_cycles;      //deadline: epoch period, per bit of the sync period (cycles)
+  uint64_t epoch_guard;           //deadline: release of Rx after the start of an epoch (cycles)
+  uint64_t pilot_period;          //bits between pilots (0: off)
+  uint64_t heartbeat_freq;        //bits between heartbeats
+  uint64_t train_bits;            //training bits at the start of every sync epoch (0: fixed threshold)
+  bool ecc;
+  int chase_flips;                //ECC: least reliable bits flipped per block by the soft decoding (0: hard decoding)
+  uint64_t interleave_depth;      //ECC: blocks interleaved (1: off)
+  uint64_t outer_parity;          //ECC: parity blocks of the outer code per frame (0: off)
+  uint64_t outer_frame;           //ECC: blocks of a frame of the outer code
+  uint64_t epoch_repair;          //repair epochs of a group of the erasure code across epochs (0: off)
+  uint64_t epoch_group;           //sync epochs of a group of the erasure code
+  int payload_type;
+  int scrambler;                  //generator of the whitening keystream
+  int pattern;                    //access pattern
+  uint64_t pattern_stride;        //lines between accesses to a page (0: default of the pattern)
+  uint64_t pattern_pages;         //pages accessed in turn (0: default of the pattern)
+};
+
+static void channel_params_init(struct channel_params* p)
+{
+  p->arraysz_per_cachesz = DEFAULT_ARRAYSZ_PER_CACHESZ;
+  p->array_numentries = ARRAYSZ_2_NUMENTRIES(p->arraysz_per_cachesz);
+  p->sync_bitfreq = DEFAULT_SYNC_BITFREQ;
+  p->sync_adapt_max = DEFAULT_SYNC_ADAPT_MAX;
+  p->sync_adapt_target = DEFAULT_SYNC_ADAPT_TARGET;
+  p->lag_delta = DEFAULT_ACCESS_LAG_DELTA;
+  p->num_lag_taps = 1;
+  p->lag_taps[0] = DEFAULT_ACCESS_LAG_DELTA;
+  p->lag_every[0] = 1;
+  p->rx_sync_timeout = DEFAULT_RX_SYNC_TIMEOUT;
+  p->sync_lines = DEFAULT_SYNC_LINES;
+  p->sync_poll_min = DEFAULT_SYNC_POLL_MIN;
+  p->sync_poll_max = DEFAULT_SYNC_POLL_MAX;
+  p->sync_mode = DEFAULT_SYNC_MODE;
+  p->epoch_bit_cycles = DEFAULT_EPOCH_BIT_CYCLES;
+  p->epoch_guard = DEFAULT_EPOCH_GUARD;
+  p->pilot_period = DEFAULT_PILOT_PERIOD;
+  p->heartbeat_freq = DEFAULT_HEARTBEAT_FREQ;
+  p->train_bits = DEFAULT_TRAIN_BITS;
+  p->ecc = DEFAULT_ECC;
+  p->chase_flips = DEFAULT_CHASE_FLIPS;
+  p->interleave_depth = DEFAULT_INTERLEAVE_DEPTH;
+  p->outer_parity = DEFAULT_OUTER_PARITY;
+  p->outer_frame = DEFAULT_OUTER_FRAME;
+  p->epoch_repair = DEFAULT_EPOCH_REPAIR;
+  p->epoch_group = DEFAULT_EPOCH_GROUP;
+  p->payload_type = DEFAULT_PAYLOAD_TYPE;
+  p->scrambler = SCRAMBLER_MT;
+  p->pattern = DEFAULT_PATTERN;
+  p->pattern_stride = 0;
+  p->pattern_pages = 0;
+}
+
+static const char* payload_type_name(int payload_type)
+{
+  switch(payload_type){
+  case PAYLOAD_CONSTANT_0: return "Constant-0 Payload";
+  case PAYLOAD_CONSTANT_1: return "Constant-1 Payload";
+  default:                 return "Random Payload";
+  }
+}
+
+/*
+ * Parses an access pattern "<name or number>[,<stride>,<pages>]" (0: the
+ * pattern's default, see addr_pattern_resolve). Returns false if the name is unknown.
+ */
+static bool parse_pattern(const char* arg, struct channel_params* p)
+{
+  char name[32] = "";
+  unsigned long long stride = 0, pages = 0;
+  sscanf(arg, "%31[^,],%llu,%llu", name, &stride, &pages);
+  int pattern = 0;
+  for(int i=1; i<NUM_PATTERNS; i++)
+    if(strcmp(name, pattern_names[i]) == 0 || atoi(name) == i)
+      pattern = i;
+  if(pattern == 0)
+    return false;
+  p->pattern = pattern;
+  p->pattern_stride = stride;
+  p->pattern_pages = pages;
+  return true;
+}
+
+/*
+ * Parses a synchronization mode "<name or number>[,<cycles per bit>,<guard>]"
+ * (deadline; 0 or left out: the default). Returns false if the name is unknown.
+ */
+static bool parse_sync_mode(const char* arg, struct channel_params* p)
+{
+  char name[32] = "";
+  unsigned long long bit_cycles = 0, guard = 0;
+  int fields = sscanf(arg, "%31[^,],%llu,%llu", name, &bit_cycles, &guard);
+  int mode = 0;
+  for(int i=1; i<NUM_SYNC_MODES; i++)
+    if(strcmp(name, sync_mode_names[i]) == 0 || atoi(name) == i)
+      mode = i;
+  if(mode == 0)
+    return false;
+  p->sync_mode = mode;
+  if(bit_cycles)
+    p->epoch_bit_cycles = bit_cycles;
+  if(fields == 3)
+    p->epoch_guard = guard;
+  return true;
+}
+
+/*
+ * Parses an adaptive sync period "<max period>[,<target error %>]" (0: off).
+ * Returns false, leaving p unchanged, if invalid.
+ */
+static bool parse_sync_adapt(const char* arg, struct channel_params* p)
+{
+  unsigned long long max_period = 0;
+  double target = p->sync_adapt_target;
+  if(sscanf(arg, "%llu,%lf", &max_period, &target) < 1 || target <= 0)
+    return false;
+  p->sync_adapt_max = max_period;
+  p->sync_adapt_target = target;
+  return true;
+}
+
+/*
+ * Parses the sync barrier "<voting lines>[,<poll min>,<poll max>]" (cycles).
+ * Returns false, leaving p unchanged, if invalid.
+ */
+static bool parse_sync_lines(const char* arg, struct channel_params* p)
+{
+  int lines = 0, end = 0;
+  unsigned long long poll_min = p->sync_poll_min, poll_max = p->sync_poll_max;
+  int fields = sscanf(arg, "%d%n,%llu,%llu%n", &lines, &end, &poll_min, &poll_max, &end);
+  if((fields != 1 && fields != 3) || arg[end] != '\0')
+    return false;
+  p->sync_lines = lines;
+  p->sync_poll_min = poll_min;
+  p->sync_poll_max = poll_max;
+  return true;
+}
+
+/*
+ * Parses an outer code "<parity blocks>[,<frame blocks>]" (0: off). Returns
+ * false, leaving p unchanged, if invalid.
+ */
+static bool parse_outer_code(const char* arg, struct channel_params* p)
+{
+  unsigned long long parity = 0, frame = p->outer_frame;
+  if(sscanf(arg, "%llu,%llu", &parity, &frame) < 1)
+    return false;
+  p->outer_parity = parity;
+  p->outer_frame = frame;
+  return true;
+}
+
+/*
+ * Parses an erasure code across epochs "<repair epochs>[,<group epochs>]" (0:
+ * off). Returns false, leaving p unchanged, if invalid.
+ */
+static bool parse_epoch_code(const char* arg, struct channel_params* p)
+{
+  unsigned long long repair = 0, group = p->epoch_group;
+  if(sscanf(arg, "%llu,%llu", &repair, &group) < 1)
+    return false;
+  p->epoch_repair = repair;
+  p->epoch_group = group;
+  return true;
+}
+
+/*
+ * Parses the lag taps "<lag>[/<every>][,<lag>[/<every>]...]": each access
+ * is repeated <lag> bits later, for 1 in <every> bits (default 1, a power of
+ * two). Returns false, leaving p unchanged, if invalid.
+ */
+static bool parse_lag_taps(const char* arg, struct channel_params* p)
+{
+  uint64_t taps[MAX_LAG_TAPS], every[MAX_LAG_TAPS];
+  int n = 0;
+  const char* s = arg;
+  while(*s){
+    char* end;
+    if(n == MAX_LAG_TAPS)
+      return false;
+    taps[n] = strtoull(s, &end, 10);
+    every[n] = 1;
+    if(*end == '/')
+      every[n] = strtoull(end + 1, &end, 10);
+    if(end == s || taps[n] == 0 || every[n] == 0 || (every[n] & (every[n] - 1)) || (*end && *end != ','))
+      return false;
+    n++;
+    s = (*end == ',') ? end + 1 : end;
+  }
+  if(n == 0)
+    return false;
+  p->num_lag_taps = n;
+  for(int t=0; t<n; t++){
+    p->lag_taps[t] = taps[t];
+    p->lag_every[t] = every[t];
+  }
+  p->lag_delta = taps[0];
+  return true;
+}
+
+/*
+ * Formats the lag taps as parse_lag_taps reads them.
+ */
+static void format_lag_taps(const struct channel_params* p, char* buf, size_t len)
+{
+  size_t pos = 0;
+  buf[0] = '\0';
+  for(int t=0; t<p->num_lag_taps && pos < len; t++){
+    pos += snprintf(buf + pos, len - pos, "%s%llu", t ? "," : "", p->lag_taps[t]);
+    if(p->lag_every[t] != 1 && pos < len)
+      pos += snprintf(buf + pos, len - pos, "/%llu", p->lag_every[t]);
+  }
+}
+
+/*
+ * Largest lag of the taps.
+ */
+static uint64_t max_lag_tap(const struct channel_params* p)
+{
+  uint64_t lag = 0;
+  for(int t=0; t<p->num_lag_taps; t++)
+    if(p->lag_taps[t] > lag)
+      lag = p->lag_taps[t];
+  return lag;
+}
+
+static void print_channel_params(const struct channel_params* p)
+{
+  char taps[128], sync[128], pilots[32], period[96], ecc[128], payload[64];
+  format_lag_taps(p, taps, sizeof(taps));
+  snprintf(payload, sizeof(payload), "%s%s", payload_type_name(p->payload_type),
+           p->scrambler == SCRAMBLER_LFSR ? " (LFSR whitening)" : "");
+  if(p->pilot_period)
+    snprintf(pilots, sizeof(pilots), "every %llu bits", p->pilot_period);
+  else
+    snprintf(pilots, sizeof(pilots), "off");
+  if(p->sync_adapt_max)
+    snprintf(period, sizeof(period), "%llu-%llu bits (adaptive, %.2f%% errors)", p->sync_bitfreq, p->sync_adapt_max,
+             p->sync_adapt_target);
+  else
+    snprintf(period, sizeof(period), "%llu bits", p->sync_bitfreq);
+  if(p->epoch_repair)
+    snprintf(period + strlen(period), sizeof(period) - strlen(period), " (RS(%llu,%llu) across epochs)",
+             p->epoch_group, p->epoch_group - p->epoch_repair);
+  snprintf(ecc, sizeof(ecc), "%s", p->ecc ? "on" : "off");
+  if(p->ecc && p->chase_flips)
+    snprintf(ecc + strlen(ecc), sizeof(ecc) - strlen(ecc), " (soft, %d flips)", p->chase_flips);
+  if(p->ecc && p->interleave_depth > 1)
+    snprintf(ecc + strlen(ecc), sizeof(ecc) - strlen(ecc), " (interleaved %llu blocks)", p->interleave_depth);
+  if(p->ecc && p->outer_parity)
+    snprintf(ecc + strlen(ecc), sizeof(ecc) - strlen(ecc), " (RS(%llu,%llu) outer code)", p->outer_frame,
+             p->outer_frame - p->outer_parity);
+  if(p->sync_mode == SYNC_DEADLINE)
+    snprintf(sync, sizeof(sync), "deadline (%llu cycles/bit, guard %llu cycles)", p->epoch_bit_cycles, p->epoch_guard);
+  else
+    snprintf(sync, sizeof(sync), "barrier");
+  printf("Parameters: Array-Size:%llux LLC, Sync-Period:%s, Sync:%s, Access-Lag:%s bits,"
+         " Rx-Sync-Timeout:%llu cycles, Barrier:%d lines (poll %llu-%llu cycles), Pilots:%s, Heartbeat:%llu bits, Training:%llu bits/epoch, ECC:%s, %s,"
+         " Pattern:%s (stride %llu, %llu pages).\n",
+         p->arraysz_per_cachesz, period, sync, taps,
+         p->rx_sync_timeout, p->sync_lines, p->sync_poll_min, p->sync_poll_max, pilots, p->heartbeat_freq, p->train_bits, ecc,
+         payload, pattern_names[p->pattern], p->pattern_stride, p->pattern_pages);
+}
+
+/*
+ * Parameter of a loop instance: the template argument k of a specialized
+ * instance, or the runtime value rt in the generic one (k == 0). The condition
+ * is a constant, so a specialized instance only sees k, even at -O0.
+ */
+#define LOOP_PARAM(k, rt) ((k) ? (k) : (rt))
+
+// Specialized instances: sync periods, with the default access lag (a single
+// tap) and heartbeat, without pilots and adaptive sync period.
+#define LOOP_SPECIALIZATIONS(X)                                         \
+  X(DEFAULT_SYNC_BITFREQ)                                               \
+  X(25000) X(50000) X(100000) X(200000) X(500000)
+
+template<typename Fn>
+struct loop_instance {
+  uint64_t sync_bitfreq;
+  Fn fn;
+};
+
+/*
+ * Loop instance specialized for the parameters p, or the generic one.
+ */
+template<typename Fn, size_t N>
+static Fn loop_select(const struct loop_instance<Fn> (&instances)[N], Fn generic, const struct channel_params* p)
+{
+  if(p->lag_delta != DEFAULT_ACCESS_LAG_DELTA || p->num_lag_taps != 1 || p->lag_every[0] != 1 ||
+     p->heartbeat_freq != DEFAULT_HEARTBEAT_FREQ || p->pilot_period || p->sync_adapt_max)
+    return generic;
+  for(size_t i=0; i<N; i++)
+    if(instances[i].sync_bitfreq == p->sync_bitfreq)
+      return instances[i].fn;
+  return generic;
+}
+
+#endif
+
+//
+// params.hh ends here
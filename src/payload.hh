@@ -0,0 +1,283 @@
+// Copyright (C) 2020, Gururaj Saileshwar
+
+// Commentary:
+// Payload construction shared by the sender and receiver: payload bits,
+// (72,64) ECC framing and channel encoding (whitening), all on packed bits.
+// With the erasure code across epochs (see epoch_code.hh), the repair epochs
+// then take the place of the channel bits of their epochs.
+//
+
+#ifndef PAYLOAD_H_
+#define PAYLOAD_H_
+
+#include "utils.hh"
+#include "params.hh"
+#include "bitvec.hh"
+#include "interleave.hh"
+#include "outer_code.hh"
+#include "epoch_code.hh"
+
+// Error-Correction Parameters: (72,64) Hamming Code
+#define DATABLK_BITLEN (64)
+#define PARITY_BITLEN (8)
+#define ECCBLK_BITLEN (DATABLK_BITLEN+PARITY_BITLEN)
+
+// Unit of payload generation: whole number of words, of 64-bit packets and of 72-bit ECC packets.
+#define PAYLOAD_CHUNK_BITS ((uint64_t)(BITVEC_WORD_BITS*ECCBLK_BITLEN*8))
+
+/*
+ * Channel-encoding (whitening) keystream. The scrambler is re-seeded at the start of
+ * every synchronization epoch, so the keystream repeats every sync_bitfreq bits: it is
+ * generated once, for one epoch, and applied to the payload with word-wide XORs.
+ *
+ * By default (-w mt) the keystream is the original one (one uniform_int<int>(0,1) draw
+ * from a Mersenne Twister seeded with 42 per bit). With -w lfsr, it is a xorshift64
+ * LFSR producing 64 bits per step instead (sender and receiver must agree).
+ */
+#define SCRAMBLER_SEED (42)
+
+struct channel_keystream {
+  struct bitvec bits;   //one epoch, followed by its first 64 bits again
+  uint64_t period;      //sync_bitfreq
+};
+
+static void channel_keystream_init(struct channel_keystream* ks, uint64_t sync_bitfreq, int scrambler)
+{
+  ks->period = sync_bitfreq;
+  bitvec_alloc(&ks->bits, sync_bitfreq + BITVEC_WORD_BITS);
+
+  if(scrambler == SCRAMBLER_LFSR){
+    uint64_t state = SCRAMBLER_SEED;
+    for(uint64_t w=0; w*BITVEC_WORD_BITS < sync_bitfreq; w++){
+      state ^= state << 13;
+      state ^= state >> 7;
+      state ^= state << 17;
+      ks->bits.words[w] = state;
+    }
+    //Bits past the epoch are overwritten below.
+  } else {
+    std::tr1::mt19937 mt(SCRAMBLER_SEED); //Mersenne Twister PRNG engine
+    std::tr1::uniform_int<int> channel_enc(0, 1); //uniform distribution [0,1]
+    uint64_t word = 0;
+    for(uint64_t i=0; i<sync_bitfreq; i++){
+      word = (word << 1) | (uint64_t)channel_enc(mt);
+      if(i % BITVEC_WORD_BITS == BITVEC_WORD_BITS-1){
+        ks->bits.words[i/BITVEC_WORD_BITS] = word;
+        word = 0;
+      }
+    }
+    if(sync_bitfreq % BITVEC_WORD_BITS)
+      ks->bits.words[sync_bitfreq/BITVEC_WORD_BITS] = word << (BITVEC_WORD_BITS - sync_bitfreq % BITVEC_WORD_BITS);
+  }
+
+  //Wrap-around: the epoch's first word again, so that any 64 bits can be read at once.
+  bitvec_set_bits(&ks->bits, sync_bitfreq, BITVEC_WORD_BITS, ks->bits.words[0]);
+}
+
+static void channel_keystream_free(struct channel_keystream* ks)
+{
+  bitvec_free(&ks->bits);
+}
+
+/*
+ * Returns n (1..64) keystream bits for the channel bits starting at bit_id.
+ */
+inline __attribute__((always_inline))
+uint64_t channel_keystream_bits(const struct channel_keystream* ks, uint64_t bit_id, unsigned int n)
+{
+  return bitvec_get_bits(&ks->bits, bit_id % ks->period, n);
+}
+
+/*
+ * Generator for the channel bits of the payload (payload bits, parity bits
+ * with ECC, then channel encoding), producing the stream in consecutive chunks
+ * so that it never has to be held in memory in full.
+ *
+ * Payload bits use a private random_r() state seeded like srand(42), so the
+ * stream matches the original rand()-based payload bit for bit.
+ */
+struct payload_gen {
+  uint64_t sync_bitfreq;
+  bool ecc;
+  int payload_type;
+  uint64_t bit_id;            //next channel bit to be generated
+  struct random_data rand_state;
+  char rand_statebuf[128];
+  struct channel_keystream ks;
+  uint64_t interleave_depth;
+  struct outer_code outer;
+  struct bitvec blocks;       //a chunk of blocks before the interleaving (depth > 1)
+  struct epoch_code epochs;
+  struct bitvec group_bits;   //channel bits of the current group of the erasure code
+  uint64_t encoded_groups;    //groups whose repair epochs are computed
+};
+
+static void payload_gen_init(struct payload_gen* gen, const struct channel_params* p, uint64_t transmitted_bits)
+{
+  gen->sync_bitfreq = p->sync_bitfreq;
+  gen->ecc = p->ecc;
+  gen->payload_type = p->payload_type;
+  gen->bit_id = 0;
+  memset(&gen->rand_state, 0, sizeof(gen->rand_state));
+  initstate_r(42, gen->rand_statebuf, sizeof(gen->rand_statebuf), &gen->rand_state);
+  channel_keystream_init(&gen->ks, p->sync_bitfreq, p->scrambler);
+  gen->interleave_depth = p->ecc ? p->interleave_depth : 1;
+  outer_code_init(&gen->outer, p);
+  memset(&gen->blocks, 0, sizeof(gen->blocks));
+  if(gen->interleave_depth > 1)
+    bitvec_alloc(&gen->blocks, PAYLOAD_CHUNK_BITS);
+  epoch_code_init(&gen->epochs, p, transmitted_bits);
+  memset(&gen->group_bits, 0, sizeof(gen->group_bits));
+  if(gen->epochs.groups)
+    bitvec_alloc(&gen->group_bits, epoch_code_group_bits(&gen->epochs));
+  gen->encoded_groups = 0;
+}
+
+static void payload_gen_free(struct payload_gen* gen)
+{
+  channel_keystream_free(&gen->ks);
+  if(gen->interleave_depth > 1)
+    bitvec_free(&gen->blocks);
+  if(gen->epochs.groups)
+    bitvec_free(&gen->group_bits);
+  epoch_code_free(&gen->epochs);
+}
+
+/*
+ * Erasure code across epochs: keeps the num_bits channel bits at out_pos of
+ * out (from bit chunk_start of the stream) that fall in the payload epochs of
+ * a group, and replaces those in its repair epochs, computed once the payload
+ * epochs are all kept.
+ */
+static void payload_gen_epochs(struct payload_gen* gen, struct bitvec* out, uint64_t out_pos, uint64_t chunk_start,
+                               uint64_t num_bits)
+{
+  struct epoch_code* ec = &gen->epochs;
+  uint64_t group_bits = epoch_code_group_bits(ec);
+  uint64_t data_bits = ec->data*ec->epoch_bits;
+  for(uint64_t pos = chunk_start; pos < chunk_start + num_bits; ){
+    uint64_t g = pos/group_bits;
+    if(g >= ec->groups)
+      break;
+    uint64_t rel = pos - g*group_bits;
+    uint64_t end = (rel < data_bits) ? data_bits : group_bits;
+    uint64_t len = end - rel;
+    if(len > chunk_start + num_bits - pos)
+      len = chunk_start + num_bits - pos;
+    if(rel < data_bits){
+      bitvec_copy_bits(&gen->group_bits, rel, out, out_pos + pos - chunk_start, len);
+    } else {
+      if(gen->encoded_groups == g){
+        epoch_code_load(ec, &gen->group_bits);
+        epoch_code_encode(ec);
+        for(uint64_t r=0; r<ec->repair; r++)
+          epoch_code_store(ec, &gen->group_bits, ec->data + r);
+        gen->encoded_groups++;
+      }
+      bitvec_copy_bits(out, out_pos + pos - chunk_start, &gen->group_bits, rel, len);
+    }
+    pos += len;
+  }
+}
+
+inline int payload_gen_bit(struct payload_gen* gen)
+{
+  switch(gen->payload_type){
+  case PAYLOAD_CONSTANT_0:
+    return 0;
+  case PAYLOAD_CONSTANT_1:
+    return 1;
+  default: {
+    //random payload:
+    int32_t r;
+    random_r(&gen->rand_state, &r);
+    return r%2;
+  }
+  }
+}
+
+/*
+ * Generates the next num_bits (at most PAYLOAD_CHUNK_BITS) channel bits into out,
+ * starting at bit out_pos (a multiple of 64) of out.
+ * Chunks other than the last must be a multiple of 64 bits and of the ECC block length.
+ * With ECC, every 72-bit block is laid out as 8 parity bits followed by the 64 data bits;
+ * a trailing partial block is sent without parity. The data words of the parity blocks of
+ * the outer code (see outer_code.hh) carry its parity instead of payload bits, and the
+ * blocks are then interleaved (see interleave.hh), before the channel encoding.
+ */
+static void payload_gen_chunk(struct payload_gen* gen, struct bitvec* out, uint64_t out_pos, uint64_t num_bits)
+{
+  uint64_t pos = out_pos;
+  uint64_t end = out_pos + num_bits;
+  if(gen->ecc){
+    //Full blocks: generate the 64-bit data words, then encode them in one batch.
+    uint64_t data[PAYLOAD_CHUNK_BITS/ECCBLK_BITLEN];
+    uint8_t parity[PAYLOAD_CHUNK_BITS/ECCBLK_BITLEN];
+    unsigned int num_blks = num_bits/ECCBLK_BITLEN;
+    assert(num_blks <= PAYLOAD_CHUNK_BITS/ECCBLK_BITLEN);
+    for(unsigned int b=0; b<num_blks; b++){
+      data[b] = 0;
+      if(outer_is_parity(&gen->outer, b, num_blks))
+        continue;
+      for(int j=0; j<DATABLK_BITLEN; j++)
+        data[b] = (data[b] << 1) | (uint64_t)payload_gen_bit(gen);
+    }
+    outer_encode_blocks(&gen->outer, data, num_blks);
+    fec_secded7264_encode_words(num_blks, data, parity);
+
+    //parity byte, then data bits
+    struct bitvec* blocks = (gen->interleave_depth > 1) ? &gen->blocks : out;
+    uint64_t blk_pos = (gen->interleave_depth > 1) ? 0 : pos;
+    for(unsigned int b=0; b<num_blks; b++){
+      bitvec_set_bits(blocks, blk_pos, PARITY_BITLEN, parity[b]);
+      bitvec_set_bits(blocks, blk_pos+PARITY_BITLEN, DATABLK_BITLEN, data[b]);
+      blk_pos += ECCBLK_BITLEN;
+    }
+    if(gen->interleave_depth > 1)
+      interleave_blocks(&gen->blocks, 0, out, pos, num_blks, gen->interleave_depth);
+    pos += num_blks*ECCBLK_BITLEN;
+  }
+  while(pos < end){
+    uint64_t remaining = end - pos;
+    unsigned int len = remaining < DATABLK_BITLEN ? remaining : DATABLK_BITLEN;
+    uint64_t data = 0;
+    for(unsigned int j=0; j<len; j++)
+      data = (data << 1) | (uint64_t)payload_gen_bit(gen);
+    bitvec_set_bits(out, pos, len, data);
+    pos += len;
+  }
+
+  //Modulate Payload with Channel Encoding, one word at a time.
+  for(uint64_t w=0; w*BITVEC_WORD_BITS < num_bits; w++){
+    unsigned int len = BITVEC_WORD_BITS;
+    if(num_bits - w*BITVEC_WORD_BITS < BITVEC_WORD_BITS)
+      len = num_bits - w*BITVEC_WORD_BITS;
+
+    uint64_t ks = channel_keystream_bits(&gen->ks, gen->bit_id, len);
+    out->words[out_pos/BITVEC_WORD_BITS + w] ^= ks << (BITVEC_WORD_BITS - len);
+    gen->bit_id += len;
+  }
+  if(gen->epochs.groups)
+    payload_gen_epochs(gen, out, out_pos, gen->bit_id - num_bits, num_bits);
+}
+
+/*
+ * Creates the complete (channel-encoded) payload of transmitted_bits.
+ */
+static void create_tx_payload(struct bitvec* tx_payload, uint64_t transmitted_bits, const struct channel_params* p)
+{
+  struct payload_gen gen;
+  payload_gen_init(&gen, p, transmitted_bits);
+  for(uint64_t pos=0; pos < transmitted_bits; pos += PAYLOAD_CHUNK_BITS){
+    uint64_t num_bits = transmitted_bits - pos;
+    if(num_bits > PAYLOAD_CHUNK_BITS)
+      num_bits = PAYLOAD_CHUNK_BITS;
+    payload_gen_chunk(&gen, tx_payload, pos, num_bits);
+  }
+  payload_gen_free(&gen);
+}
+
+#endif
+
+//
+// payload.hh ends here
@@ -0,0 +1,237 @@
+// Copyright (C) 2020, Gururaj Saileshwar
+
+// Commentary:
+// Pilots: recovery of the receiver from slips within a sync epoch (-P <bits>).
+//
+// A bit is carried by its line of the shared array, not by its time, so the
+// receiver cannot lose count of the bits. It can run ahead of the sender,
+// though: after it left a barrier on the Rx sync timeout (the sender was
+// preempted, or slower), or whenever it catches up with a slower sender. It
+// then reads lines before the sender has accessed them, and, without the
+// pilots, every later bit of the epoch is an error.
+//
+// Every <period> bits (a power of two), at the end of a span of bits, the
+// sender loads a pilot marker: one of PILOT_MARKERS lines of the lane's sync
+// pages, not used by the barrier, in turn. It also reloads the markers of its
+// last PILOT_WINDOW spans, so that they stay in the LLC (and come back after
+// the receiver flushed them) until the receiver, some 5000 bits behind, gets
+// there, also while it waits at its barrier. At the end of the same span, the receiver reloads (timed) and
+// flushes the marker:
+// - a hit: the sender has passed the span, so its bits were there to be read.
+// - a miss: the receiver polls the marker until it hits, and probes the
+//   marker of the next span. If it hits too, the sender was ahead already,
+//   and the marker had been evicted from the LLC in between the sender's
+//   reloads (a lost marker). Otherwise, it is a slip: the receiver was ahead
+//   of the sender. It marks the bits of the span as erasures, and polls the
+//   markers of the next PILOT_REALIGN_LEAD spans until the sender has passed
+//   them, and so goes on that many spans behind it. If its last barrier
+//   timed out, the sender is still waiting at that barrier, so the receiver
+//   keeps signaling its ready lines there. It gives up after the Rx sync
+//   timeout, or the time the sender takes for these spans at the slowest
+//   (PILOT_TIMEOUT_BIT_CYCLES per bit), if longer.
+// A slip costs a span of erased bits, instead of the rest of the epoch.
+//
+// The markers are reused every PILOT_MARKERS spans: those of the window behind
+// the sender hit, the others (ahead of it) miss. The receiver has to stay
+// within the window behind the sender, so the period is at least
+// PILOT_MIN_PERIOD. The receiver hands the latencies of a span to the decoder
+// only after its pilot, so that the erasures can still be marked.
+
+#ifndef PILOT_H_
+#define PILOT_H_
+
+#include "utils.hh"
+#include "params.hh"
+#include "fr_barrier.hh"
+
+// Markers: 8 lines on each of the 6 sync pages of the lane, between the barrier's lines
+#define PILOT_MARKERS (48)
+#define PILOT_MARKER_OFFSET (256)
+#define PILOT_MARKER_STRIDE (512)
+// Spans behind the sender whose markers it keeps loaded (the rest of the markers are ahead of it)
+#define PILOT_WINDOW (PILOT_MARKERS/2)
+// The window covers the usual lag of the receiver (TX_SYNC_LAG_DELTA bits, and what Tx gains in an epoch)
+#define PILOT_MIN_PERIOD (1024)
+// A span fits in half of the decoder's latency ring (see rx_decoder.hh)
+#define PILOT_MAX_PERIOD (1 << 16)
+// Spans the receiver falls back behind the sender after a slip
+#define PILOT_REALIGN_LEAD (2)
+// Poll interval (cycles) while waiting for the sender
+#define PILOT_POLL_CYCLES (200)
+// Bit period of the sender at the slowest (cycles), for the timeout of a re-alignment
+#define PILOT_TIMEOUT_BIT_CYCLES (1000)
+
+struct pilot_stats {
+  uint64_t pilots;            //checked by the receiver
+  uint64_t slips;
+  uint64_t lost;              //markers evicted before the receiver checked them
+  uint64_t wait_cycles;       //re-aligning after the slips
+  uint64_t timeouts;
+  uint64_t erased_bits;
+};
+
+struct pilots {
+  volatile uint64_t* marker[PILOT_MARKERS];
+  volatile uint64_t* window[PILOT_WINDOW];  //Tx: markers reloaded at the barrier
+  uint64_t period;
+  uint64_t threshold;         //hit/miss threshold of the marker reloads
+  uint64_t timeout;           //cycles
+  uint64_t confirmed;         //Rx: pilots the sender is known to have passed
+  uint64_t pending_barrier;   //Rx: last bit of the sender before a barrier the receiver timed out of (0: none)
+  struct pilot_stats stats;
+};
+
+/*
+ * Markers on the sync pages of the lane (own and peer pages of its barrier,
+ * the same for sender and receiver), and period of p.
+ */
+static void pilots_init(struct pilots* pl, uint64_t* const* txready_pages, uint64_t* const* rxready_pages,
+                        const struct channel_params* p, uint64_t threshold, uint64_t timeout)
+{
+  memset(pl, 0, sizeof(*pl));
+  for(int m=0; m<PILOT_MARKERS; m++){
+    int page = m % (2*FR_BARRIER_SYNC_PAGES);
+    uint8_t* base = (uint8_t*) ((page < FR_BARRIER_SYNC_PAGES) ? txready_pages[page] : rxready_pages[page - FR_BARRIER_SYNC_PAGES]);
+    pl->marker[m] = (uint64_t*) (base + PILOT_MARKER_OFFSET + (m/(2*FR_BARRIER_SYNC_PAGES))*PILOT_MARKER_STRIDE);
+  }
+  pl->period = p->pilot_period;
+  pl->threshold = threshold;
+  pl->timeout = timeout;
+  if(pl->timeout < (PILOT_REALIGN_LEAD + 1)*pl->period*PILOT_TIMEOUT_BIT_CYCLES)
+    pl->timeout = (PILOT_REALIGN_LEAD + 1)*pl->period*PILOT_TIMEOUT_BIT_CYCLES;
+}
+
+/*
+ * Sender: passes the pilot at the end of span (bit_id/period), and reloads
+ * the markers of the window behind it.
+ */
+static void pilot_tx(const struct pilots* pl, uint64_t bit_id)
+{
+  uint64_t j = bit_id/pl->period;
+  uint64_t temp = 0;
+  for(uint64_t k=0; k<PILOT_WINDOW && k<=j; k++)
+    temp += MEM_LOAD(pl->marker[(j - k) % PILOT_MARKERS]);
+}
+
+/*
+ * Sender, before the barrier after bit_id: keeps the markers of the window
+ * of spans it has passed loaded while it waits there.
+ */
+static void pilot_keep(struct pilots* pl, uint64_t bit_id, struct fr_barrier* barrier)
+{
+  uint64_t passed = (bit_id + 1)/pl->period;
+  int n = 0;
+  for(uint64_t k=1; k<=PILOT_WINDOW && k<=passed; k++)
+    pl->window[n++] = pl->marker[(passed - k) % PILOT_MARKERS];
+  fr_barrier_keep(barrier, pl->window, n);
+}
+
+/*
+ * Reloads and flushes the marker of pilot j: true if the sender has passed it.
+ */
+static bool pilot_probe(struct pilots* pl, uint64_t j)
+{
+  unsigned int junk = 0;
+  volatile uint64_t* marker = pl->marker[j % PILOT_MARKERS];
+  uint64_t time0 = MEM_RDTSCP(&junk);
+  uint64_t temp = MEM_LOAD(marker);
+  uint64_t delta_time = MEM_RDTSCP(&junk) - time0;
+  MEM_CLFLUSH((uint64_t*) marker);
+  return delta_time < pl->threshold;
+}
+
+/*
+ * Polls the marker of pilot k until the sender has passed it, signaling the
+ * ready lines of barrier if the sender waits there. Returns false after the
+ * timeout (from start).
+ */
+static bool pilot_wait(struct pilots* pl, uint64_t k, uint64_t start, struct fr_barrier* barrier)
+{
+  unsigned int junk = 0;
+  while(!pilot_probe(pl, k)){
+    if(MEM_RDTSCP(&junk) - start > pl->timeout)
+      return false;
+    if(pl->pending_barrier)
+      fr_barrier_signal_ready(barrier);
+    delayloop(PILOT_POLL_CYCLES);
+  }
+  return true;
+}
+
+/*
+ * Receiver: the sender did not finish the barrier before the last bit
+ * tx_bit_id of its epoch, which it is waiting for.
+ */
+static void pilot_barrier_missed(struct pilots* pl, uint64_t tx_bit_id)
+{
+  pl->pending_barrier = tx_bit_id;
+}
+
+/*
+ * Receiver, at the end of the span of bit_id: checks its pilot and, after a
+ * slip, waits until the sender is PILOT_REALIGN_LEAD spans ahead (signaling
+ * barrier's ready lines, if the sender is waiting there). Returns true after
+ * a slip: the bits of the span are erasures.
+ */
+static bool pilot_rx(struct pilots* pl, uint64_t bit_id, struct fr_barrier* barrier)
+{
+  uint64_t j = bit_id/pl->period;
+  bool slip = false;
+  pl->stats.pilots++;
+  if(j >= pl->confirmed && pilot_probe(pl, j)){
+    pl->confirmed = j + 1;
+  } else if(j >= pl->confirmed){
+    unsigned int junk = 0;
+    uint64_t start = MEM_RDTSCP(&junk);
+    bool passed = pilot_wait(pl, j, start, barrier);
+    if(passed && pilot_probe(pl, j + 1)){
+      //The sender was past the next span already
+      pl->confirmed = j + 2;
+      pl->stats.lost++;
+    } else {
+      slip = true;
+      pl->stats.slips++;
+      pl->stats.erased_bits += pl->period;
+      if(passed)
+        pl->confirmed = j + 1;
+      for(uint64_t k=j+1; passed && k<=j + PILOT_REALIGN_LEAD; k++){
+        passed = pilot_wait(pl, k, start, barrier);
+        if(passed)
+          pl->confirmed = k + 1;
+      }
+      if(!passed)
+        pl->stats.timeouts++;
+    }
+    pl->stats.wait_cycles += MEM_RDTSCP(&junk) - start;
+  }
+  //The sender has left the barrier once it passed a pilot after it
+  if(pl->pending_barrier && pl->confirmed*pl->period > pl->pending_barrier + 1)
+    pl->pending_barrier = 0;
+  return slip;
+}
+
+/*
+ * Adds the counters of a lane's pilots to sum.
+ */
+static void pilot_stats_add(struct pilot_stats* sum, const struct pilot_stats* s)
+{
+  sum->pilots += s->pilots;
+  sum->slips += s->slips;
+  sum->lost += s->lost;
+  sum->wait_cycles += s->wait_cycles;
+  sum->timeouts += s->timeouts;
+  sum->erased_bits += s->erased_bits;
+}
+
+static void pilot_print(const struct pilot_stats* s, uint64_t period, uint64_t total_bits)
+{
+  printf("Pilots: every %llu bits, %llu checked, %llu markers lost. Slips: %llu (%llu timeouts). Waits: %.0f cycles on average."
+         " Erased: %llu bits (%.4f%%).\n", period, s->pilots, s->lost, s->slips, s->timeouts,
+         (s->slips + s->lost) ? 1.0*s->wait_cycles/(s->slips + s->lost) : 0.0, s->erased_bits,
+         total_bits ? 100.0*s->erased_bits/total_bits : 0.0);
+}
+
+#endif
+
+//
+// pilot.hh ends here
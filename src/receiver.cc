@@ -5,6 +5,12 @@
 
 #include "utils.hh" //Header for Streamline defines.
 #include "fr_util.hh" //Header for Flush+Reload Handshake. (from "https://github.com/yshalabi/covert-channel-tutorial")
+#include "payload.hh" //Header for payload creation, ECC framing and channel encoding.
+#include "rx_stream.hh" //Header for streaming analysis of received bits.
+#include "rx_decoder.hh" //Header for the concurrent decoder thread.
+#include "lanes.hh" //Header for multi-lane transmission.
+#include "addr_schedule.hh" //Header for the shared-array address schedule.
+#include "results.hh" //Header for the result line read by the orchestrator.
 
 /* 
  * Receiver for Flush+Reload (Used for Initial Handshake with Sender)
@@ -28,8 +34,8 @@ bool detect_bit(struct config *config, int interval)
 
     // Ignore access times larger than 1000 cycles usually due to a disk miss.
     if (access_time < 1000) {
-      // Count if it's a miss or hit depending on latency
-      if (access_time > LLC_MISS_THRESHOLD_CYCLES) {
+      // Count if it's a miss or hit depending on latency (the threshold is for rdtscp-timed loads)
+      if (access_time > config->threshold - sys_timer.rdtscp_overhead + sys_timer.fence_overhead) {
         misses++;
       } else {
         hits++;
@@ -41,32 +47,19 @@ bool detect_bit(struct config *config, int interval)
 
 
 /* Variables for Streamline */
-//Frequency to Print Progress Heartbeat
-#define HEARTBEAT_FREQ (1000)
+//Channel parameters (array size, sync period, sync timeout, heartbeat, ECC, payload type): see params.hh
+struct channel_params params;
 
 //-------- Access Pattern ----------
-// Access every 3n cacheline alternating between page 0 and page 1, then continue to pages 2,3 .. 4,5 ... and so on.
-#define PG_NUM(l) (((uint64_t)(((uint64_t)(l/2))*3/CL_IN_PAGE))*2 + l%2)
-#define CL_NUM(l) ((((uint64_t)(l/2))*3 + 14) % CL_IN_PAGE)
-#define BITID_2_ARRINDEX(l) ( PG_NUM(l)*ENTRY_PER_PAGE + CL_NUM(l)*ENTRY_PER_CL )
+// Access every 3n cacheline alternating between page 0 and page 1, then continue to pages 2,3 .. 4,5 ... and so on (see addr_schedule.hh).
 
-// Beating the LLC Replacement Policy (Access older lines)
-#define TX_ACCESS_LAG_DELTA (5000)
+// Beating the LLC Replacement Policy (Access older lines, params.lag_delta behind)
 #define TX_ACCESS_LAG       (1)
 
 //-------- Synchronization ----------
-// Rx Delay Per Sync Iteration
-#define RX_SYNC_SLEEP  (1000)
-// Frequency of Sync 
-#ifndef SYNC_FREQ_SENSITIVITY
-#define TX_SYNC_BITFREQ (200000)
-#else
-#define TX_SYNC_BITFREQ (SYNC_FREQ_SENSITIVITY)
-#endif
-// Gap Between TX and RX At Syncronization
-#define TX_SYNC_LAG_DELTA (5000) /*cross-core */
-// Timeout after which Rx exits sync
-#define RX_SYNC_TIMEOUT (5*100*5000)
+// Voting lines and poll interval of the barrier: params.sync_lines, params.sync_poll_min/max (see fr_barrier.hh)
+// Frequency of Sync, and Timeout after which Rx exits sync: params.sync_bitfreq, params.rx_sync_timeout
+// Gap Between TX and RX At Syncronization: TX_SYNC_LAG_DELTA (cross-core)
 
 //Initial Synchronization
 uint64_t RX_DELAY_CYCLES = 250000;
@@ -75,24 +68,15 @@ uint64_t RX_DELAY_CYCLES = 250000;
 //1. Static-Delay based synchronization.
 #define TX_DELAY_CYCLES (400000)
 
-//2. Flush+Reload based synchronization
-uint64_t* sync_rxready_page; //to be a page-size allocated page-aligned.
-uint64_t* sync_rxready_page1; //to be a page-size allocated page-aligned.
-uint64_t* sync_rxready_page2; //to be a page-size allocated page-aligned.
+//2. Flush+Reload based synchronization (sync pages of every lane, see lane_region)
 
-uint64_t* sync_txready_page; //to be a page-size allocated page-aligned.
-uint64_t* sync_txready_page1; //to be a page-size allocated page-aligned.
-uint64_t* sync_txready_page2; //to be a page-size allocated page-aligned.
+//4. TSC-deadline epochs (-E deadline, see epoch_schedule.hh): start of the first epoch, agreed at the initial handshake
+uint64_t epoch_start = 0;
 
 
 // -------- Network Parameters  -------------
-// LFSR Based Channel Encoding to modulate payloads (to allow pathological payloads)
-std::tr1::mt19937 mt (42); //Mersenne Twister PRNG engine
-std::tr1::uniform_int<int> channel_enc(0, 1); //uniform distribution [0,1]
-
-// Error-Correction Parameters: (72,64) Hamming Code
-#define DATABLK_BITLEN (64)
-#define PARITY_BITLEN (8)
+// Channel Encoding to modulate payloads (to allow pathological payloads):
+// keystream precomputed once per session, see channel_keystream in payload.hh
 
 
 // -------- Transmission Parameters  -------------
@@ -108,6 +92,7 @@ uint64_t TRANSMITTED_BITS ; //Includes data and parity bits
 
 //Array used for communication
 uint64_t* SHARED_ARRAY ;  //Shared array used for communication
+uint64_t SHARED_ARRAY_NUMENTRIES; //params.array_numentries
 uint64_t SHARED_SEED = 42; // Starting point in the array.
 
 //Cores that Tx and Rx will be pinned to.
@@ -125,24 +110,283 @@ uint64_t* rx_time_obs;
 uint64_t* tx_time_obs_timestamp;
 uint64_t* rx_time_obs_timestamp;
 
-//Bits to be transferred
-bool* tx_payload;
-bool* rx_payload;
+//Received bits and their analysis (constant memory)
+struct rx_stream rx_stream;
+uint64_t rx_raw_samples; //Raw latencies kept in rx_time_obs
+struct rx_decoder rx_decoder; //Decoder thread fed by the receiver loop
 
 //Starting time-stamp
 uint64_t tx_start_timestamp = 0,rx_start_timestamp = 0;
 
-//Debugging Data-Structures
-std::vector<uint64_t> tx_epoch_timestamp;
-std::vector<uint64_t> rx_epoch_timestamp;
-std::vector<uint64_t> rxsync_reached_timevec,rxsync_start_timevec,rxsync_complete_timevec;
-std::vector<uint64_t> txsync_reached_timevec,txsync_complete_timevec;
-std::vector<uint64_t> debug_rxsync_time, debug_timeout_duration, debug_timeout_bitid;
-
-
 //Global variable for tx_start
 bool tx_started = false;
 
+//Lanes: lane 0 runs on the main thread, lanes 1.. on their own threads.
+struct rx_lane {
+  int id;
+  int cpuid;
+  struct lane_region region;
+  uint64_t num_bits;                //bits carried by this lane
+  struct rx_lat_ring* ring;         //latencies handed to the decoder
+  uint64_t* time_obs_timestamp;
+  uint64_t start_time, end_time, loop_count;
+  pthread_t thread;
+
+  //Debugging Data-Structures
+  std::vector<uint64_t> rx_epoch_timestamp;
+  std::vector<uint64_t> rxsync_reached_timevec,rxsync_start_timevec,rxsync_complete_timevec;
+  std::vector<uint64_t> debug_rxsync_time, debug_timeout_duration, debug_timeout_bitid;
+  struct fr_barrier barrier;        //Flush+Reload barrier with the sender, and its cost
+  struct epoch_schedule epochs;     //deadlines of the epochs (-E deadline), and their cost
+  struct pilots pilots;             //re-alignment after slips (-P), and its cost
+  struct sync_adapt adapt;          //epochs between the barriers (-D), chosen from the errors and the lead
+};
+int num_lanes = 1;
+struct rx_lane rx_lanes[MAX_LANES];
+std::atomic<bool> rx_lanes_go(false); //set once the initial handshake is done
+
+
+/*
+ * Pin the calling thread to cpuid with the highest SCHED_FIFO priority.
+ */
+void set_rx_thread_sched(int cpuid)
+{
+#ifdef SIM_BACKEND
+  //Simulated core (see cache_sim.hh)
+  sim_attach(cpuid);
+#else
+  //Set Core Affinity and Scheduler Parameters
+  cpu_set_t mask;
+  int status;
+  CPU_ZERO(&mask);
+  CPU_SET(cpuid, &mask);
+  status = sched_setaffinity(0, sizeof(mask), &mask);
+  if (status != 0) {
+    perror("sched_setaffinity");
+  }
+
+  //Setting Scheduler Priority & Policy
+  int policy;
+  struct sched_param param;
+  pthread_getschedparam(pthread_self(), &policy, &param);
+  param.sched_priority = sched_get_priority_max(SCHED_FIFO);
+  pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+  printf("Receiver Process - PID:%llu, TID:%lu, CPU:%d\n",getpid(), syscall(__NR_gettid) ,sched_getcpu());
+  display_thread_sched_attr();
+  fail_if_pthrattr_mismatch(SCHED_FIFO,sched_get_priority_max(SCHED_FIFO),cpuid) ;
+#endif
+}
+
+// Per-bit parameters of a loop instance (see LOOP_PARAM)
+#define TX_SYNC_BITFREQ     LOOP_PARAM(kSyncBitfreq, params.sync_bitfreq)
+#define HEARTBEAT_FREQ      LOOP_PARAM(kHeartbeatFreq, params.heartbeat_freq)
+#define RX_SYNC_TIMEOUT     (params.rx_sync_timeout)
+#define PILOT_PERIOD        ((kSpecialized) ? 0 : params.pilot_period)
+#define SYNC_ADAPT          ((kSpecialized) ? 0 : params.sync_adapt_max)
+
+/*
+ * Streamline reception of the bits carried by one lane.
+ * (kLagDelta is unused: the access lag only concerns the sender.)
+ */
+template<bool kSpecialized, uint64_t kSyncBitfreq, uint64_t kLagDelta, uint64_t kHeartbeatFreq>
+void rx_lane_loop(struct rx_lane* lane)
+{
+  //Lane's region of the shared array, and sync pages
+  uint64_t* lane_array = lane->region.shared_array;
+  uint64_t lane_numentries = lane->region.numentries;
+  uint64_t lane_bits = lane->num_bits;
+  struct rx_lat_ring* lane_ring = lane->ring;
+  uint64_t lat_mask = rx_decoder.lat_mask;
+  uint64_t* train_array = lane->region.train_array;
+  uint64_t train_bits = params.train_bits;
+  //Flush+Reload barrier with the sender, on the lane's sync pages
+  fr_barrier_init(&lane->barrier, lane->region.sync_rxready_page, lane->region.sync_txready_page,
+                  &params, LLC_HIT_THRESHOLD_CYCLES_SYNC, RX_SYNC_TIMEOUT);
+  //Deadlines of the epochs: Rx goes on the guard after the start of every epoch
+  bool deadline_sync = (params.sync_mode == SYNC_DEADLINE);
+  epoch_schedule_init(&lane->epochs, epoch_start, &params, params.epoch_guard);
+  //Pilots (generic instance only): on the lane's sync pages
+  pilots_init(&lane->pilots, lane->region.sync_txready_page, lane->region.sync_rxready_page,
+              &params, LLC_HIT_THRESHOLD_CYCLES_SYNC, RX_SYNC_TIMEOUT);
+  //Adaptive sync period (generic instance only): chosen at every barrier, sent on the lane's sync pages
+  sync_adapt_init(&lane->adapt, lane->region.sync_rxready_page, &params, LLC_HIT_THRESHOLD_CYCLES_SYNC);
+
+  unsigned int junk_temp_rx = 0;
+
+  if(lane->id == 0)
+    rx_start_timestamp = MEM_RDTSCP(&junk_temp_rx);
+  uint64_t rx_loop_count = 0;
+  struct addr_schedule schedule;
+  addr_schedule_init(&schedule, SHARED_SEED, lane_numentries, &params);
+  register uint64_t rx_start_time,rx_end_time;
+  unsigned int junk_temp=0;
+
+  //First epoch: start the initial Tx-Rx delay after Tx (its first bit runs after the training bits, off the schedule)
+  if(deadline_sync){
+    struct epoch_times epoch_times;
+    epoch_wait(&lane->epochs, epoch_start + RX_DELAY_CYCLES, EPOCH_UNSCHEDULED, &epoch_times);
+  }
+
+  //Mark Start Time
+  rx_start_time = MEM_RDTSCP( & junk_temp);
+  uint64_t timestamp_rxstart_cycles = MEM_RDTSCP( & junk_temp_rx);
+
+  //Start Receiver Loop
+  for (uint64_t rx_id = 0; rx_id < lane_bits; rx_id++){
+    unsigned int junk = 0;
+    register uint64_t time0, delta_time0;
+
+    //--- Training bits at the start of every sync epoch (see training.hh) -------
+    if( (rx_id % (TX_SYNC_BITFREQ)) == 0 && train_bits ){
+      uint16_t* train_lat = rx_decoder_train_slot(lane_ring, rx_id/TX_SYNC_BITFREQ, train_bits);
+      for(uint64_t j=0; j<train_bits; j++){
+        volatile uint64_t* train_addr = &train_array[train_line_index(j)];
+        time0 = MEM_RDTSCP( & junk); /* READ TIMER */
+        junk = MEM_LOAD(train_addr);
+        delta_time0 = MEM_RDTSCP( & junk) - time0; /* READ TIMER & COMPUTE ELAPSED TIME */
+        train_lat[j] = (uint16_t)(delta_time0 > RX_LATENCY_MAX ? RX_LATENCY_MAX : delta_time0);
+      }
+      //Flush the training lines, so that they are misses in the next epoch unless Tx loads them.
+      for(uint64_t j=0; j<train_bits; j++)
+        MEM_CLFLUSH(&train_array[train_line_index(j)]);
+      //Errors of the epoch, for the adaptive sync period
+      if(SYNC_ADAPT)
+        sync_adapt_train(&lane->adapt, train_lat, train_bits);
+    }
+
+    //Array index of curr_bitid = SHARED_SEED + rx_loop_count
+    uint64_t curr_arrindex = addr_schedule_index(&schedule, lane_numentries);
+    addr_schedule_next(&schedule, lane_numentries);
+    volatile uint64_t* addr0 = &lane_array[curr_arrindex];
+
+    //Get time for reading addr0
+    time0 = MEM_RDTSCP( & junk); /* READ TIMER */
+    junk = MEM_LOAD(addr0);
+    delta_time0 = MEM_RDTSCP( & junk) - time0; /* READ TIMER & COMPUTE ELAPSED TIME */
+    
+    //delta_time0 = junk % 512;
+    //delta_time0++;
+
+    //Hand the latency to the decoder thread (thresholded and analyzed there)
+    rx_decoder_store(lane_ring, lat_mask, rx_id, delta_time0);
+    if(PILOT_PERIOD){
+      //Pilots: hand a span over once its pilot is checked, as erasures after a slip (see pilot.hh)
+      if( (rx_id & (PILOT_PERIOD - 1)) == (PILOT_PERIOD - 1) ){
+        if(pilot_rx(&lane->pilots, rx_id, &lane->barrier)){
+          rx_decoder_erase(lane_ring, lat_mask, rx_id + 1 - PILOT_PERIOD, rx_id);
+          if(SYNC_ADAPT)
+            sync_adapt_reset(&lane->adapt);
+        }
+        rx_decoder_publish_span(lane_ring, rx_id + 1, PILOT_PERIOD);
+      }
+    } else if( (rx_id % RX_DECODER_BATCH) == (RX_DECODER_BATCH - 1) )
+      rx_decoder_publish(lane_ring, rx_id + 1);
+    lane->time_obs_timestamp[rx_id%NUM_BITS_DEBUG_DTSTR] = time0;
+    
+#ifdef PROGRESS_HEARTBEAT
+    if( (rx_id % HEARTBEAT_FREQ) == (HEARTBEAT_FREQ - 1) && rx_id < NUM_BITS_DEBUG_MAX ){
+      uint64_t epoch_timestamp  = MEM_RDTSCP( & junk_temp_rx);
+      lane->rx_epoch_timestamp.push_back(epoch_timestamp);
+      //printf("Rx-Epoch Curr-BitID:%d,Timestamp:%llu\n\n",rx_id,epoch_timestamp);
+    }
+#endif
+
+    //--- Syncrhonization every TX_SYNC_BITFREQ -------
+    if( (rx_id % (TX_SYNC_BITFREQ)) == (TX_SYNC_BITFREQ - TX_SYNC_LAG_DELTA) ){
+
+#ifdef FR_BARRIER_SYNC
+      //RX_SYNC 
+      //3. Flush-Reload based Synchronization (see fr_barrier.hh)
+      struct fr_barrier_times sync_times;
+      if(!deadline_sync){
+        if(!SYNC_ADAPT || sync_adapt_due(&lane->adapt, rx_id/TX_SYNC_BITFREQ)){
+          if(SYNC_ADAPT)
+            sync_adapt_choose(&lane->adapt, &lane->barrier);
+          bool left = fr_barrier_rx(&lane->barrier, &sync_times);
+          if(!left){
+            lane->debug_rxsync_time.push_back(sync_times.complete - sync_times.reached);
+            lane->debug_timeout_duration.push_back(RX_SYNC_TIMEOUT);
+            lane->debug_timeout_bitid.push_back(rx_id);
+            //The sender is still to reach the barrier, at the end of the epoch
+            if(PILOT_PERIOD)
+              pilot_barrier_missed(&lane->pilots, (rx_id/TX_SYNC_BITFREQ + 1)*TX_SYNC_BITFREQ - 1);
+          }
+          if(SYNC_ADAPT)
+            sync_adapt_rx(&lane->adapt, rx_id/TX_SYNC_BITFREQ, rx_id, &sync_times, left);
+          //Erasure code across epochs: lost up to the next barrier (see epoch_code.hh)
+          if(!left && params.epoch_repair)
+            rx_stream_lose_epochs(&rx_stream, rx_id/TX_SYNC_BITFREQ,
+                                  SYNC_ADAPT ? lane->adapt.next_epoch : rx_id/TX_SYNC_BITFREQ + 1);
+        } else {
+          //Adaptive sync period: no barrier at the end of this epoch (see sync_adapt.hh)
+          sync_times.reached = sync_times.start = sync_times.complete = MEM_RDTSCP(&junk);
+        }
+
+        lane->rxsync_reached_timevec.push_back(sync_times.reached);
+        lane->rxsync_start_timevec.push_back(sync_times.start);
+        lane->rxsync_complete_timevec.push_back(sync_times.complete);      
+      }
+#endif      
+
+      //4. TSC-deadline epochs: wait for the start of the next epoch, plus the guard (see epoch_schedule.hh)
+      if(deadline_sync){
+        struct epoch_times epoch_times;
+        epoch_measure_skew(&lane->epochs, lane->time_obs_timestamp, NUM_BITS_DEBUG_DTSTR, rx_id);
+        epoch_wait(&lane->epochs, epoch_deadline(&lane->epochs, rx_id/TX_SYNC_BITFREQ + 1), rx_id + 1, &epoch_times);
+        if(params.epoch_repair && epoch_times.reached > epoch_times.deadline)
+          rx_stream_lose_epochs(&rx_stream, rx_id/TX_SYNC_BITFREQ, rx_id/TX_SYNC_BITFREQ + 1);
+
+        lane->rxsync_reached_timevec.push_back(epoch_times.reached);
+        lane->rxsync_start_timevec.push_back(epoch_times.deadline);
+        lane->rxsync_complete_timevec.push_back(epoch_times.released);
+      }
+    }
+
+#if VERBOSE
+    uint64_t curr_bitid = SHARED_SEED + rx_loop_count;
+    printf("Rx: Curr-BitID:%llu, Addr accessed:%#18x, PG_NUM:%llu, CL_NUM:%llu Time:%llu, Rx-Bit:%d\n",curr_bitid,addr0,PG_NUM(curr_bitid),CL_NUM(curr_bitid),delta_time0,delta_time0>LLC_HIT_THRESHOLD_CYCLES_COMM?1:0);
+#endif
+
+    rx_loop_count++;
+  }
+ 
+  //Mark End Time
+  rx_end_time = MEM_RDTSCP( & junk_temp);
+
+  rx_decoder_close_lane(lane_ring, rx_loop_count);
+  addr_schedule_free(&schedule);
+  lane->start_time = rx_start_time;
+  lane->end_time = rx_end_time;
+  lane->loop_count = rx_loop_count;
+}
+
+#undef TX_SYNC_BITFREQ
+#undef HEARTBEAT_FREQ
+#undef RX_SYNC_TIMEOUT
+#undef PILOT_PERIOD
+#undef SYNC_ADAPT
+
+//Loop instances: specialized ones, and the generic one.
+typedef void (*rx_lane_loop_fn)(struct rx_lane*);
+#define RX_LOOP_INSTANCE(sync_bitfreq)                                   \
+  {sync_bitfreq, rx_lane_loop<true, sync_bitfreq, DEFAULT_ACCESS_LAG_DELTA, DEFAULT_HEARTBEAT_FREQ>},
+static const struct loop_instance<rx_lane_loop_fn> rx_lane_loops[] = { LOOP_SPECIALIZATIONS(RX_LOOP_INSTANCE) };
+rx_lane_loop_fn rx_loop = rx_lane_loop<false, 0, 0, 0>; //selected once, from the parameters
+
+/*
+ * Receiver thread of lanes 1..
+ */
+void* rx_lane_thread(void* arg)
+{
+  struct rx_lane* lane = (struct rx_lane*) arg;
+  set_rx_thread_sched(lane->cpuid);
+  while(!rx_lanes_go.load(std::memory_order_acquire)) {}
+  rx_loop(lane);
+  return NULL;
+}
+
+
+
 
 int main(int argc, char **argv)
 {
@@ -151,29 +395,23 @@ int main(int argc, char **argv)
   // Get command-line parameters
   struct config config; //for initial sync
   init_config(&config, NUM_BITS, argc, argv);
+  params = config.params;
+  LLC_HIT_THRESHOLD_CYCLES_SYNC = LLC_HIT_THRESHOLD_CYCLES_COMM = config.threshold;
 
   //Initialize the Number of Transmitted Bits
-#ifdef ECC
-  assert((NUM_BITS%8 == 0) && "Number of Bits has to be a Multiple of 8\n" );
-  TRANSMITTED_BITS = NUM_BITS*(DATABLK_BITLEN+PARITY_BITLEN)/DATABLK_BITLEN;    
-  #else
-  TRANSMITTED_BITS = NUM_BITS;
-  #endif
+  if(params.ecc){
+    assert((NUM_BITS%8 == 0) && "Number of Bits has to be a Multiple of 8\n" );
+    TRANSMITTED_BITS = NUM_BITS*(DATABLK_BITLEN+PARITY_BITLEN)/DATABLK_BITLEN;    
+  } else {
+    TRANSMITTED_BITS = NUM_BITS;
+  }
   if(NUM_BITS > NUM_BITS_DEBUG_MAX)
     NUM_BITS_DEBUG_DTSTR = NUM_BITS_DEBUG_MAX;
   else
     NUM_BITS_DEBUG_DTSTR = TRANSMITTED_BITS ;
 
   //Printing Inputs
-  #ifdef  RANDOM_PAYLOAD  
-  std::string payload_type = "Random Payload";
-  #endif    
-  #ifdef CONSTANT_PAYLOAD_0
-  std::string payload_type = "Constant-0 Payload";
-  #endif    
-  #ifdef CONSTANT_PAYLOAD_1
-  std::string payload_type = "Constant-1 Payload";
-  #endif
+  std::string payload_type = payload_type_name(params.payload_type);
   printf("Streamline Covert Channel Receiver with Num_Bits:%llu, %s,\
  LLC-Hit-Threshold-Comm:%llu cycles. LLC-Hit-Threshold-Sync:%llu cycles. \
  Start Tx-Rx-Delay-Cycles: %llu\n",
@@ -184,6 +422,7 @@ int main(int argc, char **argv)
   //Data-structures used for transmission:
   //Shared array used for transmission
   SHARED_ARRAY =  (uint64_t*) (config.addr + OFFSET_SHARED_ARRAY);
+  SHARED_ARRAY_NUMENTRIES = params.array_numentries;
 
   // Stream Through Shared Array
   uint64_t temp = 0;
@@ -191,132 +430,97 @@ int main(int argc, char **argv)
     temp+= SHARED_ARRAY[i];
   }
 
-  //Shared page used for synchronization
-  sync_rxready_page =  (uint64_t*) (config.addr + OFFSET_FR_SYNC_REG_RX1);
-  sync_txready_page =  (uint64_t*) (config.addr + OFFSET_FR_SYNC_REG_TX1);
-  sync_rxready_page1 = (uint64_t*) (config.addr + OFFSET_FR_SYNC_REG_RX2);
-  sync_txready_page1 = (uint64_t*) (config.addr + OFFSET_FR_SYNC_REG_TX2);
-  sync_rxready_page2 = (uint64_t*) (config.addr + OFFSET_FR_SYNC_REG_RX3);
-  sync_txready_page2 = (uint64_t*) (config.addr + OFFSET_FR_SYNC_REG_TX3);
-
-  // Flush shared page used for synchronization
-  for(uint64_t i=0;i<PAGE_SZ/sizeof(uint64_t);i++){
-    _mm_clflush(&sync_rxready_page[i]);
-    _mm_clflush(&sync_rxready_page1[i]);
-    _mm_clflush(&sync_rxready_page2[i]);
-
+  //Lanes: regions of the shared array, and pages used for synchronization
+  num_lanes = config.num_lanes;
+  if(num_lanes < 1 || num_lanes > MAX_LANES){
+    printf("Number of lanes has to be between 1 and %d\n", MAX_LANES);
+    exit(1);
+  }
+  for(int l=0; l<num_lanes; l++){
+    rx_lanes[l].id = l;
+    rx_lanes[l].cpuid = (l == 0) ? rx_cpuid : LANE_RX_CPUID(l);
+    host_check_llc_sharing((l == 0) ? tx_cpuid : LANE_TX_CPUID(l), rx_lanes[l].cpuid);
+    rx_lanes[l].num_bits = lane_num_bits(TRANSMITTED_BITS, l, num_lanes);
+    lane_region_init(&rx_lanes[l].region, config.addr, SHARED_ARRAY_NUMENTRIES, l, num_lanes);
+
+    // Flush shared page used for synchronization
+    lane_flush_sync_pages(&rx_lanes[l].region);
   }
-  for(uint64_t i=0;i<PAGE_SZ/sizeof(uint64_t);i++){
-    _mm_clflush(&sync_txready_page[i]);
-    _mm_clflush(&sync_txready_page1[i]);
-    _mm_clflush(&sync_txready_page2[i]);
-  }   
   
   //Transmission & Receiver Data-Structures
+  //Raw latencies are only kept for the first rx_raw_samples bits.
+  rx_raw_samples = config.raw_samples < TRANSMITTED_BITS ? config.raw_samples : TRANSMITTED_BITS;
   tx_time_obs = (uint64_t*)malloc(NUM_BITS_DEBUG_DTSTR*sizeof(uint64_t));
-  rx_time_obs =  (uint64_t*)malloc(TRANSMITTED_BITS*sizeof(uint64_t));
+  rx_time_obs =  (uint64_t*)malloc((rx_raw_samples+1)*sizeof(uint64_t));
   tx_time_obs_timestamp = (uint64_t*)malloc(NUM_BITS_DEBUG_DTSTR*sizeof(uint64_t));
   rx_time_obs_timestamp = (uint64_t*)malloc(NUM_BITS_DEBUG_DTSTR*sizeof(uint64_t));
-  //Bits to be transferred
-  tx_payload = (bool*)malloc(TRANSMITTED_BITS*sizeof(bool));;
-  rx_payload = (bool*)malloc(TRANSMITTED_BITS*sizeof(bool));
+  //Received bits (ring) and expected bits (regenerated chunk by chunk)
+  rx_stream_init(&rx_stream, NUM_BITS, TRANSMITTED_BITS, &params, num_lanes);
+  FILE* hist_file = NULL;
+  if(config.hist_filename != NULL){
+    hist_file = fopen(config.hist_filename, "w");
+    if(hist_file == NULL){
+      printf("Failed to open the histogram file %s\n", config.hist_filename);
+      exit(1);
+    }
+    rx_stream_export_hist(&rx_stream, hist_file);
+  }
 
   //Initialize the data-structures used for transmission with random data
   srand(42);
-  for(uint64_t i=0;i<TRANSMITTED_BITS;i++){
+  for(uint64_t i=0;i<NUM_BITS_DEBUG_DTSTR;i++){
     tx_time_obs[i%NUM_BITS_DEBUG_DTSTR] = rand();    
-    rx_time_obs[i] = rand();
     tx_time_obs_timestamp[i%NUM_BITS_DEBUG_DTSTR] = rand(); 
     rx_time_obs_timestamp[i%NUM_BITS_DEBUG_DTSTR] = rand();
-    tx_payload[i] = rand()%2;
-    rx_payload[i] = rand()%2;
+  }
+  for(uint64_t i=0;i<rx_raw_samples;i++){
+    rx_time_obs[i] = rand();
+  }
+  for(uint64_t w=0;w<rx_stream.ring.num_words;w++){
+    rx_stream.ring.words[w] = rand();
+    rx_stream.tx_chunk.words[w%rx_stream.tx_chunk.num_words] = rand();
+  }
+
+  //Start the decoder (before the receiver is pinned and gets real-time priority)
+  int decoder_cpuid = config.decoder_cpuid;
+  if(decoder_cpuid == DECODER_CPUID_AUTO)
+    decoder_cpuid = (num_lanes == 1) ? DEFAULT_DECODER_CPUID : LANE_RX_CPUID(num_lanes);
+  rx_decoder_start(&rx_decoder, &rx_stream, &LLC_HIT_THRESHOLD_CYCLES_COMM, &params,
+                   rx_time_obs, rx_raw_samples, decoder_cpuid, num_lanes);
+  for(int l=0; l<num_lanes; l++){
+    rx_lanes[l].ring = &rx_decoder.rings[l];
+    if(l == 0)
+      rx_lanes[l].time_obs_timestamp = rx_time_obs_timestamp;
+    else
+      rx_lanes[l].time_obs_timestamp = (uint64_t*)calloc(NUM_BITS_DEBUG_DTSTR, sizeof(uint64_t));
   }
 
   //Print Preliminaries.
   printf("Array Size: %llu bytes (%.2f GB). Starting index is: %llu (%lluth page)\n",
          SHARED_ARRAY_NUMENTRIES*sizeof(SHARED_ARRAY[0]), SHARED_ARRAY_NUMENTRIES*sizeof(SHARED_ARRAY[0])/(1024*1024*1024.0),\
          BITID_2_ARRINDEX(SHARED_SEED), SHARED_SEED);
+  print_channel_params(&params);
+  addr_pattern_print(&params, rx_lanes[0].region.numentries);
 
-  printf("Other Data-Structures Sizes: rx_time_obs:%2f MB, tx_payload:%.2f MB, rx_payload:%.2f MB.\n",
-         1.0*TRANSMITTED_BITS*sizeof(uint64_t)/1024/1024,1.0*TRANSMITTED_BITS*sizeof(bool)/1024/1024,1.0*TRANSMITTED_BITS*sizeof(bool)/1024/1024);
-
-
-  //Set Core Affinity and Scheduler Parameters
-  cpu_set_t mask;
-  int status;
-  CPU_ZERO(&mask);
-  CPU_SET(rx_cpuid, &mask);
-  status = sched_setaffinity(0, sizeof(mask), &mask);
-  if (status != 0) {
-    perror("sched_setaffinity");
-  }
+  //Loop instance for these parameters
+  rx_loop = loop_select(rx_lane_loops, (rx_lane_loop_fn) rx_lane_loop<false, 0, 0, 0>, &params);
+  printf("Rx loop: %s instance\n", rx_loop == rx_lane_loop<false, 0, 0, 0> ? "generic" : "specialized");
 
-  //Setting Scheduler Priority & Policy
-  int policy;
-  struct sched_param param;
-  pthread_getschedparam(pthread_self(), &policy, &param);
-  param.sched_priority = sched_get_priority_max(SCHED_FIFO);
-  pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
-  printf("Receiver Process - PID:%llu, TID:%lu, CPU:%d\n",getpid(), syscall(__NR_gettid) ,sched_getcpu());
-  display_thread_sched_attr();
-  fail_if_pthrattr_mismatch(SCHED_FIFO,sched_get_priority_max(SCHED_FIFO),rx_cpuid) ;
+  printf("Other Data-Structures Sizes: rx_time_obs:%2f MB, tx_payload:%.2f MB, rx_payload:%.2f MB.\n",
+         1.0*rx_raw_samples*sizeof(uint64_t)/1024/1024,1.0*bitvec_size_bytes(&rx_stream.tx_chunk)/1024/1024,1.0*bitvec_size_bytes(&rx_stream.ring)/1024/1024);
 
-  // Create Tx Payload.
-  srand(42);
-  for(uint64_t i=0;i<TRANSMITTED_BITS;i++){
-#ifdef  RANDOM_PAYLOAD
-    //random payload:
-    int cur_payload = rand()%2;
-#endif
-    
-#ifdef CONSTANT_PAYLOAD_0    
-    int cur_payload = 0;
-#endif
-    
-#ifdef CONSTANT_PAYLOAD_1
-    int cur_payload = 1;
-#endif
- 
-    //tx each iteration.
-    tx_payload[i] = cur_payload ;
-
-    //Add error-correction
-#ifdef ECC
-    if(i% (DATABLK_BITLEN+PARITY_BITLEN) == (DATABLK_BITLEN-1)){
-      //datablk bool array of 64 bits => datablk_bytes encoding 8 byte data
-      bool* datablk = &tx_payload[i-DATABLK_BITLEN+1];
-      /* print_bool_array(datablk,64); */
-      uint8_t datablk_bytes[8], enc_datablk_bytes[9] ;       
-      conv_char(datablk,8,datablk_bytes);
-      
-      //encode data
-      int enc_bytelen = fec_secded7264_encode(8,datablk_bytes, enc_datablk_bytes);
-      assert(enc_bytelen == 9);
-      
-      //enc_datablk_bytes of 9 bytes => enc_datablk
-      bool* enc_datablk = &tx_payload[i-DATABLK_BITLEN+1];
-      string_to_binary(enc_datablk_bytes,enc_bytelen,enc_datablk);
-      /* print_bool_array(enc_datablk,72); */
-
-      //increment the bit-id
-      i+=PARITY_BITLEN;  
-    }                                             
-#endif
-  }
-  
-  //Modulate Payload with Channel Encoding.
-  uint64_t num_pkts = 0;
-  for(uint64_t i=0;i<TRANSMITTED_BITS;i++){
 
-    if(i%TX_SYNC_BITFREQ == 0)
-      mt.seed(42); //Mersenne Twister PRNG engine
+  //Set Core Affinity and Scheduler Parameters (lane 0 runs on this thread)
+  set_rx_thread_sched(rx_cpuid);
 
-    int channel_enc_i = channel_enc(mt);
-    tx_payload[i] =  tx_payload[i] ^ channel_enc_i;
+  //Receivers of the other lanes (wait for the initial handshake)
+  for(int l=1; l<num_lanes; l++){
+    if(pthread_create(&rx_lanes[l].thread, NULL, rx_lane_thread, &rx_lanes[l]) != 0){
+      printf("Failed to create Rx thread of lane %d\n", l);
+      exit(1);
+    }
   }
 
- 
-  
   //Initialize Initial Synchronization Variables
   int flip_sequence = 4;
   bool current;
@@ -342,6 +546,7 @@ int main(int argc, char **argv)
   }
 
   // Initial Sync Done
+  epoch_start = epoch_schedule_start(config.CHANNEL_SYNC_TIMEMASK);
   printf("Receiver Ready: Done Initial Sync\n");
 
   
@@ -349,308 +554,57 @@ int main(int argc, char **argv)
 
   //Start Rx
   delayloop(RX_DELAY_CYCLES);
-  unsigned int junk_temp_rx = 0;
-
-  rx_start_timestamp = __rdtscp(&junk_temp_rx);
-  uint64_t rx_loop_count = 0;
-  register uint64_t rx_start_time,rx_end_time;
-  unsigned int junk_temp=0;
-
-  //Mark Start Time
-  rx_start_time = __rdtscp( & junk_temp);
-  uint64_t timestamp_rxstart_cycles = __rdtscp( & junk_temp_rx);
-
-  //Start Receiver Loop
-  for (uint64_t rx_id = 0; rx_id < TRANSMITTED_BITS; rx_id++){
-    unsigned int junk = 0;
-    register uint64_t time0, delta_time0;
-
-    uint64_t curr_bitid = SHARED_SEED + rx_loop_count ;
-    uint64_t curr_arrindex = (BITID_2_ARRINDEX(curr_bitid))%SHARED_ARRAY_NUMENTRIES + 4;
-    volatile uint64_t* addr0 = &SHARED_ARRAY[curr_arrindex];
-
-    //Get time for reading addr0
-    time0 = __rdtscp( & junk); /* READ TIMER */
-    junk = *addr0;
-    delta_time0 = __rdtscp( & junk) - time0; /* READ TIMER & COMPUTE ELAPSED TIME */
-    
-    //delta_time0 = junk % 512;
-    //delta_time0++;
-
-    //Store Time0 and Time1 in obs_time_array_0[], obs_time_array_1[]
-    rx_time_obs[rx_id] = delta_time0;
-    rx_time_obs_timestamp[rx_id%NUM_BITS_DEBUG_DTSTR] = time0;
-    
-#ifdef PROGRESS_HEARTBEAT
-    if( (rx_id % HEARTBEAT_FREQ) == (HEARTBEAT_FREQ - 1) ){
-      uint64_t epoch_timestamp  = __rdtscp( & junk_temp_rx);
-      rx_epoch_timestamp.push_back(epoch_timestamp);
-      //printf("Rx-Epoch Curr-BitID:%d,Timestamp:%llu\n\n",rx_id,epoch_timestamp);
-    }
-#endif
-
-    //--- Syncrhonization every TX_SYNC_BITFREQ -------
-    if( (rx_id % (TX_SYNC_BITFREQ)) == (TX_SYNC_BITFREQ - TX_SYNC_LAG_DELTA) ){
-
-#ifdef FR_BARRIER_SYNC
-      //RX_SYNC 
-      //3. Flush-Reload based Synchronization
-      volatile uint64_t* sync_rxready_addr =  (&sync_rxready_page[0]);
-      volatile uint64_t* sync_rxready_addr1 =  (&sync_rxready_page1[0]);
-      volatile uint64_t* sync_rxready_addr2 =  (&sync_rxready_page2[0]);
-
-      unsigned int sync_junk = 0, sync_junk2 = 0;
-      register uint64_t sync_time0, sync_delta_time0, sync_time0_2, sync_delta_time0_2;
-      register uint64_t sync_time1, sync_delta_time1, sync_time2, sync_delta_time2;
-      register uint64_t sync_time0_21, sync_delta_time0_21, sync_time0_22, sync_delta_time0_22;
-
-      volatile uint64_t* sync_txready_addr =  (&sync_txready_page[0]);
-      volatile uint64_t* sync_txready_addr1 =  (&sync_txready_page1[0]);
-      volatile uint64_t* sync_txready_addr2 =  (&sync_txready_page2[0]);
-      
-      bool sync_start = false;
-      int tx_ready_count = 0;
-      
-      bool sync_complete = false;
-      int llc_hit_count = 0;
-      uint64_t sync_temp = 0,sync_temp1 = 0,sync_temp2 = 0 ;
-
-      register uint64_t rxsync_reached_donetime, rxsync_start_donetime, rxsync_complete_donetime;
-      
-      /* printf("%llu. \t Bit_Id:%d, Flush-Reload Sync Starts for Rx.\n",__rdtsc(), rx_id); */
-      rxsync_reached_donetime =  __rdtscp( &sync_junk);
-
-      //Check if Tx has reached barrier.
-      uint64_t sleep_count = 0;    
-      while(!(sync_start)){
-        //a. Flush addr where Tx will communicate (sync_txready_addr)
-        _mm_clflush(&sync_txready_page[0]);
-        _mm_clflush(&sync_txready_page1[0]);
-        _mm_clflush(&sync_txready_page2[0]);
-
-        //b. Sleep
-        delayloop(RX_SYNC_SLEEP);
-
-        //c Reload and Check latency of sync_txready_addr
-        sync_time0_2 = __rdtscp( &sync_junk2); /* READ TIMER */
-        sync_temp += *sync_txready_addr;
-        sync_delta_time0_2 = __rdtscp(&sync_junk) - sync_time0_2; /* READ TIMER & COMPUTE ELAPSED TIME */
-
-        sync_time0_21 = __rdtscp( &sync_junk2); /* READ TIMER */
-        sync_temp1 += *sync_txready_addr1;
-        sync_delta_time0_21 = __rdtscp(&sync_junk) - sync_time0_21; /* READ TIMER & COMPUTE ELAPSED TIME */
-
-        sync_time0_22 = __rdtscp( &sync_junk2); /* READ TIMER */
-        sync_temp2 += *sync_txready_addr2;
-        sync_delta_time0_22 = __rdtscp(&sync_junk) - sync_time0_22; /* READ TIMER & COMPUTE ELAPSED TIME */
-
-        //If tx_ready has 2 LLC-Hit, means Tx has reached barrier.
-        if(sync_delta_time0_2 <LLC_HIT_THRESHOLD_CYCLES_SYNC)
-          tx_ready_count++;
-        if(sync_delta_time0_21 <LLC_HIT_THRESHOLD_CYCLES_SYNC)
-          tx_ready_count++;
-        if(sync_delta_time0_22 <LLC_HIT_THRESHOLD_CYCLES_SYNC)
-          tx_ready_count++;
-
-        if(tx_ready_count >=2)
-          sync_start = true;
-
-#ifdef RX_SYNC_TIMEOUT      
-        sleep_count++;
-
-        if(sleep_count*RX_SYNC_SLEEP > RX_SYNC_TIMEOUT){
-          sync_start = true;
-          sync_complete = true;
-
-          debug_rxsync_time.push_back(__rdtscp( &sync_junk) - rxsync_reached_donetime);
-          debug_timeout_duration.push_back(RX_SYNC_TIMEOUT);
-          debug_timeout_bitid.push_back(rx_id);
-        }
-        
-
+  uint64_t rx_wall_start_ns = timer_wall_ns();
+  rx_lanes_go.store(true, std::memory_order_release);
+  rx_loop(&rx_lanes[0]);
+#ifdef SIM_BACKEND
+  sim_detach();
 #endif
-      }
-
-      rxsync_start_donetime =  __rdtscp( &sync_junk);
-      
-      //Speculation Barrier.
-      int a,b;
-      __asm__("cpuid"
-              :"=a"(b)                 // EAX into b (output)
-              :"0"(a)                  // a into EAX (input)
-              :"%ebx","%ecx","%edx");  // clobbered registers
-
-      //Communicate that Rx has reached barrier.
-      while(!(sync_complete)){
-
-        //a. Load sync_rxready_addr (to communicate Rx has reached barrier)
-        sync_time0 = __rdtscp( &sync_junk); /* READ TIMER */
-        sync_temp += *sync_rxready_addr;
-        sync_delta_time0 = __rdtscp(&sync_junk) - sync_time0; /* READ TIMER & COMPUTE ELAPSED TIME */
-
-        sync_time1 = __rdtscp( &sync_junk); /* READ TIMER */
-        sync_temp1 += *sync_rxready_addr1;
-        sync_delta_time1 = __rdtscp(&sync_junk) - sync_time1; /* READ TIMER & COMPUTE ELAPSED TIME */
-
-        sync_time2 = __rdtscp( &sync_junk); /* READ TIMER */
-        sync_temp2 += *sync_rxready_addr2;
-        sync_delta_time2 = __rdtscp(&sync_junk) - sync_time2; /* READ TIMER & COMPUTE ELAPSED TIME */
-
-        //Continue until 3/3 or 4/5 loads are LLC-Hits (Flush stops from Tx-side, so Tx has exited the barrier)
-        /* llc_hit_count = (sync_delta_time0 <LLC_HIT_THRESHOLD_CYCLES_SYNC)?llc_hit_count+1:llc_hit_count-1 ; */
-        /* if(llc_hit_count < 0) */
-        /*   llc_hit_count = 0; */
-        
-        /* if(llc_hit_count == 3) */
-        /*   sync_complete=true; */
-
-        // Continue until 3/3 or 4/5 loads are LLC-Hits (Flush stops from Tx-side, so Tx has exited the barrier)
-        if(sync_delta_time0<LLC_HIT_THRESHOLD_CYCLES_SYNC)
-          llc_hit_count++;
-        if(sync_delta_time1<LLC_HIT_THRESHOLD_CYCLES_SYNC)
-          llc_hit_count++;        
-        if(sync_delta_time2<LLC_HIT_THRESHOLD_CYCLES_SYNC)
-          llc_hit_count++;        
-        
-        if(llc_hit_count >= 30) 
-          sync_complete=true;
-      }
-
-      rxsync_complete_donetime =  __rdtscp( &sync_junk);
-      /* printf("%llu. \t Bit_Id:%d, Flush-Reload Sync Ends for Rx. Rx-Delta:%llu\n",__rdtsc(), rx_id,sync_delta_time0); */
-
-      rxsync_reached_timevec.push_back(rxsync_reached_donetime);
-      rxsync_start_timevec.push_back(rxsync_start_donetime);
-      rxsync_complete_timevec.push_back(rxsync_complete_donetime);      
-#endif      
-    }
+  for(int l=1; l<num_lanes; l++)
+    pthread_join(rx_lanes[l].thread, NULL);
 
-#if VERBOSE
-    printf("Rx: Curr-BitID:%d, Tx-Bit is:%d, Addr accessed:%#18x, PG_NUM:%d, CL_NUM:%d Time:%d, Rx-Bit:%d,%s\n",curr_bitid,tx_payload[rx_id],addr0,PG_NUM(curr_bitid),CL_NUM(curr_bitid),delta_time0,delta_time0>LLC_HIT_THRESHOLD_CYCLES_COMM?1:0,
-           (delta_time0>LLC_HIT_THRESHOLD_CYCLES_COMM?1:0) == tx_payload[rx_id]?"":"Error");
-#endif
+  uint64_t rx_wall_ns = timer_wall_ns() - rx_wall_start_ns;
 
-    rx_loop_count++;
-  }
- 
-  //Mark End Time
-  rx_end_time = __rdtscp( & junk_temp);
   //Done Rx
   printf("Receiving Done\n");
 
-  //------ Construct Rx-Payload -----------
-  for(uint64_t i=0; i < rx_loop_count; i++){
-    if(rx_time_obs[i] > LLC_HIT_THRESHOLD_CYCLES_COMM)
-      rx_payload[i] = 1; //miss = 1
-    else
-      rx_payload[i] = 0; //hit = 0
+  //------ Wait for the decoder to analyze the remaining Rx-Payload -----------
+  unsigned int junk_temp=0;
+  uint64_t rx_start_time = rx_lanes[0].start_time, rx_end_time = rx_lanes[0].end_time;
+  uint64_t rx_loop_count = 0;
+  for(int l=0; l<num_lanes; l++){
+    if(rx_lanes[l].start_time < rx_start_time)
+      rx_start_time = rx_lanes[l].start_time;
+    if(rx_lanes[l].end_time > rx_end_time)
+      rx_end_time = rx_lanes[l].end_time;
+    rx_loop_count += rx_lanes[l].loop_count;
   }
+  rx_decoder_finish(&rx_decoder);
+  uint64_t rx_decode_tail_cycles = MEM_RDTSCP( & junk_temp) - rx_end_time;
+  if(hist_file != NULL)
+    fclose(hist_file);
 
   //------ Error-Correction and Analysis --------
-  //Calculate Bit Period.
+  //Calculate Bit Period (of all lanes together).
   long bit_period_cycles = (rx_end_time - rx_start_time)/rx_loop_count*1.0; //cycles
-  double freq_mhz = SYS_FREQ_MHZ; 
-  double bit_period_us = (1.0*bit_period_cycles/freq_mhz);
-
-  //Calculate the error-rate:
-  uint64_t total_ones = 0;
-  uint64_t total_samples = 0;
-  uint64_t correct_samples = 0;
-  uint64_t one2zero_error = 0;
-  uint64_t zero2one_error = 0;
- 
-  uint64_t zero_bit_error_blks =0;  
-  uint64_t one_bit_error_blks =0;
-  uint64_t twoplus_bit_error_blks =0;
-  uint64_t tot_blks =0;
-  int bit_errors_in_blk =0;
-  uint64_t bit_id =0, tx_samples=0,tx_correct_samples=0;
-
-  uint64_t data_pkts = NUM_BITS/DATABLK_BITLEN;
-  uint64_t packet_sz ;
-
-#ifdef ECC
-  packet_sz = DATABLK_BITLEN + PARITY_BITLEN;
-#else
-  packet_sz = DATABLK_BITLEN;
-#endif
- 
-  for(uint64_t i=0;i< data_pkts;i++){
-    if(i*packet_sz >= rx_loop_count)
-      break;
-
-    bool tx_packet_enc_bits[72], rx_packet_enc_bits[72];
-    bool tx_packet_dec_bits[64], rx_packet_dec_bits[64];
-    uint8_t tx_packet_enc_bytes[9], rx_packet_enc_bytes[9]; 
-    uint8_t tx_packet_dec_bytes[8], rx_packet_dec_bytes[8];  
-
-    //De-modulate Payload with Channel Encoding.
-    for(int j=0;j<packet_sz;j++){
-      if(bit_id%TX_SYNC_BITFREQ == 0)
-        mt.seed(42); //Mersenne Twister PRNG engine
-     
-      int channel_enc_i = channel_enc(mt);
-      tx_packet_enc_bits[j] = tx_payload[bit_id] ^ channel_enc_i;
-      rx_packet_enc_bits[j] = rx_payload[bit_id] ^ channel_enc_i;
-    
-      if(tx_packet_enc_bits[j] == rx_packet_enc_bits[j])
-        tx_correct_samples++;
-      else
-        tx_payload[bit_id]?one2zero_error++:zero2one_error++;
-
-      if(tx_payload[bit_id])
-        total_ones++;
-
-      bit_id++;
-    }
-    tx_samples = bit_id;
-   
-    //Perform ECC-Decoding 
-#ifdef ECC
-    unsigned int errors;
-    //convert bits to bytes
-    conv_char(tx_packet_enc_bits,9,tx_packet_enc_bytes);
-    conv_char(rx_packet_enc_bits,9,rx_packet_enc_bytes);
-   
-    //decode
-    fec_secded7264_decode(9, tx_packet_enc_bytes, tx_packet_dec_bytes, &errors);
-    fec_secded7264_decode(9, rx_packet_enc_bytes, rx_packet_dec_bytes, &errors);
-
-    //convert bytes to bits
-    string_to_binary(tx_packet_dec_bytes,8,tx_packet_dec_bits);
-    string_to_binary(rx_packet_dec_bytes,8,rx_packet_dec_bits);   
-#endif
-
-    //Check for Errors
-    for(int j=0; j<DATABLK_BITLEN;j++){  
-#ifdef ECC
-      int tx_act = tx_packet_dec_bits[j];
-      int rx_act = rx_packet_dec_bits[j];
-      int tx_transmitted = tx_packet_dec_bits[j];
-#else
-      int tx_act = tx_packet_enc_bits[j];
-      int rx_act = rx_packet_enc_bits[j];
-#endif
-      if(tx_act == rx_act)
-        correct_samples++;
-      else{
-        bit_errors_in_blk++;
-      }
-      total_samples++;
-    }
-   
-    //Calculate type of error, at end of blk.
-    if(bit_errors_in_blk == 0)
-      zero_bit_error_blks++;
-    else if (bit_errors_in_blk == 1)
-      one_bit_error_blks++;
-    else if (bit_errors_in_blk > 1)
-      twoplus_bit_error_blks++;
-
-    //reset bit_errors
-    tot_blks++;
-    bit_errors_in_blk = 0;
-  }
+  double freq_mhz = sys_timer.tsc_mhz; //measured TSC frequency (see timer.hh)
+  double bit_period_us = timer_cycles_to_us(bit_period_cycles);
+  double wall_bit_period_us = rx_wall_ns/1000.0/rx_loop_count;
+
+  //Error-rates:
+  uint64_t total_samples = rx_stream.total_samples;
+  uint64_t correct_samples = rx_stream.correct_samples;
+  uint64_t zero_bit_error_blks = rx_stream.zero_bit_error_blks;
+  uint64_t one_bit_error_blks = rx_stream.one_bit_error_blks;
+  uint64_t twoplus_bit_error_blks = rx_stream.twoplus_bit_error_blks;
+  uint64_t tot_blks = rx_stream.tot_blks;
+  uint64_t packet_sz = rx_stream.packet_sz;
+
+  uint64_t tx_samples = rx_stream.tx_stats.samples;
+  uint64_t tx_correct_samples = rx_stream.tx_stats.samples - rx_stream.tx_stats.errors;
+  uint64_t one2zero_error = rx_stream.tx_stats.one2zero;
+  uint64_t zero2one_error = rx_stream.tx_stats.zero2one;
+  uint64_t total_ones = rx_stream.tx_stats.tx_ones;
 
   //Print Output
   printf("\n-----------------------------\n");
@@ -660,30 +614,138 @@ int main(int argc, char **argv)
          (1.0*DATABLK_BITLEN/packet_sz)*1000000.0/bit_period_us,100.0*correct_samples/total_samples,correct_samples,total_samples,\
          100.0*one2zero_error/tx_samples,100.0*zero2one_error/tx_samples,100.0*total_ones/tx_samples);
   
+  printf("Wall-Clock: %.4f s for %llu bits. Bit Period: %.4fus. Bits/Sec: %.4f bps. (TSC: %.1f MHz, %s)\n",
+         rx_wall_ns/1e9, rx_loop_count, wall_bit_period_us,
+         (1.0*DATABLK_BITLEN/packet_sz)*1000000.0/wall_bit_period_us, freq_mhz, sys_timer.tsc_source);
+  struct fr_barrier_stats barrier_stats = {};
+  struct epoch_stats epoch_stats = {};
+  struct pilot_stats pilot_stats = {};
+  struct sync_adapt_stats adapt_stats = {};
+  uint64_t lane_cycles = 0;
+  for(int l=0; l<num_lanes; l++){
+    fr_barrier_stats_add(&barrier_stats, &rx_lanes[l].barrier.stats);
+    epoch_stats_add(&epoch_stats, &rx_lanes[l].epochs.stats);
+    pilot_stats_add(&pilot_stats, &rx_lanes[l].pilots.stats);
+    sync_adapt_stats_add(&adapt_stats, &rx_lanes[l].adapt.stats);
+    lane_cycles += rx_lanes[l].end_time - rx_lanes[l].start_time;
+  }
+  bool deadline_sync = (params.sync_mode == SYNC_DEADLINE);
+  if(deadline_sync)
+    epoch_print("Rx", &epoch_stats, lane_cycles);
+  else
+    fr_barrier_print("Rx", &barrier_stats, lane_cycles);
+  if(params.sync_adapt_max)
+    sync_adapt_print(&adapt_stats, params.sync_bitfreq);
+  struct bitvec_err_stats* erased_stats = &rx_stream.erased_stats;
+  if(params.pilot_period){
+    pilot_print(&pilot_stats, params.pilot_period, rx_loop_count);
+    printf("Erasures: %llu bits, %.2f%% of them in error. Errors outside the erasures: %.4f%% (%llu/%llu).\n",
+           erased_stats->samples, erased_stats->samples ? 100.0*erased_stats->errors/erased_stats->samples : 0.0,
+           tx_samples > erased_stats->samples ? 100.0*(rx_stream.tx_stats.errors - erased_stats->errors)/(tx_samples - erased_stats->samples) : 0.0,
+           rx_stream.tx_stats.errors - erased_stats->errors, tx_samples - erased_stats->samples);
+  }
+  
   printf("Packet-ErrorType: NoError, \t 1-Bit Error,\t >=2-Bit Errors: \t %.2f%%  \t %.2f%% \
  \t %.2f%% (%llu,%llu,%llu)/%llu. Bit-Error-Perc:(1-Bit,2+): %.2f%% \t %.2f%% \n",
          100.0*zero_bit_error_blks/tot_blks,100.0*one_bit_error_blks/tot_blks, \
          100.0*twoplus_bit_error_blks/tot_blks,zero_bit_error_blks,one_bit_error_blks,twoplus_bit_error_blks,tot_blks,
          100.0*one_bit_error_blks/total_samples,100-100.0*correct_samples/total_samples-100.0*one_bit_error_blks/total_samples);
 
+  //Payload bits per second: the outer code's parity blocks and the repair epochs carry none
+  double data_bps = outer_rate(&params)*epoch_code_rate(&params)*(1.0*DATABLK_BITLEN/packet_sz)*1000000.0/bit_period_us;
+  if(params.ecc && (params.interleave_depth > 1 || params.outer_parity))
+    outer_print(&rx_stream.outer_stats, &params);
+  if(params.epoch_repair)
+    epoch_code_print(&rx_stream.repair_stats, &params);
+  struct soft_stats* soft_stats = &rx_stream.soft_stats;
+  if(rx_stream.rel_ring != NULL)
+    soft_print(soft_stats, params.chase_flips, zero_bit_error_blks, total_samples - correct_samples, tot_blks, data_bps);
+
   printf("Transmission Error Rates: TxCorrectRate=%.2f\% (%llu/%llu).\
  Tx1to0_errors=%.2f\%, Tx0to1_errors=%.2f\%\n",\
          100.0*tx_correct_samples/tx_samples,tx_correct_samples,tx_samples,\
          100.0*one2zero_error/tx_samples,100.0*zero2one_error/tx_samples);
+  printf("Decoder: finished %llu cycles after the last bit. Ring: %llu latencies, %llu bits.\n",
+         rx_decode_tail_cycles, RX_DECODER_RING_ENTRIES, rx_stream_ring_bits(&rx_stream));
+  struct lat_hist_summary lat_summary;
+  lat_hist_summarize(&rx_stream.total_hist, &lat_summary);
+  printf("Latency (cycles, net of the %llu-cycle timer overhead): Sent-0 mean/sd/p50/p99: %.1f/%.1f/%llu/%llu. Sent-1 p1/p50/mean/sd: %llu/%llu/%.1f/%.1f.\
+ Separation=%.2f, Overlap=%.4f, Best-Threshold=%llu (%.4f%% errors)\n",
+         rx_decoder.timer_overhead, lat_summary.mean[0], lat_summary.sd[0], lat_summary.p50[0], lat_summary.p99[0],
+         lat_summary.p1[1], lat_summary.p50[1], lat_summary.mean[1], lat_summary.sd[1],
+         lat_summary.separation, lat_summary.overlap, lat_summary.best_threshold, 100.0*lat_summary.best_error);
+  struct train_stats* train_stats = &rx_decoder.train_stats;
+  if(train_stats->epochs)
+    printf("Adaptive Threshold: %llu epochs, %llu fits rejected. Threshold (min/mean/max): %llu/%.1f/%llu cycles (net).\n",
+           train_stats->epochs, train_stats->rejected, train_stats->min,
+           1.0*train_stats->sum/train_stats->epochs, train_stats->max);
+  else
+    printf("Fixed Threshold: %llu cycles.\n", LLC_HIT_THRESHOLD_CYCLES_COMM);
+  if(num_lanes > 1){
+    printf("Lanes: %d. Lane, Tx-CPU, Rx-CPU, Bits, Bit Period (cycles), Bits/Sec, TxCorrectRate, Tx1to0_errors, Tx0to1_errors, RXSync-Timeouts\n", num_lanes);
+    for(int l=0; l<num_lanes; l++){
+      struct rx_lane* lane = &rx_lanes[l];
+      struct bitvec_err_stats* st = &rx_stream.lane_stats[l];
+      double lane_period = 1.0*(lane->end_time - lane->start_time)/lane->loop_count;
+      printf("Lane %d \t %d \t %d \t %llu \t %.1f \t %.4f bps \t %.2f%% \t %.2f%% \t %.2f%% \t %zu\n",
+             l, (l == 0) ? tx_cpuid : LANE_TX_CPUID(l), lane->cpuid, lane->loop_count, lane_period,
+             (1.0*DATABLK_BITLEN/packet_sz)*freq_mhz*1000000.0/lane_period,
+             100.0*(st->samples - st->errors)/st->samples, 100.0*st->one2zero/st->samples, 100.0*st->zero2one/st->samples,
+             lane->debug_timeout_bitid.size());
+    }
+  }
   printf("-----------------------------\n\n");
 
-#ifndef ECC
+  //Result line for the orchestrator
+  if(config.result_fd >= 0){
+    struct run_result result;
+    result.metric[METRIC_BIT_PERIOD] = bit_period_cycles;
+    result.metric[METRIC_BPS] = (1.0*DATABLK_BITLEN/packet_sz)*1000000.0/bit_period_us;
+    result.metric[METRIC_WALL_BPS] = (1.0*DATABLK_BITLEN/packet_sz)*1000000.0/wall_bit_period_us;
+    result.metric[METRIC_BER] = 100 - 100.0*correct_samples/total_samples;
+    result.metric[METRIC_BER10] = 100.0*one2zero_error/tx_samples;
+    result.metric[METRIC_BER01] = 100.0*zero2one_error/tx_samples;
+    result.metric[METRIC_BER1BIT] = 100.0*one_bit_error_blks/total_samples;
+    result.metric[METRIC_BERMULTIBIT] = 100-100.0*correct_samples/total_samples-100.0*one_bit_error_blks/total_samples;
+    result.metric[METRIC_TX_CORRECT] = 100.0*tx_correct_samples/tx_samples;
+    result.metric[METRIC_SEPARATION] = lat_summary.separation;
+    result.metric[METRIC_OVERLAP] = lat_summary.overlap;
+    result.metric[METRIC_BEST_THRESHOLD] = lat_summary.best_threshold;
+    result.metric[METRIC_SYNC_OVERHEAD] = deadline_sync ? epoch_overhead(&epoch_stats, lane_cycles)
+                                                        : fr_barrier_overhead(&barrier_stats, lane_cycles);
+    result.metric[METRIC_MISSED_DEADLINES] = epoch_stats.late;
+    result.metric[METRIC_ERASED] = 100.0*erased_stats->samples/tx_samples;
+    result.metric[METRIC_SYNC_INTERVAL] = sync_adapt_interval(&adapt_stats, params.sync_bitfreq);
+    result.metric[METRIC_GOODPUT] = soft_goodput(zero_bit_error_blks, tot_blks, data_bps);
+    result.metric[METRIC_GOODPUT_HARD] = soft_goodput(rx_stream.rel_ring != NULL ? soft_stats->hard_good_blks : zero_bit_error_blks,
+                                                      tot_blks, data_bps);
+    if(!run_result_write(config.result_fd, &result))
+      printf("Warning: could not write the result line to fd %d\n", config.result_fd);
+    close(config.result_fd);
+  }
+
 #ifdef PROGRESS_HEARTBEAT
+  //Per-epoch report of the single-lane channel (without ECC)
+  if(num_lanes == 1 && !params.ecc){
+  std::vector<uint64_t>& rxsync_reached_timevec = rx_lanes[0].rxsync_reached_timevec;
+  std::vector<uint64_t>& rxsync_start_timevec = rx_lanes[0].rxsync_start_timevec;
+  std::vector<uint64_t>& rxsync_complete_timevec = rx_lanes[0].rxsync_complete_timevec;
+  std::vector<uint64_t>& debug_rxsync_time = rx_lanes[0].debug_rxsync_time;
+  std::vector<uint64_t>& debug_timeout_duration = rx_lanes[0].debug_timeout_duration;
+  std::vector<uint64_t>& debug_timeout_bitid = rx_lanes[0].debug_timeout_bitid;
 
   // Post-Processing Debugging Output for Epochs where Receiver Timeout used
   std::vector<uint64_t> rxsync_epoch_miss;
   uint64_t rxsync_miss = 0;
 
-  for (int i=0;i<NUM_BITS/TX_SYNC_BITFREQ; i++){
+  for (uint64_t i=0;i<NUM_BITS/params.sync_bitfreq; i++){
    
     uint64_t rxsync_time = rxsync_complete_timevec[i] - rxsync_reached_timevec[i];
    
-    if(rxsync_time > 0.9 * RX_SYNC_TIMEOUT ){
+    //Barrier: timed out. Deadline: reached after the deadline (start column: the deadline)
+    bool rxsync_missed = deadline_sync ? rxsync_reached_timevec[i] > rxsync_start_timevec[i]
+                                       : rxsync_time > 0.9 * params.rx_sync_timeout;
+    if(rxsync_missed){
       rxsync_epoch_miss.push_back(1);
       rxsync_miss++;
     }
@@ -696,64 +758,31 @@ int main(int argc, char **argv)
   printf("BitID(in1000s), \t Correct-Tx-rate, \t 1->0.Error, \t 0->1.Error.\
  RX_SYNCREACH_TIME, RX_SYNCSTART_TIME, RX_SYNCCOMPLETE_TIME \n");
 
-  uint64_t epoch_id=0;
-  uint64_t epoch_correct_samples=0,epoch_num_samples=0;
-  uint64_t epoch_one2zero_error = 0, epoch_zero2one_error = 0;
-
- 
-  for(uint64_t i=0; i<NUM_BITS; i++){
-    //breaking condition.
-    if(i >= rx_loop_count)
-      break;
-
-    // printf("%d\n",i);
-    epoch_num_samples++;
-
-    //Modulate Payload with Channel Encoding.
-    if(i%TX_SYNC_BITFREQ == 0)
-      mt.seed(42); //Mersenne Twister PRNG engine
-     
-    int channel_enc_i = channel_enc(mt);
-    int tx_act = tx_payload[i] ^ channel_enc_i;
-    int rx_act = rx_payload[i] ^ channel_enc_i;
-
-    if(tx_act == rx_act)
-      epoch_correct_samples++;
-    else
-      tx_payload[i]?epoch_one2zero_error++:epoch_zero2one_error++;
-
-    //End of a epoch
-    if( (i % HEARTBEAT_FREQ) == (HEARTBEAT_FREQ - 1) ) {
-
-      if(epoch_id % (TX_SYNC_BITFREQ/HEARTBEAT_FREQ) == 0 ){
-        int sync_id = i/TX_SYNC_BITFREQ;
-        //BitID(in1000Bits), \t Correct-Tx-rate, \t 1->0.Error, \t 0->1.Error. \
-        RX_SYNCREACH_TIME, RX_SYNCSTART_TIME, RX_SYNCCOMPLETE_TIME 
-        printf("%llu \t %.2f\% \t %.2f\% \t %.2f\% \t %lld \t %lld \t %lld \t %d \n", \
-               epoch_id,100.0*epoch_correct_samples/epoch_num_samples,
-               100.0*epoch_one2zero_error/epoch_num_samples,100.0*epoch_zero2one_error/epoch_num_samples, \
-               rxsync_reached_timevec[sync_id], \
-               rxsync_start_timevec[sync_id]-rxsync_reached_timevec[sync_id],
-               rxsync_complete_timevec[sync_id]-rxsync_reached_timevec[sync_id],rxsync_epoch_miss[sync_id]);
-      }
-      
-      epoch_id++;
-      epoch_correct_samples = 0;
-      epoch_num_samples=0;
-      epoch_zero2one_error =0;
-      epoch_one2zero_error =0;
-    }
-    
+  //Only the first heartbeat-epoch of every sync-epoch is reported.
+  for(uint64_t sync_id=0; sync_id<rx_stream.epoch_stats.size() && sync_id<rxsync_epoch_miss.size(); sync_id++){
+    struct bitvec_err_stats* epoch_stats = &rx_stream.epoch_stats[sync_id];
+    uint64_t epoch_id = sync_id*(params.sync_bitfreq/params.heartbeat_freq);
+    uint64_t epoch_num_samples = epoch_stats->samples;
+    uint64_t epoch_correct_samples = epoch_stats->samples - epoch_stats->errors;
+
+    //BitID(in1000Bits), \t Correct-Tx-rate, \t 1->0.Error, \t 0->1.Error. \
+    RX_SYNCREACH_TIME, RX_SYNCSTART_TIME, RX_SYNCCOMPLETE_TIME 
+    printf("%llu \t %.2f\% \t %.2f\% \t %.2f\% \t %lld \t %lld \t %lld \t %llu \n", \
+           epoch_id,100.0*epoch_correct_samples/epoch_num_samples,
+           100.0*epoch_stats->one2zero/epoch_num_samples,100.0*epoch_stats->zero2one/epoch_num_samples, \
+           rxsync_reached_timevec[sync_id], \
+           rxsync_start_timevec[sync_id]-rxsync_reached_timevec[sync_id],
+           rxsync_complete_timevec[sync_id]-rxsync_reached_timevec[sync_id],rxsync_epoch_miss[sync_id]);
   }
 
-  printf("RXSync-Misses: %d in %llu bits\n",rxsync_miss,NUM_BITS);
+  printf("RXSync-Misses: %llu in %llu bits\n",rxsync_miss,NUM_BITS);
 
-  for(int j=0; j< debug_rxsync_time.size();j++){
+  for(uint64_t j=0; j< debug_rxsync_time.size();j++){
     printf("Bit-ID:%llu, RX-Sync-Delay:%llu, Rx-Sync-Timeout:%llu\n",\
            debug_timeout_bitid[j],debug_rxsync_time[j],debug_timeout_duration[j]);
   }
+  }
  
-#endif
 #endif
  
   printf("Receiver finished\n");
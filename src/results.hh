@@ -0,0 +1,95 @@
+// Copyright (C) 2020, Gururaj Saileshwar
+
+// Commentary:
+// Result record of one receiver run, exchanged with the experiment
+// orchestrator.
+//
+// With -R <fd>, the receiver writes its results to the file descriptor fd as
+// one text line: "RESULT" followed by name=value pairs for the metrics below
+// (the same values as the Bit Period / Bit-Error / Transmission Error / Latency
+// / Barriers (or Epochs) lines of its report). The orchestrator parses the line instead of scraping the report.
+
+#ifndef RESULTS_H_
+#define RESULTS_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+enum run_metric {
+  METRIC_BIT_PERIOD,    //cycles
+  METRIC_BPS,           //bits per second (bit period in TSC cycles, at the TSC frequency)
+  METRIC_WALL_BPS,      //bits per second (wall-clock time of the reception)
+  METRIC_BER,           //% of bits received erroneously (100 - FinalCorrectSamples)
+  METRIC_BER10,         //% of transmitted bits sent as 1 and received as 0
+  METRIC_BER01,         //% of transmitted bits sent as 0 and received as 1
+  METRIC_BER1BIT,       //% of bits in 8-byte packets with a 1-bit error
+  METRIC_BERMULTIBIT,   //% of bits in 8-byte packets with multi-bit errors
+  METRIC_TX_CORRECT,    //% of transmitted bits received correctly
+  METRIC_SEPARATION,    //distance of the hit and miss latency means, in standard deviations
+  METRIC_OVERLAP,       //overlap of the hit and miss latency histograms (0..1)
+  METRIC_BEST_THRESHOLD,//threshold (cycles) with the fewest errors on the latency histograms
+  METRIC_SYNC_OVERHEAD, //% of the receiver's cycles in the sync barriers (or waiting for the epoch deadlines)
+  METRIC_MISSED_DEADLINES, //epoch deadlines the receiver reached late (-E deadline)
+  METRIC_ERASED,        //% of transmitted bits the receiver marked as erasures (-P)
+  METRIC_SYNC_INTERVAL, //bits between the barriers, on average (the sync period, unless -D)
+  METRIC_GOODPUT,       //bits per second of data in error-free 8-byte packets
+  METRIC_GOODPUT_HARD,  //goodput with hard-decision ECC decoding (the goodput, unless -C)
+  NUM_METRICS
+};
+
+static const char* run_metric_names[NUM_METRICS] = {
+  "bit_period_cycles", "bps", "wall_bps", "ber", "ber10", "ber01", "ber1bit", "bermultibit", "tx_correct",
+  "separation", "overlap", "best_threshold", "sync_overhead", "missed_deadlines", "erased",
+  "sync_interval", "goodput", "goodput_hard"
+};
+
+struct run_result {
+  double metric[NUM_METRICS];
+};
+
+#define RUN_RESULT_TAG "RESULT"
+#define RUN_RESULT_LINE_MAX (1024)
+
+/*
+ * Writes the result line to fd. Returns false if it could not be written.
+ */
+static bool run_result_write(int fd, const struct run_result* r)
+{
+  char line[RUN_RESULT_LINE_MAX];
+  int len = snprintf(line, sizeof(line), RUN_RESULT_TAG);
+  for(int m=0; m<NUM_METRICS; m++)
+    len += snprintf(line + len, sizeof(line) - len, " %s=%.6f", run_metric_names[m], r->metric[m]);
+  len += snprintf(line + len, sizeof(line) - len, "\n");
+  return write(fd, line, len) == len;
+}
+
+/*
+ * Parses the first result line in buf. Returns false if there is none, or if
+ * a metric is missing.
+ */
+static bool run_result_parse(const char* buf, struct run_result* r)
+{
+  const char* line = strstr(buf, RUN_RESULT_TAG " ");
+  if(line == NULL)
+    return false;
+  const char* end = strchr(line, '\n');
+  if(end == NULL)
+    return false;
+
+  for(int m=0; m<NUM_METRICS; m++){
+    char key[64];
+    int klen = snprintf(key, sizeof(key), " %s=", run_metric_names[m]);
+    const char* pos = strstr(line, key);
+    if(pos == NULL || pos > end)
+      return false;
+    r->metric[m] = strtod(pos + klen, NULL);
+  }
+  return true;
+}
+
+#endif
+
+//
+// results.hh ends here
@@ -0,0 +1,286 @@
+// Copyright (C) 2020, Gururaj Saileshwar
+
+// Commentary:
+// Concurrent demodulation of received bits on a helper core.
+//
+// The pinned receiver loop only stores each measured latency into a lock-free
+// single-producer/single-consumer ring. A decoder thread thresholds the
+// latencies into packed bits and runs the streaming analysis (de-whitening,
+// ECC-decoding, per-epoch statistics) while reception continues.
+//
+// The latencies of the training bits of every sync epoch go to a small ring of
+// their own; the decoder fits the threshold of each epoch on them (see training.hh).
+//
+// The decoder subtracts the timer overhead (see timer.hh) from the latencies,
+// so the thresholds, raw latencies aside, are net of it.
+//
+// With several lanes, every lane's receiver has its own ring and the decoder
+// reassembles the striped words in global order (see lanes.hh).
+//
+// With soft-decision decoding, the decoder also fits the reliability model of
+// each epoch on its training latencies, and keeps the reliability of every bit
+// (see soft_decode.hh).
+//
+// With pilots, the receiver publishes a span of latencies at a time, after
+// flagging them as erasures if the span slipped (see pilot.hh).
+
+#ifndef RX_DECODER_H_
+#define RX_DECODER_H_
+
+#include <atomic>
+
+#include "utils.hh"
+#include "rx_stream.hh"
+#include "lanes.hh"
+#include "training.hh"
+#include "soft_decode.hh"
+
+// Latencies buffered between each receiver and the decoder (power of two).
+#define RX_DECODER_RING_ENTRIES ((uint64_t)1 << 17)
+// The receiver publishes its progress once every RX_DECODER_BATCH latencies.
+#define RX_DECODER_BATCH (BITVEC_WORD_BITS)
+// Latencies are stored saturated to 15 bits, with the erasure flag above them.
+#define RX_LATENCY_MAX (0x7FFF)
+#define RX_LATENCY_ERASED (0x8000)
+
+//SPSC ring of latencies: written by one lane's receiver, read by the decoder.
+struct rx_lat_ring {
+  uint16_t* lat;
+  uint16_t* train_lat;                      //training latencies of the epochs in flight
+  uint64_t train_slots;
+  alignas(64) std::atomic<uint64_t> head;  //latencies published by the receiver
+  uint64_t tail_cache;                      //receiver's view of tail
+  alignas(64) std::atomic<uint64_t> tail;  //latencies consumed by the decoder
+};
+
+struct rx_decoder {
+  struct rx_lat_ring* rings;  //one per lane
+  uint64_t lat_mask;
+  int num_lanes;
+  std::atomic<bool> done;     //all receivers finished (heads are final)
+
+  //Decoder state
+  struct rx_stream* rs;
+  uint64_t sync_bitfreq;
+  uint64_t train_bits;
+  uint64_t timer_overhead;              //cycles of an empty timed section
+  uint64_t lane_threshold[MAX_LANES];   //hit/miss threshold (cycles) of the current epoch of every lane
+  uint64_t lane_next_epoch[MAX_LANES];  //lane-local position of the next epoch of every lane
+  bool soft;                            //reliabilities of the bits (soft-decision decoding)
+  struct soft_model lane_soft[MAX_LANES]; //reliability model of the current epoch of every lane
+  struct train_stats train_stats;
+  uint64_t* raw_obs;          //first raw_samples latencies
+  uint64_t raw_samples;
+  int cpuid;
+  pthread_t thread;
+};
+
+/*
+ * Fits the threshold of the epoch of a lane that starts at the lane-local
+ * position lane_next_epoch, on its training latencies.
+ */
+static void rx_decoder_fit_epoch(struct rx_decoder* dec, int lane)
+{
+  struct rx_lat_ring* ring = &dec->rings[lane];
+  uint64_t epoch = dec->lane_next_epoch[lane]/dec->sync_bitfreq;
+  const uint16_t* train_lat = &ring->train_lat[(epoch % ring->train_slots)*dec->train_bits];
+
+  //Fitted on the raw latencies
+  struct train_fit fit;
+  bool fitted = train_fit_model(train_lat, dec->train_bits, &fit);
+  if(fitted){
+    dec->lane_threshold[lane] = fit.threshold > dec->timer_overhead ? fit.threshold - dec->timer_overhead : 0;
+    soft_model_fit(&dec->lane_soft[lane], &fit, dec->timer_overhead);
+  }
+  train_stats_add(&dec->train_stats, dec->lane_threshold[lane], fitted);
+  dec->lane_next_epoch[lane] += dec->sync_bitfreq;
+}
+
+/*
+ * Decoder thread: drain published latencies into the streaming analysis,
+ * taking every word from the lane that carries it.
+ */
+static void* rx_decoder_thread(void* arg)
+{
+  struct rx_decoder* dec = (struct rx_decoder*) arg;
+  struct rx_stream* rs = dec->rs;
+  uint64_t pos = 0;
+  uint64_t rx_word = 0, erased_word = 0;
+
+  if(dec->cpuid >= 0){
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    CPU_SET(dec->cpuid, &mask);
+    if(pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask) != 0)
+      printf("Warning: Rx-Decoder could not be pinned to CPU %d\n", dec->cpuid);
+  }
+
+  while(true){
+    bool done = dec->done.load(std::memory_order_acquire);
+
+    //Lane and lane-local position of the next bit
+    uint64_t w = pos / LANE_STRIPE_BITS;
+    int lane = lane_of_word(w, dec->num_lanes);
+    struct rx_lat_ring* ring = &dec->rings[lane];
+    uint64_t lpos = lane_word(w, dec->num_lanes)*LANE_STRIPE_BITS + pos % LANE_STRIPE_BITS;
+    uint64_t lend = lpos - pos % LANE_STRIPE_BITS + LANE_STRIPE_BITS;
+
+    uint64_t head = ring->head.load(std::memory_order_acquire);
+    if(head <= lpos){
+      //The first lane without the next word marks the end.
+      if(done)
+        break;
+      rx_stream_drain(rs, false);
+      sched_yield();
+      continue;
+    }
+    if(head > lend)
+      head = lend;
+
+    for(; lpos < head; lpos++, pos++){
+      if(lpos == dec->lane_next_epoch[lane])
+        rx_decoder_fit_epoch(dec, lane);
+      uint64_t threshold = dec->lane_threshold[lane];
+      uint64_t latency = ring->lat[lpos & dec->lat_mask];
+      bool erased = latency & RX_LATENCY_ERASED;
+      latency &= RX_LATENCY_MAX;
+      if(pos < dec->raw_samples)
+        dec->raw_obs[pos] = latency;
+      latency = latency > dec->timer_overhead ? latency - dec->timer_overhead : 0;
+      uint8_t rel = (dec->soft && !erased) ? soft_reliability(&dec->lane_soft[lane], latency) : 0;
+      rx_stream_push_latency(rs, latency, rel);
+
+      //miss = 1, hit = 0
+      rx_word = (rx_word << 1) | (uint64_t)(latency > threshold);
+      erased_word = (erased_word << 1) | (uint64_t)erased;
+      if( (pos % BITVEC_WORD_BITS) == (BITVEC_WORD_BITS - 1) )
+        rx_stream_push_word(rs, rx_word, erased_word);
+    }
+    ring->tail.store(lpos, std::memory_order_release);
+
+    if(rs->stored_bits - rs->analyzed_bits >= RX_CHUNK_BITS)
+      rx_stream_drain(rs, false);
+  }
+
+  rx_stream_finish(rs, pos, rx_word, erased_word);
+  return NULL;
+}
+
+/*
+ * Starts the decoder, with the hit/miss threshold (raw cycles) used until the
+ * first fit (or in every epoch, without training bits).
+ */
+static void rx_decoder_start(struct rx_decoder* dec, struct rx_stream* rs, const uint64_t* threshold,
+                             const struct channel_params* p, uint64_t* raw_obs, uint64_t raw_samples,
+                             int cpuid, int num_lanes)
+{
+  dec->num_lanes = num_lanes;
+  dec->rings = new struct rx_lat_ring[num_lanes];
+  dec->lat_mask = RX_DECODER_RING_ENTRIES - 1;
+  //The receiver is at most a ring (and a batch, or a span of pilots) of latencies ahead of the decoder.
+  uint64_t batch = p->pilot_period > RX_DECODER_BATCH ? p->pilot_period : RX_DECODER_BATCH;
+  uint64_t train_slots = (RX_DECODER_RING_ENTRIES + batch)/p->sync_bitfreq + 2;
+  for(int l=0; l<num_lanes; l++){
+    dec->rings[l].lat = (uint16_t*) calloc(RX_DECODER_RING_ENTRIES, sizeof(uint16_t));
+    dec->rings[l].train_lat = (uint16_t*) calloc(train_slots*p->train_bits + 1, sizeof(uint16_t));
+    dec->rings[l].train_slots = train_slots;
+    dec->rings[l].head.store(0);
+    dec->rings[l].tail.store(0);
+    dec->rings[l].tail_cache = 0;
+  }
+  dec->done.store(false);
+
+  dec->rs = rs;
+  dec->sync_bitfreq = p->sync_bitfreq;
+  dec->train_bits = p->train_bits;
+  dec->timer_overhead = sys_timer.rdtscp_overhead;
+  for(int l=0; l<num_lanes; l++){
+    dec->lane_threshold[l] = *threshold > dec->timer_overhead ? *threshold - dec->timer_overhead : 0;
+    dec->lane_next_epoch[l] = p->train_bits ? 0 : UINT64_MAX;
+    soft_model_init(&dec->lane_soft[l], dec->lane_threshold[l]);
+  }
+  dec->soft = p->ecc && p->chase_flips;
+  train_stats_init(&dec->train_stats);
+  dec->raw_obs = raw_obs;
+  dec->raw_samples = raw_samples;
+  dec->cpuid = cpuid;
+
+  if(pthread_create(&dec->thread, NULL, rx_decoder_thread, dec) != 0){
+    printf("Failed to create Rx-Decoder thread\n");
+    exit(1);
+  }
+}
+
+/*
+ * Receiver side: store the latency of (lane-local) bit rx_id (one store per bit).
+ */
+inline __attribute__((always_inline))
+void rx_decoder_store(struct rx_lat_ring* ring, uint64_t lat_mask, uint64_t rx_id, uint64_t latency)
+{
+  ring->lat[rx_id & lat_mask] = (uint16_t)(latency > RX_LATENCY_MAX ? RX_LATENCY_MAX : latency);
+}
+
+/*
+ * Receiver side: training latencies of (lane-local) sync epoch epoch.
+ */
+static inline uint16_t* rx_decoder_train_slot(struct rx_lat_ring* ring, uint64_t epoch, uint64_t train_bits)
+{
+  return &ring->train_lat[(epoch % ring->train_slots)*train_bits];
+}
+
+/*
+ * Receiver side: flag the stored latencies of (lane-local) bits [from, to] as erasures.
+ */
+static void rx_decoder_erase(struct rx_lat_ring* ring, uint64_t lat_mask, uint64_t from, uint64_t to)
+{
+  for(uint64_t rx_id=from; rx_id<=to; rx_id++)
+    ring->lat[rx_id & lat_mask] |= RX_LATENCY_ERASED;
+}
+
+/*
+ * Receiver side: publish the first count latencies, and wait (rarely) until the
+ * decoder has freed the slots for the next span of latencies.
+ */
+inline __attribute__((always_inline))
+void rx_decoder_publish_span(struct rx_lat_ring* ring, uint64_t count, uint64_t span)
+{
+  ring->head.store(count, std::memory_order_release);
+  while(count + span - ring->tail_cache > RX_DECODER_RING_ENTRIES)
+    ring->tail_cache = ring->tail.load(std::memory_order_acquire);
+}
+
+/*
+ * Receiver side: publish the first count latencies, with room for the next batch.
+ */
+inline __attribute__((always_inline))
+void rx_decoder_publish(struct rx_lat_ring* ring, uint64_t count)
+{
+  rx_decoder_publish_span(ring, count, RX_DECODER_BATCH);
+}
+
+/*
+ * Receiver side: publish the final count of a lane.
+ */
+static void rx_decoder_close_lane(struct rx_lat_ring* ring, uint64_t count)
+{
+  ring->head.store(count, std::memory_order_release);
+}
+
+/*
+ * Wait for the decoder to finish, once every lane is closed.
+ */
+static void rx_decoder_finish(struct rx_decoder* dec)
+{
+  dec->done.store(true, std::memory_order_release);
+  pthread_join(dec->thread, NULL);
+  for(int l=0; l<dec->num_lanes; l++){
+    free(dec->rings[l].lat);
+    free(dec->rings[l].train_lat);
+  }
+  delete[] dec->rings;
+}
+
+#endif
+
+//
+// rx_decoder.hh ends here
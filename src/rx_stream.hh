@@ -0,0 +1,541 @@
+// Copyright (C) 2020, Gururaj Saileshwar
+
+// Commentary:
+// Streaming receiver analysis with constant memory.
+//
+// The receiver loop thresholds every sample as it arrives and appends the bit
+// to a fixed-size ring of packed words. The ring is analyzed one chunk at a time
+// against the expected payload, which is regenerated chunk by chunk, so memory
+// use does not depend on the number of transmitted bits.
+//
+// The latency of every bit is kept in a parallel ring, so that the analysis can
+// histogram the latencies of the bits sent as 0 and as 1 of every sync epoch
+// (see lat_hist.hh). Finished epochs are written to hist_file, if any.
+//
+// Bits the receiver marked as erasures (see pilot.hh) are flagged in a third
+// parallel ring, and their errors counted apart.
+//
+// With soft-decision decoding (see soft_decode.hh), the reliability of every
+// bit is kept in a fourth one, and the hard decoding of the ECC blocks is
+// counted apart, to compare the two.
+//
+// With the interleaver (see interleave.hh), the channel bits of a chunk are
+// de-modulated and de-interleaved back into blocks before the decoding, and
+// with the outer code (see outer_code.hh), its frames are decoded after
+// SEC-DED. The channel statistics stay on the channel bits, and the payload
+// ones leave out the parity blocks of the outer code.
+//
+// With the erasure code across epochs (see epoch_code.hh), the chunks of a
+// group are analyzed only once it is received in full, and its lost epochs
+// rebuilt: the payload is decoded from the rebuilt bits (with the highest
+// reliability), the channel statistics from the received ones. The ring then
+// holds a group and a chunk at least.
+
+#ifndef RX_STREAM_H_
+#define RX_STREAM_H_
+
+#include "utils.hh"
+#include "bitvec.hh"
+#include "payload.hh"
+#include "lanes.hh"
+#include "lat_hist.hh"
+#include "soft_decode.hh"
+
+// Chunk of analysis (see PAYLOAD_CHUNK_BITS).
+#define RX_CHUNK_BITS (PAYLOAD_CHUNK_BITS)
+#define RX_CHUNK_WORDS (RX_CHUNK_BITS/BITVEC_WORD_BITS)
+// Number of chunks in the ring of received bits.
+#define RX_RING_CHUNKS (64)
+
+struct rx_stream {
+  //Ring of received bits
+  struct bitvec ring;
+  uint64_t ring_widx;         //next word of the ring to be written
+  uint64_t stored_bits;       //bits written to the ring
+  uint64_t analyzed_bits;     //bits consumed by the analysis
+  uint16_t* lat_ring;         //latency of every bit of the ring
+  uint64_t lat_widx;
+  struct bitvec erased_ring;  //erasure flag of every bit of the ring
+  uint8_t* rel_ring;          //reliability of every bit of the ring (NULL: hard decoding)
+
+  //Expected bits of the chunk under analysis
+  struct bitvec tx_chunk;
+  struct payload_gen gen;
+
+  //De-interleaved blocks of the chunk under analysis (interleave_depth > 1)
+  struct bitvec demod_chunk, tx_blocks, rx_blocks;
+  uint8_t* rel_blocks;
+
+  //Erasure code across epochs: state of every epoch (set by the receiver), rebuilt bits of the last two groups
+  struct epoch_code epochs;
+  uint8_t* epoch_state;
+  uint64_t num_epochs;
+  uint64_t decoded_groups;
+  struct bitvec group_bits[2];
+  struct bitvec fixed_chunk;  //received bits of the chunk under analysis, with the rebuilt epochs
+
+  //Parameters
+  uint64_t num_bits;          //payload bits
+  uint64_t transmitted_bits;  //payload and parity bits
+  uint64_t packet_sz;
+  uint64_t sync_bitfreq;
+  uint64_t heartbeat_freq;
+  bool ecc;
+  int chase_flips;
+  int num_lanes;
+  uint64_t interleave_depth;
+  struct outer_code outer;
+
+  //Results
+  struct bitvec_err_stats tx_stats;         //channel errors
+  struct bitvec_err_stats erased_stats;     //channel errors of the erasures (among tx_stats)
+  uint64_t total_samples, correct_samples;  //payload errors (after ECC)
+  uint64_t zero_bit_error_blks, one_bit_error_blks, twoplus_bit_error_blks, tot_blks;
+  struct soft_stats soft_stats;             //soft-decision decoding, and the hard decoding of the same blocks
+  struct outer_stats outer_stats;
+  struct epoch_code_stats repair_stats;
+  std::vector<struct bitvec_err_stats> epoch_stats; //first heartbeat of every sync epoch
+  struct bitvec_err_stats lane_stats[MAX_LANES];     //channel errors of every lane (all received bits)
+  struct lat_hist epoch_hist;   //latencies of the current sync epoch
+  struct lat_hist total_hist;   //latencies of the finished epochs
+  uint64_t hist_epoch;
+  FILE* hist_file;              //per-epoch histograms (NULL: not exported)
+};
+
+static inline uint64_t rx_stream_ring_bits(const struct rx_stream* rs)
+{
+  return rs->ring.num_bits;
+}
+
+/*
+ * Exports the latency histograms of every sync epoch to the csv file f.
+ */
+static void rx_stream_export_hist(struct rx_stream* rs, FILE* f)
+{
+  rs->hist_file = f;
+  lat_hist_write_header(f);
+}
+
+static void rx_stream_init(struct rx_stream* rs, uint64_t num_bits, uint64_t transmitted_bits,
+                           const struct channel_params* p, int num_lanes)
+{
+  //A group of the erasure code is analyzed once complete
+  uint64_t ring_chunks = RX_RING_CHUNKS;
+  if(p->epoch_repair && p->epoch_group*p->sync_bitfreq/RX_CHUNK_BITS + 3 > ring_chunks)
+    ring_chunks = p->epoch_group*p->sync_bitfreq/RX_CHUNK_BITS + 3;
+  bitvec_alloc(&rs->ring, RX_CHUNK_BITS*ring_chunks);
+  rs->ring_widx = 0;
+  rs->stored_bits = 0;
+  rs->analyzed_bits = 0;
+  rs->lat_ring = (uint16_t*) calloc(rx_stream_ring_bits(rs), sizeof(uint16_t));
+  rs->lat_widx = 0;
+  bitvec_alloc(&rs->erased_ring, rx_stream_ring_bits(rs));
+  rs->rel_ring = (p->ecc && p->chase_flips) ? (uint8_t*) calloc(rx_stream_ring_bits(rs), sizeof(uint8_t)) : NULL;
+
+  bitvec_alloc(&rs->tx_chunk, RX_CHUNK_BITS);
+  payload_gen_init(&rs->gen, p, transmitted_bits);
+  epoch_code_init(&rs->epochs, p, transmitted_bits);
+  rs->num_epochs = (transmitted_bits + p->sync_bitfreq - 1)/p->sync_bitfreq;
+  rs->epoch_state = (uint8_t*) calloc(rs->num_epochs + 1, sizeof(uint8_t));
+  rs->decoded_groups = 0;
+  if(rs->epochs.groups){
+    for(int i=0; i<2; i++)
+      bitvec_alloc(&rs->group_bits[i], epoch_code_group_bits(&rs->epochs));
+    bitvec_alloc(&rs->fixed_chunk, RX_CHUNK_BITS);
+  }
+
+  rs->num_bits = num_bits;
+  rs->transmitted_bits = transmitted_bits;
+  rs->ecc = p->ecc;
+  rs->chase_flips = p->chase_flips;
+  rs->packet_sz = p->ecc ? DATABLK_BITLEN + PARITY_BITLEN : DATABLK_BITLEN;
+  rs->sync_bitfreq = p->sync_bitfreq;
+  rs->heartbeat_freq = p->heartbeat_freq;
+  rs->num_lanes = num_lanes;
+  rs->interleave_depth = p->ecc ? p->interleave_depth : 1;
+  outer_code_init(&rs->outer, p);
+  rs->rel_blocks = NULL;
+  if(rs->interleave_depth > 1){
+    bitvec_alloc(&rs->demod_chunk, RX_CHUNK_BITS);
+    bitvec_alloc(&rs->tx_blocks, RX_CHUNK_BITS);
+    bitvec_alloc(&rs->rx_blocks, RX_CHUNK_BITS);
+    if(rs->rel_ring != NULL)
+      rs->rel_blocks = (uint8_t*) calloc(RX_CHUNK_BITS, sizeof(uint8_t));
+  }
+
+  memset(&rs->tx_stats, 0, sizeof(rs->tx_stats));
+  memset(&rs->erased_stats, 0, sizeof(rs->erased_stats));
+  rs->total_samples = rs->correct_samples = 0;
+  rs->zero_bit_error_blks = rs->one_bit_error_blks = rs->twoplus_bit_error_blks = rs->tot_blks = 0;
+  memset(&rs->soft_stats, 0, sizeof(rs->soft_stats));
+  memset(&rs->outer_stats, 0, sizeof(rs->outer_stats));
+  memset(&rs->repair_stats, 0, sizeof(rs->repair_stats));
+  rs->epoch_stats.clear();
+  memset(rs->lane_stats, 0, sizeof(rs->lane_stats));
+  lat_hist_reset(&rs->epoch_hist);
+  lat_hist_reset(&rs->total_hist);
+  rs->hist_epoch = 0;
+  rs->hist_file = NULL;
+}
+
+/*
+ * Keep the latency of the next received bit, and its reliability with
+ * soft-decision decoding (before its word is appended).
+ */
+inline __attribute__((always_inline))
+void rx_stream_push_latency(struct rx_stream* rs, uint64_t latency, uint8_t rel)
+{
+  rs->lat_ring[rs->lat_widx] = latency;
+  if(rs->rel_ring != NULL)
+    rs->rel_ring[rs->lat_widx] = rel;
+  rs->lat_widx++;
+  if(rs->lat_widx == rx_stream_ring_bits(rs))
+    rs->lat_widx = 0;
+}
+
+/*
+ * Ends the sync epoch of the latency histograms.
+ */
+static void rx_stream_end_hist_epoch(struct rx_stream* rs)
+{
+  if(rs->hist_file != NULL)
+    lat_hist_write_epoch(rs->hist_file, rs->hist_epoch, rs->hist_epoch*rs->sync_bitfreq, &rs->epoch_hist);
+  lat_hist_merge(&rs->total_hist, &rs->epoch_hist);
+  lat_hist_reset(&rs->epoch_hist);
+  rs->hist_epoch++;
+}
+
+/*
+ * Append 64 received bits (first bit in the most-significant position) to the
+ * ring, and their erasure flags.
+ */
+inline __attribute__((always_inline))
+void rx_stream_push_word(struct rx_stream* rs, uint64_t rx_word, uint64_t erased_word)
+{
+  rs->ring.words[rs->ring_widx] = rx_word;
+  rs->erased_ring.words[rs->ring_widx] = erased_word;
+  rs->ring_widx++;
+  if(rs->ring_widx == rs->ring.num_words)
+    rs->ring_widx = 0;
+  rs->stored_bits += BITVEC_WORD_BITS;
+}
+
+/*
+ * Receiver side: flags the sync epochs first to last as lost (erasures of
+ * the erasure code across epochs), before their last bits are published.
+ */
+static void rx_stream_lose_epochs(struct rx_stream* rs, uint64_t first, uint64_t last)
+{
+  for(uint64_t e=first; e<=last && e<rs->num_epochs; e++)
+    rs->epoch_state[e] = EPOCH_LOST;
+}
+
+/*
+ * Copies the n bits of the ring from (global) bit pos to the start of dst.
+ */
+static void rx_stream_ring_copy(const struct rx_stream* rs, struct bitvec* dst, uint64_t pos, uint64_t n)
+{
+  uint64_t ring_pos = pos % rx_stream_ring_bits(rs);
+  uint64_t first = rx_stream_ring_bits(rs) - ring_pos;
+  if(first > n)
+    first = n;
+  bitvec_copy_bits(dst, 0, &rs->ring, ring_pos, first);
+  if(first < n)
+    bitvec_copy_bits(dst, first, &rs->ring, 0, n - first);
+}
+
+/*
+ * Rebuilds the lost payload epochs of group g (received in full), into its
+ * buffer.
+ */
+static void rx_stream_decode_group(struct rx_stream* rs, uint64_t g)
+{
+  struct epoch_code* ec = &rs->epochs;
+  uint8_t* state = &rs->epoch_state[g*ec->group];
+  uint64_t lost = 0;
+  for(uint64_t j=0; j<ec->group; j++)
+    lost += (state[j] == EPOCH_LOST);
+  rs->repair_stats.groups++;
+  rs->repair_stats.lost += lost;
+  if(lost == 0)
+    return;
+  rs->repair_stats.lossy_groups++;
+
+  struct bitvec* bits = &rs->group_bits[g % 2];
+  uint64_t start = g*epoch_code_group_bits(ec);
+  rx_stream_ring_copy(rs, bits, start, epoch_code_group_bits(ec));
+  epoch_code_load(ec, bits);
+  int rebuilt = epoch_code_rebuild(ec, state);
+  if(rebuilt < 0){
+    rs->repair_stats.failed++;
+    return;
+  }
+  rs->repair_stats.rebuilt += rebuilt;
+  for(uint64_t j=0; j<ec->data; j++){
+    if(state[j] != EPOCH_LOST)
+      continue;
+    epoch_code_store(ec, bits, j);
+    state[j] = EPOCH_REBUILT;
+    for(uint64_t i=0; rs->rel_ring != NULL && i<ec->epoch_bits; i++)
+      rs->rel_ring[(start + j*ec->epoch_bits + i) % rx_stream_ring_bits(rs)] = SOFT_REL_MAX;
+  }
+}
+
+/*
+ * True once the groups of the erasure code up to bit end are received (or
+ * with final, whatever was), and decoded.
+ */
+static bool rx_stream_epochs_ready(struct rx_stream* rs, uint64_t end, bool final)
+{
+  uint64_t group_bits = epoch_code_group_bits(&rs->epochs);
+  while(rs->decoded_groups < rs->epochs.groups && rs->decoded_groups*group_bits < end){
+    bool complete = (rs->stored_bits >= (rs->decoded_groups + 1)*group_bits);
+    if(!complete && !final)
+      return false;
+    if(complete)
+      rx_stream_decode_group(rs, rs->decoded_groups);
+    rs->decoded_groups++;
+  }
+  return true;
+}
+
+/*
+ * The received bits of a chunk, with its rebuilt epochs (fixed_chunk), or
+ * rx_chunk if none.
+ */
+static const struct bitvec* rx_stream_rebuilt_chunk(struct rx_stream* rs, const struct bitvec* rx_chunk,
+                                                    uint64_t chunk_start, uint64_t num_bits)
+{
+  struct epoch_code* ec = &rs->epochs;
+  const struct bitvec* chunk = rx_chunk;
+  if(ec->groups == 0)
+    return chunk;
+  for(uint64_t e = chunk_start/ec->epoch_bits; e*ec->epoch_bits < chunk_start + num_bits; e++){
+    if(e >= rs->num_epochs || rs->epoch_state[e] != EPOCH_REBUILT)
+      continue;
+    if(chunk == rx_chunk){
+      memcpy(rs->fixed_chunk.words, rx_chunk->words, RX_CHUNK_WORDS*sizeof(uint64_t));
+      chunk = &rs->fixed_chunk;
+    }
+    uint64_t from = e*ec->epoch_bits > chunk_start ? e*ec->epoch_bits : chunk_start;
+    uint64_t to = (e + 1)*ec->epoch_bits < chunk_start + num_bits ? (e + 1)*ec->epoch_bits : chunk_start + num_bits;
+    bitvec_copy_bits(&rs->fixed_chunk, from - chunk_start, &rs->group_bits[e/ec->group % 2],
+                     (e % ec->group)*ec->epoch_bits + from - e*ec->epoch_bits, to - from);
+  }
+  return chunk;
+}
+
+/*
+ * True if the packet k (of num_pkts, at bit pos of the stream) carries
+ * payload: not parity of the outer code, nor in a repair epoch.
+ */
+static inline bool rx_stream_payload_packet(const struct rx_stream* rs, unsigned int k, unsigned int num_pkts,
+                                            uint64_t pos)
+{
+  return !(rs->ecc && outer_is_parity(&rs->outer, k, num_pkts)) && !epoch_code_is_repair(&rs->epochs, pos, rs->packet_sz);
+}
+
+/*
+ * De-modulates the num_bits channel bits of chunk (starting at global bit
+ * chunk_start) and de-interleaves its num_blks blocks into blocks.
+ */
+static void rx_stream_deinterleave(struct rx_stream* rs, const struct bitvec* chunk, struct bitvec* blocks,
+                                   uint64_t chunk_start, uint64_t num_bits, uint64_t num_blks)
+{
+  for(uint64_t w=0; w*BITVEC_WORD_BITS < num_bits; w++){
+    unsigned int len = BITVEC_WORD_BITS;
+    if(num_bits - w*BITVEC_WORD_BITS < BITVEC_WORD_BITS)
+      len = num_bits - w*BITVEC_WORD_BITS;
+    uint64_t ks = channel_keystream_bits(&rs->gen.ks, chunk_start + w*BITVEC_WORD_BITS, len);
+    rs->demod_chunk.words[w] = chunk->words[w] ^ (ks << (BITVEC_WORD_BITS - len));
+  }
+  deinterleave_blocks(&rs->demod_chunk, 0, blocks, 0, num_blks, rs->interleave_depth);
+}
+
+/*
+ * Analyze num_bits received bits (a chunk, starting at global bit chunk_start)
+ * held in rx_chunk, with their erasure flags in erased_chunk.
+ */
+static void rx_stream_analyze_chunk(struct rx_stream* rs, const struct bitvec* rx_chunk,
+                                    const struct bitvec* erased_chunk, uint64_t chunk_start, uint64_t num_bits)
+{
+  struct bitvec* tx_chunk = &rs->tx_chunk;
+  uint64_t chunk_end = chunk_start + num_bits;
+
+  //Expected channel bits for this chunk
+  payload_gen_chunk(&rs->gen, tx_chunk, 0, num_bits);
+
+  //Received bits of the payload: with the rebuilt epochs
+  const struct bitvec* data_chunk = rx_stream_rebuilt_chunk(rs, rx_chunk, chunk_start, num_bits);
+
+  //Blocks in their order, de-modulated, with the interleaver
+  const struct bitvec* tx_blks = tx_chunk;
+  const struct bitvec* rx_blks = data_chunk;
+  const uint8_t* rel = (rs->rel_ring != NULL) ? &rs->rel_ring[chunk_start % rx_stream_ring_bits(rs)] : NULL;
+  bool demodulated = (rs->interleave_depth > 1);
+  if(demodulated){
+    uint64_t num_blks = num_bits/ECCBLK_BITLEN;
+    rx_stream_deinterleave(rs, tx_chunk, &rs->tx_blocks, chunk_start, num_bits, num_blks);
+    rx_stream_deinterleave(rs, data_chunk, &rs->rx_blocks, chunk_start, num_bits, num_blks);
+    tx_blks = &rs->tx_blocks;
+    rx_blks = &rs->rx_blocks;
+    if(rel != NULL){
+      deinterleave_bytes(rel, rs->rel_blocks, num_blks, rs->interleave_depth);
+      rel = rs->rel_blocks;
+    }
+  }
+
+  //Packets (every packet lies within one chunk)
+  uint64_t data_pkts = rs->num_bits/DATABLK_BITLEN;
+  uint64_t packet_sz = rs->packet_sz;
+  uint64_t blk_diff[RX_CHUNK_BITS/DATABLK_BITLEN];
+  unsigned int num_pkts = 0;
+  uint64_t tx_data[RX_CHUNK_BITS/ECCBLK_BITLEN], rx_data[RX_CHUNK_BITS/ECCBLK_BITLEN];
+  uint8_t rx_parity[RX_CHUNK_BITS/ECCBLK_BITLEN];
+  for(uint64_t pkt = chunk_start/packet_sz; pkt < data_pkts && (pkt+1)*packet_sz <= chunk_end; pkt++, num_pkts++){
+    uint64_t bit_id = pkt*packet_sz - chunk_start;
+
+    //Channel errors (channel encoding cancels out in tx^rx)
+    bitvec_compare(tx_chunk, rx_chunk, bit_id, packet_sz, &rs->tx_stats);
+    bitvec_compare_masked(tx_chunk, rx_chunk, erased_chunk, bit_id, packet_sz, &rs->erased_stats);
+
+    if(rs->ecc){
+      //De-modulate Payload with Channel Encoding (the generator's keystream).
+      uint64_t ks_parity = 0, ks_data = 0;
+      if(!demodulated){
+        ks_parity = channel_keystream_bits(&rs->gen.ks, chunk_start+bit_id, PARITY_BITLEN);
+        ks_data = channel_keystream_bits(&rs->gen.ks, chunk_start+bit_id+PARITY_BITLEN, DATABLK_BITLEN);
+      }
+
+      //The expected packet is a valid codeword, so only the received one needs decoding.
+      tx_data[num_pkts] = bitvec_get_bits(tx_blks, bit_id+PARITY_BITLEN, DATABLK_BITLEN) ^ ks_data;
+      rx_data[num_pkts] = bitvec_get_bits(rx_blks, bit_id+PARITY_BITLEN, DATABLK_BITLEN) ^ ks_data;
+      rx_parity[num_pkts] = bitvec_get_bits(rx_blks, bit_id, PARITY_BITLEN) ^ ks_parity;
+    } else {
+      blk_diff[num_pkts] = bitvec_get_bits(tx_chunk, bit_id, DATABLK_BITLEN) ^ bitvec_get_bits(data_chunk, bit_id, DATABLK_BITLEN);
+    }
+  }
+
+  unsigned char flags[RX_CHUNK_BITS/ECCBLK_BITLEN];
+  if(rs->ecc && rel != NULL && num_pkts > 0){
+    //Perform soft-decision ECC-Decoding (the packets start with the chunk), and count the hard one apart
+    uint64_t hard_data[RX_CHUNK_BITS/ECCBLK_BITLEN];
+    soft_decode_blocks(num_pkts, rx_data, rx_parity, rel, rs->chase_flips, hard_data, flags, &rs->soft_stats);
+    for(unsigned int k=0; k<num_pkts; k++)
+      if(rx_stream_payload_packet(rs, k, num_pkts, chunk_start + k*packet_sz))
+        soft_stats_add_hard(&rs->soft_stats, 1, &tx_data[k], &hard_data[k]);
+  } else if(rs->ecc){
+    //Perform ECC-Decoding
+    fec_secded7264_decode_words(num_pkts, rx_data, rx_parity, flags);
+  }
+  if(rs->ecc){
+    //Outer code: the blocks SEC-DED flags are its erasures
+    outer_decode_blocks(&rs->outer, rx_data, flags, num_pkts, &rs->outer_stats);
+    for(unsigned int k=0; k<num_pkts; k++)
+      blk_diff[k] = tx_data[k] ^ rx_data[k];
+  }
+
+  for(unsigned int k=0; k<num_pkts; k++){
+    if(!rx_stream_payload_packet(rs, k, num_pkts, chunk_start + k*packet_sz))
+      continue;
+    //Check for Errors
+    int bit_errors_in_blk = __builtin_popcountll(blk_diff[k]);
+    rs->correct_samples += DATABLK_BITLEN - bit_errors_in_blk;
+    rs->total_samples += DATABLK_BITLEN;
+
+    //Calculate type of error, at end of blk.
+    if(bit_errors_in_blk == 0)
+      rs->zero_bit_error_blks++;
+    else if (bit_errors_in_blk == 1)
+      rs->one_bit_error_blks++;
+    else if (bit_errors_in_blk > 1)
+      rs->twoplus_bit_error_blks++;
+    rs->tot_blks++;
+  }
+
+  //Per-lane channel errors (lanes carry alternate words)
+  if(rs->num_lanes > 1){
+    for(uint64_t w=0; w*BITVEC_WORD_BITS < num_bits; w++){
+      uint64_t len = num_bits - w*BITVEC_WORD_BITS;
+      if(len > BITVEC_WORD_BITS)
+        len = BITVEC_WORD_BITS;
+      int lane = lane_of_word(chunk_start/BITVEC_WORD_BITS + w, rs->num_lanes);
+      bitvec_compare(tx_chunk, rx_chunk, w*BITVEC_WORD_BITS, len, &rs->lane_stats[lane]);
+    }
+  }
+
+  //Latency histograms per sync epoch, of the bits sent as 0 and as 1
+  const uint16_t* lat = &rs->lat_ring[chunk_start % rx_stream_ring_bits(rs)];
+  for(uint64_t i=0; i<num_bits; i++){
+    if(chunk_start + i == (rs->hist_epoch + 1)*rs->sync_bitfreq)
+      rx_stream_end_hist_epoch(rs);
+    lat_hist_add(&rs->epoch_hist, bitvec_get(tx_chunk, i), lat[i]);
+  }
+
+  //Per-epoch statistics: first heartbeat-epoch of every sync-epoch that overlaps this chunk
+  for(uint64_t sync_id = chunk_start/rs->sync_bitfreq; sync_id*rs->sync_bitfreq < chunk_end; sync_id++){
+    uint64_t win_start = sync_id*rs->sync_bitfreq;
+    uint64_t win_end = win_start + rs->heartbeat_freq;
+    if(win_end > rs->num_bits)
+      break;
+    if(win_end <= chunk_start)
+      continue;
+    if(rs->epoch_stats.size() <= sync_id){
+      struct bitvec_err_stats zero_stats = {0,0,0,0,0};
+      rs->epoch_stats.resize(sync_id+1, zero_stats);
+    }
+
+    uint64_t from = win_start > chunk_start ? win_start : chunk_start;
+    uint64_t to = win_end < chunk_end ? win_end : chunk_end;
+    bitvec_compare(tx_chunk, rx_chunk, from - chunk_start, to - from, &rs->epoch_stats[sync_id]);
+  }
+}
+
+/*
+ * Analyze all complete chunks of the ring (and with final, the trailing partial chunk).
+ */
+static void rx_stream_drain(struct rx_stream* rs, bool final)
+{
+  while(rs->analyzed_bits < rs->stored_bits){
+    uint64_t num_bits = rs->stored_bits - rs->analyzed_bits;
+    if(num_bits > RX_CHUNK_BITS)
+      num_bits = RX_CHUNK_BITS;
+    if(num_bits < RX_CHUNK_BITS && !final)
+      break;
+    if(!rx_stream_epochs_ready(rs, rs->analyzed_bits + num_bits, final))
+      break;
+
+    //Chunks never wrap around the ring.
+    uint64_t ring_word = (rs->analyzed_bits/BITVEC_WORD_BITS) % rs->ring.num_words;
+    struct bitvec rx_chunk;
+    rx_chunk.words = &rs->ring.words[ring_word];
+    rx_chunk.num_bits = num_bits;
+    rx_chunk.num_words = RX_CHUNK_WORDS;
+    struct bitvec erased_chunk = rx_chunk;
+    erased_chunk.words = &rs->erased_ring.words[ring_word];
+
+    rx_stream_analyze_chunk(rs, &rx_chunk, &erased_chunk, rs->analyzed_bits, num_bits);
+    rs->analyzed_bits += num_bits;
+  }
+}
+
+/*
+ * Marks the end of reception after rx_count bits, given the pending (partial)
+ * word and its erasure flags.
+ */
+static void rx_stream_finish(struct rx_stream* rs, uint64_t rx_count, uint64_t rx_word, uint64_t erased_word)
+{
+  unsigned int pending = rx_count % BITVEC_WORD_BITS;
+  if(pending){
+    rx_stream_push_word(rs, rx_word << (BITVEC_WORD_BITS - pending), erased_word << (BITVEC_WORD_BITS - pending));
+    rs->stored_bits = rx_count;
+  }
+  rx_stream_drain(rs, true);
+  if(rs->epoch_hist.samples[0] + rs->epoch_hist.samples[1] > 0)
+    rx_stream_end_hist_epoch(rs);
+}
+
+#endif
+
+//
+// rx_stream.hh ends here
@@ -5,6 +5,9 @@
 
 #include "utils.hh" //Header for Streamline defines.
 #include "fr_util.hh" //Header for Flush+Reload Handshake. (from "https://github.com/yshalabi/covert-channel-tutorial")
+#include "payload.hh" //Header for payload creation, ECC framing and channel encoding.
+#include "lanes.hh" //Header for multi-lane transmission.
+#include "addr_schedule.hh" //Header for the shared-array address schedule.
 
 /* 
  * Function to send 0/1 via Flush+Reload channel to Receiver (for Initial Handshake)
@@ -31,32 +34,19 @@ void send_bit_init_FR(bool one, struct config *config, int interval){
 }
 
 /* Variables for Streamline */
-//Frequency to Print Progress Heartbeat
-#define HEARTBEAT_FREQ (1000)
+//Channel parameters (array size, sync period, access lag, heartbeat, ECC, payload type): see params.hh
+struct channel_params params;
 
 //-------- Access Pattern ----------
-// Access every 3n cacheline alternating between page 0 and page 1, then continue to pages 2,3 .. 4,5 ... and so on.
-#define PG_NUM(l) (((uint64_t)(((uint64_t)(l/2))*3/CL_IN_PAGE))*2 + l%2)
-#define CL_NUM(l) ((((uint64_t)(l/2))*3 + 14) % CL_IN_PAGE)
-#define BITID_2_ARRINDEX(l) ( PG_NUM(l)*ENTRY_PER_PAGE + CL_NUM(l)*ENTRY_PER_CL )
+// Access every 3n cacheline alternating between page 0 and page 1, then continue to pages 2,3 .. 4,5 ... and so on (see addr_schedule.hh).
 
-// Beating the LLC Replacement Policy (Access older lines)
-#define TX_ACCESS_LAG_DELTA (5000)
+// Beating the LLC Replacement Policy (Access older lines, params.lag_delta behind)
 #define TX_ACCESS_LAG       (1)
 
 //-------- Synchronization ----------
 // Rx Delay Per Sync Iteration
 #define RX_SYNC_SLEEP  (1000)
-// Frequency of Sync 
-#ifndef SYNC_FREQ_SENSITIVITY
-#define TX_SYNC_BITFREQ (200000)
-#else
-#define TX_SYNC_BITFREQ (SYNC_FREQ_SENSITIVITY)
-#endif
-// Gap Between TX and RX At Sync 
-#define TX_SYNC_LAG_DELTA (5000)
-// Timeout after which Rx exits sync
-#define RX_SYNC_TIMEOUT (5*100*5000)
+// Frequency of Sync: params.sync_bitfreq
 
 //Initial Synchronization
 uint64_t RX_DELAY_CYCLES = 250000;
@@ -65,24 +55,15 @@ uint64_t RX_DELAY_CYCLES = 250000;
 //1. Static-Delay based synchronization.
 #define TX_DELAY_CYCLES (400000)
 
-//2. Flush+Reload based synchronization
-uint64_t* sync_rxready_page; //to be a page-size allocated page-aligned.
-uint64_t* sync_rxready_page1; //to be a page-size allocated page-aligned.
-uint64_t* sync_rxready_page2; //to be a page-size allocated page-aligned.
+//2. Flush+Reload based synchronization (sync pages of every lane, see lane_region)
 
-uint64_t* sync_txready_page; //to be a page-size allocated page-aligned.
-uint64_t* sync_txready_page1; //to be a page-size allocated page-aligned.
-uint64_t* sync_txready_page2; //to be a page-size allocated page-aligned.
+//4. TSC-deadline epochs (-E deadline, see epoch_schedule.hh): start of the first epoch, agreed at the initial handshake
+uint64_t epoch_start = 0;
 
 
 // -------- Network Parameters  -------------
-// LFSR Based Channel Encoding to modulate payloads (to allow pathological payloads)
-std::tr1::mt19937 mt (42); //Mersenne Twister PRNG engine
-std::tr1::uniform_int<int> channel_enc(0, 1); //uniform distribution [0,1]
-
-// Error-Correction Parameters: (72,64) Hamming Code
-#define DATABLK_BITLEN (64)
-#define PARITY_BITLEN (8)
+// Channel Encoding to modulate payloads (to allow pathological payloads):
+// keystream precomputed once per session, see channel_keystream in payload.hh
 
 
 // -------- Transmission Parameters  -------------
@@ -98,6 +79,7 @@ uint64_t TRANSMITTED_BITS ; //Includes data and parity bits
 
 //Array used for communication
 uint64_t* SHARED_ARRAY ;  //Shared array used for communication  [**TODO**: Assign addresses from shared_file.txt ]
+uint64_t SHARED_ARRAY_NUMENTRIES; //params.array_numentries
 uint64_t SHARED_SEED = 42; // Starting point in the array.
 
 //Cores that Tx and Rx will be pinned to.
@@ -110,24 +92,274 @@ uint64_t* rx_time_obs;
 uint64_t* tx_time_obs_timestamp;
 uint64_t* rx_time_obs_timestamp;
 
-//Bits to be transferred
-bool* tx_payload;
-bool* rx_payload;
+//Bits to be transferred (packed)
+struct bitvec tx_payload;
+struct bitvec rx_payload;
 
 //Starting time-stamp
 uint64_t tx_start_timestamp = 0,rx_start_timestamp = 0;
 
-//Debugging Data-Structures
-std::vector<uint64_t> tx_epoch_timestamp;
-std::vector<uint64_t> rx_epoch_timestamp;
-std::vector<uint64_t> rxsync_reached_timevec,rxsync_start_timevec,rxsync_complete_timevec;
-std::vector<uint64_t> txsync_reached_timevec,txsync_complete_timevec;
-std::vector<uint64_t> debug_rxsync_time, debug_timeout_duration, debug_timeout_bitid;
-
-
 //Global variable for tx_start
 bool tx_started = false;
 
+//Lanes: lane 0 runs on the main thread, lanes 1.. on their own threads.
+struct tx_lane {
+  int id;
+  int cpuid;
+  struct lane_region region;
+  struct bitvec payload;            //bits carried by this lane
+  uint64_t* time_obs;
+  uint64_t* time_obs_timestamp;
+  pthread_t thread;
+
+  //Debugging Data-Structures
+  std::vector<uint64_t> tx_epoch_timestamp;
+  std::vector<uint64_t> txsync_reached_timevec,txsync_complete_timevec;
+  struct fr_barrier barrier;        //Flush+Reload barrier with the receiver, and its cost
+  struct epoch_schedule epochs;     //deadlines of the epochs (-E deadline), and their cost
+  struct pilots pilots;             //markers of the spans passed (-P)
+  struct sync_adapt adapt;          //epochs between the barriers, as the receiver chose them (-D)
+};
+int num_lanes = 1;
+struct tx_lane tx_lanes[MAX_LANES];
+std::atomic<bool> tx_lanes_go(false); //set once the initial handshake is done
+
+
+/*
+ * Pin the calling thread to cpuid with the highest SCHED_FIFO priority.
+ */
+void set_tx_thread_sched(int cpuid)
+{
+#ifdef SIM_BACKEND
+    //Simulated core (see cache_sim.hh)
+    sim_attach(cpuid);
+#else
+    //Set Core Affinity and Scheduler Parameters
+    cpu_set_t mask;
+    int status;
+    CPU_ZERO(&mask);
+    CPU_SET(cpuid, &mask);
+    status = sched_setaffinity(0, sizeof(mask), &mask);
+    if (status != 0) {
+      perror("sched_setaffinity");
+    }
+
+    //Setting Scheduler Priority & Policy
+    int policy;
+    struct sched_param param;
+    pthread_getschedparam(pthread_self(), &policy, &param);
+    param.sched_priority = sched_get_priority_max(SCHED_FIFO);
+    pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    printf("Sender Process - PID:%llu, TID:%lu, CPU:%d\n",getpid(), syscall(__NR_gettid) ,sched_getcpu());
+    display_thread_sched_attr();
+    fail_if_pthrattr_mismatch(SCHED_FIFO,sched_get_priority_max(SCHED_FIFO),cpuid) ;
+#endif
+}
+
+// Per-bit parameters of a loop instance (see LOOP_PARAM)
+#define TX_SYNC_BITFREQ     LOOP_PARAM(kSyncBitfreq, params.sync_bitfreq)
+#define TX_ACCESS_LAG_DELTA LOOP_PARAM(kLagDelta, params.lag_delta)
+// Specialized instances have the single default tap, of every bit
+#define TX_ACCESS_LAG_MASK  ((kLagDelta) ? 0 : params.lag_every[0] - 1)
+#define TX_ACCESS_LAG_TAPS  ((kLagDelta) ? 1 : params.num_lag_taps)
+#define HEARTBEAT_FREQ      LOOP_PARAM(kHeartbeatFreq, params.heartbeat_freq)
+#define PILOT_PERIOD        ((kSpecialized) ? 0 : params.pilot_period)
+#define SYNC_ADAPT          ((kSpecialized) ? 0 : params.sync_adapt_max)
+
+/*
+ * Streamline transmission of the bits carried by one lane.
+ */
+template<bool kSpecialized, uint64_t kSyncBitfreq, uint64_t kLagDelta, uint64_t kHeartbeatFreq>
+void tx_lane_loop(struct tx_lane* lane)
+{
+    //Lane's region of the shared array, and sync pages
+    uint64_t* lane_array = lane->region.shared_array;
+    uint64_t lane_numentries = lane->region.numentries;
+    uint64_t lane_bits = lane->payload.num_bits;
+    //Flush+Reload barrier with the receiver, on the lane's sync pages
+    fr_barrier_init(&lane->barrier, lane->region.sync_txready_page, lane->region.sync_rxready_page,
+                    &params, LLC_HIT_THRESHOLD_CYCLES_SYNC, 0);
+    //Deadlines of the epochs: Tx starts every epoch at its start
+    bool deadline_sync = (params.sync_mode == SYNC_DEADLINE);
+    epoch_schedule_init(&lane->epochs, epoch_start, &params, 0);
+    //Pilots (generic instance only): on the lane's sync pages
+    pilots_init(&lane->pilots, lane->region.sync_txready_page, lane->region.sync_rxready_page,
+                &params, LLC_HIT_THRESHOLD_CYCLES_SYNC, 0);
+    //Adaptive sync period (generic instance only): the barriers the receiver asks for
+    sync_adapt_init(&lane->adapt, lane->region.sync_rxready_page, &params, LLC_HIT_THRESHOLD_CYCLES_SYNC);
+
+    //Local Private Array for Communication
+    uint64_t TX_PRIVATE_ARRAY[PAGE_SZ] = {1} ; 
+
+    //Training lines (see training.hh)
+    uint64_t* train_array = lane->region.train_array;
+    uint64_t train_bits = params.train_bits;
+
+    //Address schedule of the shared array, and addresses of the last bits for the lagging re-access
+    struct addr_schedule schedule;
+    addr_schedule_init(&schedule, SHARED_SEED, lane_numentries, &params);
+    struct addr_lag_ring lag_ring;
+    addr_lag_ring_init(&lag_ring, (kLagDelta) ? TX_ACCESS_LAG_DELTA : max_lag_tap(&params));
+
+    //Start Tx
+    uint64_t bit_id = 0;
+    unsigned int junk_temp_tx = 0;
+    uint64_t temp = 0;
+    if(deadline_sync){
+      struct epoch_times epoch_times;
+      epoch_wait(&lane->epochs, epoch_deadline(&lane->epochs, 0), 0, &epoch_times);
+    }
+
+    for(bit_id=0; bit_id<lane_bits; bit_id++){
+
+      //------- Training bits at the start of every sync epoch (see training.hh) -------
+      if( (bit_id % (TX_SYNC_BITFREQ)) == 0 ){
+        for(uint64_t j=0; j<train_bits; j++){
+          //Bit 0: training line, bit 1: private array (as for payload bits)
+          volatile uint64_t* train_addr = train_bit(j) ? &TX_PRIVATE_ARRAY[0] : &train_array[train_line_index(j)];
+          temp += MEM_LOAD(train_addr);
+        }
+      }
+
+      //tx each iteration.
+      int curr_payload = bitvec_get(&lane->payload, bit_id);
+      //Get array index to communicate (curr_bitid = SHARED_SEED + bit_id -> curr_arrindex)
+      uint64_t curr_arrindex = addr_schedule_index(&schedule, lane_numentries);
+      addr_schedule_next(&schedule, lane_numentries);
+
+      //Based on Payload value (0/1), Mask = 0x0000000.. if Payload=0, or 0xFFFFFFF.. if Payload=1
+      uint64_t payload_mask_0 = 0 - ((uint64_t)curr_payload & (uint64_t)1);
+      uint64_t payload_mask_1 = ~payload_mask_0;
+    
+      //access corresponding array index
+      uintptr_t addr_1 = (uintptr_t) &lane_array[curr_arrindex] & (uintptr_t)payload_mask_1; //will be 0x00 if Payload=1
+      uintptr_t addr_0 = (uintptr_t) &TX_PRIVATE_ARRAY[0]         & (uintptr_t)payload_mask_0; //will be 0x00 if Payload=0
+      volatile uint64_t* addr = (uint64_t*) (addr_1 | addr_0);
+
+      unsigned int junk = 0;
+      register uint64_t time0, delta_time0;
+
+      time0 = MEM_RDTSCP( & junk); /* READ TIMER */
+      temp = MEM_LOAD(addr);
+
+#if TX_ACCESS_LAG == 0     
+      delta_time0 = MEM_RDTSCP( & junk) - time0; /* READ TIMER & COMPUTE ELAPSED TIME */
+#endif
+    
+#if TX_ACCESS_LAG
+      //Repeat Access to older line (N-behind): the address accessed for bit lag_bit_id
+      addr_lag_ring_push(&lag_ring, bit_id, (uintptr_t) addr);
+      if(bit_id > TX_ACCESS_LAG_DELTA && ((bit_id - TX_ACCESS_LAG_DELTA) & TX_ACCESS_LAG_MASK) == 0){
+        volatile uint64_t* prev_addr = (uint64_t*) addr_lag_ring_get(&lag_ring, bit_id, TX_ACCESS_LAG_DELTA);
+        temp = MEM_LOAD(prev_addr);
+      }
+      //Further taps (-g <lag>[/<every>],...), in the generic instance only
+      for(int t=1; t<TX_ACCESS_LAG_TAPS; t++){
+        uint64_t tap_lag = params.lag_taps[t];
+        if(bit_id > tap_lag && ((bit_id - tap_lag) & (params.lag_every[t] - 1)) == 0){
+          volatile uint64_t* tap_addr = (uint64_t*) addr_lag_ring_get(&lag_ring, bit_id, tap_lag);
+          temp = MEM_LOAD(tap_addr);
+        }
+      }
+#endif    
+
+      //Pilot at the end of every span (see pilot.hh)
+      if(PILOT_PERIOD && (bit_id & (PILOT_PERIOD - 1)) == (PILOT_PERIOD - 1))
+        pilot_tx(&lane->pilots, bit_id);
+
+#ifdef PROGRESS_HEARTBEAT
+      if( (bit_id % HEARTBEAT_FREQ) == (HEARTBEAT_FREQ - 1) ){
+        uint64_t epoch_timestamp  = MEM_RDTSCP( & junk_temp_tx);
+        lane->tx_epoch_timestamp.push_back(epoch_timestamp);
+        //printf("Tx-Epoch Curr-BitID:%d,Time-Epoch:%llu\n",bit_id,epoch_timestamp);
+      }
+#endif
+
+#if VERBOSE
+      //Print the index and addr accessed.
+      printf("Tx: Curr-BitID:%d, Payload is:%d, Addr accessed:%#18x. Time=%d\n",SHARED_SEED + bit_id,curr_payload,addr,delta_time0);
+#endif
+    
+      lane->time_obs[bit_id%NUM_BITS_DEBUG_DTSTR] = delta_time0;
+      lane->time_obs_timestamp[bit_id%NUM_BITS_DEBUG_DTSTR] = time0;
+
+    
+      //------- Synchronization every TX_SYNC_BITFREQ -------
+      if( (bit_id % (TX_SYNC_BITFREQ)) == (TX_SYNC_BITFREQ - 1) ){
+
+#ifdef DELAY_SYNC
+        //1. Static Delays (400k cycles every 20k)
+        uint64_t sleep_cycles = (TX_DELAY_CYCLES);
+        delayloop(sleep_cycles);
+#endif
+
+#ifdef FR_BARRIER_SYNC
+        //TX_SYNC
+        //3. Flush-Reload based Synchronization (see fr_barrier.hh)
+        struct fr_barrier_times sync_times;
+        if(!deadline_sync){
+          if(!SYNC_ADAPT || sync_adapt_due(&lane->adapt, bit_id/TX_SYNC_BITFREQ)){
+            if(PILOT_PERIOD)
+              pilot_keep(&lane->pilots, bit_id, &lane->barrier);
+            if(SYNC_ADAPT)
+              sync_adapt_clear(&lane->adapt);
+            fr_barrier_tx(&lane->barrier, &sync_times);
+            if(SYNC_ADAPT)
+              sync_adapt_tx(&lane->adapt, bit_id/TX_SYNC_BITFREQ);
+          } else {
+            //Adaptive sync period: no barrier at the end of this epoch (see sync_adapt.hh)
+            sync_times.reached = sync_times.complete = MEM_RDTSCP(&junk);
+          }
+
+          lane->txsync_reached_timevec.push_back(sync_times.reached);
+          lane->txsync_complete_timevec.push_back(sync_times.complete);
+        }
+#endif
+
+        //4. TSC-deadline epochs: wait for the start of the next epoch (see epoch_schedule.hh)
+        if(deadline_sync){
+          struct epoch_times epoch_times;
+          epoch_measure_skew(&lane->epochs, lane->time_obs_timestamp, NUM_BITS_DEBUG_DTSTR, bit_id);
+          epoch_wait(&lane->epochs, epoch_deadline(&lane->epochs, bit_id/TX_SYNC_BITFREQ + 1), bit_id + 1, &epoch_times);
+
+          lane->txsync_reached_timevec.push_back(epoch_times.reached);
+          lane->txsync_complete_timevec.push_back(epoch_times.released);
+        }
+      }            
+    }
+    addr_lag_ring_free(&lag_ring);
+    addr_schedule_free(&schedule);
+}
+
+#undef TX_SYNC_BITFREQ
+#undef TX_ACCESS_LAG_DELTA
+#undef TX_ACCESS_LAG_MASK
+#undef TX_ACCESS_LAG_TAPS
+#undef HEARTBEAT_FREQ
+#undef PILOT_PERIOD
+#undef SYNC_ADAPT
+
+//Loop instances: specialized ones, and the generic one.
+typedef void (*tx_lane_loop_fn)(struct tx_lane*);
+#define TX_LOOP_INSTANCE(sync_bitfreq)                                   \
+  {sync_bitfreq, tx_lane_loop<true, sync_bitfreq, DEFAULT_ACCESS_LAG_DELTA, DEFAULT_HEARTBEAT_FREQ>},
+static const struct loop_instance<tx_lane_loop_fn> tx_lane_loops[] = { LOOP_SPECIALIZATIONS(TX_LOOP_INSTANCE) };
+tx_lane_loop_fn tx_loop = tx_lane_loop<false, 0, 0, 0>; //selected once, from the parameters
+
+/*
+ * Sender thread of lanes 1..
+ */
+void* tx_lane_thread(void* arg)
+{
+    struct tx_lane* lane = (struct tx_lane*) arg;
+    set_tx_thread_sched(lane->cpuid);
+    while(!tx_lanes_go.load(std::memory_order_acquire)) {}
+    tx_loop(lane);
+    return NULL;
+}
+
+
+
 
 
 int main(int argc, char **argv)
@@ -135,29 +367,23 @@ int main(int argc, char **argv)
     // Initialize config and local variables
     struct config config;
     init_config(&config,NUM_BITS, argc, argv);
+    params = config.params;
+    LLC_HIT_THRESHOLD_CYCLES_SYNC = LLC_HIT_THRESHOLD_CYCLES_COMM = config.threshold;
 
     //Initialize the Number of Transmitted Bits
-#ifdef ECC
-    assert((NUM_BITS%8 == 0) && "Number of Bits has to be a Multiple of 8\n" );
-    TRANSMITTED_BITS = NUM_BITS*(DATABLK_BITLEN+PARITY_BITLEN)/DATABLK_BITLEN;    
-#else
-    TRANSMITTED_BITS = NUM_BITS;
-#endif
+    if(params.ecc){
+      assert((NUM_BITS%8 == 0) && "Number of Bits has to be a Multiple of 8\n" );
+      TRANSMITTED_BITS = NUM_BITS*(DATABLK_BITLEN+PARITY_BITLEN)/DATABLK_BITLEN;    
+    } else {
+      TRANSMITTED_BITS = NUM_BITS;
+    }
     if(NUM_BITS > NUM_BITS_DEBUG_MAX)
       NUM_BITS_DEBUG_DTSTR = NUM_BITS_DEBUG_MAX;
     else
       NUM_BITS_DEBUG_DTSTR = TRANSMITTED_BITS ;
 
     //Printing Inputs
-#ifdef  RANDOM_PAYLOAD  
-    std::string payload_type = "Random Payload";
-#endif    
-#ifdef CONSTANT_PAYLOAD_0
-    std::string payload_type = "Constant-0 Payload";
-#endif    
-#ifdef CONSTANT_PAYLOAD_1
-    std::string payload_type = "Constant-1 Payload";
-#endif
+    std::string payload_type = payload_type_name(params.payload_type);
     printf("Streamline Covert Channel Sender with Num_Bits:%llu, %s,\
  LLC-Hit-Threshold-Comm:%llu cycles. LLC-Hit-Threshold-Sync:%llu cycles. \
  Start Tx-Rx-Delay-Cycles: %llu\n",
@@ -169,6 +395,7 @@ int main(int argc, char **argv)
     //Data-structures used for transmission:
     //Shared array used for transmission
     SHARED_ARRAY =  (uint64_t*) (config.addr + OFFSET_SHARED_ARRAY);
+    SHARED_ARRAY_NUMENTRIES = params.array_numentries;
 
     // Stream Through Shared Array
     uint64_t temp = 0;
@@ -176,26 +403,20 @@ int main(int argc, char **argv)
       temp+= SHARED_ARRAY[i];
     }
 
-    //Shared page used for synchronization
-    sync_rxready_page =  (uint64_t*) (config.addr + OFFSET_FR_SYNC_REG_RX1);
-    sync_txready_page =  (uint64_t*) (config.addr + OFFSET_FR_SYNC_REG_TX1);
-    sync_rxready_page1 = (uint64_t*) (config.addr + OFFSET_FR_SYNC_REG_RX2);
-    sync_txready_page1 = (uint64_t*) (config.addr + OFFSET_FR_SYNC_REG_TX2);
-    sync_rxready_page2 = (uint64_t*) (config.addr + OFFSET_FR_SYNC_REG_RX3);
-    sync_txready_page2 = (uint64_t*) (config.addr + OFFSET_FR_SYNC_REG_TX3);
-
-    // Flush shared page used for synchronization
-    for(uint64_t i=0;i<PAGE_SZ/sizeof(uint64_t);i++){
-      _mm_clflush(&sync_rxready_page[i]);
-      _mm_clflush(&sync_rxready_page1[i]);
-      _mm_clflush(&sync_rxready_page2[i]);
+    //Lanes: regions of the shared array, and pages used for synchronization
+    num_lanes = config.num_lanes;
+    if(num_lanes < 1 || num_lanes > MAX_LANES){
+      printf("Number of lanes has to be between 1 and %d\n", MAX_LANES);
+      exit(1);
+    }
+    for(int l=0; l<num_lanes; l++){
+      tx_lanes[l].id = l;
+      tx_lanes[l].cpuid = (l == 0) ? tx_cpuid : LANE_TX_CPUID(l);
+      lane_region_init(&tx_lanes[l].region, config.addr, SHARED_ARRAY_NUMENTRIES, l, num_lanes);
 
+      // Flush shared page used for synchronization
+      lane_flush_sync_pages(&tx_lanes[l].region);
     }
-    for(uint64_t i=0;i<PAGE_SZ/sizeof(uint64_t);i++){
-      _mm_clflush(&sync_txready_page[i]);
-      _mm_clflush(&sync_txready_page1[i]);
-      _mm_clflush(&sync_txready_page2[i]);
-    }   
 
     //Transmission & Receiver Data-Structures
     tx_time_obs = (uint64_t*)malloc(NUM_BITS_DEBUG_DTSTR*sizeof(uint64_t));
@@ -203,109 +424,70 @@ int main(int argc, char **argv)
     tx_time_obs_timestamp = (uint64_t*)malloc(NUM_BITS_DEBUG_DTSTR*sizeof(uint64_t));
     rx_time_obs_timestamp = (uint64_t*)malloc(NUM_BITS_DEBUG_DTSTR*sizeof(uint64_t));
     //Bits to be transferred
-    tx_payload = (bool*)malloc(TRANSMITTED_BITS*sizeof(bool));;
-    rx_payload = (bool*)malloc(TRANSMITTED_BITS*sizeof(bool));
+    bitvec_alloc(&tx_payload, TRANSMITTED_BITS);
+    bitvec_alloc(&rx_payload, TRANSMITTED_BITS);
 
     //Initialize the data-structures used for transmission with random data
     srand(42);
-    for(uint64_t i=0;i<TRANSMITTED_BITS;i++){
+    for(uint64_t i=0;i<NUM_BITS_DEBUG_DTSTR;i++){
       tx_time_obs[i%NUM_BITS_DEBUG_DTSTR] = rand();
       rx_time_obs[i%NUM_BITS_DEBUG_DTSTR] = rand();
       tx_time_obs_timestamp[i%NUM_BITS_DEBUG_DTSTR] = rand(); 
       rx_time_obs_timestamp[i%NUM_BITS_DEBUG_DTSTR] = rand();
-      tx_payload[i] = rand()%2;
-      rx_payload[i] = rand()%2;
+    }
+    for(uint64_t w=0;w<tx_payload.num_words;w++){
+      tx_payload.words[w] = rand();
+      rx_payload.words[w] = rand();
     }
 
     //Print Preliminaries.
     printf("Array Size: %llu bytes (%.2f GB). Starting index is: %llu (%lluth page)\n",
            SHARED_ARRAY_NUMENTRIES*sizeof(SHARED_ARRAY[0]), SHARED_ARRAY_NUMENTRIES*sizeof(SHARED_ARRAY[0])/(1024*1024*1024.0),\
            BITID_2_ARRINDEX(SHARED_SEED), SHARED_SEED);
+    print_channel_params(&params);
+
+    //Loop instance for these parameters
+    tx_loop = loop_select(tx_lane_loops, (tx_lane_loop_fn) tx_lane_loop<false, 0, 0, 0>, &params);
+    printf("Tx loop: %s instance\n", tx_loop == tx_lane_loop<false, 0, 0, 0> ? "generic" : "specialized");
 
     printf("Other Data-Structures Sizes: rx_time_obs:%2f MB, tx_payload:%.2f MB, rx_payload:%.2f MB.\n",
-           1.0*NUM_BITS_DEBUG_DTSTR*sizeof(uint64_t)/1024/1024,1.0*TRANSMITTED_BITS*sizeof(bool)/1024/1024,1.0*TRANSMITTED_BITS*sizeof(bool)/1024/1024);
+           1.0*NUM_BITS_DEBUG_DTSTR*sizeof(uint64_t)/1024/1024,1.0*bitvec_size_bytes(&tx_payload)/1024/1024,1.0*bitvec_size_bytes(&rx_payload)/1024/1024);
 
 
-    //Set Core Affinity and Scheduler Parameters
-    cpu_set_t mask;
-    int status;
-    CPU_ZERO(&mask);
-    CPU_SET(tx_cpuid, &mask);
-    status = sched_setaffinity(0, sizeof(mask), &mask);
-    if (status != 0) {
-      perror("sched_setaffinity");
-    }
-
-    //Setting Scheduler Priority & Policy
-    int policy;
-    struct sched_param param;
-    pthread_getschedparam(pthread_self(), &policy, &param);
-    param.sched_priority = sched_get_priority_max(SCHED_FIFO);
-    pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
-    printf("Sender Process - PID:%llu, TID:%lu, CPU:%d\n",getpid(), syscall(__NR_gettid) ,sched_getcpu());
-    display_thread_sched_attr();
-    fail_if_pthrattr_mismatch(SCHED_FIFO,sched_get_priority_max(SCHED_FIFO),tx_cpuid) ;
+    //Set Core Affinity and Scheduler Parameters (lane 0 runs on this thread)
+    set_tx_thread_sched(tx_cpuid);
   
-    // Create Tx Payload.
-    srand(42);
-    for(uint64_t i=0;i<TRANSMITTED_BITS;i++){
-#ifdef  RANDOM_PAYLOAD
-      //random payload:
-      int cur_payload = rand()%2;
-#endif
-    
-#ifdef CONSTANT_PAYLOAD_0    
-      int cur_payload = 0;
-#endif
-    
-#ifdef CONSTANT_PAYLOAD_1
-      int cur_payload = 1;
-#endif
- 
-      //tx each iteration.
-      tx_payload[i] = cur_payload ;
-
-      //Add error-correction
-#ifdef ECC
-      if(i% (DATABLK_BITLEN+PARITY_BITLEN) == (DATABLK_BITLEN-1)){
-        //datablk bool array of 64 bits => datablk_bytes encoding 8 byte data
-        bool* datablk = &tx_payload[i-DATABLK_BITLEN+1];
-        /* print_bool_array(datablk,64); */
-        uint8_t datablk_bytes[8], enc_datablk_bytes[9] ;       
-        conv_char(datablk,8,datablk_bytes);
-      
-        //encode data
-        int enc_bytelen = fec_secded7264_encode(8,datablk_bytes, enc_datablk_bytes);
-        assert(enc_bytelen == 9);
-      
-        //enc_datablk_bytes of 9 bytes => enc_datablk
-        bool* enc_datablk = &tx_payload[i-DATABLK_BITLEN+1];
-        string_to_binary(enc_datablk_bytes,enc_bytelen,enc_datablk);
-        /* print_bool_array(enc_datablk,72); */
-
-        //increment the bit-id
-        i+=PARITY_BITLEN;  
-      }                                             
-#endif
+    // Create Tx Payload (modulated with the channel encoding).
+    create_tx_payload(&tx_payload, TRANSMITTED_BITS, &params);
+
+    //Stripe the payload across the lanes
+    if(num_lanes == 1){
+      tx_lanes[0].payload = tx_payload;
+    } else {
+      for(int l=0; l<num_lanes; l++)
+        lane_split_payload(&tx_payload, l, num_lanes, &tx_lanes[l].payload);
     }
-  
-    //Modulate Payload with Channel Encoding.
-    uint64_t num_pkts = 0;
-    for(uint64_t i=0;i<TRANSMITTED_BITS;i++){
-
-      if(i%TX_SYNC_BITFREQ == 0)
-        mt.seed(42); //Mersenne Twister PRNG engine
-
-      int channel_enc_i = channel_enc(mt);
-      tx_payload[i] =  tx_payload[i] ^ channel_enc_i;
+    for(int l=0; l<num_lanes; l++){
+      if(l == 0){
+        tx_lanes[l].time_obs = tx_time_obs;
+        tx_lanes[l].time_obs_timestamp = tx_time_obs_timestamp;
+      } else {
+        tx_lanes[l].time_obs = (uint64_t*)calloc(NUM_BITS_DEBUG_DTSTR, sizeof(uint64_t));
+        tx_lanes[l].time_obs_timestamp = (uint64_t*)calloc(NUM_BITS_DEBUG_DTSTR, sizeof(uint64_t));
+      }
     }
 
-    //Local Private Array for Communication
-    uint64_t TX_PRIVATE_ARRAY[PAGE_SZ] = {1} ; 
+    //Senders of the other lanes (wait for the initial handshake)
+    for(int l=1; l<num_lanes; l++){
+      if(pthread_create(&tx_lanes[l].thread, NULL, tx_lane_thread, &tx_lanes[l]) != 0){
+        printf("Failed to create Tx thread of lane %d\n", l);
+        exit(1);
+      }
+    }
   
     //Flush SHARED_ARRAY
     for(uint64_t i=0;i<SHARED_ARRAY_NUMENTRIES; i++){
-      _mm_clflush(&SHARED_ARRAY[i]);
+      MEM_CLFLUSH(&SHARED_ARRAY[i]);
     }
 
       
@@ -319,168 +501,35 @@ int main(int argc, char **argv)
     send_bit_init_FR(true, &config,config.sync_interval);
 
     // Initial Sync Done
+    epoch_start = epoch_schedule_start(config.CHANNEL_SYNC_TIMEMASK);
     printf("Sender Ready: Done Initial Sync\n");
 
 
     // ----------- START STREAMLINE --------------------
 
-    //Start Tx
-    uint64_t bit_id = 0;
-    unsigned int junk_temp_tx = 0;
-
-    for(bit_id=0; bit_id<TRANSMITTED_BITS; bit_id++){
-
-      //tx each iteration.
-      int curr_payload = tx_payload[bit_id];
-      //Get array index to communicate by getting curr_bitid -> curr_arrindex)
-      uint64_t curr_bitid = SHARED_SEED + bit_id ;
-      uint64_t curr_arrindex = (BITID_2_ARRINDEX(curr_bitid))%SHARED_ARRAY_NUMENTRIES + 4;
-
-      //Based on Payload value (0/1), Mask = 0x0000000.. if Payload=0, or 0xFFFFFFF.. if Payload=1
-      uint64_t payload_mask_0 = 0 - ((uint64_t)curr_payload & (uint64_t)1);
-      uint64_t payload_mask_1 = ~payload_mask_0;
-    
-      //access corresponding array index
-      uintptr_t addr_1 = (uintptr_t) &SHARED_ARRAY[curr_arrindex] & (uintptr_t)payload_mask_1; //will be 0x00 if Payload=1
-      uintptr_t addr_0 = (uintptr_t) &TX_PRIVATE_ARRAY[0]         & (uintptr_t)payload_mask_0; //will be 0x00 if Payload=0
-      volatile uint64_t* addr = (uint64_t*) (addr_1 | addr_0);
-
-      unsigned int junk = 0;
-      register uint64_t time0, delta_time0;
-
-      time0 = __rdtscp( & junk); /* READ TIMER */
-      uint64_t temp = *addr;
-
-#if TX_ACCESS_LAG == 0     
-      delta_time0 = __rdtscp( & junk) - time0; /* READ TIMER & COMPUTE ELAPSED TIME */
+    uint64_t tx_start_cycles = timer_cycles(), tx_wall_start_ns = timer_wall_ns();
+    tx_lanes_go.store(true, std::memory_order_release);
+    tx_loop(&tx_lanes[0]);
+#ifdef SIM_BACKEND
+    sim_detach();
 #endif
-    
-#if TX_ACCESS_LAG
-      //Repeat Access to older line (N-behind)    
-      int lag_bit_id = bit_id - TX_ACCESS_LAG_DELTA;
-      if(lag_bit_id >0){
-        int prev_payload = tx_payload[lag_bit_id];
-        //Get array index to communicate by getting curr_bitid -> curr_arrindex)
-        uint64_t prev_bitid = SHARED_SEED + lag_bit_id ;
-        uint64_t prev_arrindex = (BITID_2_ARRINDEX(prev_bitid))%SHARED_ARRAY_NUMENTRIES + 4;
-
-        //Based on Payload value (0/1), Mask = 0x0000000.. if Payload=0, or 0xFFFFFFF.. if Payload=1
-        uint64_t prev_payload_mask_0 = 0 - ((uint64_t)prev_payload & (uint64_t)1);
-        uint64_t prev_payload_mask_1 = ~prev_payload_mask_0;
-    
-        //access corresponding array index
-        uintptr_t prev_addr_1 = (uintptr_t) &SHARED_ARRAY[prev_arrindex] & (uintptr_t)prev_payload_mask_1; //will be 0x00 if Payload=1
-        uintptr_t prev_addr_0 = (uintptr_t) &TX_PRIVATE_ARRAY[0]         & (uintptr_t)prev_payload_mask_0; //will be 0x00 if Payload=0
-        volatile uint64_t* prev_addr = (uint64_t*) (prev_addr_1 | prev_addr_0);
-
-        //unsigned int junk = 0;
-        //register uint64_t time0, delta_time0;
-        //time0 = __rdtscp( & junk); /* READ TIMER */
-      
-        temp = *prev_addr;      
-        //delta_time0 = __rdtscp( & junk) - time0; /* READ TIMER & COMPUTE ELAPSED TIME */
-      }
-#endif    
-
-#ifdef PROGRESS_HEARTBEAT
-      if( (bit_id % HEARTBEAT_FREQ) == (HEARTBEAT_FREQ - 1) ){
-        uint64_t epoch_timestamp  = __rdtscp( & junk_temp_tx);
-        tx_epoch_timestamp.push_back(epoch_timestamp);
-        //printf("Tx-Epoch Curr-BitID:%d,Time-Epoch:%llu\n",bit_id,epoch_timestamp);
-      }
-#endif
-
-#if VERBOSE
-      //Print the index and addr accessed.
-      printf("Tx: Curr-BitID:%d, Payload is:%d, Addr accessed:%#18x. Time=%d\n",curr_bitid,curr_payload,addr,delta_time0);
-#endif
-    
-      tx_time_obs[bit_id%NUM_BITS_DEBUG_DTSTR] = delta_time0;
-      tx_time_obs_timestamp[bit_id%NUM_BITS_DEBUG_DTSTR] = time0;
-
-    
-      //------- Synchronization every TX_SYNC_BITFREQ -------
-      if( (bit_id % (TX_SYNC_BITFREQ)) == (TX_SYNC_BITFREQ - 1) ){
-
-#ifdef DELAY_SYNC
-        //1. Static Delays (400k cycles every 20k)
-        uint64_t sleep_cycles = (TX_DELAY_CYCLES);
-        delayloop(sleep_cycles);
-#endif
-
-#ifdef FR_BARRIER_SYNC
-        //TX_SYNC
-        //3. Flush-Reload based Synchronization
-        volatile uint64_t* sync_rxready_addr =  (&sync_rxready_page[0]);
-        volatile uint64_t* sync_rxready_addr1 =  (&sync_rxready_page1[0]);
-        volatile uint64_t* sync_rxready_addr2 =  (&sync_rxready_page2[0]);
-
-        volatile uint64_t* sync_txready_addr =  (&sync_txready_page[0]);
-        volatile uint64_t* sync_txready_addr1 =  (&sync_txready_page1[0]);
-        volatile uint64_t* sync_txready_addr2 =  (&sync_txready_page2[0]);
-      
-        unsigned int sync_junk = 0;
-        uint64_t sync_temp = 0,sync_temp1=0,sync_temp2=0;
-        register uint64_t sync_time0, sync_delta_time0,sync_time1, sync_delta_time1,sync_time2, sync_delta_time2;
-
-        register uint64_t txsync_reached_donetime,txsync_complete_donetime;
-      
-        /* printf("%llu. \t Bit_Id:%d, Flush-Reload Sync Starts for Tx.\n",__rdtsc(), bit_id); */
-
-        txsync_reached_donetime =  __rdtscp( &sync_junk);
-
-        bool sync_complete = false;
-        int llc_hit_count = 0;
-        while(!sync_complete){
-        
-          //a. Flush addr where Rx will communicate it has reached barrier (sync_rxready_addr)
-          _mm_clflush(&sync_rxready_page[0]);
-          _mm_clflush(&sync_rxready_page1[0]);
-          _mm_clflush(&sync_rxready_page2[0]);
-        
-          //z. Communicate that Tx has reached barrier
-          sync_temp += *sync_txready_addr;
-          sync_temp += *sync_txready_addr1;
-          sync_temp += *sync_txready_addr2;
-
-          //b. Sleep
-          delayloop(1000);
-        
-          //c. Reload and Check latency of sync_rxready_addr
-          sync_time0 = __rdtscp( &sync_junk); /* READ TIMER */
-          sync_temp = *sync_rxready_addr;
-          sync_delta_time0 = __rdtscp(&sync_junk) - sync_time0; /* READ TIMER & COMPUTE ELAPSED TIME */
-        
-          sync_time1 = __rdtscp( &sync_junk); /* READ TIMER */
-          sync_temp1 = *sync_rxready_addr1;
-          sync_delta_time1 = __rdtscp(&sync_junk) - sync_time1; /* READ TIMER & COMPUTE ELAPSED TIME */
-        
-          sync_time2 = __rdtscp( &sync_junk); /* READ TIMER */
-          sync_temp2 = *sync_rxready_addr2;
-          sync_delta_time2 = __rdtscp(&sync_junk) - sync_time2; /* READ TIMER & COMPUTE ELAPSED TIME */
-
-          //d. Synchronization Condition
-          //if rx_ready has 2 LLC hit, Rx reached barrier
-          if(sync_delta_time0<LLC_HIT_THRESHOLD_CYCLES_SYNC)
-            llc_hit_count++;
-          if(sync_delta_time1<LLC_HIT_THRESHOLD_CYCLES_SYNC)
-            llc_hit_count++;        
-          if(sync_delta_time2<LLC_HIT_THRESHOLD_CYCLES_SYNC)
-            llc_hit_count++;        
-        
-          if(llc_hit_count >= 2) 
-            sync_complete=true;
-
-        }
-        txsync_complete_donetime =  __rdtscp( &sync_junk);
-
-      
-        txsync_reached_timevec.push_back(txsync_reached_donetime);
-        txsync_complete_timevec.push_back(txsync_complete_donetime);
-      
-#endif
-      }            
+    for(int l=1; l<num_lanes; l++)
+      pthread_join(tx_lanes[l].thread, NULL);
+    uint64_t tx_cycles = timer_cycles() - tx_start_cycles, tx_wall_ns = timer_wall_ns() - tx_wall_start_ns;
+
+    printf("Sending Done: %llu bits. Bit Period: %.1f cycles or %.4fus (TSC: %.1f MHz). Wall-Clock: %.4f s, %.4fus per bit.\n",
+           TRANSMITTED_BITS, 1.0*tx_cycles/TRANSMITTED_BITS, timer_cycles_to_us(1.0*tx_cycles/TRANSMITTED_BITS),
+           sys_timer.tsc_mhz, tx_wall_ns/1e9, tx_wall_ns/1000.0/TRANSMITTED_BITS);
+    struct fr_barrier_stats barrier_stats = {};
+    struct epoch_stats epoch_stats = {};
+    for(int l=0; l<num_lanes; l++){
+      fr_barrier_stats_add(&barrier_stats, &tx_lanes[l].barrier.stats);
+      epoch_stats_add(&epoch_stats, &tx_lanes[l].epochs.stats);
     }
+    if(params.sync_mode == SYNC_DEADLINE)
+      epoch_print("Tx", &epoch_stats, tx_cycles*num_lanes);
+    else
+      fr_barrier_print("Tx", &barrier_stats, tx_cycles*num_lanes);
 
     printf("Sender finished\n");
     return 0;
@@ -0,0 +1,233 @@
+// Copyright (C) 2020, Gururaj Saileshwar
+
+// Commentary:
+// The region shared by the sender and the receiver (sync pages and shared
+// array), and how it is backed (-M):
+// - file:      the shared file, mapped as 4 KB page-cache pages.
+// - thp:       the shared file, mapped at a 2 MB-aligned address, prefaulted
+//              (MAP_POPULATE) and advised to huge pages (MADV_HUGEPAGE, then
+//              MADV_COLLAPSE where the kernel has it). Page-cache huge pages
+//              need a kernel with read-only file THP (CONFIG_READ_ONLY_THP_FOR_FS).
+// - hugetlbfs: a shared file of its own on a hugetlbfs mount (-f, default
+//              REGION_HUGETLBFS_PATH), i.e. reserved huge pages
+//              (/proc/sys/vm/nr_hugepages).
+// - memfd:     an in-memory region of one process, i.e. of the simulated
+//              sender and receiver of sim_channel (their default).
+// The receiver loop crosses a page every couple of dozen bits, so with 4 KB
+// pages its timed loads also time dTLB misses.
+//
+// Whatever was asked for, region_map() reports how much of the region the
+// kernel actually backs with huge pages (from /proc/self/smaps).
+
+#ifndef SHARED_REGION_H_
+#define SHARED_REGION_H_
+
+#include <sys/mman.h>
+#include <sys/vfs.h>
+
+#include "utils.hh"
+#include "host.hh"
+
+#define REGION_HUGE_PAGE_SZ (2*1024*1024)
+#define REGION_HUGETLBFS_PATH ("/dev/hugepages/streamline_shared_region")
+#define REGION_HUGETLBFS_MAGIC (0x958458f6)
+#ifndef MADV_COLLAPSE
+#define MADV_COLLAPSE (25)
+#endif
+
+// Backends (0 is left for the default of the program)
+enum region_backend {
+  REGION_DEFAULT = 0,
+  REGION_FILE = 1,
+  REGION_FILE_THP = 2,
+  REGION_HUGETLBFS = 3,
+  REGION_MEMFD = 4,
+};
+#define REGION_NUM_BACKENDS (5)
+static const char* region_backend_names[REGION_NUM_BACKENDS] = {"default", "file", "thp", "hugetlbfs", "memfd"};
+
+struct shared_region {
+  enum region_backend backend;
+  const char* path;       //backing file (NULL: memfd)
+  uint8_t* addr;
+  uint64_t size;
+  //From /proc/self/smaps
+  uint64_t huge_bytes;    //backed by huge pages
+  uint64_t resident_bytes;
+  uint64_t page_size;     //kernel page size of the mapping
+};
+
+/*
+ * Backend from its name or number, or REGION_DEFAULT if unknown.
+ */
+static enum region_backend region_backend_parse(const char* arg)
+{
+  for(int b=1; b<REGION_NUM_BACKENDS; b++)
+    if(strcmp(arg, region_backend_names[b]) == 0 || atoi(arg) == b)
+      return (enum region_backend) b;
+  return REGION_DEFAULT;
+}
+
+/*
+ * Reads the huge-page, resident and page-size counters of the mappings of r from /proc/self/smaps.
+ */
+static void region_check_huge(struct shared_region* r)
+{
+  r->huge_bytes = r->resident_bytes = r->page_size = 0;
+  FILE* f = fopen("/proc/self/smaps", "r");
+  if(f == NULL)
+    return;
+  uint64_t start = (uint64_t) r->addr, end = start + r->size;
+  bool in = false;
+  char line[512];
+  while(fgets(line, sizeof(line), f)){
+    unsigned long long lo, hi, kb;
+    char perm[8], key[64];
+    if(sscanf(line, "%llx-%llx %7s", &lo, &hi, perm) == 3){
+      in = (lo < end && hi > start);
+      continue;
+    }
+    if(!in || sscanf(line, "%63[^:]: %llu kB", key, &kb) != 2)
+      continue;
+    if(strcmp(key, "AnonHugePages") == 0 || strcmp(key, "ShmemPmdMapped") == 0 ||
+       strcmp(key, "FilePmdMapped") == 0 || strcmp(key, "Shared_Hugetlb") == 0 ||
+       strcmp(key, "Private_Hugetlb") == 0)
+      r->huge_bytes += kb*1024;
+    else if(strcmp(key, "Rss") == 0)
+      r->resident_bytes += kb*1024;
+    else if(strcmp(key, "KernelPageSize") == 0 && kb*1024 > r->page_size)
+      r->page_size = kb*1024;
+  }
+  fclose(f);
+  //Hugetlb pages are not in Rss
+  if(r->resident_bytes < r->huge_bytes)
+    r->resident_bytes = r->huge_bytes;
+}
+
+/*
+ * Maps fd (size bytes, read-only) at an address aligned to a huge page, so
+ * that huge pages of the file can be mapped as such. Returns MAP_FAILED on failure.
+ */
+static void* region_mmap_aligned(int fd, uint64_t size, int flags)
+{
+  uint8_t* reserve = (uint8_t*) mmap(NULL, size + REGION_HUGE_PAGE_SZ, PROT_NONE,
+                                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if(reserve == MAP_FAILED)
+    return MAP_FAILED;
+  uint8_t* aligned = (uint8_t*)(((uint64_t) reserve + REGION_HUGE_PAGE_SZ - 1) & ~(uint64_t)(REGION_HUGE_PAGE_SZ - 1));
+  //Give back the unaligned head and the tail of the reservation
+  if(aligned > reserve)
+    munmap(reserve, aligned - reserve);
+  munmap(aligned + size, reserve + REGION_HUGE_PAGE_SZ - aligned);
+  return mmap(aligned, size, PROT_READ, flags | MAP_FIXED, fd, 0);
+}
+
+/*
+ * Opens the hugetlbfs file at path, creating or growing it to size (rounded
+ * up to huge pages) under an exclusive lock. Returns -1 on failure.
+ */
+static int region_hugetlbfs_open(const char* path, uint64_t* size)
+{
+  int fd = open(path, O_RDWR | O_CREAT, 0644);
+  struct statfs sfs;
+  struct stat st;
+  if(fd == -1 || fstatfs(fd, &sfs) != 0 || flock(fd, LOCK_EX) != 0 || fstat(fd, &st) != 0){
+    perror(path);
+    return -1;
+  }
+  if(sfs.f_type != REGION_HUGETLBFS_MAGIC){
+    printf("%s is not on a hugetlbfs mount\n", path);
+    close(fd);
+    return -1;
+  }
+  *size = (*size + sfs.f_bsize - 1)/sfs.f_bsize*sfs.f_bsize;
+  if((uint64_t)st.st_size < *size){
+    //hugetlbfs has no write(): fill the new pages through a mapping
+    printf("Shared file %s: writing %.1f MB of %llu KB pages\n", path, (*size - st.st_size)/1024.0/1024.0,
+           (uint64_t) sfs.f_bsize/1024);
+    uint64_t* fill = (ftruncate(fd, *size) == 0) ?
+      (uint64_t*) mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : (uint64_t*) MAP_FAILED;
+    if(fill == MAP_FAILED){
+      perror("Not enough huge pages (see /proc/sys/vm/nr_hugepages)");
+      close(fd);
+      return -1;
+    }
+    uint64_t x = HOST_FILE_SEED ^ st.st_size;
+    host_random_fill(fill + st.st_size/sizeof(uint64_t), (*size - st.st_size)/sizeof(uint64_t), &x);
+    munmap(fill, *size);
+  }
+  flock(fd, LOCK_UN);
+  return fd;
+}
+
+/*
+ * Maps size bytes of the shared region with backend b (path: the shared file,
+ * NULL for the backend's default). Exits on failure.
+ */
+static void region_map(struct shared_region* r, enum region_backend b, const char* path, uint64_t size)
+{
+  r->backend = b;
+  r->size = size;
+  r->path = NULL;
+  void* addr = MAP_FAILED;
+  int fd = -1;
+  switch(b){
+  case REGION_FILE:
+  case REGION_FILE_THP:
+    r->path = path ? path : SHARED_READONLY_FILE_PATH;
+    fd = host_shared_file_open(r->path, size);
+    if(fd == -1)
+      break;
+    if(b == REGION_FILE)
+      addr = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    else {
+      addr = region_mmap_aligned(fd, size, MAP_SHARED | MAP_POPULATE);
+      if(addr != MAP_FAILED){
+        madvise(addr, size, MADV_HUGEPAGE);
+        madvise(addr, size, MADV_COLLAPSE);   //synchronous, where supported (otherwise left to khugepaged)
+      }
+    }
+    break;
+  case REGION_HUGETLBFS:
+    r->path = path ? path : REGION_HUGETLBFS_PATH;
+    fd = region_hugetlbfs_open(r->path, &r->size);
+    if(fd != -1)
+      addr = mmap(NULL, r->size, PROT_READ, MAP_SHARED | MAP_POPULATE, fd, 0);
+    break;
+  case REGION_MEMFD:
+#ifdef SIM_BACKEND
+    addr = sim_shared_region(size);
+#else
+    printf("The memfd region is for a sender and a receiver in one process (sim_channel)\n");
+    exit(1);
+#endif
+    break;
+  default:
+    break;
+  }
+  if(fd != -1)
+    close(fd);
+  if(addr == MAP_FAILED){
+    printf("Failed to Map the shared region (%s%s%s)\n", region_backend_names[b],
+           r->path ? ": " : "", r->path ? r->path : "");
+    exit(1);
+  }
+  r->addr = (uint8_t*) addr;
+  region_check_huge(r);
+}
+
+static void region_print(const struct shared_region* r)
+{
+  printf("Region: %s%s%s, %.1f MB, %.1f MB resident, %.1f MB (%.1f%%) in huge pages, %llu KB pages.\n",
+         region_backend_names[r->backend], r->path ? " " : "", r->path ? r->path : "",
+         r->size/1024.0/1024.0, r->resident_bytes/1024.0/1024.0, r->huge_bytes/1024.0/1024.0,
+         100.0*r->huge_bytes/r->size, r->page_size/1024);
+  if((r->backend == REGION_FILE_THP || r->backend == REGION_HUGETLBFS) &&
+     r->huge_bytes < (r->size & ~(uint64_t)(REGION_HUGE_PAGE_SZ - 1)))
+    printf("Warning: only %.1f%% of the shared region is in huge pages.\n", 100.0*r->huge_bytes/r->size);
+}
+
+#endif
+
+//
+// shared_region.hh ends here
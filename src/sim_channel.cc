@@ -0,0 +1,132 @@
+// Copyright (C) 2020, Gururaj Saileshwar
+
+// Commentary:
+// Simulated channel: the sender and the receiver (sender.cc and receiver.cc,
+// unchanged) run as two threads of one process, built with the simulator
+// memory backend (-DSIM_BACKEND, see mem_backend.hh and cache_sim.hh). They
+// share an anonymous region instead of the shared file, and run on the
+// simulated cores of their usual CPU ids, so no Intel hardware, shared LLC or
+// root privileges are needed and a run is deterministic.
+//
+// Usage: sim_channel [simulator options] [-- options for sender and receiver]
+//
+
+#include "utils.hh"
+#include "fr_util.hh"
+#include "payload.hh"
+#include "rx_stream.hh"
+#include "rx_decoder.hh"
+#include "lanes.hh"
+#include "addr_schedule.hh"
+#include "results.hh"
+
+#ifndef SIM_BACKEND
+#error "sim_channel.cc needs the simulator memory backend (-DSIM_BACKEND)"
+#endif
+
+//The programs, each in its own namespace (their globals have the same names)
+namespace sim_tx {
+#define main sender_main
+#include "sender.cc"
+#undef main
+}
+
+namespace sim_rx {
+#define main receiver_main
+#include "receiver.cc"
+#undef main
+}
+
+struct sim_program {
+  int (*main)(int, char**);
+  int argc;
+  char** argv;
+  int ret;
+};
+
+static void* sim_program_thread(void* arg)
+{
+  struct sim_program* prog = (struct sim_program*) arg;
+  prog->ret = prog->main(prog->argc, prog->argv);
+  return NULL;
+}
+
+/*
+ * Prints help menu
+ */
+static void print_sim_help()
+{
+  printf("Usage: sim_channel [simulator options] [-- options for sender and receiver]\n"
+         "-c,\tLLC size (KB)\n"
+         "-w,\tLLC associativity\n"
+         "-p,\tLLC replacement policy: lru, srrip or random\n"
+         "-t,\tMean latencies (cycles) of L1,L2,LLC,memory\n"
+         "-j,\tStandard deviation of the latencies of L1,L2,LLC,memory\n"
+         "-s,\tSeed\n");
+}
+
+static void parse_levels(const char* arg, uint64_t* values)
+{
+  if(sscanf(arg, "%llu,%llu,%llu,%llu", &values[SIM_L1], &values[SIM_L2], &values[SIM_LLC], &values[SIM_MEM]) != 4){
+    printf("Expected 4 values (L1,L2,LLC,memory): %s\n", arg);
+    exit(1);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  struct sim_config cfg;
+  sim_config_init(&cfg, CACHE_SZ);
+
+  int option;
+  while ((option = getopt(argc, argv, "c:w:p:t:j:s:h")) != -1) {
+    switch (option) {
+    case 'c': cfg.size[SIM_LLC] = strtoull(optarg, NULL, 10)*1024; break;
+    case 'w': cfg.ways[SIM_LLC] = strtoull(optarg, NULL, 10); break;
+    case 'p':
+      if(strcmp(optarg, "lru") == 0)
+        cfg.llc_repl = SIM_REPL_LRU;
+      else if(strcmp(optarg, "srrip") == 0)
+        cfg.llc_repl = SIM_REPL_SRRIP;
+      else if(strcmp(optarg, "random") == 0)
+        cfg.llc_repl = SIM_REPL_RANDOM;
+      else {
+        printf("Unknown replacement policy %s\n", optarg);
+        exit(1);
+      }
+      break;
+    case 't': parse_levels(optarg, cfg.lat); break;
+    case 'j': parse_levels(optarg, cfg.jitter); break;
+    case 's': cfg.seed = strtoull(optarg, NULL, 10); break;
+    default:
+      print_sim_help();
+      exit(1);
+    }
+  }
+  if(cfg.ways[SIM_LLC] == 0 || cfg.size[SIM_LLC] < cfg.ways[SIM_LLC]*SIM_LINE_SZ){
+    printf("Invalid LLC: %llu KB, %llu-way\n", cfg.size[SIM_LLC]/1024, cfg.ways[SIM_LLC]);
+    exit(1);
+  }
+  sim_init(&cfg);
+
+  //Options after "--" go to both programs
+  char** prog_argv = (char**) calloc(argc - optind + 2, sizeof(char*));
+  prog_argv[0] = argv[0];
+  for(int i=optind; i<argc; i++)
+    prog_argv[i - optind + 1] = argv[i];
+  int prog_argc = argc - optind + 1;
+
+  struct sim_program rx = {sim_rx::receiver_main, prog_argc, prog_argv, 0};
+  struct sim_program tx = {sim_tx::sender_main, prog_argc, prog_argv, 0};
+  pthread_t rx_thread, tx_thread;
+  if(pthread_create(&rx_thread, NULL, sim_program_thread, &rx) != 0 ||
+     pthread_create(&tx_thread, NULL, sim_program_thread, &tx) != 0){
+    printf("Failed to create the sender and receiver threads\n");
+    exit(1);
+  }
+  pthread_join(tx_thread, NULL);
+  pthread_join(rx_thread, NULL);
+
+  sim_print_stats();
+  return rx.ret | tx.ret;
+}
@@ -0,0 +1,228 @@
+// Copyright (C) 2020, Gururaj Saileshwar
+
+// Commentary:
+// Soft-decision decoding of the (72,64) ECC blocks from the receiver's
+// latencies (-C <flips>).
+//
+// The decoder thread thresholds every latency into a bit, and also keeps how
+// reliable the bit is: the distance of the latency from the threshold, in
+// standard deviations of the cluster (hits or misses) on its side, as fitted
+// on the training bits of the epoch (see training.hh). That is the distance
+// the threshold itself balances, so a bit at the threshold has reliability 0.
+// Without training bits, the deviation is SOFT_DEFAULT_DEV cycles. Erasures
+// (see pilot.hh) have reliability 0.
+//
+// A block whose hard decoding detects errors is decoded again (Chase-II): the
+// <flips> least reliable of its 72 bits are flipped in each of the 2^<flips>
+// combinations, every test pattern is hard-decoded, and the codeword closest
+// to the received bits, weighing each differing bit by its reliability, wins.
+// SEC-DED corrects 1 error per block and detects 2; with the test patterns,
+// errors on the unreliable bits no longer count. A codeword further than
+// CHASE_MAX_DISTANCE from the received bits is not taken (other than the hard
+// decoding's): the errors of a burst, when the receiver ran ahead of the
+// sender, are reliable misses, and flipping more bits only adds to them. The blocks are handed over
+// as hard bits with reliabilities (struct soft_block), so other soft-input
+// codes can take the place of the (72,64) one.
+
+#ifndef SOFT_DECODE_H_
+#define SOFT_DECODE_H_
+
+#include "utils.hh"
+#include "payload.hh"
+#include "fec_secded7264.hh"
+#include "training.hh"
+
+// Reliability units per standard deviation (saturated at 255)
+#define SOFT_REL_SCALE (32)
+#define SOFT_REL_MAX (255)
+// Deviation of both clusters (cycles) without training bits
+#define SOFT_DEFAULT_DEV (16)
+// Test patterns: 2^flips, flips up to CHASE_MAX_FLIPS
+#define CHASE_MAX_FLIPS (8)
+// Soft distance of a codeword from the received bits, at most (3 deviations)
+#define CHASE_MAX_DISTANCE (3*SOFT_REL_SCALE)
+// Bits of a (72,64) block: 8 parity bits, then 64 data bits (as laid out in the stream)
+#define SOFT_BLOCK_BITS (72)
+#define SOFT_PARITY_BITS (8)
+
+// Reliability model of an epoch: threshold, and reliability units per cycle on each side of it
+struct soft_model {
+  uint64_t threshold;
+  double scale[2];
+};
+
+// A received block: hard bits and their reliabilities, in stream order
+struct soft_block {
+  uint64_t data;
+  uint8_t parity;
+  const uint8_t* rel;
+};
+
+// Blocks decoded with test patterns
+struct soft_stats {
+  uint64_t chased;            //blocks whose hard decoding detected errors
+  uint64_t changed;           //of which decoded to another codeword than the hard decoding
+  uint64_t hard_good_blks;    //blocks without errors after hard decoding (of every block)
+  uint64_t hard_bit_errors;   //data bits in error after hard decoding
+};
+
+/*
+ * Model with the threshold (net cycles) and the default deviation.
+ */
+static void soft_model_init(struct soft_model* m, uint64_t threshold)
+{
+  m->threshold = threshold;
+  m->scale[0] = m->scale[1] = 1.0*SOFT_REL_SCALE/SOFT_DEFAULT_DEV;
+}
+
+/*
+ * Model of a training fit (raw cycles, overhead: timer overhead).
+ */
+static void soft_model_fit(struct soft_model* m, const struct train_fit* fit, uint64_t overhead)
+{
+  m->threshold = fit->threshold > overhead ? fit->threshold - overhead : 0;
+  for(int c=0; c<2; c++)
+    m->scale[c] = 1.0*SOFT_REL_SCALE/(fit->dev[c] > 1 ? fit->dev[c] : 1);
+}
+
+/*
+ * Reliability of a bit of latency (net cycles).
+ */
+static inline uint8_t soft_reliability(const struct soft_model* m, uint64_t latency)
+{
+  double r = (latency > m->threshold) ? (latency - m->threshold)*m->scale[1] : (m->threshold - latency)*m->scale[0];
+  return (r < SOFT_REL_MAX) ? (uint8_t) r : SOFT_REL_MAX;
+}
+
+/*
+ * Soft distance of the codeword (data, parity) from the block: the
+ * reliabilities of the bits that differ.
+ */
+static uint64_t soft_distance(const struct soft_block* b, uint64_t data, uint8_t parity)
+{
+  uint64_t dist = 0;
+  for(uint8_t diff = parity ^ b->parity; diff; diff &= diff - 1)
+    dist += b->rel[SOFT_PARITY_BITS - 1 - __builtin_ctz(diff)];
+  for(uint64_t diff = data ^ b->data; diff; diff &= diff - 1)
+    dist += b->rel[SOFT_BLOCK_BITS - 1 - __builtin_ctzll(diff)];
+  return dist;
+}
+
+/*
+ * Chase-II decoding of a (72,64) block with 2^flips test patterns. Returns
+ * false (data unchanged) if no test pattern decodes close enough.
+ */
+static bool chase_decode_secded7264(const struct soft_block* b, int flips, uint64_t* data)
+{
+  //Least reliable bits, in increasing reliability
+  int pos[CHASE_MAX_FLIPS];
+  int n = 0;
+  for(int i=0; i<SOFT_BLOCK_BITS; i++){
+    if(n == flips && (n == 0 || b->rel[i] >= b->rel[pos[n-1]]))
+      continue;
+    int k = (n < flips) ? n++ : n - 1;
+    for(; k > 0 && b->rel[pos[k-1]] > b->rel[i]; k--)
+      pos[k] = pos[k-1];
+    pos[k] = i;
+  }
+
+  //Test patterns, hard-decoded as a batch
+  uint64_t cand[1 << CHASE_MAX_FLIPS];
+  uint8_t cand_parity[1 << CHASE_MAX_FLIPS], enc_parity[1 << CHASE_MAX_FLIPS];
+  unsigned char flags[1 << CHASE_MAX_FLIPS];
+  unsigned int patterns = 1u << n;
+  for(unsigned int t=0; t<patterns; t++){
+    cand[t] = b->data;
+    cand_parity[t] = b->parity;
+    for(int j=0; j<n; j++){
+      if(!(t & (1u << j)))
+        continue;
+      if(pos[j] < SOFT_PARITY_BITS)
+        cand_parity[t] ^= 1u << (SOFT_PARITY_BITS - 1 - pos[j]);
+      else
+        cand[t] ^= (uint64_t)1 << (SOFT_BLOCK_BITS - 1 - pos[j]);
+    }
+  }
+  fec_secded7264_decode_words(patterns, cand, cand_parity, flags);
+  fec_secded7264_encode_words(patterns, cand, enc_parity);
+
+  //Closest codeword (the first pattern is the hard decoding)
+  bool found = false;
+  uint64_t best = CHASE_MAX_DISTANCE + 1;
+  for(unsigned int t=0; t<patterns; t++){
+    if(flags[t] > 1)
+      continue;
+    if(t == 0)
+      best = UINT64_MAX;
+    uint64_t dist = soft_distance(b, cand[t], enc_parity[t]);
+    if(dist < best){
+      best = dist;
+      *data = cand[t];
+      found = true;
+    }
+  }
+  return found;
+}
+
+/*
+ * Decodes num consecutive blocks (data and parity, and the reliabilities of
+ * their bits rel) with 2^flips test patterns: the data of the blocks whose
+ * hard decoding detects errors are replaced by the Chase decoding.
+ * hard_data: the data after hard decoding. flags: the SEC-DED flags of the
+ * blocks (see fec_secded7264.hh), 1 for the blocks the Chase decoding decoded.
+ */
+static void soft_decode_blocks(unsigned int num, uint64_t* data, const uint8_t* parity, const uint8_t* rel,
+                               int flips, uint64_t* hard_data, unsigned char* flags, struct soft_stats* st)
+{
+  memcpy(hard_data, data, num*sizeof(uint64_t));
+  fec_secded7264_decode_words(num, hard_data, parity, flags);
+  for(unsigned int k=0; k<num; k++){
+    uint64_t decoded = hard_data[k];
+    if(flags[k]){
+      struct soft_block b = {data[k], parity[k], rel + k*SOFT_BLOCK_BITS};
+      st->chased++;
+      if(chase_decode_secded7264(&b, flips, &decoded)){
+        flags[k] = 1;
+        st->changed += (decoded != hard_data[k]);
+      }
+    }
+    data[k] = decoded;
+  }
+}
+
+/*
+ * Error-free blocks, and data bits in error, of the hard decoding (given the
+ * expected data).
+ */
+static void soft_stats_add_hard(struct soft_stats* st, unsigned int num, const uint64_t* tx_data,
+                                const uint64_t* hard_data)
+{
+  for(unsigned int k=0; k<num; k++){
+    int errors = __builtin_popcountll(tx_data[k] ^ hard_data[k]);
+    st->hard_good_blks += (errors == 0);
+    st->hard_bit_errors += errors;
+  }
+}
+
+/*
+ * Goodput (bits per second of data in error-free blocks) of good_blks out of
+ * tot_blks, at bps.
+ */
+static inline double soft_goodput(uint64_t good_blks, uint64_t tot_blks, double bps)
+{
+  return tot_blks ? bps*good_blks/tot_blks : 0;
+}
+
+static void soft_print(const struct soft_stats* s, int flips, uint64_t good_blks, uint64_t bit_errors,
+                       uint64_t tot_blks, double bps)
+{
+  printf("Soft Decoding: %d flips, %llu blocks decoded with test patterns (%llu changed). Error-free blocks: %llu hard,"
+         " %llu soft (of %llu). Data bits in error: %llu hard, %llu soft. Goodput: %.4f bps hard, %.4f bps soft.\n",
+         flips, s->chased, s->changed, s->hard_good_blks, good_blks, tot_blks, s->hard_bit_errors, bit_errors,
+         soft_goodput(s->hard_good_blks, tot_blks, bps), soft_goodput(good_blks, tot_blks, bps));
+}
+
+#endif
+
+//
+// soft_decode.hh ends here
@@ -0,0 +1,266 @@
+// Copyright (C) 2020, Gururaj Saileshwar
+
+// Commentary:
+// Adaptive sync period (-D <max period>[,<target error %>]): the barrier runs
+// at the end of every 2^k sync epochs instead of every epoch, and the receiver
+// chooses k at every barrier, for the interval up to the next one: from a
+// single epoch (the sync period, -p) up to <max period> bits.
+//
+// The epochs themselves stay (training bits, thresholds, statistics): only the
+// barriers between them are skipped, which saves their waits and handshakes,
+// but leaves the sender and the receiver to drift apart for longer. Over an
+// interval, the receiver measures:
+// - its errors on the training bits of the epochs, thresholded by their own
+//   fit (see training.hh; a rejected fit counts as half of the bits in error).
+// - the lead it lost to the sender: it reaches a barrier TX_SYNC_LAG_DELTA
+//   bits behind the sender's, and waits for the sender only if the sender
+//   lost that much of its lead. The wait of the last barrier, in bits of the
+//   receiver, is the lead lost in an interval.
+// It doubles the interval after <patience> intervals in a row with errors below
+// half the target, if the lead lost stays below a quarter of TX_SYNC_LAG_DELTA
+// (half of it over twice the bits), halves it after errors above the target or
+// a loss above half of TX_SYNC_LAG_DELTA, and goes back to a single epoch after
+// a barrier timeout, or a slip (with pilots, see pilot.hh). The patience starts
+// at 1, and doubles whenever the interval right after a growth is cut again
+// (up to SYNC_ADAPT_MAX_PATIENCE), so the interval settles below the length
+// the channel does not stand, instead of trying it over and over.
+//
+// The receiver sends k to the sender at the barrier, on lines of its sync pages
+// (between the lines of the barrier and the pilot markers), in a thermometer
+// code: it loads the lines of the levels k and above along with its ready
+// lines (fr_barrier_keep), so before them. The sender, once it has seen the
+// receiver ready, reloads and flushes them, and takes the lowest level whose
+// lines hit (a majority of the pages), or the highest one. A line evicted
+// before the sender reads it can only make its interval longer: the receiver
+// then times out of the barriers the sender skips, goes back to a single
+// epoch, and they meet again at the sender's next barrier. (A shorter one
+// would leave the sender waiting at a barrier the receiver skipped.)
+
+#ifndef SYNC_ADAPT_H_
+#define SYNC_ADAPT_H_
+
+#include "utils.hh"
+#include "params.hh"
+#include "fr_barrier.hh"
+#include "training.hh"
+
+// Intervals of 1 to 2^(SYNC_ADAPT_LEVELS - 1) epochs
+#define SYNC_ADAPT_LEVELS (8)
+// Lines of level k: on each of the receiver's sync pages, at SYNC_ADAPT_LINE_OFFSET + k x SYNC_ADAPT_LINE_STRIDE
+#define SYNC_ADAPT_LINE_OFFSET (128)
+#define SYNC_ADAPT_LINE_STRIDE (512)
+#define SYNC_ADAPT_VOTES (FR_BARRIER_SYNC_PAGES/2 + 1)
+// Good intervals in a row before a growth, at most
+#define SYNC_ADAPT_MAX_PATIENCE (64)
+
+// Intervals chosen by the receiver
+struct sync_adapt_stats {
+  uint64_t barriers;
+  uint64_t epochs;            //of the intervals chosen at the barriers
+  uint64_t longest;           //epochs
+  uint64_t grown, shrunk, resets;
+  uint64_t train_errors, train_samples;
+};
+
+struct sync_adapt {
+  volatile uint64_t* line[SYNC_ADAPT_LEVELS][FR_BARRIER_SYNC_PAGES];
+  volatile uint64_t* vote[SYNC_ADAPT_LEVELS*FR_BARRIER_SYNC_PAGES];  //Rx: lines of the levels it sends
+  int max_level, level;
+  uint64_t next_epoch;        //epoch at the end of which the next barrier runs
+  uint64_t threshold;         //hit/miss threshold of the reloads
+  double target;              //training errors (%)
+  //Rx: measurements of the current interval
+  uint64_t train_errors, train_samples;
+  uint64_t lead_lost;         //bits, at the last barrier
+  uint64_t last_bit, last_time; //last barrier: bit and exit
+  bool reset;
+  uint64_t patience, good;    //good intervals before a growth, and in a row
+  bool grown;                 //the current interval is a growth
+  struct sync_adapt_stats stats;
+};
+
+/*
+ * Lines of the levels on the receiver's sync pages (the same for sender and
+ * receiver), and the range and target of p.
+ */
+static void sync_adapt_init(struct sync_adapt* sa, uint64_t* const* rxready_pages, const struct channel_params* p,
+                            uint64_t threshold)
+{
+  memset(sa, 0, sizeof(*sa));
+  for(int k=0; k<SYNC_ADAPT_LEVELS; k++)
+    for(int pg=0; pg<FR_BARRIER_SYNC_PAGES; pg++)
+      sa->line[k][pg] = (uint64_t*) ((uint8_t*) rxready_pages[pg] + SYNC_ADAPT_LINE_OFFSET + k*SYNC_ADAPT_LINE_STRIDE);
+  for(uint64_t period = p->sync_bitfreq; p->sync_adapt_max && period < p->sync_adapt_max; period *= 2)
+    sa->max_level++;
+  sa->threshold = threshold;
+  sa->target = p->sync_adapt_target;
+  sa->patience = 1;
+}
+
+/*
+ * True if the barrier runs at the end of epoch.
+ */
+static inline bool sync_adapt_due(const struct sync_adapt* sa, uint64_t epoch)
+{
+  return epoch >= sa->next_epoch;
+}
+
+/*
+ * Receiver: errors on the n training latencies lat of an epoch.
+ */
+static void sync_adapt_train(struct sync_adapt* sa, const uint16_t* lat, uint64_t n)
+{
+  uint64_t threshold = sa->threshold;
+  uint64_t errors = n/2;
+  if(train_fit_threshold(lat, n, &threshold)){
+    errors = 0;
+    for(uint64_t j=0; j<n; j++)
+      errors += ((lat[j] > threshold) != train_bit(j));
+  }
+  sa->train_errors += errors;
+  sa->train_samples += n;
+}
+
+/*
+ * Receiver: the sender and the receiver drifted apart (a slip, see pilot.hh),
+ * back to a single epoch at the next barrier.
+ */
+static void sync_adapt_reset(struct sync_adapt* sa)
+{
+  sa->reset = true;
+}
+
+/*
+ * Receiver, before its barrier: chooses the level of the next interval from
+ * the current one, and sends it along with its ready lines.
+ */
+static void sync_adapt_choose(struct sync_adapt* sa, struct fr_barrier* barrier)
+{
+  double errors = sa->train_samples ? 100.0*sa->train_errors/sa->train_samples : 0;
+  bool cut = sa->reset || errors > sa->target || sa->lead_lost > TX_SYNC_LAG_DELTA/2;
+  bool good = !cut && 2*errors <= sa->target && 4*sa->lead_lost <= TX_SYNC_LAG_DELTA;
+  if(cut){
+    if(sa->grown && sa->patience < SYNC_ADAPT_MAX_PATIENCE)
+      sa->patience *= 2;
+    if(sa->reset && sa->level > 0){
+      sa->level = 0;
+      sa->stats.resets++;
+    } else if(sa->level > 0){
+      sa->level--;
+      sa->stats.shrunk++;
+    }
+  }
+  sa->good = good ? sa->good + 1 : 0;
+  sa->grown = false;
+  if(sa->good >= sa->patience && sa->level < sa->max_level){
+    sa->level++;
+    sa->stats.grown++;
+    sa->good = 0;
+    sa->grown = true;
+  }
+  sa->stats.train_errors += sa->train_errors;
+  sa->stats.train_samples += sa->train_samples;
+  sa->train_errors = sa->train_samples = 0;
+  sa->reset = false;
+
+  int n = 0;
+  for(int k=sa->level; k<=sa->max_level; k++)
+    for(int pg=0; pg<FR_BARRIER_SYNC_PAGES; pg++)
+      sa->vote[n++] = sa->line[k][pg];
+  fr_barrier_keep(barrier, sa->vote, n);
+}
+
+/*
+ * Receiver, after its barrier at the end of epoch, at bit_id (left: false if
+ * it timed out): the lead the sender lost, and the next barrier.
+ */
+static void sync_adapt_rx(struct sync_adapt* sa, uint64_t epoch, uint64_t bit_id, const struct fr_barrier_times* t,
+                          bool left)
+{
+  uint64_t bits = bit_id - sa->last_bit;
+  uint64_t cycles = t->reached - sa->last_time;
+  if(!left)
+    sa->reset = true;
+  else if(sa->last_time && bits && cycles)
+    sa->lead_lost = (t->start - t->reached)*bits/cycles;
+  sa->last_bit = bit_id;
+  sa->last_time = t->complete;
+
+  uint64_t epochs = (uint64_t)1 << sa->level;
+  sa->next_epoch = epoch + epochs;
+  sa->stats.barriers++;
+  sa->stats.epochs += epochs;
+  if(epochs > sa->stats.longest)
+    sa->stats.longest = epochs;
+}
+
+/*
+ * Sender, before its barrier: flushes the lines of the last one.
+ */
+static void sync_adapt_clear(struct sync_adapt* sa)
+{
+  for(int k=0; k<=sa->max_level; k++)
+    for(int pg=0; pg<FR_BARRIER_SYNC_PAGES; pg++)
+      MEM_CLFLUSH((uint64_t*) sa->line[k][pg]);
+}
+
+/*
+ * Sender, after its barrier at the end of epoch: reads the level the receiver
+ * sent, and the next barrier.
+ */
+static void sync_adapt_tx(struct sync_adapt* sa, uint64_t epoch)
+{
+  unsigned int junk = 0;
+  uint64_t temp = 0;
+  sa->level = sa->max_level;
+  for(int k=sa->max_level; k>=0; k--){
+    int hits = 0;
+    for(int pg=0; pg<FR_BARRIER_SYNC_PAGES; pg++){
+      uint64_t time0 = MEM_RDTSCP(&junk);
+      temp += MEM_LOAD(sa->line[k][pg]);
+      uint64_t delta_time = MEM_RDTSCP(&junk) - time0;
+      MEM_CLFLUSH((uint64_t*) sa->line[k][pg]);
+      hits += (delta_time < sa->threshold);
+    }
+    if(hits >= SYNC_ADAPT_VOTES)
+      sa->level = k;
+  }
+  sa->next_epoch = epoch + ((uint64_t)1 << sa->level);
+}
+
+/*
+ * Adds the counters of a lane's intervals to sum.
+ */
+static void sync_adapt_stats_add(struct sync_adapt_stats* sum, const struct sync_adapt_stats* s)
+{
+  sum->barriers += s->barriers;
+  sum->epochs += s->epochs;
+  if(s->longest > sum->longest)
+    sum->longest = s->longest;
+  sum->grown += s->grown;
+  sum->shrunk += s->shrunk;
+  sum->resets += s->resets;
+  sum->train_errors += s->train_errors;
+  sum->train_samples += s->train_samples;
+}
+
+/*
+ * Average interval between the barriers (bits), for epochs of sync_bitfreq.
+ */
+static double sync_adapt_interval(const struct sync_adapt_stats* s, uint64_t sync_bitfreq)
+{
+  return s->barriers ? 1.0*s->epochs*sync_bitfreq/s->barriers : sync_bitfreq;
+}
+
+static void sync_adapt_print(const struct sync_adapt_stats* s, uint64_t sync_bitfreq)
+{
+  printf("Adaptive Sync: %llu barriers, every %.0f bits on average (longest %llu bits). Intervals grown %llu,"
+         " shrunk %llu, reset %llu times. Training errors: %.2f%%.\n", s->barriers,
+         sync_adapt_interval(s, sync_bitfreq), s->longest*sync_bitfreq, s->grown, s->shrunk, s->resets,
+         s->train_samples ? 100.0*s->train_errors/s->train_samples : 0.0);
+}
+
+#endif
+
+//
+// sync_adapt.hh ends here
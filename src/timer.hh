@@ -0,0 +1,167 @@
+// Copyright (C) 2020, Gururaj Saileshwar
+
+// Commentary:
+// Timer layer: cycle and wall-clock time, and what is known of the timestamp
+// counter (TSC) behind them.
+//
+// timer_init() finds out whether the TSC is invariant (runs at a constant rate
+// whatever the core frequency) and its frequency: from CPUID leaf 0x15 when it
+// reports the crystal clock, otherwise by calibrating the TSC against
+// clock_gettime(). It also measures the overhead of the timed-load sequences:
+// rdtscp; rdtscp (the channel's loops) and lfence; rdtsc; lfence; rdtsc (the
+// initial handshake). Cycle counts convert to time with the measured frequency,
+// instead of the nominal SYS_FREQ_MHZ.
+//
+// With the simulator backend, the TSC is the virtual clock of the simulated
+// core: it runs at the nominal frequency, and the overhead is the simulated
+// cost of a timer read.
+
+#ifndef TIMER_H_
+#define TIMER_H_
+
+#include <time.h>
+#include <cpuid.h>
+#include <algorithm>
+
+#include "mem_backend.hh"
+
+// Calibration against clock_gettime(), and samples of the overhead measurements
+#define TIMER_CALIBRATION_NS (50*1000*1000)
+#define TIMER_OVERHEAD_SAMPLES (10001)
+
+struct timer_info {
+  bool initialized;
+  bool invariant_tsc;
+  double tsc_mhz;
+  const char* tsc_source;     //how tsc_mhz was found
+  uint64_t rdtscp_overhead;   //cycles measured by rdtscp; rdtscp (median)
+  uint64_t fence_overhead;    //cycles measured by lfence; rdtsc; lfence; rdtsc (median)
+};
+static struct timer_info sys_timer;
+
+/*
+ * Cycles (TSC), and wall-clock nanoseconds.
+ */
+inline __attribute__((always_inline))
+uint64_t timer_cycles()
+{
+  unsigned int aux;
+  return MEM_RDTSCP(&aux);
+}
+
+static inline uint64_t timer_wall_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec*1000000000ULL + ts.tv_nsec;
+}
+
+static inline double timer_cycles_to_us(double cycles)
+{
+  return cycles/sys_timer.tsc_mhz;
+}
+
+#ifndef SIM_BACKEND
+/*
+ * TSC frequency from CPUID leaf 0x15 (TSC/crystal ratio and crystal frequency),
+ * or 0 if the processor does not report it.
+ */
+static double timer_cpuid_tsc_mhz()
+{
+  unsigned int eax, ebx, ecx, edx;
+  if(__get_cpuid_max(0, NULL) < 0x15)
+    return 0;
+  __cpuid_count(0x15, 0, eax, ebx, ecx, edx);
+  if(eax == 0 || ebx == 0 || ecx == 0)
+    return 0;
+  return 1.0*ecx*ebx/eax/1e6;
+}
+
+/*
+ * TSC frequency from the cycles elapsed over TIMER_CALIBRATION_NS of clock_gettime().
+ */
+static double timer_calibrate_tsc_mhz()
+{
+  uint64_t ns0 = timer_wall_ns(), c0 = timer_cycles();
+  uint64_t ns1, c1;
+  do {
+    ns1 = timer_wall_ns();
+    c1 = timer_cycles();
+  } while(ns1 - ns0 < TIMER_CALIBRATION_NS);
+  return 1000.0*(c1 - c0)/(ns1 - ns0);
+}
+
+/*
+ * Median cycles measured by an empty timed section, with rdtscp or with lfence; rdtsc.
+ */
+static uint64_t timer_measure_overhead(bool fenced)
+{
+  std::vector<uint64_t> samples(TIMER_OVERHEAD_SAMPLES);
+  unsigned int aux;
+  for(int i=0; i<TIMER_OVERHEAD_SAMPLES; i++){
+    uint64_t t0, t1;
+    if(fenced){
+      _mm_lfence();
+      t0 = __rdtsc();
+      _mm_lfence();
+      t1 = __rdtsc();
+    } else {
+      t0 = __rdtscp(&aux);
+      t1 = __rdtscp(&aux);
+    }
+    samples[i] = t1 - t0;
+  }
+  std::nth_element(samples.begin(), samples.begin() + TIMER_OVERHEAD_SAMPLES/2, samples.end());
+  return samples[TIMER_OVERHEAD_SAMPLES/2];
+}
+#endif
+
+/*
+ * Initializes the timer layer (once); nominal_mhz is used only if the TSC frequency can't be found.
+ */
+static void timer_init(double nominal_mhz)
+{
+  if(sys_timer.initialized)
+    return;
+  sys_timer.initialized = true;
+
+#ifdef SIM_BACKEND
+  sys_timer.invariant_tsc = true;
+  sys_timer.tsc_mhz = nominal_mhz;
+  sys_timer.tsc_source = "simulated";
+  sys_timer.rdtscp_overhead = sim.cfg.timer_cycles;
+  sys_timer.fence_overhead = sim.cfg.timer_cycles;
+#else
+  //Invariant TSC: CPUID 0x80000007, EDX bit 8
+  unsigned int eax, ebx, ecx, edx;
+  sys_timer.invariant_tsc = __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) && (edx & (1 << 8));
+
+  sys_timer.tsc_mhz = timer_cpuid_tsc_mhz();
+  sys_timer.tsc_source = "cpuid";
+  if(sys_timer.tsc_mhz == 0){
+    sys_timer.tsc_mhz = timer_calibrate_tsc_mhz();
+    sys_timer.tsc_source = "calibrated";
+  }
+  if(!(sys_timer.tsc_mhz > 0)){
+    sys_timer.tsc_mhz = nominal_mhz;
+    sys_timer.tsc_source = "nominal";
+  }
+
+  sys_timer.rdtscp_overhead = timer_measure_overhead(false);
+  sys_timer.fence_overhead = timer_measure_overhead(true);
+#endif
+}
+
+static void timer_print()
+{
+  printf("Timer: TSC %.1f MHz (%s), %sinvariant. Overhead: rdtscp %llu cycles, lfence+rdtsc %llu cycles.\n",
+         sys_timer.tsc_mhz, sys_timer.tsc_source, sys_timer.invariant_tsc ? "" : "not ",
+         sys_timer.rdtscp_overhead, sys_timer.fence_overhead);
+  if(!sys_timer.invariant_tsc)
+    printf("Warning: the TSC is not invariant, cycle counts do not convert to time reliably.\n");
+}
+
+#endif
+
+//
+// timer.hh ends here
@@ -0,0 +1,173 @@
+// Copyright (C) 2020, Gururaj Saileshwar
+
+// Commentary:
+// In-band calibration of the hit/miss threshold, once per sync epoch.
+//
+// At the start of every sync epoch (right after the initial handshake, and
+// after every Flush+Reload barrier), the sender transmits params.train_bits
+// bits of a known, balanced pattern before the payload bits of the epoch. They
+// are carried by training lines of their own (the training pages of the lane,
+// see lane_region): bit 0 loads the line, bit 1 loads the private array. The
+// receiver times the training lines and flushes them, so that they are misses
+// again in the next epoch.
+//
+// The receiver's decoder splits the training latencies into two clusters with
+// Otsu's method, and thresholds the bits of the epoch between the cluster means,
+// weighted by their spreads (where overlapping clusters are equally likely). A
+// fit that does not split the samples roughly in half (as the pattern is
+// balanced) is rejected, and the previous threshold is kept.
+
+#ifndef TRAINING_H_
+#define TRAINING_H_
+
+#include <math.h>
+
+#include "utils.hh"
+#include "lanes.hh"
+
+// Training bits per epoch: a multiple of TRAIN_BITS_UNIT, at most one per line of the training pages.
+#define TRAIN_BITS_UNIT (16)
+#define TRAIN_MAX_BITS (LANE_TRAIN_PAGES*CL_IN_PAGE)
+
+// Training pattern (every 16 bits are balanced), first bit in the most-significant position.
+static const uint64_t train_pattern[TRAIN_MAX_BITS/64] = {0xa3362e8e507757c2ULL, 0x5556295d9e58385eULL};
+
+// Latencies above this are outliers (interrupts, page walks), left out of the fit.
+#define TRAIN_LATENCY_MAX (1000)
+// A fit is rejected if a cluster has less than 1/TRAIN_MIN_CLUSTER_FRAC of the samples.
+#define TRAIN_MIN_CLUSTER_FRAC (4)
+
+/*
+ * Bit j of the training pattern.
+ */
+static inline int train_bit(uint64_t j)
+{
+  return (train_pattern[j/64] >> (63 - j%64)) & 1;
+}
+
+/*
+ * Entry of the training pages accessed by training bit j: alternating between
+ * the two pages, 3 lines apart (as the payload schedule), so every bit has its own line.
+ */
+static inline uint64_t train_line_index(uint64_t j)
+{
+  return (j%2)*ENTRY_PER_PAGE + ((j/2)*3 + 14)%CL_IN_PAGE*ENTRY_PER_CL;
+}
+
+// Latency model fitted on the training bits: the clusters of hits (0) and misses (1), and the threshold
+struct train_fit {
+  double mean[2], dev[2];
+  uint64_t threshold;
+};
+
+/*
+ * Fits the latency model on the n training latencies lat (Otsu's method: the
+ * split of the sorted latencies maximizing the between-cluster variance).
+ * Returns false, leaving fit unchanged, if the split is not plausible.
+ */
+static bool train_fit_model(const uint16_t* lat, uint64_t n, struct train_fit* fit)
+{
+  uint16_t s[TRAIN_MAX_BITS];
+  uint64_t m = 0;
+
+  //Insertion sort of the samples, without outliers
+  for(uint64_t i=0; i<n; i++){
+    if(lat[i] > TRAIN_LATENCY_MAX)
+      continue;
+    uint64_t k = m++;
+    for(; k > 0 && s[k-1] > lat[i]; k--)
+      s[k] = s[k-1];
+    s[k] = lat[i];
+  }
+  if(m < 2)
+    return false;
+
+  uint64_t total = 0;
+  for(uint64_t i=0; i<m; i++)
+    total += s[i];
+
+  //Split between s[k-1] and s[k]: hits s[0..k), misses s[k..m)
+  double best = 0;
+  uint64_t best_k = 0, sum = 0;
+  for(uint64_t k=1; k<m; k++){
+    sum += s[k-1];
+    if(s[k] == s[k-1])
+      continue;
+    double mean_hit = 1.0*sum/k;
+    double mean_miss = 1.0*(total - sum)/(m - k);
+    double between = 1.0*k*(m - k)*(mean_miss - mean_hit)*(mean_miss - mean_hit);
+    if(between > best){
+      best = between;
+      best_k = k;
+    }
+  }
+  if(best_k == 0 || best_k*TRAIN_MIN_CLUSTER_FRAC < m || (m - best_k)*TRAIN_MIN_CLUSTER_FRAC < m)
+    return false;
+
+  //Mean and deviation of each cluster
+  double mean[2] = {0, 0}, dev[2] = {0, 0};
+  uint64_t cnt[2] = {best_k, m - best_k};
+  for(uint64_t i=0; i<m; i++)
+    mean[i >= best_k] += s[i];
+  for(int c=0; c<2; c++)
+    mean[c] /= cnt[c];
+  for(uint64_t i=0; i<m; i++)
+    dev[i >= best_k] += (s[i] - mean[i >= best_k])*(s[i] - mean[i >= best_k]);
+  for(int c=0; c<2; c++)
+    dev[c] = sqrt(dev[c]/cnt[c]);
+
+  //Latencies above the threshold are misses
+  if(dev[0] + dev[1] > 0)
+    fit->threshold = mean[0] + (mean[1] - mean[0])*dev[0]/(dev[0] + dev[1]);
+  else
+    fit->threshold = (mean[0] + mean[1])/2;
+  for(int c=0; c<2; c++){
+    fit->mean[c] = mean[c];
+    fit->dev[c] = dev[c];
+  }
+  return true;
+}
+
+/*
+ * Fits the hit/miss threshold on the n training latencies lat (see
+ * train_fit_model). Returns false, leaving threshold unchanged, if the split
+ * is not plausible.
+ */
+static bool train_fit_threshold(const uint16_t* lat, uint64_t n, uint64_t* threshold)
+{
+  struct train_fit fit;
+  if(!train_fit_model(lat, n, &fit))
+    return false;
+  *threshold = fit.threshold;
+  return true;
+}
+
+// Thresholds applied by the decoder.
+struct train_stats {
+  uint64_t epochs;      //epochs with training bits
+  uint64_t rejected;    //fits rejected (previous threshold kept)
+  uint64_t min, max, sum;
+};
+
+static void train_stats_init(struct train_stats* st)
+{
+  memset(st, 0, sizeof(*st));
+  st->min = UINT64_MAX;
+}
+
+static void train_stats_add(struct train_stats* st, uint64_t threshold, bool fitted)
+{
+  st->epochs++;
+  if(!fitted)
+    st->rejected++;
+  if(threshold < st->min)
+    st->min = threshold;
+  if(threshold > st->max)
+    st->max = threshold;
+  st->sum += threshold;
+}
+
+#endif
+
+//
+// training.hh ends here
@@ -43,6 +43,8 @@
 #include <x86intrin.h> /* for rdtscp and clflush */
 #endif
 
+#include "mem_backend.hh" /* for the timer, load and flush primitives (native or simulated) */
+#include "timer.hh" /* for the TSC frequency, timer overheads and wall-clock time */
 #include "mastik.hh" /* for a helper function: delayloop(cycles)  */
 #include "bits_util.hh" /* for converting string to bits. */
 #include "fec_secded7264.hh"  /* for ECC (Hamming Codes 72,64) */
@@ -54,22 +56,24 @@
  */
 
 //SYSTEM-SPECIFIC DEFINES
+// LLC size of the specialized loops, and fallback if it can't be found (see host.hh)
+#ifndef CACHE_SZ
 #define CACHE_SZ (8*1024*1024)
-#define SYS_FREQ_MHZ (3900)
-#define LLC_MISS_THRESHOLD_CYCLES (180)
-#define SHARED_READONLY_FILE_PATH ("/home/gururaj/Documents/Research/streamline/PUBLIC_ASPLOS21_REPO/streamline_two/shared_readonly_file.txt")
+#endif
+#define SYS_FREQ_MHZ (3900) /* nominal: only used if the TSC frequency can't be found (see timer.hh) */
+#define LLC_MISS_THRESHOLD_CYCLES (180) /* fallback: the threshold is probed at startup (see host.hh) */
+#define SHARED_READONLY_FILE_PATH ("shared_readonly_file.txt") /* relative to the working directory, created if missing */
 
 // Other Sizes
 #define PAGE_SZ (4*1024)
 #define CACHELINE_SZ (64)
 #define CL_IN_PAGE (PAGE_SZ/CACHELINE_SZ)
 #define ARRENTRY_SZ (8)
-#ifndef ARRAYSZ_PER_CACHESZ
-#define SHARED_ARRAY_SZ ((uint64_t)((2*CACHE_SZ*4)))
-#else
-#define SHARED_ARRAY_SZ ((uint64_t)((ARRAYSZ_PER_CACHESZ*CACHE_SZ)))
-#endif
-#define SHARED_ARRAY_NUMENTRIES ((uint64_t)(SHARED_ARRAY_SZ/ARRENTRY_SZ))
+// Shared-array size (a runtime parameter, see params.hh) in multiples of the LLC size, to entries
+#define ARRAYSZ_2_NUMENTRIES_LLC(x, llc_sz) ((uint64_t)((x)*(llc_sz))/ARRENTRY_SZ)
+#define ARRAYSZ_2_NUMENTRIES(x) ARRAYSZ_2_NUMENTRIES_LLC(x, CACHE_SZ)
+// Shared-file size for a shared array (and the pages before it)
+#define FILE_SIZE(array_numentries)	((uint64_t)((array_numentries)*ARRENTRY_SZ + 1024*1024))
 #define ENTRY_PER_PAGE (PAGE_SZ/ARRENTRY_SZ)
 #define ENTRY_PER_CL (CACHELINE_SZ/ARRENTRY_SZ)
 // Offsets for Addresses in Shared File (used for communication)